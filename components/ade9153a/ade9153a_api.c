@@ -282,6 +282,45 @@ bool ade9153a_apply_acal(ade9153a_t *dev, float aicc, float avcc)
     return true;
 }
 
+/*===============================================================================
+  Event Interrupts
+  ===============================================================================*/
+
+void ade9153a_enable_dip_irq(ade9153a_t *dev, uint32_t dip_lvl, uint16_t dip_cyc)
+{
+    if (!dev || !dev->initialized) return;
+    
+    ade9153a_write_32(dev, REG_DIP_LVL, dip_lvl);
+    ade9153a_write_16(dev, REG_DIP_CYC, dip_cyc);
+    
+    // Clear anything latched before enabling the interrupt
+    ade9153a_ack_events(dev);
+    
+    ade9153a_write_32(dev, REG_EVENT_MASK, ade9153a_read_32(dev, REG_EVENT_MASK) | ADE9153A_EVENT_DIPA);
+    ade9153a_write_32(dev, REG_MASK, ade9153a_read_32(dev, REG_MASK) | ADE9153A_STATUS_EVENT_STAT);
+    
+    ESP_LOGI(TAG, "Dip IRQ enabled: DIP_LVL=0x%08lX, DIP_CYC=%u",
+             (unsigned long)dip_lvl, dip_cyc);
+}
+
+uint32_t ade9153a_ack_events(ade9153a_t *dev)
+{
+    if (!dev || !dev->initialized) return 0;
+    
+    // Both tiers are write-1-to-clear
+    uint32_t events = ade9153a_read_32(dev, REG_EVENT_STATUS);
+    if (events) {
+        ade9153a_write_32(dev, REG_EVENT_STATUS, events);
+    }
+    
+    uint32_t status = ade9153a_read_32(dev, REG_STATUS);
+    if (status & ADE9153A_STATUS_EVENT_STAT) {
+        ade9153a_write_32(dev, REG_STATUS, ADE9153A_STATUS_EVENT_STAT);
+    }
+    
+    return events;
+}
+
 /*===============================================================================
   Temperature Reading
   ===============================================================================*/
@@ -111,6 +111,7 @@ bool ade9153a_init(ade9153a_t *dev, uint32_t spi_speed, int cs_pin,
     }
     
     dev->cs_pin = cs_pin;
+    dev->lock = xSemaphoreCreateMutex();
     dev->initialized = true;
     
     ESP_LOGI(TAG, "ADE9153A SPI initialized at %lu Hz", spi_speed);
@@ -128,6 +129,7 @@ static bool spi_write(ade9153a_t *dev, uint8_t *data, uint8_t length)
         return false;
     }
     
+    xSemaphoreTake(dev->lock, portMAX_DELAY);
     gpio_set_level(dev->cs_pin, 0);
     esp_rom_delay_us(5);
     
@@ -135,6 +137,7 @@ static bool spi_write(ade9153a_t *dev, uint8_t *data, uint8_t length)
     
     esp_rom_delay_us(5);
     gpio_set_level(dev->cs_pin, 1);
+    xSemaphoreGive(dev->lock);
     
     return true;
 }
@@ -146,6 +149,7 @@ static bool spi_read(ade9153a_t *dev, uint16_t cmd, uint8_t *data, uint8_t lengt
         return false;
     }
     
+    xSemaphoreTake(dev->lock, portMAX_DELAY);
     gpio_set_level(dev->cs_pin, 0);
     esp_rom_delay_us(5);
     
@@ -153,6 +157,7 @@ static bool spi_read(ade9153a_t *dev, uint16_t cmd, uint8_t *data, uint8_t lengt
     
     esp_rom_delay_us(5);
     gpio_set_level(dev->cs_pin, 1);
+    xSemaphoreGive(dev->lock);
     
     return true;
 }
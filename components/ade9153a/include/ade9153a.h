@@ -128,6 +128,7 @@ extern "C" {
 #define REG_MS_STATUS_IRQ     0x04C0    /* Tier 2 status register for the autocalibration. */
 #define REG_EVENT_STATUS      0x04C1    /* Tier 2 status register for power quality event related interrupts. */
 #define REG_CHIP_STATUS       0x04C2    /* Tier 2 status register for chip error related interrupts. */
+#define REG_EVENT_MASK        0x04C4    /* Tier 2 interrupt enable register for power quality event related interrupts. */
 #define REG_UART_BAUD_SWITCH  0x04DC    /* This register switches the UART Baud rate. */
 #define REG_VERSION           0x04FE    /* Version of the ADE9153 IC. */
 #define REG_AI_WAV_1          0x0600    /* SPI burst read accessible registers organized functionally. */
@@ -5,6 +5,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "driver/spi_master.h"  
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "ade9153a.h"
 
 #ifdef __cplusplus
@@ -31,9 +33,16 @@ extern "C" {
 #define ADE9153A_COMPMODE            0x0005      /* Initialize for proper operation */
 #define ADE9153A_VDIV_RSMALL         0x03E8      /* Small resistor on board is 1kOhm=0x3E8 */
 #define ADE9153A_EP_CFG              0x0009      /* Energy accumulation configuration - Note: 0x0009 from their code */
+#define ADE9153A_EP_CFG_RD_RST       0x0021      /* EGY_PWR_EN | RD_RST_EN: accumulate, clear xWATTHR on read */
 #define ADE9153A_EGY_TIME            0x0F9F      /* Accumulate energy for 4000 samples */
 #define ADE9153A_TEMP_CFG            0x000C      /* Temperature sensor configuration */
 
+/*===============================================================================
+  Interrupt Bits
+  ===============================================================================*/
+#define ADE9153A_STATUS_EVENT_STAT   (1UL << 24) /* STATUS: a tier 2 event in EVENT_STATUS is pending */
+#define ADE9153A_EVENT_DIPA          (1UL << 3)  /* EVENT_STATUS: AVRMS_OC below DIP_LVL for DIP_CYC half cycles */
+
 /*===============================================================================
   Calibration Constants
   ===============================================================================*/
@@ -109,6 +118,7 @@ typedef struct {
     spi_device_handle_t spi_handle;
     int cs_pin;
     bool initialized;
+    SemaphoreHandle_t lock;     // Serialises transactions (CS is driven manually)
 } ade9153a_t;
 
 /*===============================================================================
@@ -206,6 +216,24 @@ bool ade9153a_apply_acal(ade9153a_t *dev, float aicc, float avcc);
  */
 void ade9153a_read_temperature(ade9153a_t *dev, temperature_t *data);
 
+/**
+ * @brief Enable voltage dip detection on the fast AVRMS_OC path
+ * 
+ * The dip event is routed to the IRQ pin (active low) through the tier 2
+ * EVENT_MASK and the EVENT_STAT bit of the tier 1 MASK.
+ * 
+ * @param dip_lvl Threshold in AVRMS_OC codes
+ * @param dip_cyc Half line cycles below the threshold before the event fires
+ */
+void ade9153a_enable_dip_irq(ade9153a_t *dev, uint32_t dip_lvl, uint16_t dip_cyc);
+
+/**
+ * @brief Read and clear pending event interrupts (releases the IRQ pin)
+ * 
+ * @return uint32_t EVENT_STATUS bits that were set
+ */
+uint32_t ade9153a_ack_events(ade9153a_t *dev);
+
 /**
  * @brief Delay function matching their ade9153a_spi_delay_ms
  */
@@ -0,0 +1,143 @@
+// smart_plug/components/encoding/cbor_writer.c
+#include "cbor_writer.h"
+#include <string.h>
+
+/*===============================================================================
+  CBOR Constants
+  ===============================================================================*/
+
+#define MAJOR_UINT          0x00
+#define MAJOR_NEGINT        0x20
+#define MAJOR_BYTES         0x40
+#define MAJOR_TEXT          0x60
+#define MAJOR_ARRAY         0x80
+#define MAJOR_MAP           0xA0
+
+#define SIMPLE_FALSE        0xF4
+#define SIMPLE_TRUE         0xF5
+#define SIMPLE_NULL         0xF6
+#define INDEFINITE          0x1F
+#define BREAK               0xFF
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static void put(cbor_writer_t *w, const uint8_t *data, size_t n)
+{
+    if (w->overflow) return;
+    
+    if (w->len + n > w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, data, n);
+    w->len += n;
+}
+
+static void put_byte(cbor_writer_t *w, uint8_t b)
+{
+    put(w, &b, 1);
+}
+
+// Initial byte plus big-endian argument in the shortest form
+static void put_head(cbor_writer_t *w, uint8_t major, uint64_t arg)
+{
+    uint8_t head[9];
+    size_t n;
+    
+    if (arg < 24) {
+        head[0] = major | (uint8_t)arg;
+        n = 1;
+    } else if (arg <= UINT8_MAX) {
+        head[0] = major | 24;
+        n = 2;
+    } else if (arg <= UINT16_MAX) {
+        head[0] = major | 25;
+        n = 3;
+    } else if (arg <= UINT32_MAX) {
+        head[0] = major | 26;
+        n = 5;
+    } else {
+        head[0] = major | 27;
+        n = 9;
+    }
+    
+    for (size_t i = n - 1; i >= 1; i--) {
+        head[i] = (uint8_t)arg;
+        arg >>= 8;
+    }
+    put(w, head, n);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->overflow = (buf == NULL);
+}
+
+void cbor_writer_begin_map(cbor_writer_t *w)
+{
+    put_byte(w, MAJOR_MAP | INDEFINITE);
+}
+
+void cbor_writer_begin_array(cbor_writer_t *w)
+{
+    put_byte(w, MAJOR_ARRAY | INDEFINITE);
+}
+
+void cbor_writer_end(cbor_writer_t *w)
+{
+    put_byte(w, BREAK);
+}
+
+void cbor_writer_int(cbor_writer_t *w, int64_t value)
+{
+    if (value >= 0) {
+        put_head(w, MAJOR_UINT, (uint64_t)value);
+    } else {
+        // -1 - n without overflowing at INT64_MIN
+        put_head(w, MAJOR_NEGINT, (uint64_t)(-(value + 1)));
+    }
+}
+
+void cbor_writer_text(cbor_writer_t *w, const char *value)
+{
+    if (!value) {
+        cbor_writer_null(w);
+        return;
+    }
+    size_t n = strlen(value);
+    put_head(w, MAJOR_TEXT, n);
+    put(w, (const uint8_t *)value, n);
+}
+
+void cbor_writer_bytes(cbor_writer_t *w, const uint8_t *data, size_t len)
+{
+    put_head(w, MAJOR_BYTES, len);
+    put(w, data, len);
+}
+
+void cbor_writer_bool(cbor_writer_t *w, bool value)
+{
+    put_byte(w, value ? SIMPLE_TRUE : SIMPLE_FALSE);
+}
+
+void cbor_writer_null(cbor_writer_t *w)
+{
+    put_byte(w, SIMPLE_NULL);
+}
+
+const uint8_t *cbor_writer_finish(cbor_writer_t *w, size_t *len)
+{
+    if (w->overflow) return NULL;
+    
+    if (len) *len = w->len;
+    return w->buf;
+}
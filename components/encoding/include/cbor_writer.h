@@ -0,0 +1,85 @@
+// smart_plug/components/encoding/include/cbor_writer.h
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Streaming CBOR (RFC 8949) writer over a caller-provided buffer
+ * 
+ * Maps and arrays are written with indefinite length so members can be
+ * streamed without counting them first. Like json_writer, an overflow is
+ * only reported by cbor_writer_finish().
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    bool overflow;
+} cbor_writer_t;
+
+/**
+ * @brief Start a document
+ */
+void cbor_writer_init(cbor_writer_t *w, uint8_t *buf, size_t size);
+
+/**
+ * @brief Open an indefinite-length map (close with cbor_writer_end())
+ */
+void cbor_writer_begin_map(cbor_writer_t *w);
+
+/**
+ * @brief Open an indefinite-length array (close with cbor_writer_end())
+ */
+void cbor_writer_begin_array(cbor_writer_t *w);
+
+/**
+ * @brief Close the innermost map or array
+ */
+void cbor_writer_end(cbor_writer_t *w);
+
+/**
+ * @brief Add a signed integer in its shortest encoding
+ */
+void cbor_writer_int(cbor_writer_t *w, int64_t value);
+
+/**
+ * @brief Add a UTF-8 text string
+ */
+void cbor_writer_text(cbor_writer_t *w, const char *value);
+
+/**
+ * @brief Add a byte string
+ */
+void cbor_writer_bytes(cbor_writer_t *w, const uint8_t *data, size_t len);
+
+/**
+ * @brief Add a boolean
+ */
+void cbor_writer_bool(cbor_writer_t *w, bool value);
+
+/**
+ * @brief Add null
+ */
+void cbor_writer_null(cbor_writer_t *w);
+
+/**
+ * @brief Finish the document
+ * 
+ * @param w Writer
+ * @param len Receives the encoded length
+ * @return const uint8_t* Encoded document, or NULL if it did not fit
+ */
+const uint8_t *cbor_writer_finish(cbor_writer_t *w, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CBOR_WRITER_H */
@@ -0,0 +1,106 @@
+// smart_plug/components/encoding/include/json_reader.h
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Error Codes (negative returns of json_reader_parse)
+  ===============================================================================*/
+
+#define JSON_ERR_NOMEM      (-1)    // More tokens than provided
+#define JSON_ERR_INVAL      (-2)    // Malformed document
+#define JSON_ERR_PART       (-3)    // Document ends early
+
+/**
+ * @brief Token types
+ */
+typedef enum {
+    JSON_TOK_OBJECT,
+    JSON_TOK_ARRAY,
+    JSON_TOK_STRING,
+    JSON_TOK_PRIMITIVE,             // Number, true, false or null
+} json_tok_type_t;
+
+/**
+ * @brief One token, referencing the input buffer
+ * 
+ * Tokens follow document order; a token's children come right after it.
+ * Object members are a key (STRING, size 1) followed by its value.
+ */
+typedef struct {
+    uint8_t type;                   // json_tok_type_t
+    int16_t parent;                 // Enclosing container or key, -1 at top level
+    uint16_t size;                  // Members, elements, or 1 for a key
+    uint32_t start;                 // First byte (after the quote for strings)
+    uint32_t end;                   // One past the last byte
+} json_tok_t;
+
+/**
+ * @brief Tokenize a document in place, without allocating
+ * 
+ * @param js Input (need not be NUL-terminated)
+ * @param len Input length
+ * @param toks Token array
+ * @param max_toks Token array length
+ * @return int Number of tokens, or a JSON_ERR_* code
+ */
+int json_reader_parse(const char *js, size_t len, json_tok_t *toks, int max_toks);
+
+/**
+ * @brief Find a value by dotted path, e.g. "state.relay_status"
+ * 
+ * @param js Input passed to json_reader_parse()
+ * @param toks Tokens
+ * @param count Token count returned by json_reader_parse()
+ * @param obj Object to search from (0 for the root)
+ * @param path Member names separated by '.'
+ * @return int Token index of the value, or -1
+ */
+int json_reader_find(const char *js, const json_tok_t *toks, int count, int obj, const char *path);
+
+/**
+ * @brief Compare a string or primitive token with a C string
+ */
+bool json_reader_eq(const char *js, const json_tok_t *tok, const char *s);
+
+/**
+ * @brief Read a boolean
+ * 
+ * Accepts true/false and the strings "true"/"false" the shadow uses.
+ * 
+ * @return true if the token is a boolean
+ */
+bool json_reader_get_bool(const char *js, const json_tok_t *tok, bool *out);
+
+/**
+ * @brief Read an integer primitive
+ * 
+ * @return true if the token is an integer that fits in int64_t
+ */
+bool json_reader_get_int(const char *js, const json_tok_t *tok, int64_t *out);
+
+/**
+ * @brief Copy a string value, resolving escapes
+ * 
+ * Escaped characters outside ASCII are replaced by '?'.
+ * 
+ * @param js Input
+ * @param tok String token
+ * @param buf Destination
+ * @param size Destination size
+ * @return true if the whole string fit
+ */
+bool json_reader_get_string(const char *js, const json_tok_t *tok, char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_READER_H */
@@ -0,0 +1,126 @@
+// smart_plug/components/encoding/include/json_writer.h
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Streaming JSON writer over a caller-provided buffer
+ * 
+ * Values are appended in document order without building a tree and
+ * without touching the heap. Numbers are formatted as fixed point. Once
+ * the buffer is full the writer stops and json_writer_finish() fails, so
+ * callers only check once at the end.
+ */
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool need_comma;
+    bool overflow;
+} json_writer_t;
+
+/**
+ * @brief Start a document
+ * 
+ * @param w Writer
+ * @param buf Output buffer
+ * @param size Buffer size (including the terminating NUL)
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t size);
+
+/**
+ * @brief Open an object
+ * 
+ * @param w Writer
+ * @param key Member name, or NULL for the root and array elements
+ */
+void json_writer_begin_object(json_writer_t *w, const char *key);
+
+/**
+ * @brief Close the innermost object
+ */
+void json_writer_end_object(json_writer_t *w);
+
+/**
+ * @brief Open an array
+ * 
+ * @param w Writer
+ * @param key Member name, or NULL inside an array
+ */
+void json_writer_begin_array(json_writer_t *w, const char *key);
+
+/**
+ * @brief Close the innermost array
+ */
+void json_writer_end_array(json_writer_t *w);
+
+/**
+ * @brief Add an escaped string value
+ */
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+
+/**
+ * @brief Add a boolean value
+ */
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+
+/**
+ * @brief Add an integer value
+ */
+void json_writer_int(json_writer_t *w, const char *key, int64_t value);
+
+/**
+ * @brief Add a fixed-point value
+ * 
+ * Writes value / 10^decimals exactly, e.g. (123456, 3) -> 123.456.
+ * 
+ * @param w Writer
+ * @param key Member name, or NULL inside an array
+ * @param value Scaled integer
+ * @param decimals Digits after the decimal point (0-9)
+ */
+void json_writer_fixed(json_writer_t *w, const char *key, int64_t value, uint8_t decimals);
+
+/**
+ * @brief Add a float rounded to a number of decimals
+ * 
+ * NaN, infinity and values too large for fixed point are written as null.
+ * 
+ * @param w Writer
+ * @param key Member name, or NULL inside an array
+ * @param value Value
+ * @param decimals Digits after the decimal point (0-9)
+ */
+void json_writer_float(json_writer_t *w, const char *key, float value, uint8_t decimals);
+
+/**
+ * @brief Add binary data as a base64 string
+ */
+void json_writer_base64(json_writer_t *w, const char *key, const uint8_t *data, size_t len);
+
+/**
+ * @brief Add a null value
+ */
+void json_writer_null(json_writer_t *w, const char *key);
+
+/**
+ * @brief Finish the document
+ * 
+ * @param w Writer
+ * @param len Receives the length without the NUL (optional)
+ * @return const char* NUL-terminated document, or NULL if it did not fit
+ */
+const char *json_writer_finish(json_writer_t *w, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* JSON_WRITER_H */
@@ -0,0 +1,162 @@
+// smart_plug/components/encoding/include/payload_writer.h
+#ifndef PAYLOAD_WRITER_H
+#define PAYLOAD_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "json_writer.h"
+#include "cbor_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Payload encodings
+ */
+typedef enum {
+    PAYLOAD_JSON,                   // Named keys, decimal numbers
+    PAYLOAD_CBOR,                   // Integer keys, scaled integers
+    PAYLOAD_SCHEMA,                 // JSON description of the CBOR keys
+    PAYLOAD_FORMAT_COUNT
+} payload_format_t;
+
+/**
+ * @brief Format-independent message writer
+ * 
+ * Every member is given both an integer key (used in CBOR) and a name
+ * (used in JSON). Running the same builder in PAYLOAD_SCHEMA mode writes
+ * the key table, so the schema published to consumers always matches
+ * the encoder. Pass name NULL for the root map and array elements.
+ */
+typedef struct {
+    payload_format_t format;
+    json_writer_t json;             // JSON and SCHEMA
+    cbor_writer_t cbor;
+    uint8_t depth;
+    uint8_t skip_depth;             // SCHEMA: array contents are not described
+} payload_writer_t;
+
+/**
+ * @brief Start a JSON or CBOR message
+ * 
+ * @param w Writer
+ * @param format PAYLOAD_JSON or PAYLOAD_CBOR
+ * @param buf Output buffer
+ * @param size Buffer size
+ */
+void payload_writer_init(payload_writer_t *w, payload_format_t format, void *buf, size_t size);
+
+/**
+ * @brief Start a schema document
+ * 
+ * Writes {"stream":..., "version":..., "fields":{...}}, where fields maps
+ * each CBOR key to its name, type and decimal scale.
+ * 
+ * @param w Writer
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @param stream Stream name
+ * @param version Schema version (bump whenever keys change)
+ */
+void payload_writer_init_schema(payload_writer_t *w, void *buf, size_t size,
+                                const char *stream, uint32_t version);
+
+/**
+ * @brief Open a map
+ * 
+ * @param w Writer
+ * @param key CBOR key (unique within the enclosing map)
+ * @param name JSON name, or NULL for the root and array elements
+ */
+void payload_writer_begin_map(payload_writer_t *w, uint8_t key, const char *name);
+
+/**
+ * @brief Close the innermost map
+ */
+void payload_writer_end_map(payload_writer_t *w);
+
+/**
+ * @brief Open an array (its elements are not described in the schema)
+ */
+void payload_writer_begin_array(payload_writer_t *w, uint8_t key, const char *name);
+
+/**
+ * @brief Open an array of numbers that share one decimal scale
+ * 
+ * Add elements with payload_writer_fixed() or payload_writer_float() (key 0,
+ * name NULL) using the same decimals. The schema records the scale, so CBOR
+ * consumers can restore the values.
+ */
+void payload_writer_begin_column(payload_writer_t *w, uint8_t key, const char *name,
+                                 uint8_t decimals);
+
+/**
+ * @brief Close the innermost array
+ */
+void payload_writer_end_array(payload_writer_t *w);
+
+/**
+ * @brief Add a text value
+ */
+void payload_writer_string(payload_writer_t *w, uint8_t key, const char *name, const char *value);
+
+/**
+ * @brief Add a boolean value
+ */
+void payload_writer_bool(payload_writer_t *w, uint8_t key, const char *name, bool value);
+
+/**
+ * @brief Add an integer value
+ */
+void payload_writer_int(payload_writer_t *w, uint8_t key, const char *name, int64_t value);
+
+/**
+ * @brief Add a fixed-point value (value / 10^decimals)
+ * 
+ * JSON gets the decimal text; CBOR gets the scaled integer as-is.
+ */
+void payload_writer_fixed(payload_writer_t *w, uint8_t key, const char *name,
+                          int64_t value, uint8_t decimals);
+
+/**
+ * @brief Add a float rounded to a number of decimals
+ * 
+ * CBOR gets round(value * 10^decimals); NaN and infinity become null.
+ */
+void payload_writer_float(payload_writer_t *w, uint8_t key, const char *name,
+                          float value, uint8_t decimals);
+
+/**
+ * @brief Add binary data (base64 string in JSON, byte string in CBOR)
+ */
+void payload_writer_bytes(payload_writer_t *w, uint8_t key, const char *name,
+                          const uint8_t *data, size_t len);
+
+/**
+ * @brief Finish the message
+ * 
+ * @param w Writer
+ * @param len Receives the encoded length
+ * @return const void* Encoded message (JSON is NUL-terminated), or NULL on overflow
+ */
+const void *payload_writer_finish(payload_writer_t *w, size_t *len);
+
+/**
+ * @brief Get a format name ("json", "cbor")
+ */
+const char *payload_format_name(payload_format_t format);
+
+/**
+ * @brief Look up a format by name
+ * 
+ * @return true if name is "json" or "cbor"
+ */
+bool payload_format_from_name(const char *name, size_t len, payload_format_t *format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PAYLOAD_WRITER_H */
@@ -0,0 +1,346 @@
+// smart_plug/components/encoding/json_reader.c
+#include "json_reader.h"
+#include <string.h>
+
+/*===============================================================================
+  Parser State
+  ===============================================================================*/
+
+typedef enum {
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_CLOSE,          // After '['
+    EXPECT_KEY,                     // After ',' in an object
+    EXPECT_KEY_OR_CLOSE,            // After '{'
+    EXPECT_COLON,
+    EXPECT_COMMA_OR_CLOSE,
+    EXPECT_END,                     // Top-level value complete
+} expect_t;
+
+typedef struct {
+    json_tok_t *toks;
+    int max;
+    int count;
+    int super;                      // Innermost open container or key
+    expect_t expect;
+} parser_t;
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static json_tok_t *new_token(parser_t *p, json_tok_type_t type, size_t start, size_t end)
+{
+    if (p->count >= p->max || p->count >= INT16_MAX) return NULL;
+    
+    json_tok_t *tok = &p->toks[p->count++];
+    tok->type = type;
+    tok->parent = (int16_t)p->super;
+    tok->size = 0;
+    tok->start = (uint32_t)start;
+    tok->end = (uint32_t)end;
+    if (p->super >= 0) p->toks[p->super].size++;
+    return tok;
+}
+
+// A value is complete: pop its key and decide what may follow
+static void value_done(parser_t *p)
+{
+    if (p->super >= 0 && p->toks[p->super].type == JSON_TOK_STRING) {
+        p->super = p->toks[p->super].parent;
+    }
+    p->expect = (p->super < 0) ? EXPECT_END : EXPECT_COMMA_OR_CLOSE;
+}
+
+static bool expects_value(const parser_t *p)
+{
+    return p->expect == EXPECT_VALUE || p->expect == EXPECT_VALUE_OR_CLOSE;
+}
+
+static bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static int hex_value(char c)
+{
+    if (c <= '9') return c - '0';
+    if (c <= 'F') return c - 'A' + 10;
+    return c - 'a' + 10;
+}
+
+// Returns the index of the closing quote, or a JSON_ERR_* code
+static int scan_string(const char *js, size_t len, size_t pos)
+{
+    for (pos++; pos < len; pos++) {
+        unsigned char c = (unsigned char)js[pos];
+        if (c == '"') return (int)pos;
+        if (c < 0x20) return JSON_ERR_INVAL;
+        if (c != '\\') continue;
+        
+        if (++pos >= len) return JSON_ERR_PART;
+        switch (js[pos]) {
+            case '"': case '\\': case '/': case 'b':
+            case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                for (int i = 0; i < 4; i++) {
+                    if (++pos >= len) return JSON_ERR_PART;
+                    if (!is_hex(js[pos])) return JSON_ERR_INVAL;
+                }
+                break;
+            default:
+                return JSON_ERR_INVAL;
+        }
+    }
+    return JSON_ERR_PART;
+}
+
+static bool is_delimiter(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' ||
+           c == ',' || c == ']' || c == '}' || c == ':';
+}
+
+static bool valid_number(const char *s, size_t n)
+{
+    size_t i = 0;
+    if (i < n && s[i] == '-') i++;
+    if (i >= n) return false;
+    
+    if (s[i] == '0') {
+        i++;
+    } else if (s[i] >= '1' && s[i] <= '9') {
+        while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+    } else {
+        return false;
+    }
+    
+    if (i < n && s[i] == '.') {
+        size_t digits = ++i;
+        while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+        if (i == digits) return false;
+    }
+    
+    if (i < n && (s[i] == 'e' || s[i] == 'E')) {
+        i++;
+        if (i < n && (s[i] == '+' || s[i] == '-')) i++;
+        size_t digits = i;
+        while (i < n && s[i] >= '0' && s[i] <= '9') i++;
+        if (i == digits) return false;
+    }
+    
+    return i == n;
+}
+
+static bool valid_primitive(const char *s, size_t n)
+{
+    if (n == 4 && (memcmp(s, "true", 4) == 0 || memcmp(s, "null", 4) == 0)) return true;
+    if (n == 5 && memcmp(s, "false", 5) == 0) return true;
+    return valid_number(s, n);
+}
+
+// Index of the first token after tok and its children
+static int skip(const json_tok_t *toks, int count, int i)
+{
+    uint32_t end = toks[i].end;
+    i++;
+    while (i < count && toks[i].start < end) i++;
+    return i;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+int json_reader_parse(const char *js, size_t len, json_tok_t *toks, int max_toks)
+{
+    parser_t p = {
+        .toks = toks,
+        .max = max_toks,
+        .count = 0,
+        .super = -1,
+        .expect = EXPECT_VALUE,
+    };
+    
+    for (size_t pos = 0; pos < len; pos++) {
+        char c = js[pos];
+        json_tok_t *tok;
+        
+        switch (c) {
+            case ' ': case '\t': case '\r': case '\n':
+                break;
+            
+            case '{':
+            case '[':
+                if (!expects_value(&p)) return JSON_ERR_INVAL;
+                tok = new_token(&p, c == '{' ? JSON_TOK_OBJECT : JSON_TOK_ARRAY, pos, 0);
+                if (!tok) return JSON_ERR_NOMEM;
+                p.super = p.count - 1;
+                p.expect = (c == '{') ? EXPECT_KEY_OR_CLOSE : EXPECT_VALUE_OR_CLOSE;
+                break;
+            
+            case '}':
+            case ']': {
+                json_tok_type_t type = (c == '}') ? JSON_TOK_OBJECT : JSON_TOK_ARRAY;
+                bool may_close = p.expect == EXPECT_COMMA_OR_CLOSE ||
+                                 (type == JSON_TOK_OBJECT && p.expect == EXPECT_KEY_OR_CLOSE) ||
+                                 (type == JSON_TOK_ARRAY && p.expect == EXPECT_VALUE_OR_CLOSE);
+                if (!may_close || p.super < 0 || toks[p.super].type != type) {
+                    return JSON_ERR_INVAL;
+                }
+                toks[p.super].end = (uint32_t)(pos + 1);
+                p.super = toks[p.super].parent;
+                value_done(&p);
+                break;
+            }
+            
+            case '"': {
+                int close = scan_string(js, len, pos);
+                if (close < 0) return close;
+                
+                if (p.expect == EXPECT_KEY || p.expect == EXPECT_KEY_OR_CLOSE) {
+                    if (!new_token(&p, JSON_TOK_STRING, pos + 1, close)) return JSON_ERR_NOMEM;
+                    p.super = p.count - 1;
+                    p.expect = EXPECT_COLON;
+                } else if (expects_value(&p)) {
+                    if (!new_token(&p, JSON_TOK_STRING, pos + 1, close)) return JSON_ERR_NOMEM;
+                    value_done(&p);
+                } else {
+                    return JSON_ERR_INVAL;
+                }
+                pos = close;
+                break;
+            }
+            
+            case ':':
+                if (p.expect != EXPECT_COLON) return JSON_ERR_INVAL;
+                p.expect = EXPECT_VALUE;
+                break;
+            
+            case ',':
+                if (p.expect != EXPECT_COMMA_OR_CLOSE) return JSON_ERR_INVAL;
+                p.expect = (toks[p.super].type == JSON_TOK_OBJECT) ? EXPECT_KEY : EXPECT_VALUE;
+                break;
+            
+            default: {
+                if (!expects_value(&p)) return JSON_ERR_INVAL;
+                
+                size_t end = pos;
+                while (end < len && !is_delimiter(js[end])) end++;
+                if (!valid_primitive(js + pos, end - pos)) {
+                    return (end == len) ? JSON_ERR_PART : JSON_ERR_INVAL;
+                }
+                if (!new_token(&p, JSON_TOK_PRIMITIVE, pos, end)) return JSON_ERR_NOMEM;
+                value_done(&p);
+                pos = end - 1;
+                break;
+            }
+        }
+    }
+    
+    return (p.expect == EXPECT_END) ? p.count : JSON_ERR_PART;
+}
+
+int json_reader_find(const char *js, const json_tok_t *toks, int count, int obj, const char *path)
+{
+    while (obj >= 0 && obj < count && toks[obj].type == JSON_TOK_OBJECT) {
+        const char *dot = strchr(path, '.');
+        size_t seg = dot ? (size_t)(dot - path) : strlen(path);
+        
+        int i = obj + 1;
+        int found = -1;
+        for (int m = 0; m < toks[obj].size && i + 1 < count; m++) {
+            const json_tok_t *key = &toks[i];
+            if (key->end - key->start == seg && memcmp(js + key->start, path, seg) == 0) {
+                found = i + 1;
+                break;
+            }
+            i = skip(toks, count, i + 1);
+        }
+        
+        if (found < 0 || !dot) return found;
+        obj = found;
+        path = dot + 1;
+    }
+    return -1;
+}
+
+bool json_reader_eq(const char *js, const json_tok_t *tok, const char *s)
+{
+    if (tok->type != JSON_TOK_STRING && tok->type != JSON_TOK_PRIMITIVE) return false;
+    
+    size_t n = strlen(s);
+    return tok->end - tok->start == n && memcmp(js + tok->start, s, n) == 0;
+}
+
+bool json_reader_get_bool(const char *js, const json_tok_t *tok, bool *out)
+{
+    if (json_reader_eq(js, tok, "true")) {
+        *out = true;
+        return true;
+    }
+    if (json_reader_eq(js, tok, "false")) {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+bool json_reader_get_int(const char *js, const json_tok_t *tok, int64_t *out)
+{
+    if (tok->type != JSON_TOK_PRIMITIVE) return false;
+    
+    const char *s = js + tok->start;
+    const char *end = js + tok->end;
+    bool neg = (s < end && *s == '-');
+    if (neg) s++;
+    if (s == end) return false;
+    
+    uint64_t v = 0;
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9') return false;
+        uint64_t digit = (uint64_t)(*s - '0');
+        if (v > (UINT64_MAX - digit) / 10) return false;
+        v = v * 10 + digit;
+    }
+    
+    if (v > (uint64_t)INT64_MAX + (neg ? 1 : 0)) return false;
+    *out = neg ? (int64_t)(0 - v) : (int64_t)v;
+    return true;
+}
+
+bool json_reader_get_string(const char *js, const json_tok_t *tok, char *buf, size_t size)
+{
+    if (tok->type != JSON_TOK_STRING || size == 0) return false;
+    
+    size_t n = 0;
+    for (uint32_t i = tok->start; i < tok->end; i++) {
+        char c = js[i];
+        if (c == '\\') {
+            c = js[++i];
+            switch (c) {
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'n': c = '\n'; break;
+                case 'r': c = '\r'; break;
+                case 't': c = '\t'; break;
+                case 'u': {
+                    int cp = 0;
+                    for (int k = 0; k < 4; k++) cp = (cp << 4) | hex_value(js[++i]);
+                    c = (cp < 0x80) ? (char)cp : '?';
+                    break;
+                }
+                default:
+                    break;      // '"', '\\' and '/' stand for themselves
+            }
+        }
+        
+        if (n + 1 >= size) {
+            buf[n] = '\0';
+            return false;
+        }
+        buf[n++] = c;
+    }
+    buf[n] = '\0';
+    return true;
+}
@@ -0,0 +1,243 @@
+// smart_plug/components/encoding/json_writer.c
+#include "json_writer.h"
+#include <math.h>
+#include <string.h>
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+static const int64_t pow10_table[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL,
+    1000000LL, 10000000LL, 100000000LL, 1000000000LL
+};
+
+#define MAX_DECIMALS    9
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static const char b64_digits[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static void put(json_writer_t *w, const char *s, size_t n)
+{
+    if (w->overflow) return;
+    
+    // Keep one byte for the terminating NUL
+    if (w->len + n >= w->size) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    put_char(w, '"');
+    
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        
+        put(w, run, s - run);
+        run = s + 1;
+        
+        switch (c) {
+            case '"':  put(w, "\\\"", 2); break;
+            case '\\': put(w, "\\\\", 2); break;
+            case '\n': put(w, "\\n", 2); break;
+            case '\r': put(w, "\\r", 2); break;
+            case '\t': put(w, "\\t", 2); break;
+            default: {
+                char esc[6] = { '\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xF] };
+                put(w, esc, sizeof(esc));
+                break;
+            }
+        }
+    }
+    put(w, run, s - run);
+    
+    put_char(w, '"');
+}
+
+// Comma and key in front of every value
+static void put_key(json_writer_t *w, const char *key)
+{
+    if (w->need_comma) put_char(w, ',');
+    w->need_comma = true;
+    
+    if (key) {
+        put_escaped(w, key);
+        put_char(w, ':');
+    }
+}
+
+static void put_uint(json_writer_t *w, uint64_t v, int min_digits)
+{
+    char digits[20];
+    int n = 0;
+    
+    do {
+        digits[sizeof(digits) - 1 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v || n < min_digits);
+    
+    put(w, digits + sizeof(digits) - n, n);
+}
+
+static void put_fixed(json_writer_t *w, int64_t value, uint8_t decimals)
+{
+    if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+    
+    uint64_t mag;
+    if (value < 0) {
+        put_char(w, '-');
+        mag = (uint64_t)(-(value + 1)) + 1;     // INT64_MIN safe
+    } else {
+        mag = (uint64_t)value;
+    }
+    
+    if (decimals == 0) {
+        put_uint(w, mag, 1);
+        return;
+    }
+    
+    uint64_t scale = (uint64_t)pow10_table[decimals];
+    put_uint(w, mag / scale, 1);
+    put_char(w, '.');
+    put_uint(w, mag % scale, decimals);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size)
+{
+    w->buf = buf;
+    w->size = size;
+    w->len = 0;
+    w->need_comma = false;
+    w->overflow = (buf == NULL || size == 0);
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_char(w, '{');
+    w->need_comma = false;
+}
+
+void json_writer_end_object(json_writer_t *w)
+{
+    put_char(w, '}');
+    w->need_comma = true;
+}
+
+void json_writer_begin_array(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put_char(w, '[');
+    w->need_comma = false;
+}
+
+void json_writer_end_array(json_writer_t *w)
+{
+    put_char(w, ']');
+    w->need_comma = true;
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    put_key(w, key);
+    if (value) {
+        put_escaped(w, value);
+    } else {
+        put(w, "null", 4);
+    }
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    put_key(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value)
+{
+    put_key(w, key);
+    put_fixed(w, value, 0);
+}
+
+void json_writer_fixed(json_writer_t *w, const char *key, int64_t value, uint8_t decimals)
+{
+    put_key(w, key);
+    put_fixed(w, value, decimals);
+}
+
+void json_writer_float(json_writer_t *w, const char *key, float value, uint8_t decimals)
+{
+    put_key(w, key);
+    
+    if (decimals > MAX_DECIMALS) decimals = MAX_DECIMALS;
+    
+    // Doubles hold every int64 below 2^53 exactly, far beyond any reading
+    double scaled = (double)value * (double)pow10_table[decimals];
+    if (!isfinite(scaled) || fabs(scaled) > 9.0e15) {
+        put(w, "null", 4);
+        return;
+    }
+    put_fixed(w, (int64_t)llround(scaled), decimals);
+}
+
+void json_writer_base64(json_writer_t *w, const char *key, const uint8_t *data, size_t len)
+{
+    put_key(w, key);
+    put_char(w, '"');
+    
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t n = (uint32_t)data[i] << 16;
+        if (i + 1 < len) n |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < len) n |= data[i + 2];
+        
+        char quad[4] = {
+            b64_digits[(n >> 18) & 0x3F],
+            b64_digits[(n >> 12) & 0x3F],
+            (i + 1 < len) ? b64_digits[(n >> 6) & 0x3F] : '=',
+            (i + 2 < len) ? b64_digits[n & 0x3F] : '=',
+        };
+        put(w, quad, sizeof(quad));
+    }
+    
+    put_char(w, '"');
+}
+
+void json_writer_null(json_writer_t *w, const char *key)
+{
+    put_key(w, key);
+    put(w, "null", 4);
+}
+
+const char *json_writer_finish(json_writer_t *w, size_t *len)
+{
+    if (w->overflow) return NULL;
+    
+    w->buf[w->len] = '\0';
+    if (len) *len = w->len;
+    return w->buf;
+}
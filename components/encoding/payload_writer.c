@@ -0,0 +1,330 @@
+// smart_plug/components/encoding/payload_writer.c
+#include "payload_writer.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+static const char *const format_names[] = {
+    [PAYLOAD_JSON]   = "json",
+    [PAYLOAD_CBOR]   = "cbor",
+    [PAYLOAD_SCHEMA] = "schema",
+};
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+// CBOR map key; array elements and the root have none
+static void cbor_key(payload_writer_t *w, uint8_t key, const char *name)
+{
+    if (name) cbor_writer_int(&w->cbor, key);
+}
+
+// Schema entry for a scalar member: "<key>":{"name":...,"type":...}
+static void schema_field(payload_writer_t *w, uint8_t key, const char *name,
+                         const char *type, uint8_t decimals)
+{
+    if (w->skip_depth || !name) return;
+    
+    char key_str[4];
+    snprintf(key_str, sizeof(key_str), "%u", key);
+    json_writer_begin_object(&w->json, key_str);
+    json_writer_string(&w->json, "name", name);
+    json_writer_string(&w->json, "type", type);
+    if (decimals) json_writer_int(&w->json, "scale", decimals);
+    json_writer_end_object(&w->json);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void payload_writer_init(payload_writer_t *w, payload_format_t format, void *buf, size_t size)
+{
+    memset(w, 0, sizeof(*w));
+    w->format = format;
+    
+    if (format == PAYLOAD_CBOR) {
+        cbor_writer_init(&w->cbor, buf, size);
+    } else {
+        json_writer_init(&w->json, buf, size);
+    }
+}
+
+void payload_writer_init_schema(payload_writer_t *w, void *buf, size_t size,
+                                const char *stream, uint32_t version)
+{
+    payload_writer_init(w, PAYLOAD_SCHEMA, buf, size);
+    json_writer_begin_object(&w->json, NULL);
+    json_writer_string(&w->json, "stream", stream);
+    json_writer_int(&w->json, "version", version);
+}
+
+void payload_writer_begin_map(payload_writer_t *w, uint8_t key, const char *name)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_begin_object(&w->json, name);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_key(w, key, name);
+            cbor_writer_begin_map(&w->cbor);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            if (w->skip_depth) {
+                w->skip_depth++;
+            } else if (w->depth == 0) {
+                json_writer_begin_object(&w->json, "fields");
+            } else if (name) {
+                char key_str[4];
+                snprintf(key_str, sizeof(key_str), "%u", key);
+                json_writer_begin_object(&w->json, key_str);
+                json_writer_string(&w->json, "name", name);
+                json_writer_string(&w->json, "type", "map");
+                json_writer_begin_object(&w->json, "fields");
+            }
+            break;
+        
+        default:
+            break;
+    }
+    w->depth++;
+}
+
+void payload_writer_end_map(payload_writer_t *w)
+{
+    w->depth--;
+    
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_end_object(&w->json);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_writer_end(&w->cbor);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            if (w->skip_depth) {
+                w->skip_depth--;
+            } else {
+                json_writer_end_object(&w->json);               // "fields"
+                if (w->depth > 0) json_writer_end_object(&w->json);
+            }
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void payload_writer_begin_array(payload_writer_t *w, uint8_t key, const char *name)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_begin_array(&w->json, name);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_key(w, key, name);
+            cbor_writer_begin_array(&w->cbor);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            schema_field(w, key, name, "array", 0);
+            w->skip_depth++;
+            break;
+        
+        default:
+            break;
+    }
+    w->depth++;
+}
+
+void payload_writer_begin_column(payload_writer_t *w, uint8_t key, const char *name,
+                                 uint8_t decimals)
+{
+    if (w->format != PAYLOAD_SCHEMA) {
+        payload_writer_begin_array(w, key, name);
+        return;
+    }
+    
+    schema_field(w, key, name, "column", decimals);
+    w->skip_depth++;
+    w->depth++;
+}
+
+void payload_writer_end_array(payload_writer_t *w)
+{
+    w->depth--;
+    
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_end_array(&w->json);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_writer_end(&w->cbor);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            w->skip_depth--;
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void payload_writer_string(payload_writer_t *w, uint8_t key, const char *name, const char *value)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_string(&w->json, name, value);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_key(w, key, name);
+            cbor_writer_text(&w->cbor, value);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            schema_field(w, key, name, "string", 0);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void payload_writer_bool(payload_writer_t *w, uint8_t key, const char *name, bool value)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_bool(&w->json, name, value);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_key(w, key, name);
+            cbor_writer_bool(&w->cbor, value);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            schema_field(w, key, name, "bool", 0);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void payload_writer_int(payload_writer_t *w, uint8_t key, const char *name, int64_t value)
+{
+    payload_writer_fixed(w, key, name, value, 0);
+}
+
+void payload_writer_fixed(payload_writer_t *w, uint8_t key, const char *name,
+                          int64_t value, uint8_t decimals)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_fixed(&w->json, name, value, decimals);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_key(w, key, name);
+            cbor_writer_int(&w->cbor, value);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            schema_field(w, key, name, "int", decimals);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void payload_writer_float(payload_writer_t *w, uint8_t key, const char *name,
+                          float value, uint8_t decimals)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_float(&w->json, name, value, decimals);
+            break;
+        
+        case PAYLOAD_CBOR: {
+            cbor_key(w, key, name);
+            double scaled = (double)value * pow(10.0, decimals);
+            if (!isfinite(scaled) || fabs(scaled) > 9.0e15) {
+                cbor_writer_null(&w->cbor);
+            } else {
+                cbor_writer_int(&w->cbor, llround(scaled));
+            }
+            break;
+        }
+        
+        case PAYLOAD_SCHEMA:
+            schema_field(w, key, name, "int", decimals);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+void payload_writer_bytes(payload_writer_t *w, uint8_t key, const char *name,
+                          const uint8_t *data, size_t len)
+{
+    switch (w->format) {
+        case PAYLOAD_JSON:
+            json_writer_base64(&w->json, name, data, len);
+            break;
+        
+        case PAYLOAD_CBOR:
+            cbor_key(w, key, name);
+            cbor_writer_bytes(&w->cbor, data, len);
+            break;
+        
+        case PAYLOAD_SCHEMA:
+            schema_field(w, key, name, "bytes", 0);
+            break;
+        
+        default:
+            break;
+    }
+}
+
+const void *payload_writer_finish(payload_writer_t *w, size_t *len)
+{
+    if (w->format == PAYLOAD_CBOR) {
+        return cbor_writer_finish(&w->cbor, len);
+    }
+    
+    if (w->format == PAYLOAD_SCHEMA) {
+        json_writer_end_object(&w->json);
+    }
+    return json_writer_finish(&w->json, len);
+}
+
+const char *payload_format_name(payload_format_t format)
+{
+    return format < PAYLOAD_FORMAT_COUNT ? format_names[format] : "unknown";
+}
+
+bool payload_format_from_name(const char *name, size_t len, payload_format_t *format)
+{
+    for (int f = PAYLOAD_JSON; f <= PAYLOAD_CBOR; f++) {
+        if (strlen(format_names[f]) == len && memcmp(format_names[f], name, len) == 0) {
+            *format = (payload_format_t)f;
+            return true;
+        }
+    }
+    return false;
+}
@@ -2,7 +2,7 @@
 #include "button.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
-#include "esp_timer.h" 
+#include "timebase.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
@@ -25,9 +25,9 @@ typedef struct {
     bool current_state;
     bool last_state;
     bool stable_state;
-    uint32_t last_debounce_time;
-    uint32_t press_start_time;
-    uint32_t last_valid_press_time;
+    int64_t last_debounce_time;
+    int64_t press_start_time;
+    int64_t last_valid_press_time;
     bool press_active;
     bool reset_reported;
     bool very_long_reported;
@@ -54,7 +54,7 @@ void button_init(int gpio_pin, button_callback_t callback)
     btn.current_state = gpio_get_level(button_gpio);
     btn.last_state = btn.current_state;
     btn.stable_state = btn.current_state;
-    btn.last_debounce_time = esp_timer_get_time() / 1000;
+    btn.last_debounce_time = timebase_now_ms();
     btn.press_active = false;
     btn.reset_reported = false;
     btn.very_long_reported = false;
@@ -80,7 +80,7 @@ void button_task_handler(void)
 {
     if (button_gpio < 0) return;
     
-    uint32_t now = esp_timer_get_time() / 1000;
+    int64_t now = timebase_now_ms();
     
     // Read current state
     btn.current_state = gpio_get_level(button_gpio);
@@ -101,7 +101,7 @@ void button_task_handler(void)
                 ESP_LOGD(TAG, "Button pressed");
             } else { // Released (HIGH)
                 if (btn.press_active) {
-                    uint32_t press_duration = now - btn.press_start_time;
+                    uint32_t press_duration = (uint32_t)(now - btn.press_start_time);
                     btn.press_active = false;
                     
                     // Reset reporting flags on release
@@ -129,7 +129,7 @@ void button_task_handler(void)
     
     // Check for long press durations while button is pressed
     if (btn.press_active) {
-        uint32_t hold_duration = now - btn.press_start_time;
+        uint32_t hold_duration = (uint32_t)(now - btn.press_start_time);
         
         // Check thresholds in order (highest first)
         if (hold_duration >= WIFI_RESET_HOLD_MS) {
@@ -0,0 +1,71 @@
+// smart_plug/components/hardware/include/last_gasp.h
+#ifndef LAST_GASP_H
+#define LAST_GASP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Last-gasp handler, run from the highest-priority task
+ * 
+ * Must do only what has to survive the outage (one pre-erased flash write).
+ * 
+ * @param latency_us Dispatch latency: power-fail interrupt to this call,
+ *                   i.e. the task wake-up, not including the handler's work
+ */
+typedef void (*last_gasp_handler_t)(uint32_t latency_us);
+
+/**
+ * @brief Last-gasp statistics
+ */
+typedef struct {
+    uint32_t events;                // Power-fail interrupts taken
+    uint32_t ride_throughs;         // Events the supply recovered from
+    uint32_t last_dispatch_us;      // Interrupt to handler start
+    uint32_t max_dispatch_us;
+    uint32_t last_handler_us;       // Handler run time
+    uint32_t max_handler_us;
+    uint32_t last_total_us;         // Interrupt to handler done
+    uint32_t max_total_us;
+} last_gasp_stats_t;
+
+/**
+ * @brief Arm the power-fail interrupt
+ * 
+ * @param gpio_pin GPIO connected to the metering IC IRQ output (active low,
+ *                 open drain)
+ * @param handler Called once per falling edge
+ * @return true if armed
+ */
+bool last_gasp_init(int gpio_pin, last_gasp_handler_t handler);
+
+/**
+ * @brief Check for an event that still needs acknowledging at the source
+ * 
+ * Returns true once per event, so the measurement task can clear the
+ * metering IC status and release the IRQ line without sharing the SPI bus
+ * with the last-gasp task.
+ * 
+ * @return true if an event is waiting
+ */
+bool last_gasp_take_pending(void);
+
+/**
+ * @brief Get last-gasp statistics
+ * 
+ * Kept in RAM, so they cover the dips this boot rode through; an outage
+ * that cuts power takes them with it.
+ * 
+ * @param stats Destination
+ */
+void last_gasp_get_stats(last_gasp_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LAST_GASP_H */
@@ -9,6 +9,48 @@
 extern "C" {
 #endif
 
+/**
+ * @brief A zero-crossing synchronised switch
+ */
+typedef struct {
+    bool state;                 // New relay state
+    int64_t fire_us;            // Coil drive time (timebase_now_us())
+    int64_t target_us;          // Zero crossing the contacts were aimed at
+    uint32_t half_cycle_us;     // Half mains period at planning time
+} relay_switch_t;
+
+/**
+ * @brief Measures when the contacts actually moved after a switch
+ * 
+ * Runs in the relay learning task right after the coil is driven and may
+ * block for a few mains cycles.
+ * 
+ * @param sw The switch that just fired
+ * @return int64_t Contact time (timebase_now_us()), or 0 if not measurable
+ *         (e.g. no load connected)
+ */
+typedef int64_t (*relay_contact_observer_t)(const relay_switch_t *sw);
+
+/**
+ * @brief Zero-crossing switching statistics
+ * 
+ * Contact error = measured contact time - target zero crossing. The learned
+ * delays move by a quarter of each error.
+ */
+typedef struct {
+    uint32_t switches;              // State changes requested
+    uint32_t synced;                // Scheduled on a predicted zero crossing
+    uint32_t immediate;             // Switched at once (no recent edges or sync off)
+    uint32_t observed;              // Switches whose contact time was measured
+    uint32_t unobserved;            // Synced switches that could not be measured
+    uint32_t make_delay_us;         // Learned coil-on to contact-closed delay
+    uint32_t break_delay_us;        // Learned coil-off to contact-open delay
+    int32_t last_fire_error_us;     // Timer callback lateness on the last switch
+    int32_t last_contact_error_us;  // Contact error on the last observed switch
+    uint32_t mean_abs_error_us;     // Mean |contact error|
+    uint32_t max_abs_error_us;      // Worst |contact error|
+} relay_sync_stats_t;
+
 /**
  * @brief Initialize relay control
  * 
@@ -20,6 +62,11 @@ void relay_init(int gpio_pin, bool initial_state);
 /**
  * @brief Set relay state
  * 
+ * With CONFIG_RELAY_ZC_SYNC the coil is driven from a timer so the contacts
+ * move on the next reachable mains zero crossing (learned make/break delay
+ * ahead of it). Without recent zero-crossing edges it switches at once.
+ * relay_get_state() reflects the new state immediately.
+ * 
  * @param state true = ON, false = OFF
  */
 void relay_set(bool state);
@@ -36,6 +83,20 @@ bool relay_get_state(void);
  */
 void relay_toggle(void);
 
+/**
+ * @brief Register the contact-timing observer used to learn actuation delays
+ * 
+ * @param fn Observer (NULL disables learning)
+ */
+void relay_set_contact_observer(relay_contact_observer_t fn);
+
+/**
+ * @brief Get zero-crossing switching statistics
+ * 
+ * @param stats Destination
+ */
+void relay_get_sync_stats(relay_sync_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,96 @@
+// smart_plug/components/hardware/include/sample_sched.h
+#ifndef SAMPLE_SCHED_H
+#define SAMPLE_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One scheduled sample
+ * 
+ * Deadlines sit on a fixed grid of the sampling interval. With zero-crossing
+ * lock each deadline is moved by at most half a mains cycle so that it falls
+ * at a fixed phase after a rising edge; the grid itself never drifts.
+ */
+typedef struct {
+    uint32_t seq;               // Sample number since start
+    int64_t deadline_us;        // When the sample was due (timebase_now_us())
+    int64_t start_us;           // When the task picked it up; the sample timestamp
+    uint32_t latency_us;        // start_us - deadline_us
+    uint32_t skipped;           // Deadlines lost since the previous sample
+    bool zc_locked;             // Deadline was aligned to a zero crossing
+} sample_tick_t;
+
+/**
+ * @brief Scheduler statistics
+ * 
+ * Jitter is the deviation of the interval between consecutive sample
+ * timestamps from the interval they were scheduled at.
+ */
+typedef struct {
+    uint32_t samples;               // Samples delivered
+    uint32_t deadline_misses;       // Samples started later than the miss threshold
+    uint32_t skipped;               // Deadlines dropped because the task was still busy
+    uint32_t zc_locked;             // Samples aligned to a zero crossing
+    uint32_t interval_us;           // Current sampling interval
+    uint32_t last_latency_us;
+    uint32_t max_latency_us;
+    float jitter_rms_us;            // RMS interval deviation
+    uint32_t jitter_max_us;         // Largest interval deviation
+} sample_sched_stats_t;
+
+/**
+ * @brief Create the sampling timer
+ * 
+ * @param interval_us Sampling interval
+ * @param zc_lock Align deadlines to the zero-crossing phase when edges are present
+ * @return true if successful
+ */
+bool sample_sched_init(uint32_t interval_us, bool zc_lock);
+
+/**
+ * @brief Start delivering samples (first deadline one interval from now)
+ * 
+ * @return true if started
+ */
+bool sample_sched_start(void);
+
+/**
+ * @brief Block until the next sample is due
+ * 
+ * Intended for a single consumer task. If the task was still busy when a
+ * later deadline passed, only the newest one is delivered and the others are
+ * counted as skipped.
+ * 
+ * @param tick Sample timing
+ * @param timeout_ms Maximum wait
+ * @return true if a sample is due
+ */
+bool sample_sched_wait(sample_tick_t *tick, uint32_t timeout_ms);
+
+/**
+ * @brief Change the sampling interval
+ * 
+ * Takes effect from the next deadline, which moves to one new interval
+ * after the previous one.
+ * 
+ * @param interval_us New interval
+ */
+void sample_sched_set_interval(uint32_t interval_us);
+
+/**
+ * @brief Get scheduler statistics
+ * 
+ * @param stats Destination
+ */
+void sample_sched_get_stats(sample_sched_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLE_SCHED_H */
@@ -3,11 +3,31 @@
 #define ZERO_CROSSING_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/**
+ * @brief Multi-cycle mains frequency estimate
+ * 
+ * Built from the last CONFIG_ZC_ESTIMATOR_CYCLES edge periods. Periods more
+ * than CONFIG_ZC_OUTLIER_PCT away from the median are rejected before
+ * averaging, so a single glitched or missed edge does not move the result.
+ */
+typedef struct {
+    float frequency_hz;         // 1e6 / mean accepted period
+    float period_mean_us;       // Mean accepted period
+    float period_stddev_us;     // Cycle-to-cycle jitter
+    uint32_t period_min_us;     // Shortest accepted period
+    uint32_t period_max_us;     // Longest accepted period
+    uint32_t cycles;            // Periods accepted in this estimate
+    uint32_t outliers;          // Periods rejected in this estimate
+    uint32_t outliers_total;    // Periods rejected since start
+    int64_t newest_us;          // Newest edge used (timebase_now_us())
+} zc_frequency_t;
+
 /**
  * @brief Initialize zero-crossing detection -
  * 
@@ -33,11 +53,11 @@ void zero_crossing_stop(void);
 bool zero_crossing_detected(void);
 
 /**
- * @brief Get last zero-crossing timestamp (microseconds)
+ * @brief Get last zero-crossing timestamp
  * 
- * @return uint32_t Timestamp in microseconds
+ * @return int64_t Monotonic timestamp in microseconds (timebase_now_us())
  */
-uint32_t zero_crossing_get_last_time(void);
+int64_t zero_crossing_get_last_time(void);
 
 /**
  * @brief Get last zero-crossing period (microseconds)
@@ -53,13 +73,39 @@ uint32_t zero_crossing_get_last_period(void);
  */
 uint32_t zero_crossing_get_counter(void);
 
+/**
+ * @brief Estimate mains frequency over the recent edge history
+ * 
+ * Not reentrant: call from one task only.
+ * 
+ * @param out Destination (zeroed if no estimate is available)
+ * @return true if edges are current and in the 45-65 Hz band
+ */
+bool zero_crossing_get_frequency(zc_frequency_t *out);
+
 /**
  * @brief Calculate frequency from zero-crossing periods - matches calculateFrequencyFromZC()
  * 
- * @return float Frequency in Hz (0 if no valid period, between 45-65Hz if valid)
+ * @return float Frequency in Hz (0 if no valid estimate, between 45-65Hz if valid)
  */
 float zero_crossing_calculate_frequency(void);
 
+/**
+ * @brief Read edge timestamps newer than a cursor
+ * 
+ * Lock-free; each reader keeps its own cursor (start at
+ * zero_crossing_get_counter()). Edges overwritten before they were read
+ * are skipped and reported in dropped.
+ * 
+ * @param cursor Edge index to read from, advanced past the edges returned
+ * @param out Destination for timestamps (timebase_now_us())
+ * @param max_edges Capacity of out
+ * @param dropped Edges lost since the previous read (may be NULL)
+ * @return size_t Number of timestamps written
+ */
+size_t zero_crossing_read_edges(uint32_t *cursor, int64_t *out, size_t max_edges,
+                                uint32_t *dropped);
+
 /**
  * @brief Wait for next zero-crossing with timeout - matches waitForZeroCrossing()
  * 
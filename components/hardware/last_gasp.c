@@ -0,0 +1,127 @@
+// smart_plug/components/hardware/last_gasp.c
+#include "last_gasp.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "LAST_GASP";
+
+// The supply survived if we are still running this long after the event
+#define RIDE_THROUGH_MS     500
+
+static int irq_gpio = -1;
+static last_gasp_handler_t user_handler = NULL;
+static TaskHandle_t gasp_task_handle = NULL;
+
+static volatile int64_t irq_time_us = 0;
+static volatile bool ack_pending = false;
+static last_gasp_stats_t stats = {0};
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/*===============================================================================
+  Interrupt and Task
+  ===============================================================================*/
+
+static void IRAM_ATTR last_gasp_isr(void *arg)
+{
+    BaseType_t wake = pdFALSE;
+    
+    irq_time_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(gasp_task_handle, &wake);
+    
+    if (wake) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static void last_gasp_task(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        int64_t start = esp_timer_get_time();
+        uint32_t dispatch_us = start - irq_time_us;
+        
+        if (user_handler) {
+            user_handler(dispatch_us);
+        }
+        
+        int64_t end = esp_timer_get_time();
+        
+        // After the write, so the lock never delays it
+        portENTER_CRITICAL(&stats_mux);
+        stats.events++;
+        stats.last_dispatch_us = dispatch_us;
+        stats.last_handler_us = end - start;
+        stats.last_total_us = end - irq_time_us;
+        if (stats.last_dispatch_us > stats.max_dispatch_us) stats.max_dispatch_us = stats.last_dispatch_us;
+        if (stats.last_handler_us > stats.max_handler_us) stats.max_handler_us = stats.last_handler_us;
+        if (stats.last_total_us > stats.max_total_us) stats.max_total_us = stats.last_total_us;
+        portEXIT_CRITICAL(&stats_mux);
+        ack_pending = true;
+        
+        // Only reached if the hold-up time outlasted the dip
+        vTaskDelay(pdMS_TO_TICKS(RIDE_THROUGH_MS));
+        portENTER_CRITICAL(&stats_mux);
+        stats.ride_throughs++;
+        portEXIT_CRITICAL(&stats_mux);
+        ESP_LOGW(TAG, "Supply dip #%lu survived: dispatch %lu us, handler %lu us",
+                 (unsigned long)stats.events, (unsigned long)stats.last_dispatch_us,
+                 (unsigned long)stats.last_handler_us);
+    }
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool last_gasp_init(int gpio_pin, last_gasp_handler_t handler)
+{
+    if (gpio_pin < 0 || !handler) return false;
+    
+    irq_gpio = gpio_pin;
+    user_handler = handler;
+    
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << irq_gpio),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE
+    };
+    gpio_config(&io_conf);
+    
+    if (xTaskCreate(last_gasp_task, "last_gasp", 3072, NULL,
+                    configMAX_PRIORITIES - 1, &gasp_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task");
+        return false;
+    }
+    
+    // Already installed by the zero-crossing driver in most builds
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_LEVEL1);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "ISR service install failed: %s", esp_err_to_name(err));
+        return false;
+    }
+    gpio_isr_handler_add(irq_gpio, last_gasp_isr, NULL);
+    
+    ESP_LOGI(TAG, "Power-fail interrupt armed on GPIO %d", irq_gpio);
+    return true;
+}
+
+bool last_gasp_take_pending(void)
+{
+    if (!ack_pending) return false;
+    ack_pending = false;
+    return true;
+}
+
+void last_gasp_get_stats(last_gasp_stats_t *out)
+{
+    if (!out) return;
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_mux);
+}
@@ -2,7 +2,7 @@
 #include "led.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
-#include "esp_timer.h" 
+#include "timebase.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
@@ -11,7 +11,7 @@ static const char *TAG = "LED";
 static int led_gpio = -1;
 static led_mode_t current_mode = LED_MODE_OFF;
 static bool led_state = false;
-static uint32_t last_blink_time = 0;
+static int64_t last_blink_time = 0;
 static uint32_t pattern_counter = 0;
 static TaskHandle_t led_task_handle = NULL;
 
@@ -62,7 +62,7 @@ static void led_update(void)
 {
     if (led_gpio < 0) return;
     
-    uint32_t now = esp_timer_get_time() / 1000; // Convert to milliseconds
+    int64_t now = timebase_now_ms();
     uint32_t interval = 0;
     bool new_state = false;
     
@@ -1,14 +1,170 @@
 // smart_plug/components/hardware/relay.c
 
 #include "relay.h"
+#include "zero_crossing.h"
+#include "timebase.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 static const char *TAG = "RELAY";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+
+  CONFIG_RELAY_ZC_SYNC is a bool, undefined when off, so it has no fallback
+  here (its default is in Kconfig). The delays only exist while it is on.
+  ===============================================================================*/
+
+#ifndef CONFIG_RELAY_MAKE_DELAY_US
+#define CONFIG_RELAY_MAKE_DELAY_US 8000
+#endif
+
+#ifndef CONFIG_RELAY_BREAK_DELAY_US
+#define CONFIG_RELAY_BREAK_DELAY_US 4000
+#endif
+
+#define RELAY_MIN_LEAD_US       500     // Timer setup margin before the fire time
+#define RELAY_MIN_DELAY_US      1000
+#define RELAY_MAX_DELAY_US      30000
+#define RELAY_LEARN_GAIN        4       // Delay moves by error / gain per switch
+#define RELAY_PERIOD_CYCLES     8       // Cycles averaged to predict the next edge
+
+// Valid mains band
+#define RELAY_MIN_PERIOD_US     15384   // 65 Hz
+#define RELAY_MAX_PERIOD_US     22222   // 45 Hz
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
 static int relay_gpio = -1;
-static bool current_state = false;
+static bool current_state = false;      // Requested state
+static bool output_state = false;       // State driven on the GPIO
+
+static portMUX_TYPE relay_mux = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t fire_timer = NULL;
+static relay_switch_t pending;          // Scheduled switch (valid while armed)
+static bool armed = false;
+static relay_switch_t fired;            // Last synchronised switch, for the observer
+
+static relay_contact_observer_t observer = NULL;
+static TaskHandle_t learn_task_handle = NULL;
+static relay_sync_stats_t stats = {
+    .make_delay_us = CONFIG_RELAY_MAKE_DELAY_US,
+    .break_delay_us = CONFIG_RELAY_BREAK_DELAY_US,
+};
+static uint64_t abs_error_sum = 0;
+
+/*===============================================================================
+  Switching
+  ===============================================================================*/
+
+static void drive_output(bool state)
+{
+    output_state = state;
+    gpio_set_level(relay_gpio, state ? 1 : 0);
+}
+
+static void fire_cb(void *arg)
+{
+    int64_t now = timebase_now_us();
+    
+    portENTER_CRITICAL(&relay_mux);
+    if (!armed) {
+        portEXIT_CRITICAL(&relay_mux);
+        return;
+    }
+    drive_output(pending.state);
+    armed = false;
+    fired = pending;
+    stats.last_fire_error_us = (int32_t)(now - pending.fire_us);
+    fired.fire_us = now;
+    portEXIT_CRITICAL(&relay_mux);
+    
+    if (learn_task_handle) {
+        xTaskNotifyGive(learn_task_handle);
+    }
+}
+
+// Predict the next usable zero crossing from the recent edge history
+static bool plan_switch(bool state, relay_switch_t *sw)
+{
+    uint32_t cursor = zero_crossing_get_counter() - (RELAY_PERIOD_CYCLES + 1);
+    int64_t edges[RELAY_PERIOD_CYCLES + 1];
+    size_t n = zero_crossing_read_edges(&cursor, edges, RELAY_PERIOD_CYCLES + 1, NULL);
+    if (n < 2) return false;
+    
+    uint32_t period = (uint32_t)((edges[n - 1] - edges[0]) / (int64_t)(n - 1));
+    if (period < RELAY_MIN_PERIOD_US || period > RELAY_MAX_PERIOD_US) return false;
+    
+    int64_t now = timebase_now_us();
+    int64_t last_edge = edges[n - 1];
+    if (now - last_edge > 2 * (int64_t)period) return false;
+    
+    // Both crossings of the cycle are targets, so step in half periods
+    uint32_t half = period / 2;
+    uint32_t delay = state ? stats.make_delay_us : stats.break_delay_us;
+    int64_t earliest = now + RELAY_MIN_LEAD_US + delay;
+    int64_t k = (earliest - last_edge + half - 1) / half;
+    
+    sw->state = state;
+    sw->target_us = last_edge + k * half;
+    sw->fire_us = sw->target_us - delay;
+    sw->half_cycle_us = half;
+    return true;
+}
+
+static void learn_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        relay_switch_t sw;
+        portENTER_CRITICAL(&relay_mux);
+        sw = fired;
+        portEXIT_CRITICAL(&relay_mux);
+        
+        int64_t contact_us = observer ? observer(&sw) : 0;
+        if (contact_us == 0) {
+            stats.unobserved++;
+            continue;
+        }
+        
+        // Contacts moved at fire + true delay; we aimed at fire + learned delay
+        int32_t error = (int32_t)(contact_us - sw.target_us);
+        if (error > (int32_t)sw.half_cycle_us || error < -(int32_t)sw.half_cycle_us) {
+            stats.unobserved++;
+            ESP_LOGW(TAG, "Implausible contact timing %ld us, ignored", (long)error);
+            continue;
+        }
+        
+        uint32_t *delay = sw.state ? &stats.make_delay_us : &stats.break_delay_us;
+        int32_t updated = (int32_t)*delay + error / RELAY_LEARN_GAIN;
+        if (updated < RELAY_MIN_DELAY_US) updated = RELAY_MIN_DELAY_US;
+        if (updated > RELAY_MAX_DELAY_US) updated = RELAY_MAX_DELAY_US;
+        *delay = updated;
+        
+        uint32_t abs_error = error < 0 ? -error : error;
+        stats.observed++;
+        stats.last_contact_error_us = error;
+        abs_error_sum += abs_error;
+        stats.mean_abs_error_us = abs_error_sum / stats.observed;
+        if (abs_error > stats.max_abs_error_us) {
+            stats.max_abs_error_us = abs_error;
+        }
+        
+        ESP_LOGI(TAG, "%s contact %+ld us from zero crossing, %s delay now %lu us",
+                 sw.state ? "Make" : "Break", (long)error,
+                 sw.state ? "make" : "break", (unsigned long)*delay);
+    }
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
 
 void relay_init(int gpio_pin, bool initial_state)
 {
@@ -24,8 +180,20 @@ void relay_init(int gpio_pin, bool initial_state)
     };
     gpio_config(&io_conf);
     
-    gpio_set_level(relay_gpio, current_state ? 1 : 0);
-    ESP_LOGI(TAG, "Relay initialized on GPIO %d, initial state: %s", 
+    drive_output(current_state);
+
+#ifdef CONFIG_RELAY_ZC_SYNC
+    const esp_timer_create_args_t timer_args = {
+        .callback = fire_cb,
+        .name = "relay_fire",
+    };
+    if (esp_timer_create(&timer_args, &fire_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create switching timer, switching immediately");
+        fire_timer = NULL;
+    }
+#endif
+    
+    ESP_LOGI(TAG, "Relay initialized on GPIO %d, initial state: %s",
              relay_gpio, current_state ? "ON" : "OFF");
 }
 
@@ -36,14 +204,49 @@ void relay_set(bool state)
         return;
     }
     
-    if (state != current_state) {
-        current_state = state;
-        gpio_set_level(relay_gpio, current_state ? 1 : 0);
-        ESP_LOGI(TAG, "Relay turned %s (current_state=%d)", 
-                 current_state ? "ON" : "OFF", current_state);
-    } else {
+    if (state == current_state) {
         ESP_LOGD(TAG, "Relay already %s, no change", state ? "ON" : "OFF");
+        return;
     }
+    current_state = state;
+    stats.switches++;
+    
+    // A newer request replaces one that has not fired yet
+    if (fire_timer) {
+        esp_timer_stop(fire_timer);
+    }
+    portENTER_CRITICAL(&relay_mux);
+    armed = false;
+    bool output_matches = (output_state == state);
+    portEXIT_CRITICAL(&relay_mux);
+    if (output_matches) {
+        ESP_LOGI(TAG, "Relay turned %s (pending switch cancelled)", state ? "ON" : "OFF");
+        return;
+    }
+    
+    relay_switch_t sw;
+    if (fire_timer && plan_switch(state, &sw)) {
+        portENTER_CRITICAL(&relay_mux);
+        pending = sw;
+        armed = true;
+        portEXIT_CRITICAL(&relay_mux);
+        
+        int64_t wait = sw.fire_us - timebase_now_us();
+        esp_timer_start_once(fire_timer, wait > 0 ? wait : 0);
+        stats.synced++;
+        ESP_LOGI(TAG, "Relay turning %s at zero crossing in %lld us (current_state=%d)",
+                 state ? "ON" : "OFF", (long long)(sw.target_us - timebase_now_us()),
+                 current_state);
+        return;
+    }
+    
+    // No recent edges (or sync disabled): switch now
+    portENTER_CRITICAL(&relay_mux);
+    drive_output(state);
+    portEXIT_CRITICAL(&relay_mux);
+    stats.immediate++;
+    ESP_LOGI(TAG, "Relay turned %s (current_state=%d)",
+             current_state ? "ON" : "OFF", current_state);
 }
 
 bool relay_get_state(void)
@@ -56,4 +259,18 @@ void relay_toggle(void)
 {
     ESP_LOGI(TAG, "Toggling relay from %s", current_state ? "ON" : "OFF");
     relay_set(!current_state);
-}
\ No newline at end of file
+}
+
+void relay_set_contact_observer(relay_contact_observer_t fn)
+{
+    observer = fn;
+    if (fn && !learn_task_handle && fire_timer) {
+        xTaskCreate(learn_task, "relay_learn", 3072, NULL, 6, &learn_task_handle);
+    }
+}
+
+void relay_get_sync_stats(relay_sync_stats_t *out)
+{
+    if (!out) return;
+    *out = stats;
+}
@@ -0,0 +1,249 @@
+// smart_plug/components/hardware/sample_sched.c
+#include "sample_sched.h"
+#include "zero_crossing.h"
+#include "timebase.h"
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SAMPLE_SCHED";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_SAMPLE_ZC_PHASE_US
+#define CONFIG_SAMPLE_ZC_PHASE_US 100
+#endif
+
+#ifndef CONFIG_SAMPLE_MISS_US
+#define CONFIG_SAMPLE_MISS_US 5000
+#endif
+
+// Valid mains band
+#define SCHED_MIN_PERIOD_US     15384   // 65 Hz
+#define SCHED_MAX_PERIOD_US     22222   // 45 Hz
+
+/*===============================================================================
+  Static Variables
+  
+  The timer callback runs in the esp_timer task: it hands the due sample to
+  the consumer through due_tick and re-arms itself for the next deadline, so
+  a slow consumer never shifts the schedule.
+  ===============================================================================*/
+
+static esp_timer_handle_t sched_timer = NULL;
+static SemaphoreHandle_t due_sem = NULL;
+static portMUX_TYPE sched_mux = portMUX_INITIALIZER_UNLOCKED;
+static bool running = false;
+
+static uint32_t interval_us = 0;
+static bool zc_lock = false;
+
+static int64_t grid_us = 0;             // Nominal time of the armed deadline
+static int64_t last_grid_us = 0;        // Nominal time of the last fired deadline
+static int64_t deadline_us = 0;         // Armed deadline (grid_us, ZC-aligned)
+static bool deadline_locked = false;
+static uint32_t seq = 0;
+
+static bool due = false;
+static sample_tick_t due_tick;
+static uint32_t skipped_since = 0;
+
+// Consumer side
+static sample_sched_stats_t stats = {0};
+static int64_t prev_start_us = 0;
+static int64_t prev_deadline_us = 0;
+static double jitter_sq_sum = 0;
+static uint32_t jitter_count = 0;
+
+/*===============================================================================
+  Timer
+  ===============================================================================*/
+
+// Move a grid point by at most half a cycle to land at a fixed phase after a
+// rising edge. Edges are only trusted while they are recent.
+static int64_t align_to_zc(int64_t grid, int64_t now, bool *locked)
+{
+    *locked = false;
+    if (!zc_lock) return grid;
+    
+    int64_t edge = zero_crossing_get_last_time();
+    uint32_t period = zero_crossing_get_last_period();
+    if (edge == 0 || period < SCHED_MIN_PERIOD_US || period > SCHED_MAX_PERIOD_US) {
+        return grid;
+    }
+    if (now - edge > 2 * (int64_t)period) return grid;
+    
+    int64_t base = edge + CONFIG_SAMPLE_ZC_PHASE_US;
+    if (grid < base) return grid;
+    
+    int64_t k = (grid - base + period / 2) / period;
+    int64_t aligned = base + k * period;
+    if (aligned <= now) return grid;
+    
+    *locked = true;
+    return aligned;
+}
+
+// Arm the grid point after last_grid_us. Points already in the past are
+// stepped over (and counted as skipped when the timer itself ran late).
+static void arm_next(int64_t now, bool count_skips)
+{
+    portENTER_CRITICAL(&sched_mux);
+    int64_t next = last_grid_us + interval_us;
+    while (next <= now) {
+        next += interval_us;
+        if (count_skips) {
+            stats.skipped++;
+            skipped_since++;
+        }
+    }
+    grid_us = next;
+    portEXIT_CRITICAL(&sched_mux);
+    
+    bool locked;
+    int64_t deadline = align_to_zc(next, now, &locked);
+    
+    portENTER_CRITICAL(&sched_mux);
+    deadline_us = deadline;
+    deadline_locked = locked;
+    portEXIT_CRITICAL(&sched_mux);
+    
+    esp_timer_start_once(sched_timer, deadline - now);
+}
+
+static void sched_cb(void *arg)
+{
+    int64_t now = timebase_now_us();
+    
+    portENTER_CRITICAL(&sched_mux);
+    // Consumer still busy with the previous sample: replace it
+    if (due) {
+        stats.skipped++;
+        skipped_since++;
+    }
+    due = true;
+    due_tick.seq = seq++;
+    due_tick.deadline_us = deadline_us;
+    due_tick.zc_locked = deadline_locked;
+    last_grid_us = grid_us;
+    portEXIT_CRITICAL(&sched_mux);
+    
+    xSemaphoreGive(due_sem);
+    arm_next(now, true);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool sample_sched_init(uint32_t interval, bool lock)
+{
+    interval_us = interval;
+    zc_lock = lock;
+    
+    due_sem = xSemaphoreCreateBinary();
+    if (!due_sem) {
+        ESP_LOGE(TAG, "Failed to create semaphore");
+        return false;
+    }
+    
+    const esp_timer_create_args_t timer_args = {
+        .callback = sched_cb,
+        .name = "sample_sched",
+    };
+    if (esp_timer_create(&timer_args, &sched_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create sampling timer");
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "Sampling every %lu us%s", (unsigned long)interval_us,
+             zc_lock ? ", aligned to zero crossings" : "");
+    return true;
+}
+
+bool sample_sched_start(void)
+{
+    if (!sched_timer || running) return false;
+    
+    int64_t now = timebase_now_us();
+    last_grid_us = now;
+    running = true;
+    arm_next(now, false);
+    return true;
+}
+
+bool sample_sched_wait(sample_tick_t *tick, uint32_t timeout_ms)
+{
+    if (!due_sem || xSemaphoreTake(due_sem, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        return false;
+    }
+    
+    int64_t now = timebase_now_us();
+    portENTER_CRITICAL(&sched_mux);
+    if (!due) {
+        portEXIT_CRITICAL(&sched_mux);
+        return false;
+    }
+    *tick = due_tick;
+    tick->skipped = skipped_since;
+    skipped_since = 0;
+    due = false;
+    portEXIT_CRITICAL(&sched_mux);
+    
+    tick->start_us = now;
+    tick->latency_us = (uint32_t)(now - tick->deadline_us);
+    
+    stats.samples++;
+    if (tick->zc_locked) stats.zc_locked++;
+    stats.last_latency_us = tick->latency_us;
+    if (tick->latency_us > stats.max_latency_us) {
+        stats.max_latency_us = tick->latency_us;
+    }
+    if (tick->latency_us > CONFIG_SAMPLE_MISS_US) {
+        stats.deadline_misses++;
+    }
+    
+    // Compare actual spacing with scheduled spacing of consecutive samples
+    if (prev_start_us != 0 && tick->skipped == 0) {
+        int64_t dev = (now - prev_start_us) - (tick->deadline_us - prev_deadline_us);
+        uint32_t abs_dev = (uint32_t)(dev < 0 ? -dev : dev);
+        if (abs_dev > stats.jitter_max_us) {
+            stats.jitter_max_us = abs_dev;
+        }
+        jitter_sq_sum += (double)dev * dev;
+        jitter_count++;
+    }
+    prev_start_us = now;
+    prev_deadline_us = tick->deadline_us;
+    return true;
+}
+
+void sample_sched_set_interval(uint32_t interval)
+{
+    portENTER_CRITICAL(&sched_mux);
+    bool changed = interval != interval_us;
+    interval_us = interval;
+    portEXIT_CRITICAL(&sched_mux);
+    
+    if (!running || !changed) return;
+    
+    // Re-arm from the last deadline; if the callback is running right now it
+    // re-arms with the new interval itself and this start is refused
+    esp_timer_stop(sched_timer);
+    arm_next(timebase_now_us(), false);
+}
+
+void sample_sched_get_stats(sample_sched_stats_t *out)
+{
+    if (!out) return;
+    
+    portENTER_CRITICAL(&sched_mux);
+    *out = stats;
+    out->interval_us = interval_us;
+    portEXIT_CRITICAL(&sched_mux);
+    out->jitter_rms_us = jitter_count ? (float)sqrt(jitter_sq_sum / jitter_count) : 0.0f;
+}
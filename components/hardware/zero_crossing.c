@@ -1,36 +1,79 @@
 // smart_plug/components/hardware/zero_crossing.c
 #include "zero_crossing.h"
+#include <string.h>
+#include <math.h>
 #include "driver/gpio.h"
 #include "esp_log.h"
-#include "esp_timer.h"
+#include "timebase.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
 
 static const char *TAG = "ZC";
 
-// Static variables for ISR and task communication
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_ZC_RING_BITS
+#define CONFIG_ZC_RING_BITS 7
+#endif
+
+#ifndef CONFIG_ZC_ESTIMATOR_CYCLES
+#define CONFIG_ZC_ESTIMATOR_CYCLES 50
+#endif
+
+#ifndef CONFIG_ZC_OUTLIER_PCT
+#define CONFIG_ZC_OUTLIER_PCT 5
+#endif
+
+#define ZC_RING_SIZE        (1u << CONFIG_ZC_RING_BITS)
+#define ZC_RING_MASK        (ZC_RING_SIZE - 1)
+
+// The ISR may be writing the slot after head, so one entry is never readable
+#define ZC_MAX_CYCLES       (CONFIG_ZC_ESTIMATOR_CYCLES < ZC_RING_SIZE - 2 ? \
+                             CONFIG_ZC_ESTIMATOR_CYCLES : ZC_RING_SIZE - 2)
+
+// Valid mains band
+#define ZC_MIN_PERIOD_US    15384   // 65 Hz
+#define ZC_MAX_PERIOD_US    22222   // 45 Hz
+
+/*===============================================================================
+  Static Variables
+
+  Edge timestamp ring: single producer (ISR), lock-free readers. The ISR
+  writes the slot and then publishes it by advancing zc_head with release
+  ordering. A reader copies what it needs and re-reads zc_head afterwards to
+  discard any entry the ISR may have overwritten during the copy.
+  ===============================================================================*/
+
 static volatile bool zc_detected = false;
-static volatile uint32_t last_zc_time = 0;
-static volatile uint32_t last_zc_period = 0;
-static volatile uint32_t zc_counter = 0;
+static int64_t zc_ring[ZC_RING_SIZE];
+static volatile uint32_t zc_head = 0;      // Edges pushed since start
 static int zc_gpio = -1;
 static SemaphoreHandle_t zc_semaphore = NULL;
 
-// ISR - must be in IRAM 
+// Estimator scratch (measurement task only)
+static int64_t edges[ZC_MAX_CYCLES + 1];
+static uint32_t periods[ZC_MAX_CYCLES];
+static uint32_t sorted[ZC_MAX_CYCLES];
+static uint32_t outliers_total = 0;
+static uint32_t outliers_counted_to = 0;   // Edge index up to which outliers are counted
+
+/*===============================================================================
+  ISR
+  ===============================================================================*/
+
 static void IRAM_ATTR zero_crossing_isr(void *arg)
 {
-    uint32_t now = (uint32_t)esp_timer_get_time();
+    int64_t now = timebase_now_us();
     BaseType_t wake = pdFALSE;
     
-    // Calculate period between zero crossings 
-    if (last_zc_time > 0) {
-        last_zc_period = now - last_zc_time;
-    }
+    uint32_t head = zc_head;
+    zc_ring[head & ZC_RING_MASK] = now;
+    __atomic_store_n(&zc_head, head + 1, __ATOMIC_RELEASE);
     
-    last_zc_time = now;
     zc_detected = true;
-    zc_counter++;
     
     // Give semaphore to task if waiting
     if (zc_semaphore != NULL) {
@@ -42,6 +85,57 @@ static void IRAM_ATTR zero_crossing_isr(void *arg)
     }
 }
 
+/*===============================================================================
+  Ring Access
+  ===============================================================================*/
+
+static uint32_t ring_head(void)
+{
+    return __atomic_load_n(&zc_head, __ATOMIC_ACQUIRE);
+}
+
+// Copy edges [*first, end) into out. On return *first is the oldest edge that
+// survived the copy and the result is the number of valid entries in out.
+static uint32_t ring_copy(uint32_t *first, uint32_t end, int64_t *out)
+{
+    uint32_t n = end - *first;
+    for (uint32_t i = 0; i < n; i++) {
+        out[i] = zc_ring[(*first + i) & ZC_RING_MASK];
+    }
+    
+    uint32_t oldest_safe = ring_head() - ZC_RING_SIZE + 1;
+    if ((int32_t)(oldest_safe - *first) > 0) {
+        uint32_t drop = oldest_safe - *first;
+        if (drop >= n) {
+            *first = end;
+            return 0;
+        }
+        memmove(out, out + drop, (n - drop) * sizeof(out[0]));
+        *first += drop;
+        n -= drop;
+    }
+    return n;
+}
+
+static uint32_t median_period(uint32_t count)
+{
+    memcpy(sorted, periods, count * sizeof(sorted[0]));
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t v = sorted[i];
+        uint32_t j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+    return sorted[count / 2];
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
 void zero_crossing_init(int gpio_pin)
 {
     zc_gpio = gpio_pin;
@@ -51,14 +145,15 @@ void zero_crossing_init(int gpio_pin)
         .mode = GPIO_MODE_INPUT,
         .pull_up_en = GPIO_PULLUP_DISABLE,
         .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_POSEDGE  // Rising edge interrupt 
+        .intr_type = GPIO_INTR_POSEDGE  // Rising edge interrupt
     };
     gpio_config(&io_conf);
     
     // Create semaphore for task synchronization
     zc_semaphore = xSemaphoreCreateBinary();
     
-    ESP_LOGI(TAG, "Zero-crossing initialized on GPIO %d", zc_gpio);
+    ESP_LOGI(TAG, "Zero-crossing initialized on GPIO %d (ring %u edges)",
+             zc_gpio, (unsigned)ZC_RING_SIZE);
 }
 
 void zero_crossing_start(void)
@@ -75,14 +170,14 @@ void zero_crossing_start(void)
         isr_service_installed = true;
     }
     
-    // Add ISR handler 
-    gpio_isr_handler_add(zc_gpio, zero_crossing_isr, NULL);
-    
-    // Reset state
+    // Reset state before the ISR can run
     zc_detected = false;
-    last_zc_time = 0;
-    last_zc_period = 0;
-    zc_counter = 0;
+    zc_head = 0;
+    outliers_total = 0;
+    outliers_counted_to = 0;
+    
+    // Add ISR handler
+    gpio_isr_handler_add(zc_gpio, zero_crossing_isr, NULL);
     
     ESP_LOGI(TAG, "Zero-crossing detection started");
 }
@@ -100,37 +195,134 @@ bool zero_crossing_detected(void)
     return zc_detected;
 }
 
-uint32_t zero_crossing_get_last_time(void)
+int64_t zero_crossing_get_last_time(void)
 {
-    return last_zc_time;
+    uint32_t end = ring_head();
+    if (end == 0) return 0;
+    
+    uint32_t first = end - 1;
+    int64_t t;
+    return ring_copy(&first, end, &t) ? t : 0;
 }
 
 uint32_t zero_crossing_get_last_period(void)
 {
-    return last_zc_period;
+    uint32_t end = ring_head();
+    if (end < 2) return 0;
+    
+    uint32_t first = end - 2;
+    int64_t t[2];
+    if (ring_copy(&first, end, t) < 2) return 0;
+    return (uint32_t)(t[1] - t[0]);
 }
 
 uint32_t zero_crossing_get_counter(void)
 {
-    return zc_counter;
+    return ring_head();
 }
 
-float zero_crossing_calculate_frequency(void)
+size_t zero_crossing_read_edges(uint32_t *cursor, int64_t *out, size_t max_edges,
+                                uint32_t *dropped)
 {
-    if (last_zc_period == 0) {
-        return 0.0f;
+    uint32_t end = ring_head();
+    uint32_t first = *cursor;
+    uint32_t lost = 0;
+    
+    // Reader fell behind: skip to the oldest edge still in the ring
+    uint32_t oldest = end - (end < ZC_RING_SIZE - 1 ? end : ZC_RING_SIZE - 1);
+    if ((int32_t)(oldest - first) > 0) {
+        lost = oldest - first;
+        first = oldest;
+    }
+    if (end - first > max_edges) {
+        end = first + max_edges;
     }
     
-    // Calculate frequency from period (period is in microseconds)
-    // Formula: f = 1,000,000 / period (microseconds)
-    float frequency = 1000000.0f / (float)last_zc_period;
+    uint32_t requested = first;
+    uint32_t n = ring_copy(&first, end, out);
+    lost += first - requested;
     
-    // Validate frequency (should be around 50Hz or 60Hz)
-    if (frequency < 45.0f || frequency > 65.0f) {
-        return 0.0f;
+    *cursor = first + n;
+    if (dropped) *dropped = lost;
+    return n;
+}
+
+bool zero_crossing_get_frequency(zc_frequency_t *out)
+{
+    memset(out, 0, sizeof(*out));
+    
+    uint32_t end = ring_head();
+    uint32_t available = end < ZC_MAX_CYCLES + 1 ? end : ZC_MAX_CYCLES + 1;
+    if (available < 3) return false;
+    
+    uint32_t first = end - available;
+    uint32_t count = ring_copy(&first, end, edges);
+    if (count < 3) return false;
+    
+    uint32_t n = count - 1;
+    for (uint32_t i = 0; i < n; i++) {
+        periods[i] = (uint32_t)(edges[i + 1] - edges[i]);
     }
     
-    return frequency;
+    // Median is immune to a few glitched or missed edges
+    uint32_t median = median_period(n);
+    if (median < ZC_MIN_PERIOD_US || median > ZC_MAX_PERIOD_US) return false;
+    
+    // Edges stopped (mains off or detector lost): the ring is stale
+    if (timebase_now_us() - edges[count - 1] > 4 * (int64_t)median) return false;
+    
+    uint32_t tolerance = median * CONFIG_ZC_OUTLIER_PCT / 100;
+    int64_t sum = 0;
+    uint32_t accepted = 0;
+    uint32_t new_outliers = 0;
+    out->period_min_us = UINT32_MAX;
+    
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t p = periods[i];
+        uint32_t dev = p > median ? p - median : median - p;
+        if (dev > tolerance) {
+            out->outliers++;
+            // Count each edge once across overlapping windows
+            if ((int32_t)(first + i + 1 - outliers_counted_to) > 0) {
+                new_outliers++;
+            }
+            periods[i] = 0;
+            continue;
+        }
+        sum += p;
+        accepted++;
+        if (p < out->period_min_us) out->period_min_us = p;
+        if (p > out->period_max_us) out->period_max_us = p;
+    }
+    outliers_total += new_outliers;
+    outliers_counted_to = first + count - 1;
+    
+    if (accepted == 0) return false;
+    
+    double mean = (double)sum / accepted;
+    double m2 = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (periods[i] == 0) continue;
+        double d = periods[i] - mean;
+        m2 += d * d;
+    }
+    
+    out->frequency_hz = (float)(1000000.0 / mean);
+    out->period_mean_us = (float)mean;
+    out->period_stddev_us = accepted > 1 ? (float)sqrt(m2 / (accepted - 1)) : 0.0f;
+    out->cycles = accepted;
+    out->outliers_total = outliers_total;
+    out->newest_us = edges[count - 1];
+    return true;
+}
+
+float zero_crossing_calculate_frequency(void)
+{
+    zc_frequency_t f;
+    if (!zero_crossing_get_frequency(&f)) {
+        return 0.0f;
+    }
+    return f.frequency_hz;
 }
 
 bool zero_crossing_wait(uint32_t timeout_ms)
@@ -139,7 +331,7 @@ bool zero_crossing_wait(uint32_t timeout_ms)
         return false;
     }
     
-    // Wait for semaphore from ISR 
+    // Wait for semaphore from ISR
     if (xSemaphoreTake(zc_semaphore, pdMS_TO_TICKS(timeout_ms)) == pdTRUE) {
         return true;
     }
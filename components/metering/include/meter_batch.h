@@ -0,0 +1,121 @@
+// smart_plug/components/metering/include/meter_batch.h
+#ifndef METER_BATCH_H
+#define METER_BATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "payload_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Batch Object (inside the telemetry message)
+  
+  {"t0_ms": <first sample, epoch ms>, "energy0_uwh": <first sample>, "count": N,
+   "offset_ms": [...], "rms_v": [...], "rms_a": [...], "active_w": [...],
+   "power_factor": [...], "frequency_hz": [...], "energy_uwh": [...], "relay": [...]}
+  
+  One element per sample in every column. offset_ms and energy_uwh are
+  relative to t0_ms and energy0_uwh. In CBOR the readings are integers
+  scaled as described in the schema.
+  ===============================================================================*/
+
+/**
+ * @brief Why a batch is flushed
+ */
+typedef enum {
+    BATCH_FLUSH_NONE,
+    BATCH_FLUSH_COUNT,              // CONFIG_BATCH_MAX_SAMPLES reached
+    BATCH_FLUSH_BYTES,              // CONFIG_BATCH_MAX_BYTES of sample data reached
+    BATCH_FLUSH_AGE,                // Oldest sample is CONFIG_BATCH_MAX_AGE_S old
+    BATCH_FLUSH_EVENT,              // Relay or alarm event, sent without waiting
+    BATCH_FLUSH_REASON_COUNT
+} batch_flush_t;
+
+/**
+ * @brief Batch statistics
+ */
+typedef struct {
+    uint32_t batches[BATCH_FLUSH_REASON_COUNT];     // Batches published, by reason
+    uint32_t samples_sent;
+    uint32_t samples_dropped;       // Oldest samples overwritten while publishing failed
+    uint32_t failed;                // Flushes the MQTT client refused
+} batch_stats_t;
+
+/**
+ * @brief Clear the batch and statistics
+ */
+void meter_batch_init(void);
+
+/**
+ * @brief Append one sample
+ * 
+ * If the buffer is still full from a failed flush, the oldest sample is
+ * dropped.
+ * 
+ * @param time_ms Sample time (timebase_now_ms())
+ * @param voltage Voltage RMS (V)
+ * @param current Current RMS (A)
+ * @param power Active power (W)
+ * @param power_factor Power factor
+ * @param frequency Line frequency (Hz)
+ * @param energy_uwh Cumulative energy counter (micro-Wh)
+ * @param relay Relay state
+ * @param format Encoding the batch will be sent in (for the byte limit)
+ * @return batch_flush_t BATCH_FLUSH_COUNT or BATCH_FLUSH_BYTES if the batch is
+ *         full, else BATCH_FLUSH_NONE
+ */
+batch_flush_t meter_batch_add(int64_t time_ms, float voltage, float current, float power,
+                              float power_factor, float frequency, int64_t energy_uwh,
+                              bool relay, payload_format_t format);
+
+/**
+ * @brief Check whether the oldest sample has waited long enough
+ * 
+ * @param now_ms Current time (timebase_now_ms())
+ * @return batch_flush_t BATCH_FLUSH_AGE if due, else BATCH_FLUSH_NONE
+ */
+batch_flush_t meter_batch_due(int64_t now_ms);
+
+/**
+ * @brief Get the number of buffered samples
+ */
+size_t meter_batch_count(void);
+
+/**
+ * @brief Write the buffered samples as a map of columns
+ * 
+ * @param w Writer
+ * @param key CBOR key
+ * @param name JSON name
+ */
+void meter_batch_write(payload_writer_t *w, uint8_t key, const char *name);
+
+/**
+ * @brief Record the result of publishing the written batch
+ * 
+ * @param reason Flush reason
+ * @param ok true if published (the buffer is cleared), false to keep it
+ */
+void meter_batch_flushed(batch_flush_t reason, bool ok);
+
+/**
+ * @brief Get a printable flush reason
+ */
+const char *meter_batch_reason_name(batch_flush_t reason);
+
+/**
+ * @brief Get batch statistics
+ * 
+ * @param stats Destination
+ */
+void meter_batch_get_stats(batch_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_BATCH_H */
@@ -0,0 +1,84 @@
+// smart_plug/components/metering/include/meter_rate.h
+#ifndef METER_RATE_H
+#define METER_RATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sampling modes, slowest first
+ */
+typedef enum {
+    METER_RATE_IDLE,        // Power stable within the deadband
+    METER_RATE_NORMAL,      // Power drifting
+    METER_RATE_BURST,       // Step change or relay event
+    METER_RATE_MODE_COUNT
+} meter_rate_mode_t;
+
+/**
+ * @brief Rate controller statistics
+ */
+typedef struct {
+    meter_rate_mode_t mode;                     // Current mode
+    uint32_t interval_ms;                       // Current sampling interval
+    uint32_t burst_floor_ms;                    // Fastest interval the sample path sustains
+    uint32_t bursts;                            // Burst periods entered
+    uint32_t transitions;                       // Mode changes
+    uint64_t time_in_mode_ms[METER_RATE_MODE_COUNT];
+    uint64_t samples_in_mode[METER_RATE_MODE_COUNT];
+} meter_rate_stats_t;
+
+/**
+ * @brief Initialize the controller (starts in normal mode)
+ */
+void meter_rate_init(void);
+
+/**
+ * @brief Feed one sample and get the interval for the next one
+ * 
+ * A sample-to-sample power change beyond the deadband starts a burst. A
+ * slower drift beyond the deadband from the last reference keeps the normal
+ * rate, and power staying inside the deadband for CONFIG_ADAPT_IDLE_AFTER_S
+ * drops to the idle rate.
+ * 
+ * @param time_us Sample time (esp_timer microseconds)
+ * @param power_w Active power (W)
+ * @param busy_us Time spent acquiring and processing the sample
+ * @return uint32_t Interval until the next sample (ms)
+ */
+uint32_t meter_rate_update(int64_t time_us, float power_w, uint32_t busy_us);
+
+/**
+ * @brief Start a burst now (relay switched, alarm raised)
+ * 
+ * @param time_us Current time (esp_timer microseconds)
+ * @return uint32_t Interval until the next sample (ms)
+ */
+uint32_t meter_rate_trigger_burst(int64_t time_us);
+
+/**
+ * @brief Get the current mode
+ */
+meter_rate_mode_t meter_rate_get_mode(void);
+
+/**
+ * @brief Get a printable mode name
+ */
+const char *meter_rate_mode_name(meter_rate_mode_t mode);
+
+/**
+ * @brief Get controller statistics
+ * 
+ * @param stats Destination
+ */
+void meter_rate_get_stats(meter_rate_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_RATE_H */
@@ -0,0 +1,114 @@
+// smart_plug/components/metering/include/meter_report.h
+#ifndef METER_REPORT_H
+#define METER_REPORT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fields watched by the report-by-exception filter
+ * 
+ * Measured fields use deadbands; the event fields after them (relay, alarm)
+ * report on any change.
+ */
+typedef enum {
+    REPORT_FIELD_VOLTAGE,
+    REPORT_FIELD_CURRENT,
+    REPORT_FIELD_POWER,
+    REPORT_FIELD_POWER_FACTOR,
+    REPORT_FIELD_FREQUENCY,
+    REPORT_FIELD_ENERGY,
+    REPORT_FIELD_TEMPERATURE,
+    REPORT_FIELD_RELAY,             // 0/1
+    REPORT_FIELD_ALARM,             // Alarm bit mask
+    REPORT_FIELD_COUNT
+} report_field_t;
+
+/**
+ * @brief Why a report is due
+ */
+typedef enum {
+    REPORT_REASON_NONE,             // Suppressed
+    REPORT_REASON_CHANGE,           // A field moved beyond its deadband
+    REPORT_REASON_HEARTBEAT,        // Maximum interval reached
+    REPORT_REASON_FORCED,           // First report, relay or alarm event
+    REPORT_REASON_COUNT
+} report_reason_t;
+
+/**
+ * @brief Deadband of one field
+ * 
+ * A change is reportable once it exceeds the larger of the absolute and the
+ * relative (percent of the last reported value) limits.
+ */
+typedef struct {
+    float abs;
+    float rel_pct;
+} report_deadband_t;
+
+/**
+ * @brief Filter statistics
+ */
+typedef struct {
+    uint32_t evaluations;                       // Checks at or after the minimum interval
+    uint32_t suppressed;                        // Checks that found nothing to report
+    uint32_t reports[REPORT_REASON_COUNT];      // Reports by reason
+    uint32_t triggers[REPORT_FIELD_COUNT];      // Change reports by first field over its deadband
+    report_reason_t last_reason;
+} report_stats_t;
+
+/**
+ * @brief Initialize the filter with the Kconfig deadbands and intervals
+ * 
+ * The first check always reports.
+ */
+void meter_report_init(void);
+
+/**
+ * @brief Request a report at the next check, ignoring the minimum interval
+ */
+void meter_report_force(void);
+
+/**
+ * @brief Decide whether the current values should be reported
+ * 
+ * Deadbands are evaluated at most once per interval_ms; a pending force
+ * or a relay/alarm change reports on any call.
+ * 
+ * @param values One value per report_field_t
+ * @param now_ms Current time (timebase_now_ms())
+ * @param interval_ms Telemetry interval (minimum time between evaluations)
+ * @return report_reason_t REPORT_REASON_NONE to suppress
+ */
+report_reason_t meter_report_check(const float *values, int64_t now_ms, uint32_t interval_ms);
+
+/**
+ * @brief Record that the values were reported (new deadband reference)
+ * 
+ * @param values One value per report_field_t
+ * @param now_ms Current time (timebase_now_ms())
+ * @param reason Reason returned by meter_report_check()
+ */
+void meter_report_sent(const float *values, int64_t now_ms, report_reason_t reason);
+
+/**
+ * @brief Get a printable field name
+ */
+const char *meter_report_field_name(report_field_t field);
+
+/**
+ * @brief Get filter statistics
+ * 
+ * @param stats Destination
+ */
+void meter_report_get_stats(report_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_REPORT_H */
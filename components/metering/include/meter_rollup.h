@@ -0,0 +1,109 @@
+// smart_plug/components/metering/include/meter_rollup.h
+#ifndef METER_ROLLUP_H
+#define METER_ROLLUP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Rollup resolutions, finest first. Each level is fed from the one before it.
+ */
+typedef enum {
+    ROLLUP_LEVEL_1S,
+    ROLLUP_LEVEL_1M,
+    ROLLUP_LEVEL_15M,
+    ROLLUP_LEVEL_1H,
+    ROLLUP_LEVEL_COUNT
+} rollup_level_t;
+
+/**
+ * @brief One aggregated interval
+ */
+typedef struct {
+    uint32_t start_s;       // Interval start (seconds since boot)
+    uint32_t samples;       // Number of raw samples merged into the interval
+    float power_mean;       // Active power (W)
+    float power_min;
+    float power_max;
+    float voltage_mean;     // Voltage RMS (V)
+    float voltage_min;
+    float voltage_max;
+    float current_mean;     // Current RMS (A)
+    float current_min;
+    float current_max;
+    float energy_wh;        // Energy accumulated during the interval (Wh)
+} rollup_bucket_t;
+
+/**
+ * @brief Initialize the rollup engine (clears all history)
+ */
+void meter_rollup_init(void);
+
+/**
+ * @brief Add one raw sample
+ * 
+ * Cost is constant per sample: the sample is merged into the open 1 s bucket,
+ * and closed buckets cascade one level up only at interval boundaries.
+ * 
+ * @param time_us Sample time (esp_timer microseconds)
+ * @param voltage Voltage RMS (V)
+ * @param current Current RMS (A)
+ * @param power Active power (W)
+ * @param energy_uwh Cumulative energy counter (micro-Wh)
+ */
+void meter_rollup_add(int64_t time_us, float voltage, float current,
+                      float power, int64_t energy_uwh);
+
+/**
+ * @brief Read closed buckets of one level, oldest first
+ * 
+ * Returns the most recent buckets that start at or after since_s.
+ * 
+ * @param level Rollup level
+ * @param since_s Earliest bucket start to return (seconds since boot, 0 for all)
+ * @param out Destination array
+ * @param max_buckets Capacity of out
+ * @return size_t Number of buckets written
+ */
+size_t meter_rollup_read(rollup_level_t level, uint32_t since_s,
+                         rollup_bucket_t *out, size_t max_buckets);
+
+/**
+ * @brief Get the most recently closed bucket of one level
+ * 
+ * @param level Rollup level
+ * @param out Destination
+ * @return true if the level has at least one closed bucket
+ */
+bool meter_rollup_latest(rollup_level_t level, rollup_bucket_t *out);
+
+/**
+ * @brief Number of closed buckets currently held by one level
+ */
+size_t meter_rollup_count(rollup_level_t level);
+
+/**
+ * @brief Ring capacity of one level (from Kconfig)
+ */
+size_t meter_rollup_capacity(rollup_level_t level);
+
+/**
+ * @brief Interval length of one level in seconds
+ */
+uint32_t meter_rollup_period_s(rollup_level_t level);
+
+/**
+ * @brief Total static memory used by the rollup rings in bytes
+ */
+size_t meter_rollup_memory_bytes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_ROLLUP_H */
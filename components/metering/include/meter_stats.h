@@ -0,0 +1,84 @@
+// smart_plug/components/metering/include/meter_stats.h
+#ifndef METER_STATS_H
+#define METER_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Channels aggregated across a publish window
+ */
+typedef enum {
+    METER_CH_VOLTAGE,       // Voltage RMS (V)
+    METER_CH_CURRENT,       // Current RMS (A)
+    METER_CH_POWER,         // Active power (W)
+    METER_CH_POWER_FACTOR,  // Power factor
+    METER_CH_FREQUENCY,     // Line frequency (Hz)
+    METER_CH_COUNT
+} meter_channel_t;
+
+/**
+ * @brief Running statistics for one channel (Welford's algorithm)
+ */
+typedef struct {
+    uint32_t count;     // Number of samples
+    float min;          // Minimum value
+    float max;          // Maximum value
+    float mean;         // Running mean
+    float m2;           // Sum of squared deviations from the mean
+} meter_stat_t;
+
+/**
+ * @brief Statistics for one aggregation window
+ */
+typedef struct {
+    meter_stat_t ch[METER_CH_COUNT];
+    int64_t start_us;   // esp_timer time of first sample
+    int64_t end_us;     // esp_timer time of last sample
+} meter_window_t;
+
+/**
+ * @brief Initialize (and clear) the aggregation window
+ */
+void meter_stats_init(void);
+
+/**
+ * @brief Add one sample to the current window
+ * 
+ * @param values One value per channel, indexed by meter_channel_t
+ */
+void meter_stats_add(const float values[METER_CH_COUNT]);
+
+/**
+ * @brief Copy the current window out and start a new one
+ * 
+ * @param out Destination for the finished window
+ * @return true if the window contained at least one sample
+ */
+bool meter_stats_take(meter_window_t *out);
+
+/**
+ * @brief Population variance of a channel
+ * 
+ * @param stat Channel statistics
+ * @return float Variance (0 if fewer than 2 samples)
+ */
+float meter_stat_variance(const meter_stat_t *stat);
+
+/**
+ * @brief Population standard deviation of a channel
+ * 
+ * @param stat Channel statistics
+ * @return float Standard deviation (0 if fewer than 2 samples)
+ */
+float meter_stat_stddev(const meter_stat_t *stat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_STATS_H */
@@ -0,0 +1,68 @@
+// smart_plug/components/metering/include/meter_telemetry.h
+#ifndef METER_TELEMETRY_H
+#define METER_TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "payload_writer.h"
+#include "meter_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Telemetry Message
+  
+  Readings only, sent every publish interval (or on exception):
+  
+  {"device_id": "...", "timestamp": <epoch s>, "Temperature": ..., "relay_state": ...,
+   "firmware_version": "...", "voltage": {...}, "current": {...}, "power": {...},
+   "energy": {...}, "power_quality": {...}, "window": {...}, "batch": {...}}
+  
+  Counters and link state go in the slower stats message instead.
+  ===============================================================================*/
+
+// Bump when telemetry keys change (the schema is published on connect)
+#define TELEMETRY_SCHEMA_VERSION    8
+
+/**
+ * @brief Readings carried by one telemetry message
+ */
+typedef struct {
+    const char *device_id;
+    const char *firmware_version;
+    int64_t timestamp;              // Epoch seconds, or uptime before SNTP
+    float temperature;              // Die temperature (C)
+    bool relay_state;
+    float voltage_rms;              // V
+    float current_rms;              // A
+    float active_power;             // W
+    float reactive_power;           // var
+    float apparent_power;           // VA
+    int64_t energy_uwh;             // Cumulative energy (uWh)
+    float power_factor;
+    float frequency;                // Hz
+    float period_jitter_us;         // Stddev of the mains period
+    uint32_t zc_outliers;           // Zero-crossing periods rejected since boot
+} meter_reading_t;
+
+/**
+ * @brief Write a telemetry message
+ * 
+ * Keys are CBOR map keys of schema TELEMETRY_SCHEMA_VERSION.
+ * 
+ * @param w Writer (JSON, CBOR or SCHEMA)
+ * @param r Readings
+ * @param window Statistics since the previous message, or NULL for none
+ * @param batch true to add the samples pending in meter_batch as "batch"
+ *              (the caller knows whether CONFIG_TELEMETRY_BATCH is set)
+ */
+void meter_telemetry_write(payload_writer_t *w, const meter_reading_t *r,
+                           const meter_window_t *window, bool batch);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* METER_TELEMETRY_H */
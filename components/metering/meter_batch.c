@@ -0,0 +1,221 @@
+// smart_plug/components/metering/meter_batch.c
+#include "meter_batch.h"
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "timebase.h"
+
+static const char *TAG = "METER_BATCH";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_BATCH_MAX_SAMPLES
+#define CONFIG_BATCH_MAX_SAMPLES 10
+#endif
+
+#ifndef CONFIG_BATCH_MAX_BYTES
+#define CONFIG_BATCH_MAX_BYTES 1024
+#endif
+
+#ifndef CONFIG_BATCH_MAX_AGE_S
+#define CONFIG_BATCH_MAX_AGE_S 10
+#endif
+
+/*===============================================================================
+  Static Variables
+
+  Only used from the MQTT task, so nothing here is locked.
+  ===============================================================================*/
+
+// Readings are kept at the resolution telemetry reports them
+typedef struct {
+    int64_t time_ms;
+    int64_t energy_uwh;
+    int32_t voltage_mv;
+    int32_t current_100ua;
+    int32_t power_mw;
+    int32_t frequency_mhz;
+    int16_t power_factor_e4;
+    uint16_t bytes;                 // Encoded size of this sample's elements
+    bool relay;
+} batch_sample_t;
+
+static const char *const reason_names[BATCH_FLUSH_REASON_COUNT] = {
+    [BATCH_FLUSH_NONE]  = "none",
+    [BATCH_FLUSH_COUNT] = "count",
+    [BATCH_FLUSH_BYTES] = "bytes",
+    [BATCH_FLUSH_AGE]   = "age",
+    [BATCH_FLUSH_EVENT] = "event",
+};
+
+static batch_sample_t samples[CONFIG_BATCH_MAX_SAMPLES];
+static size_t count = 0;
+static size_t bytes = 0;
+static batch_stats_t stats;
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static int32_t scale(float value, float factor)
+{
+    if (!isfinite(value)) return 0;
+    return (int32_t)lroundf(value * factor);
+}
+
+// Columns of the batch object, keyed from 4 after t0_ms, energy0_uwh and count
+static const struct {
+    const char *name;
+    uint8_t decimals;
+} columns[] = {
+    { "offset_ms", 0 }, { "rms_v", 3 }, { "rms_a", 4 }, { "active_w", 3 },
+    { "power_factor", 4 }, { "frequency_hz", 3 }, { "energy_uwh", 0 }, { "relay", 0 },
+};
+
+#define COLUMN_COUNT (sizeof(columns) / sizeof(columns[0]))
+
+// One column element; offsets and energy are relative to the first sample
+static void write_element(payload_writer_t *w, size_t column,
+                          const batch_sample_t *s, const batch_sample_t *first)
+{
+    switch (column) {
+        case 0: payload_writer_int(w, 0, NULL, s->time_ms - first->time_ms); break;
+        case 1: payload_writer_fixed(w, 0, NULL, s->voltage_mv, 3); break;
+        case 2: payload_writer_fixed(w, 0, NULL, s->current_100ua, 4); break;
+        case 3: payload_writer_fixed(w, 0, NULL, s->power_mw, 3); break;
+        case 4: payload_writer_fixed(w, 0, NULL, s->power_factor_e4, 4); break;
+        case 5: payload_writer_fixed(w, 0, NULL, s->frequency_mhz, 3); break;
+        case 6: payload_writer_int(w, 0, NULL, s->energy_uwh - first->energy_uwh); break;
+        default: payload_writer_int(w, 0, NULL, s->relay); break;
+    }
+}
+
+// What the sample adds to the message, spread over the columns
+static size_t row_bytes(const batch_sample_t *s, const batch_sample_t *first,
+                        payload_format_t format)
+{
+    uint8_t scratch[160];
+    payload_writer_t w;
+    payload_writer_init(&w, format, scratch, sizeof(scratch));
+    payload_writer_begin_array(&w, 0, NULL);
+    for (size_t c = 0; c < COLUMN_COUNT; c++) {
+        write_element(&w, c, s, first);
+    }
+    payload_writer_end_array(&w);
+    
+    size_t len = 0;
+    if (!payload_writer_finish(&w, &len)) return sizeof(scratch);
+    return len > 2 ? len - 2 : len;             // Array open and close
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void meter_batch_init(void)
+{
+    count = 0;
+    bytes = 0;
+    memset(&stats, 0, sizeof(stats));
+    
+    ESP_LOGI(TAG, "Telemetry batching: %d samples, %d bytes, %d s",
+             CONFIG_BATCH_MAX_SAMPLES, CONFIG_BATCH_MAX_BYTES, CONFIG_BATCH_MAX_AGE_S);
+}
+
+batch_flush_t meter_batch_add(int64_t time_ms, float voltage, float current, float power,
+                              float power_factor, float frequency, int64_t energy_uwh,
+                              bool relay, payload_format_t format)
+{
+    if (count == CONFIG_BATCH_MAX_SAMPLES) {
+        // Still full after a failed flush: keep the newest samples
+        bytes -= samples[0].bytes;
+        memmove(&samples[0], &samples[1], (count - 1) * sizeof(samples[0]));
+        count--;
+        stats.samples_dropped++;
+    }
+    
+    batch_sample_t *s = &samples[count];
+    s->time_ms = time_ms;
+    s->energy_uwh = energy_uwh;
+    s->voltage_mv = scale(voltage, 1e3f);
+    s->current_100ua = scale(current, 1e4f);
+    s->power_mw = scale(power, 1e3f);
+    s->frequency_mhz = scale(frequency, 1e3f);
+    s->power_factor_e4 = (int16_t)scale(power_factor, 1e4f);
+    s->relay = relay;
+    s->bytes = (uint16_t)row_bytes(s, &samples[0], format);
+    
+    count++;
+    bytes += s->bytes;
+    
+    if (count >= CONFIG_BATCH_MAX_SAMPLES) return BATCH_FLUSH_COUNT;
+    if (bytes >= CONFIG_BATCH_MAX_BYTES) return BATCH_FLUSH_BYTES;
+    return BATCH_FLUSH_NONE;
+}
+
+batch_flush_t meter_batch_due(int64_t now_ms)
+{
+    if (count > 0 && now_ms - samples[0].time_ms >= (int64_t)CONFIG_BATCH_MAX_AGE_S * 1000) {
+        return BATCH_FLUSH_AGE;
+    }
+    return BATCH_FLUSH_NONE;
+}
+
+size_t meter_batch_count(void)
+{
+    return count;
+}
+
+void meter_batch_write(payload_writer_t *w, uint8_t key, const char *name)
+{
+    static const batch_sample_t none = {0};
+    const batch_sample_t *first = count > 0 ? &samples[0] : &none;
+    
+    // Base timestamp on the wall clock once it is known, like "timestamp"
+    int64_t t0_ms = first->time_ms;
+    if (timebase_wall_valid()) {
+        t0_ms = timebase_mono_to_wall_us(first->time_ms * 1000) / 1000;
+    }
+    
+    payload_writer_begin_map(w, key, name);
+    payload_writer_int(w, 1, "t0_ms", t0_ms);
+    payload_writer_int(w, 2, "energy0_uwh", first->energy_uwh);
+    payload_writer_int(w, 3, "count", count);
+    
+    // Column-major: one array per field
+    for (size_t c = 0; c < COLUMN_COUNT; c++) {
+        payload_writer_begin_column(w, c + 4, columns[c].name, columns[c].decimals);
+        for (size_t i = 0; i < count; i++) {
+            write_element(w, c, &samples[i], first);
+        }
+        payload_writer_end_array(w);
+    }
+    payload_writer_end_map(w);
+}
+
+void meter_batch_flushed(batch_flush_t reason, bool ok)
+{
+    if (!ok) {
+        stats.failed++;
+        return;
+    }
+    
+    if (reason < BATCH_FLUSH_REASON_COUNT) {
+        stats.batches[reason]++;
+    }
+    stats.samples_sent += count;
+    count = 0;
+    bytes = 0;
+}
+
+const char *meter_batch_reason_name(batch_flush_t reason)
+{
+    return reason < BATCH_FLUSH_REASON_COUNT ? reason_names[reason] : "unknown";
+}
+
+void meter_batch_get_stats(batch_stats_t *out)
+{
+    if (out) *out = stats;
+}
@@ -0,0 +1,206 @@
+// smart_plug/components/metering/meter_rate.c
+#include "meter_rate.h"
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "METER_RATE";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_MEASUREMENT_INTERVAL_MS
+#define CONFIG_MEASUREMENT_INTERVAL_MS 100
+#endif
+
+#ifndef CONFIG_ADAPT_IDLE_INTERVAL_MS
+#define CONFIG_ADAPT_IDLE_INTERVAL_MS 1000
+#endif
+
+#ifndef CONFIG_ADAPT_BURST_INTERVAL_MS
+#define CONFIG_ADAPT_BURST_INTERVAL_MS 20
+#endif
+
+#ifndef CONFIG_ADAPT_BURST_HOLD_MS
+#define CONFIG_ADAPT_BURST_HOLD_MS 2000
+#endif
+
+#ifndef CONFIG_ADAPT_IDLE_AFTER_S
+#define CONFIG_ADAPT_IDLE_AFTER_S 10
+#endif
+
+#ifndef CONFIG_ADAPT_DEADBAND_W
+#define CONFIG_ADAPT_DEADBAND_W 2
+#endif
+
+#ifndef CONFIG_ADAPT_DEADBAND_PCT
+#define CONFIG_ADAPT_DEADBAND_PCT 2
+#endif
+
+// Keep bursts at no more than half the sample path's duty cycle
+#define BURST_DUTY_FACTOR   2
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+static portMUX_TYPE rate_mux = portMUX_INITIALIZER_UNLOCKED;
+static meter_rate_stats_t stats;
+
+static int64_t last_update_us = 0;
+static int64_t burst_until_us = 0;
+static int64_t stable_since_us = 0;
+static float ref_power = 0.0f;              // Power when the load last changed
+static float prev_power = 0.0f;
+static bool have_prev = false;
+static float busy_avg_us = 0.0f;
+
+static const char *const mode_names[METER_RATE_MODE_COUNT] = {
+    [METER_RATE_IDLE]   = "idle",
+    [METER_RATE_NORMAL] = "normal",
+    [METER_RATE_BURST]  = "burst",
+};
+
+/*===============================================================================
+  Internal Helpers (call with rate_mux held)
+  ===============================================================================*/
+
+static float deadband(float power)
+{
+    float rel = fabsf(power) * CONFIG_ADAPT_DEADBAND_PCT / 100.0f;
+    return rel > CONFIG_ADAPT_DEADBAND_W ? rel : (float)CONFIG_ADAPT_DEADBAND_W;
+}
+
+static uint32_t mode_interval(meter_rate_mode_t mode)
+{
+    switch (mode) {
+        case METER_RATE_IDLE:
+            return CONFIG_ADAPT_IDLE_INTERVAL_MS;
+        case METER_RATE_BURST:
+            return stats.burst_floor_ms;
+        default:
+            return CONFIG_MEASUREMENT_INTERVAL_MS;
+    }
+}
+
+static void account(int64_t time_us)
+{
+    if (last_update_us != 0 && time_us > last_update_us) {
+        stats.time_in_mode_ms[stats.mode] += (time_us - last_update_us) / 1000;
+    }
+    last_update_us = time_us;
+}
+
+static void set_mode(meter_rate_mode_t mode)
+{
+    if (mode == stats.mode) return;
+    
+    stats.mode = mode;
+    stats.transitions++;
+    if (mode == METER_RATE_BURST) stats.bursts++;
+    stats.interval_ms = mode_interval(mode);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void meter_rate_init(void)
+{
+    portENTER_CRITICAL(&rate_mux);
+    memset(&stats, 0, sizeof(stats));
+    stats.mode = METER_RATE_NORMAL;
+    stats.interval_ms = CONFIG_MEASUREMENT_INTERVAL_MS;
+    stats.burst_floor_ms = CONFIG_ADAPT_BURST_INTERVAL_MS;
+    last_update_us = 0;
+    burst_until_us = 0;
+    stable_since_us = 0;
+    have_prev = false;
+    busy_avg_us = 0.0f;
+    portEXIT_CRITICAL(&rate_mux);
+    
+    ESP_LOGI(TAG, "Adaptive sampling: idle %d ms, normal %d ms, burst %d ms",
+             CONFIG_ADAPT_IDLE_INTERVAL_MS, CONFIG_MEASUREMENT_INTERVAL_MS,
+             CONFIG_ADAPT_BURST_INTERVAL_MS);
+}
+
+uint32_t meter_rate_update(int64_t time_us, float power_w, uint32_t busy_us)
+{
+    portENTER_CRITICAL(&rate_mux);
+    account(time_us);
+    stats.samples_in_mode[stats.mode]++;
+    
+    // The burst rate is limited by what one sample actually costs
+    busy_avg_us = (busy_avg_us == 0.0f) ? busy_us : busy_avg_us + (busy_us - busy_avg_us) / 8.0f;
+    uint32_t floor_ms = (uint32_t)(busy_avg_us * BURST_DUTY_FACTOR / 1000.0f) + 1;
+    stats.burst_floor_ms = floor_ms > CONFIG_ADAPT_BURST_INTERVAL_MS ?
+                           floor_ms : CONFIG_ADAPT_BURST_INTERVAL_MS;
+    
+    if (!have_prev) {
+        ref_power = prev_power = power_w;
+        stable_since_us = time_us;
+        have_prev = true;
+    }
+    
+    float band = deadband(ref_power);
+    if (fabsf(power_w - prev_power) > band) {
+        // Step change: capture the transient
+        burst_until_us = time_us + (int64_t)CONFIG_ADAPT_BURST_HOLD_MS * 1000;
+        ref_power = power_w;
+        stable_since_us = time_us;
+    } else if (fabsf(power_w - ref_power) > band) {
+        // Drift: follow it at the normal rate
+        ref_power = power_w;
+        stable_since_us = time_us;
+    }
+    prev_power = power_w;
+    
+    meter_rate_mode_t mode;
+    if (time_us < burst_until_us) {
+        mode = METER_RATE_BURST;
+    } else if (time_us - stable_since_us >= (int64_t)CONFIG_ADAPT_IDLE_AFTER_S * 1000000) {
+        mode = METER_RATE_IDLE;
+    } else {
+        mode = METER_RATE_NORMAL;
+    }
+    set_mode(mode);
+    stats.interval_ms = mode_interval(stats.mode);
+    uint32_t interval = stats.interval_ms;
+    portEXIT_CRITICAL(&rate_mux);
+    
+    return interval;
+}
+
+uint32_t meter_rate_trigger_burst(int64_t time_us)
+{
+    portENTER_CRITICAL(&rate_mux);
+    account(time_us);
+    burst_until_us = time_us + (int64_t)CONFIG_ADAPT_BURST_HOLD_MS * 1000;
+    stable_since_us = time_us;
+    set_mode(METER_RATE_BURST);
+    uint32_t interval = stats.interval_ms;
+    portEXIT_CRITICAL(&rate_mux);
+    
+    return interval;
+}
+
+meter_rate_mode_t meter_rate_get_mode(void)
+{
+    return stats.mode;
+}
+
+const char *meter_rate_mode_name(meter_rate_mode_t mode)
+{
+    return mode < METER_RATE_MODE_COUNT ? mode_names[mode] : "unknown";
+}
+
+void meter_rate_get_stats(meter_rate_stats_t *out)
+{
+    if (!out) return;
+    
+    portENTER_CRITICAL(&rate_mux);
+    *out = stats;
+    portEXIT_CRITICAL(&rate_mux);
+}
@@ -0,0 +1,168 @@
+// smart_plug/components/metering/meter_report.c
+#include "meter_report.h"
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "METER_REPORT";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_REPORT_MAX_INTERVAL_S
+#define CONFIG_REPORT_MAX_INTERVAL_S 60
+#endif
+
+#ifndef CONFIG_REPORT_DEADBAND_V_MV
+#define CONFIG_REPORT_DEADBAND_V_MV 2000
+#endif
+
+#ifndef CONFIG_REPORT_DEADBAND_A_MA
+#define CONFIG_REPORT_DEADBAND_A_MA 50
+#endif
+
+#ifndef CONFIG_REPORT_DEADBAND_W
+#define CONFIG_REPORT_DEADBAND_W 5
+#endif
+
+#ifndef CONFIG_REPORT_DEADBAND_PCT
+#define CONFIG_REPORT_DEADBAND_PCT 5
+#endif
+
+#ifndef CONFIG_REPORT_DEADBAND_WH
+#define CONFIG_REPORT_DEADBAND_WH 10
+#endif
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+// Energy is compared in Wh. Relay and alarm are handled as events.
+static const report_deadband_t deadbands[REPORT_FIELD_COUNT] = {
+    [REPORT_FIELD_VOLTAGE]      = { CONFIG_REPORT_DEADBAND_V_MV / 1000.0f, 1.0f },
+    [REPORT_FIELD_CURRENT]      = { CONFIG_REPORT_DEADBAND_A_MA / 1000.0f, CONFIG_REPORT_DEADBAND_PCT },
+    [REPORT_FIELD_POWER]        = { CONFIG_REPORT_DEADBAND_W, CONFIG_REPORT_DEADBAND_PCT },
+    [REPORT_FIELD_POWER_FACTOR] = { 0.05f, 0.0f },
+    [REPORT_FIELD_FREQUENCY]    = { 0.05f, 0.0f },
+    [REPORT_FIELD_ENERGY]       = { CONFIG_REPORT_DEADBAND_WH, 0.0f },
+    [REPORT_FIELD_TEMPERATURE]  = { 1.0f, 0.0f },
+    [REPORT_FIELD_RELAY]        = { 0.0f, 0.0f },
+    [REPORT_FIELD_ALARM]        = { 0.0f, 0.0f },
+};
+
+static const char *const field_names[REPORT_FIELD_COUNT] = {
+    [REPORT_FIELD_VOLTAGE]      = "voltage",
+    [REPORT_FIELD_CURRENT]      = "current",
+    [REPORT_FIELD_POWER]        = "power",
+    [REPORT_FIELD_POWER_FACTOR] = "power_factor",
+    [REPORT_FIELD_FREQUENCY]    = "frequency",
+    [REPORT_FIELD_ENERGY]       = "energy",
+    [REPORT_FIELD_TEMPERATURE]  = "temperature",
+    [REPORT_FIELD_RELAY]        = "relay",
+    [REPORT_FIELD_ALARM]        = "alarm",
+};
+
+static portMUX_TYPE report_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile bool force_pending = false;
+
+static float reported[REPORT_FIELD_COUNT];
+static bool have_reported = false;
+static int64_t last_report_ms = 0;
+static int64_t last_eval_ms = 0;
+static report_stats_t stats;
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void meter_report_init(void)
+{
+    memset(&stats, 0, sizeof(stats));
+    have_reported = false;
+    last_report_ms = 0;
+    last_eval_ms = 0;
+    force_pending = false;
+    
+    ESP_LOGI(TAG, "Report by exception: %d s heartbeat", CONFIG_REPORT_MAX_INTERVAL_S);
+}
+
+void meter_report_force(void)
+{
+    portENTER_CRITICAL(&report_mux);
+    force_pending = true;
+    portEXIT_CRITICAL(&report_mux);
+}
+
+report_reason_t meter_report_check(const float *values, int64_t now_ms, uint32_t interval_ms)
+{
+    portENTER_CRITICAL(&report_mux);
+    bool forced = force_pending;
+    portEXIT_CRITICAL(&report_mux);
+    
+    if (forced || !have_reported) {
+        return REPORT_REASON_FORCED;
+    }
+    
+    // Events go out immediately, ignoring the minimum interval
+    static const report_field_t events[] = { REPORT_FIELD_RELAY, REPORT_FIELD_ALARM };
+    for (int i = 0; i < 2; i++) {
+        if (values[events[i]] != reported[events[i]]) {
+            stats.triggers[events[i]]++;
+            return REPORT_REASON_FORCED;
+        }
+    }
+    
+    if (now_ms - last_eval_ms < interval_ms) {
+        return REPORT_REASON_NONE;
+    }
+    last_eval_ms = now_ms;
+    stats.evaluations++;
+    
+    for (int f = 0; f < REPORT_FIELD_RELAY; f++) {
+        float delta = fabsf(values[f] - reported[f]);
+        float limit = fabsf(reported[f]) * deadbands[f].rel_pct / 100.0f;
+        if (limit < deadbands[f].abs) limit = deadbands[f].abs;
+        
+        if (delta > limit) {
+            stats.triggers[f]++;
+            return REPORT_REASON_CHANGE;
+        }
+    }
+    
+    if (now_ms - last_report_ms >= (int64_t)CONFIG_REPORT_MAX_INTERVAL_S * 1000) {
+        return REPORT_REASON_HEARTBEAT;
+    }
+    
+    stats.suppressed++;
+    return REPORT_REASON_NONE;
+}
+
+void meter_report_sent(const float *values, int64_t now_ms, report_reason_t reason)
+{
+    portENTER_CRITICAL(&report_mux);
+    force_pending = false;
+    portEXIT_CRITICAL(&report_mux);
+    
+    memcpy(reported, values, sizeof(reported));
+    have_reported = true;
+    last_report_ms = now_ms;
+    last_eval_ms = now_ms;
+    
+    if (reason < REPORT_REASON_COUNT) {
+        stats.reports[reason]++;
+        stats.last_reason = reason;
+    }
+}
+
+const char *meter_report_field_name(report_field_t field)
+{
+    return field < REPORT_FIELD_COUNT ? field_names[field] : "unknown";
+}
+
+void meter_report_get_stats(report_stats_t *out)
+{
+    if (!out) return;
+    *out = stats;
+}
@@ -0,0 +1,268 @@
+// smart_plug/components/metering/meter_rollup.c
+#include "meter_rollup.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "ROLLUP";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_ROLLUP_1S_SLOTS
+#define CONFIG_ROLLUP_1S_SLOTS 60
+#endif
+
+#ifndef CONFIG_ROLLUP_1M_SLOTS
+#define CONFIG_ROLLUP_1M_SLOTS 60
+#endif
+
+#ifndef CONFIG_ROLLUP_15M_SLOTS
+#define CONFIG_ROLLUP_15M_SLOTS 96
+#endif
+
+#ifndef CONFIG_ROLLUP_1H_SLOTS
+#define CONFIG_ROLLUP_1H_SLOTS 72
+#endif
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+typedef struct {
+    rollup_bucket_t *ring;      // Closed buckets
+    size_t capacity;
+    size_t head;                // Next write position
+    size_t count;
+    uint32_t period_s;
+    rollup_bucket_t open;       // Bucket currently being filled
+    bool open_valid;
+} rollup_ring_t;
+
+static rollup_bucket_t ring_1s[CONFIG_ROLLUP_1S_SLOTS];
+static rollup_bucket_t ring_1m[CONFIG_ROLLUP_1M_SLOTS];
+static rollup_bucket_t ring_15m[CONFIG_ROLLUP_15M_SLOTS];
+static rollup_bucket_t ring_1h[CONFIG_ROLLUP_1H_SLOTS];
+
+static rollup_ring_t levels[ROLLUP_LEVEL_COUNT] = {
+    [ROLLUP_LEVEL_1S]  = { .ring = ring_1s,  .capacity = CONFIG_ROLLUP_1S_SLOTS,  .period_s = 1 },
+    [ROLLUP_LEVEL_1M]  = { .ring = ring_1m,  .capacity = CONFIG_ROLLUP_1M_SLOTS,  .period_s = 60 },
+    [ROLLUP_LEVEL_15M] = { .ring = ring_15m, .capacity = CONFIG_ROLLUP_15M_SLOTS, .period_s = 900 },
+    [ROLLUP_LEVEL_1H]  = { .ring = ring_1h,  .capacity = CONFIG_ROLLUP_1H_SLOTS,  .period_s = 3600 },
+};
+
+static SemaphoreHandle_t rollup_mutex = NULL;
+static int64_t last_energy_uwh = 0;
+static bool have_last_energy = false;
+
+/*===============================================================================
+  Bucket Helpers
+  ===============================================================================*/
+
+static void bucket_start(rollup_ring_t *lvl, uint32_t start_s, const rollup_bucket_t *src)
+{
+    lvl->open = *src;
+    lvl->open.start_s = start_s - (start_s % lvl->period_s);
+    lvl->open_valid = true;
+}
+
+// Merge a closed lower-level bucket (or a single sample) into an open bucket
+static void bucket_merge(rollup_bucket_t *dst, const rollup_bucket_t *src)
+{
+    uint32_t total = dst->samples + src->samples;
+    if (total == 0) return;
+    
+    float w_dst = (float)dst->samples / (float)total;
+    float w_src = (float)src->samples / (float)total;
+    
+    dst->power_mean = dst->power_mean * w_dst + src->power_mean * w_src;
+    dst->voltage_mean = dst->voltage_mean * w_dst + src->voltage_mean * w_src;
+    dst->current_mean = dst->current_mean * w_dst + src->current_mean * w_src;
+    
+    if (src->power_min < dst->power_min) dst->power_min = src->power_min;
+    if (src->power_max > dst->power_max) dst->power_max = src->power_max;
+    if (src->voltage_min < dst->voltage_min) dst->voltage_min = src->voltage_min;
+    if (src->voltage_max > dst->voltage_max) dst->voltage_max = src->voltage_max;
+    if (src->current_min < dst->current_min) dst->current_min = src->current_min;
+    if (src->current_max > dst->current_max) dst->current_max = src->current_max;
+    
+    dst->energy_wh += src->energy_wh;
+    dst->samples = total;
+}
+
+static void ring_push(rollup_ring_t *lvl, const rollup_bucket_t *bucket)
+{
+    lvl->ring[lvl->head] = *bucket;
+    lvl->head = (lvl->head + 1) % lvl->capacity;
+    if (lvl->count < lvl->capacity) {
+        lvl->count++;
+    }
+}
+
+// Feed a bucket into one level, closing and cascading the open bucket on a boundary
+static void level_feed(int level, uint32_t start_s, const rollup_bucket_t *src)
+{
+    while (level < ROLLUP_LEVEL_COUNT) {
+        rollup_ring_t *lvl = &levels[level];
+        
+        if (lvl->open_valid && start_s - lvl->open.start_s < lvl->period_s) {
+            bucket_merge(&lvl->open, src);
+            return;
+        }
+        
+        if (!lvl->open_valid) {
+            bucket_start(lvl, start_s, src);
+            return;
+        }
+        
+        // Boundary crossed: close this bucket, start the next, and push the
+        // closed one up to the next level
+        rollup_bucket_t closed = lvl->open;
+        ring_push(lvl, &closed);
+        bucket_start(lvl, start_s, src);
+        
+        level++;
+        src = &lvl->ring[(lvl->head + lvl->capacity - 1) % lvl->capacity];
+        start_s = closed.start_s;
+    }
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void meter_rollup_init(void)
+{
+    if (!rollup_mutex) {
+        rollup_mutex = xSemaphoreCreateMutex();
+    }
+    
+    for (int i = 0; i < ROLLUP_LEVEL_COUNT; i++) {
+        levels[i].head = 0;
+        levels[i].count = 0;
+        levels[i].open_valid = false;
+    }
+    have_last_energy = false;
+    
+    ESP_LOGI(TAG, "Rollups: 1s x%d, 1m x%d, 15m x%d, 1h x%d (%u bytes)",
+             CONFIG_ROLLUP_1S_SLOTS, CONFIG_ROLLUP_1M_SLOTS,
+             CONFIG_ROLLUP_15M_SLOTS, CONFIG_ROLLUP_1H_SLOTS,
+             (unsigned)meter_rollup_memory_bytes());
+}
+
+void meter_rollup_add(int64_t time_us, float voltage, float current,
+                      float power, int64_t energy_uwh)
+{
+    if (!rollup_mutex) return;
+    
+    // Difference the exact counter; only the per-sample delta becomes float
+    float energy_delta = 0.0f;
+    if (have_last_energy && energy_uwh > last_energy_uwh) {
+        energy_delta = (float)(energy_uwh - last_energy_uwh) / 1000000.0f;
+    }
+    last_energy_uwh = energy_uwh;
+    have_last_energy = true;
+    
+    rollup_bucket_t sample = {
+        .samples = 1,
+        .power_mean = power,
+        .power_min = power,
+        .power_max = power,
+        .voltage_mean = voltage,
+        .voltage_min = voltage,
+        .voltage_max = voltage,
+        .current_mean = current,
+        .current_min = current,
+        .current_max = current,
+        .energy_wh = energy_delta,
+    };
+    
+    xSemaphoreTake(rollup_mutex, portMAX_DELAY);
+    level_feed(ROLLUP_LEVEL_1S, (uint32_t)(time_us / 1000000), &sample);
+    xSemaphoreGive(rollup_mutex);
+}
+
+size_t meter_rollup_read(rollup_level_t level, uint32_t since_s,
+                         rollup_bucket_t *out, size_t max_buckets)
+{
+    if (level >= ROLLUP_LEVEL_COUNT || !out || max_buckets == 0 || !rollup_mutex) {
+        return 0;
+    }
+    
+    xSemaphoreTake(rollup_mutex, portMAX_DELAY);
+    
+    rollup_ring_t *lvl = &levels[level];
+    size_t oldest = (lvl->head + lvl->capacity - lvl->count) % lvl->capacity;
+    
+    // Skip buckets older than since_s, then keep only the newest max_buckets
+    size_t skip = 0;
+    while (skip < lvl->count &&
+           lvl->ring[(oldest + skip) % lvl->capacity].start_s < since_s) {
+        skip++;
+    }
+    size_t avail = lvl->count - skip;
+    if (avail > max_buckets) {
+        skip += avail - max_buckets;
+        avail = max_buckets;
+    }
+    
+    for (size_t i = 0; i < avail; i++) {
+        out[i] = lvl->ring[(oldest + skip + i) % lvl->capacity];
+    }
+    
+    xSemaphoreGive(rollup_mutex);
+    return avail;
+}
+
+bool meter_rollup_latest(rollup_level_t level, rollup_bucket_t *out)
+{
+    if (level >= ROLLUP_LEVEL_COUNT || !out || !rollup_mutex) {
+        return false;
+    }
+    
+    xSemaphoreTake(rollup_mutex, portMAX_DELAY);
+    rollup_ring_t *lvl = &levels[level];
+    bool found = lvl->count > 0;
+    if (found) {
+        *out = lvl->ring[(lvl->head + lvl->capacity - 1) % lvl->capacity];
+    }
+    xSemaphoreGive(rollup_mutex);
+    
+    return found;
+}
+
+size_t meter_rollup_count(rollup_level_t level)
+{
+    if (level >= ROLLUP_LEVEL_COUNT) return 0;
+    
+    if (rollup_mutex) xSemaphoreTake(rollup_mutex, portMAX_DELAY);
+    size_t count = levels[level].count;
+    if (rollup_mutex) xSemaphoreGive(rollup_mutex);
+    
+    return count;
+}
+
+size_t meter_rollup_capacity(rollup_level_t level)
+{
+    if (level >= ROLLUP_LEVEL_COUNT) return 0;
+    
+    if (rollup_mutex) xSemaphoreTake(rollup_mutex, portMAX_DELAY);
+    size_t capacity = levels[level].capacity;
+    if (rollup_mutex) xSemaphoreGive(rollup_mutex);
+    
+    return capacity;
+}
+
+uint32_t meter_rollup_period_s(rollup_level_t level)
+{
+    if (level >= ROLLUP_LEVEL_COUNT) return 0;
+    return levels[level].period_s;
+}
+
+size_t meter_rollup_memory_bytes(void)
+{
+    return sizeof(ring_1s) + sizeof(ring_1m) + sizeof(ring_15m) +
+           sizeof(ring_1h) + sizeof(levels);
+}
@@ -0,0 +1,87 @@
+// smart_plug/components/metering/meter_stats.c
+#include "meter_stats.h"
+#include <string.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "METER_STATS";
+
+// Written by the measurement task, drained by the MQTT task
+static meter_window_t window;
+static portMUX_TYPE window_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void stat_add(meter_stat_t *s, float x)
+{
+    if (s->count == 0) {
+        s->count = 1;
+        s->min = x;
+        s->max = x;
+        s->mean = x;
+        s->m2 = 0.0f;
+        return;
+    }
+    
+    if (x < s->min) s->min = x;
+    if (x > s->max) s->max = x;
+    
+    // Welford update: numerically stable without storing samples
+    s->count++;
+    float delta = x - s->mean;
+    s->mean += delta / (float)s->count;
+    s->m2 += delta * (x - s->mean);
+}
+
+void meter_stats_init(void)
+{
+    portENTER_CRITICAL(&window_lock);
+    memset(&window, 0, sizeof(window));
+    portEXIT_CRITICAL(&window_lock);
+    
+    ESP_LOGI(TAG, "Window statistics initialized (%d channels)", METER_CH_COUNT);
+}
+
+void meter_stats_add(const float values[METER_CH_COUNT])
+{
+    if (!values) return;
+    
+    int64_t now = esp_timer_get_time();
+    
+    portENTER_CRITICAL(&window_lock);
+    if (window.ch[0].count == 0) {
+        window.start_us = now;
+    }
+    window.end_us = now;
+    for (int i = 0; i < METER_CH_COUNT; i++) {
+        stat_add(&window.ch[i], values[i]);
+    }
+    portEXIT_CRITICAL(&window_lock);
+}
+
+bool meter_stats_take(meter_window_t *out)
+{
+    if (!out) return false;
+    
+    portENTER_CRITICAL(&window_lock);
+    *out = window;
+    memset(&window, 0, sizeof(window));
+    portEXIT_CRITICAL(&window_lock);
+    
+    return out->ch[0].count > 0;
+}
+
+float meter_stat_variance(const meter_stat_t *stat)
+{
+    if (!stat || stat->count < 2) {
+        return 0.0f;
+    }
+    
+    float var = stat->m2 / (float)stat->count;
+    return (var > 0.0f) ? var : 0.0f;
+}
+
+float meter_stat_stddev(const meter_stat_t *stat)
+{
+    return sqrtf(meter_stat_variance(stat));
+}
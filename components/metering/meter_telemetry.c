@@ -0,0 +1,83 @@
+// smart_plug/components/metering/meter_telemetry.c
+#include "meter_telemetry.h"
+#include "meter_batch.h"
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static void write_window_stat(payload_writer_t *w, uint8_t key, const char *name,
+                              const meter_stat_t *stat, uint8_t decimals)
+{
+    payload_writer_begin_map(w, key, name);
+    payload_writer_float(w, 1, "min", stat->min, decimals);
+    payload_writer_float(w, 2, "max", stat->max, decimals);
+    payload_writer_float(w, 3, "mean", stat->mean, decimals);
+    payload_writer_float(w, 4, "std", meter_stat_stddev(stat), decimals);
+    payload_writer_end_map(w);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+// Integer keys are used in CBOR; each map numbers its members from 1
+void meter_telemetry_write(payload_writer_t *w, const meter_reading_t *r,
+                           const meter_window_t *window, bool batch)
+{
+    payload_writer_begin_map(w, 0, NULL);
+    payload_writer_string(w, 1, "device_id", r->device_id);
+    payload_writer_int(w, 2, "timestamp", r->timestamp);
+    payload_writer_float(w, 3, "Temperature", r->temperature, 2);
+    payload_writer_bool(w, 4, "relay_state", r->relay_state);
+    payload_writer_string(w, 5, "firmware_version", r->firmware_version);
+    
+    payload_writer_begin_map(w, 6, "voltage");
+    payload_writer_float(w, 1, "rms_v", r->voltage_rms, 3);
+    payload_writer_end_map(w);
+    
+    payload_writer_begin_map(w, 7, "current");
+    payload_writer_float(w, 1, "rms_a", r->current_rms, 4);
+    payload_writer_end_map(w);
+    
+    payload_writer_begin_map(w, 8, "power");
+    payload_writer_float(w, 1, "active_w", r->active_power, 3);
+    payload_writer_float(w, 2, "reactive_var", r->reactive_power, 3);
+    payload_writer_float(w, 3, "apparent_va", r->apparent_power, 3);
+    payload_writer_end_map(w);
+    
+    // Both forms come straight from the integer counter, so no digit is lost;
+    // CBOR carries only the raw counter
+    payload_writer_begin_map(w, 9, "energy");
+    payload_writer_int(w, 1, "cumulative_uwh", r->energy_uwh);
+    if (w->format == PAYLOAD_JSON) {
+        payload_writer_fixed(w, 2, "cumulative_wh", r->energy_uwh, 6);
+    }
+    payload_writer_end_map(w);
+    
+    payload_writer_begin_map(w, 10, "power_quality");
+    payload_writer_float(w, 1, "power_factor", r->power_factor, 4);
+    payload_writer_float(w, 2, "frequency_hz", r->frequency, 3);
+    payload_writer_float(w, 3, "period_jitter_us", r->period_jitter_us, 1);
+    payload_writer_int(w, 4, "zc_outliers", r->zc_outliers);
+    payload_writer_end_map(w);
+    
+    // Min/max/mean/stddev of every sample since the previous publish
+    if (window) {
+        payload_writer_begin_map(w, 11, "window");
+        payload_writer_int(w, 1, "samples", window->ch[METER_CH_VOLTAGE].count);
+        payload_writer_int(w, 2, "duration_ms", (window->end_us - window->start_us) / 1000);
+        write_window_stat(w, 3, "voltage", &window->ch[METER_CH_VOLTAGE], 3);
+        write_window_stat(w, 4, "current", &window->ch[METER_CH_CURRENT], 4);
+        write_window_stat(w, 5, "active_power", &window->ch[METER_CH_POWER], 3);
+        write_window_stat(w, 6, "power_factor", &window->ch[METER_CH_POWER_FACTOR], 4);
+        write_window_stat(w, 7, "frequency", &window->ch[METER_CH_FREQUENCY], 3);
+        payload_writer_end_map(w);
+    }
+    
+    // Samples since the previous message; the readings above are the latest
+    if (batch) {
+        meter_batch_write(w, 12, "batch");
+    }
+    payload_writer_end_map(w);
+}
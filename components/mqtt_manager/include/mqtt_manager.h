@@ -3,8 +3,14 @@
 #define MQTT_MANAGER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <time.h>
+#include "payload_writer.h"
+#include "shadow_sync.h"
+#include "mqtt_outbox.h"
+#include "tls_transport.h"
+#include "mqtt_reconnect.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,7 +26,7 @@ typedef struct {
     float voltage_reading;                // Voltage reading in volts
     float current_reading;                 // Current reading in amps
     float power_reading;                   // Power reading in watts
-    float energy_total;                    // Total energy in Wh
+    int64_t energy_uwh;                    // Total energy in micro-Wh
     float temperature;                     // Temperature in °C
     time_t last_wake_up_time;               // Last system wake-up time
     time_t last_reset_timestamp;            // Actual reset timestamp
@@ -37,6 +43,71 @@ typedef enum {
     MQTT_ERROR
 } mqtt_status_t;
 
+/**
+ * @brief Streams whose encoding can be switched at runtime
+ * 
+ * Each stream has a JSON topic and a CBOR topic (JSON topic + "/cbor"). The
+ * CBOR key tables are published retained on smartplug/schema/<stream>.
+ */
+typedef enum {
+    MQTT_STREAM_TELEMETRY,
+    MQTT_STREAM_ENF,
+    MQTT_STREAM_STATS,
+    MQTT_STREAM_COUNT
+} mqtt_stream_t;
+
+/**
+ * @brief Publishing schedules that can be changed at runtime
+ * 
+ * Defaults come from Kconfig; the control topic can change them with
+ * {"interval_ms": {"telemetry": 5000, "shadow": 600000, "stats": 60000}}.
+ */
+typedef enum {
+    MQTT_SCHEDULE_TELEMETRY,            // Telemetry (report-by-exception check) interval
+    MQTT_SCHEDULE_SHADOW,               // Periodic shadow update, 0 = state changes only
+    MQTT_SCHEDULE_STATS,                // Diagnostic counters (stats stream)
+    MQTT_SCHEDULE_COUNT
+} mqtt_schedule_t;
+
+/**
+ * @brief Topic classes for traffic accounting
+ */
+typedef enum {
+    MQTT_TRAFFIC_TELEMETRY,
+    MQTT_TRAFFIC_SHADOW,                // Updates out; delta, get and update responses in
+    MQTT_TRAFFIC_BACKLOG,
+    MQTT_TRAFFIC_ENF,
+    MQTT_TRAFFIC_STATS,
+    MQTT_TRAFFIC_SCHEMA,
+    MQTT_TRAFFIC_CONTROL,
+    MQTT_TRAFFIC_STATUS,                // Connection state (LWT topic) and shadow get requests
+    MQTT_TRAFFIC_COUNT
+} mqtt_traffic_t;
+
+/**
+ * @brief Message and payload byte counters of one topic class
+ */
+typedef struct {
+    uint32_t tx_messages;
+    uint32_t rx_messages;
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;
+} mqtt_traffic_stats_t;
+
+/**
+ * @brief Connection statistics since boot
+ */
+typedef struct {
+    uint32_t connects;                  // Successful connections (CONNACK)
+    uint32_t disconnects;               // Established connections lost
+    uint32_t connect_ms;                // Last attempt: TCP, TLS and CONNACK
+    uint32_t connect_max_ms;
+    uint32_t outage_ms;                 // Last connection loss until reconnected
+    uint32_t outage_max_ms;
+    tls_transport_stats_t tls;
+    mqtt_reconnect_stats_t reconnect;
+} mqtt_link_stats_t;
+
 /**
  * @brief Initialize MQTT manager
  * 
@@ -58,13 +129,21 @@ void mqtt_manager_stop(void);
 
 /**
  * @brief MQTT manager main handler (call in main loop)
+ * 
+ * Reports WiFi coming and going to the reconnect state machine; it does
+ * not time reconnects itself. Also resends shadow updates that were
+ * rejected or got no response (see shadow_sync_pending()).
  */
 void mqtt_manager_handle(void);
 
 /**
  * @brief Connect to AWS IoT MQTT broker
  * 
- * @return true if connected
+ * Starts the reconnect state machine if it is idle. Attempts, including
+ * the first, are paced by it with jittered exponential backoff (see
+ * mqtt_reconnect.h), so calling this again does not hurry them.
+ * 
+ * @return true if connected or an attempt is scheduled
  */
 bool mqtt_manager_connect(void);
 
@@ -88,26 +167,138 @@ bool mqtt_manager_is_connected(void);
 mqtt_status_t mqtt_manager_get_status(void);
 
 /**
- * @brief Publish telemetry data
+ * @brief Queue telemetry for publishing with QoS 1 (call from the MQTT task)
+ * 
+ * The message stays in the outbox until the broker acknowledges it, across
+ * reconnects; see mqtt_outbox.h.
+ * 
+ * @param payload Encoded telemetry (copied)
+ * @param len Payload length in bytes
+ * @param format Encoding, selects the topic
+ * @param priority MQTT_PRIORITY_ALARM for relay and alarm events
+ * @return true if queued
+ */
+bool mqtt_manager_publish_telemetry(const void *payload, size_t len, payload_format_t format,
+                                    mqtt_priority_t priority);
+
+/**
+ * @brief Queue a store-and-forward backlog batch in the outbox (QoS 1)
  * 
- * @param json_payload JSON string to publish
+ * The batch is sent at bulk priority after live telemetry. Its PUBACK is
+ * reported through the backlog ack callback; only then may the sender
+ * move on.
+ * 
+ * @param payload Batch payload (copied)
+ * @param len Payload length in bytes
+ * @return true if queued
+ */
+bool mqtt_manager_publish_backlog(const char *payload, size_t len);
+
+/**
+ * @brief Publish a grid frequency (ENF) block or event
+ * 
+ * @param payload Message payload
+ * @param len Payload length in bytes
+ * @param format Encoding, selects the topic
  * @return true if published
  */
-bool mqtt_manager_publish_telemetry(const char *json_payload);
+bool mqtt_manager_publish_enf(const void *payload, size_t len, payload_format_t format);
+
+/**
+ * @brief Publish a stats (diagnostic counters) message
+ * 
+ * @param payload Message payload
+ * @param len Payload length in bytes
+ * @param format Encoding, selects the topic
+ * @return true if published
+ */
+bool mqtt_manager_publish_stats(const void *payload, size_t len, payload_format_t format);
+
+/**
+ * @brief Publish the CBOR key schema of a stream (retained)
+ * 
+ * @param stream Stream
+ * @param schema JSON schema document
+ * @return true if published
+ */
+bool mqtt_manager_publish_schema(mqtt_stream_t stream, const char *schema);
+
+/**
+ * @brief Get the encoding currently selected for a stream
+ * 
+ * Defaults come from Kconfig; the control topic can change them with
+ * {"format": {"telemetry": "cbor", "enf": "json", "stats": "cbor"}}.
+ */
+payload_format_t mqtt_manager_get_format(mqtt_stream_t stream);
+
+/**
+ * @brief Select the encoding of a stream
+ * 
+ * @param stream Stream
+ * @param format PAYLOAD_JSON or PAYLOAD_CBOR
+ * @return true if the format is valid for streams
+ */
+bool mqtt_manager_set_format(mqtt_stream_t stream, payload_format_t format);
+
+/**
+ * @brief Get a publishing interval
+ * 
+ * @param schedule Schedule
+ * @return uint32_t Interval in milliseconds
+ */
+uint32_t mqtt_manager_get_interval_ms(mqtt_schedule_t schedule);
+
+/**
+ * @brief Set a publishing interval
+ * 
+ * @param schedule Schedule
+ * @param interval_ms Telemetry 500..3600000 ms; shadow 0 or 10000..86400000 ms;
+ *                    stats 10000..86400000 ms
+ * @return true if the interval is in range
+ */
+bool mqtt_manager_set_interval_ms(mqtt_schedule_t schedule, uint32_t interval_ms);
+
+/**
+ * @brief Get traffic counters since boot
+ * 
+ * Bytes are payload bytes, which is what message metering is based on.
+ * 
+ * @param stats Destination, MQTT_TRAFFIC_COUNT entries
+ */
+void mqtt_manager_get_traffic(mqtt_traffic_stats_t *stats);
+
+/**
+ * @brief Get a printable topic class name
+ */
+const char *mqtt_manager_traffic_name(mqtt_traffic_t traffic);
+
+/**
+ * @brief Get connection and TLS handshake statistics
+ * 
+ * @param stats Destination
+ */
+void mqtt_manager_get_link_stats(mqtt_link_stats_t *stats);
 
 /**
  * @brief Update device shadow
  * 
+ * The complete reported document is published once per connection, unless
+ * get/accepted shows the shadow still at the version of our last accepted
+ * update; after that only fields that changed since the last update are
+ * sent. The first update of a connection waits for that version, and is
+ * then published by mqtt_manager_handle(). desired is
+ * only written to clear a relay command the device has superseded.
+ * 
  * @param voltage Voltage reading
  * @param current Current reading
  * @param power Power reading
- * @param energy Energy total
+ * @param energy_uwh Energy total (micro-Wh)
  * @param temp Temperature
  * @param relay_state Relay state
- * @return true if updated
+ * @return true if published or already up to date
  */
 bool mqtt_manager_update_shadow(float voltage, float current, float power,
-                                float energy, float temp, bool relay_state);
+                                int64_t energy_uwh, float temp, bool relay_state);
 
 /**
  * @brief Get current shadow state
@@ -116,6 +307,35 @@ bool mqtt_manager_update_shadow(float voltage, float current, float power,
  */
 const shadow_state_t* mqtt_manager_get_shadow_state(void);
 
+/**
+ * @brief Check whether shadow fields are waiting for a retry
+ * 
+ * See shadow_sync_pending(); mqtt_manager_handle() resends them as they
+ * are, mqtt_manager_update_shadow() with fresh readings.
+ */
+bool mqtt_manager_shadow_pending(void);
+
+/**
+ * @brief Get shadow sync statistics (version, updates, fields sent)
+ * 
+ * @param stats Destination
+ */
+void mqtt_manager_get_shadow_stats(shadow_sync_stats_t *stats);
+
+/**
+ * @brief Set the flash store the outbox spills to when RAM is full
+ * 
+ * @param spill Spill functions (must stay valid), NULL to drop instead
+ */
+void mqtt_manager_set_outbox_spill(const mqtt_outbox_spill_t *spill);
+
+/**
+ * @brief Get outbox statistics (call from the MQTT task)
+ * 
+ * @param stats Destination
+ */
+void mqtt_manager_get_outbox_stats(mqtt_outbox_stats_t *stats);
+
 /**
  * @brief Synchronize system time via NTP
  * 
@@ -172,6 +392,14 @@ void mqtt_manager_set_energy_reset_callback(void (*callback)(void));
  */
 void mqtt_manager_set_shadow_update_callback(void (*callback)(const shadow_state_t *state));
 
+/**
+ * @brief Set backlog acknowledgement callback
+ * 
+ * @param callback Function to call with the payload of each backlog batch
+ *                 the broker acknowledged
+ */
+void mqtt_manager_set_backlog_ack_callback(void (*callback)(const void *payload, size_t len));
+
 #ifdef __cplusplus
 }
 #endif
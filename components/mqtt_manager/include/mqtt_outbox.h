@@ -0,0 +1,158 @@
+// smart_plug/components/mqtt_manager/include/mqtt_outbox.h
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQTT_OUTBOX_RTT_BUCKETS 8
+
+/**
+ * @brief Message priority
+ * 
+ * Alarms are sent before any bulk message and are only spilled once no
+ * bulk message is left to make room.
+ */
+typedef enum {
+    MQTT_PRIORITY_BULK,
+    MQTT_PRIORITY_ALARM,
+    MQTT_PRIORITY_COUNT
+} mqtt_priority_t;
+
+/**
+ * @brief Hands a message to the MQTT client (QoS 1)
+ * 
+ * @param topic Topic id given to mqtt_outbox_enqueue()
+ * @return int Message id, or -1 if the client refused it
+ */
+typedef int (*mqtt_outbox_send_t)(uint8_t topic, const void *data, size_t len);
+
+/**
+ * @brief Called when a message is acknowledged, before it is released
+ * 
+ * @param topic Topic id given to mqtt_outbox_enqueue()
+ * @param data Payload as queued
+ * @param len Payload length
+ */
+typedef void (*mqtt_outbox_ack_t)(uint8_t topic, const void *data, size_t len);
+
+/**
+ * @brief Persistent overflow store (e.g. outbox_spill on flash)
+ */
+typedef struct {
+    bool (*push)(uint8_t topic, const void *data, size_t len);
+    size_t (*peek)(uint8_t *topic, void *buf, size_t size);     // Oldest; size 0 = length only
+    void (*pop)(void);                                          // Release the peeked message
+    bool (*peeked)(void);                                       // false once it was dropped
+} mqtt_outbox_spill_t;
+
+/**
+ * @brief Outbox statistics
+ * 
+ * rtt_hist counts PUBACK round trips by upper bound: 50, 100, 200, 500,
+ * 1000, 2000, 5000 ms and above.
+ */
+typedef struct {
+    uint32_t enqueued[MQTT_PRIORITY_COUNT];
+    uint32_t acked;
+    uint32_t retried;               // Resent after an ack timeout or a dropped client outbox
+    uint32_t spilled;               // Moved to the spill store for lack of RAM
+    uint32_t restored;              // Read back from the spill store
+    uint32_t dropped;               // Lost: too large, or no room and no spill store
+    uint16_t queued;                // Waiting in RAM
+    uint16_t inflight;              // Sent, waiting for PUBACK
+    uint16_t inflight_max;
+    uint32_t ram_bytes;             // Payload bytes held in RAM (queued and in flight)
+    uint32_t rtt_min_ms;
+    uint32_t rtt_max_ms;
+    uint32_t rtt_mean_ms;
+    uint32_t rtt_hist[MQTT_OUTBOX_RTT_BUCKETS];
+} mqtt_outbox_stats_t;
+
+/**
+ * @brief Reset the outbox (at boot)
+ * 
+ * @param send Transport used by mqtt_outbox_pump()
+ */
+void mqtt_outbox_init(mqtt_outbox_send_t send);
+
+/**
+ * @brief Set the spill store used when RAM is full (NULL = drop instead)
+ * 
+ * The oldest spilled message is sent ahead of the bulk messages in RAM;
+ * while it waits for its PUBACK they use the rest of the window.
+ */
+void mqtt_outbox_set_spill(const mqtt_outbox_spill_t *spill);
+
+/**
+ * @brief Set the function told about each PUBACK (NULL = none)
+ * 
+ * Lets a producer that must not move on before delivery (store-and-forward
+ * replay) learn which of its messages arrived.
+ */
+void mqtt_outbox_set_ack_handler(mqtt_outbox_ack_t handler);
+
+/**
+ * @brief Queue a message (the payload is copied)
+ * 
+ * Payloads are kept in a static buffer of CONFIG_MQTT_OUTBOX_RAM_BYTES. If
+ * it is full the oldest queued bulk message is spilled to make room.
+ * 
+ * @param topic Topic id passed back to the send function
+ * @param data Payload
+ * @param len Payload length
+ * @param priority Priority
+ * @return true if queued or spilled
+ */
+bool mqtt_outbox_enqueue(uint8_t topic, const void *data, size_t len, mqtt_priority_t priority);
+
+/**
+ * @brief Send queued messages while the in-flight window has room
+ * 
+ * Also resends messages whose PUBACK is overdue.
+ * 
+ * @param connected true if the client is connected
+ * @param now_us Current time (timebase_now_us())
+ */
+void mqtt_outbox_pump(bool connected, int64_t now_us);
+
+/**
+ * @brief Handle a PUBACK
+ * 
+ * @param msg_id Message id from the send function (unknown ids are ignored)
+ * @param at_us Time the PUBACK arrived
+ */
+void mqtt_outbox_acked(int msg_id, int64_t at_us);
+
+/**
+ * @brief Queue a message for resending because the client dropped it
+ */
+void mqtt_outbox_resend(int msg_id);
+
+/**
+ * @brief Queue every in-flight message for resending (client destroyed)
+ */
+void mqtt_outbox_resend_all(void);
+
+/**
+ * @brief Get outbox statistics
+ * 
+ * @param stats Destination
+ */
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *stats);
+
+/**
+ * @brief Get a printable RTT bucket name ("le_50ms" ... "gt_5000ms")
+ */
+const char *mqtt_outbox_rtt_bucket_name(int bucket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MQTT_OUTBOX_H */
@@ -0,0 +1,108 @@
+// smart_plug/components/mqtt_manager/include/mqtt_reconnect.h
+#ifndef MQTT_RECONNECT_H
+#define MQTT_RECONNECT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Connection state
+ */
+typedef enum {
+    MQTT_RECONNECT_OFFLINE,             // No network, nothing scheduled
+    MQTT_RECONNECT_WAITING,             // Backing off until the next attempt
+    MQTT_RECONNECT_CONNECTING,          // Attempt in progress
+    MQTT_RECONNECT_CONNECTED,
+    MQTT_RECONNECT_STATE_COUNT
+} mqtt_reconnect_state_t;
+
+/**
+ * @brief Inputs to the state machine
+ */
+typedef enum {
+    MQTT_RECONNECT_EV_NETWORK_UP,
+    MQTT_RECONNECT_EV_NETWORK_DOWN,
+    MQTT_RECONNECT_EV_TIMER,            // The timer asked for by the last action expired
+    MQTT_RECONNECT_EV_START_FAILED,     // The client refused to start an attempt
+    MQTT_RECONNECT_EV_DEFERRED,         // No client to start yet (not a failure)
+    MQTT_RECONNECT_EV_CONNECTED,        // CONNACK received
+    MQTT_RECONNECT_EV_DISCONNECTED,     // Attempt failed or connection lost
+    MQTT_RECONNECT_EV_COUNT
+} mqtt_reconnect_event_t;
+
+/**
+ * @brief What the caller must do after an event
+ */
+typedef struct {
+    bool connect;                       // Start a connection attempt now
+    int64_t timer_us;                   // >0 (re)arm the timer, 0 stop it, <0 leave it
+} mqtt_reconnect_action_t;
+
+/**
+ * @brief Outcome statistics since boot
+ */
+typedef struct {
+    uint32_t attempts;
+    uint32_t connected;
+    uint32_t failed;                    // Attempts that ended without a connection
+    uint32_t timeouts;                  // Failed attempts that gave no result in time
+    uint32_t lost;                      // Established connections dropped
+    uint32_t flapped;                   // Dropped before they were stable
+    uint32_t streak;                    // Failures since the last stable connection
+    uint32_t streak_max;
+    uint32_t last_delay_ms;             // Last backoff chosen
+    uint32_t ceiling_ms;                // Backoff ceiling for the next failure
+    mqtt_reconnect_state_t state;
+} mqtt_reconnect_stats_t;
+
+/**
+ * @brief Reset the state machine (at boot)
+ * 
+ * Each failure doubles the backoff ceiling from CONFIG_MQTT_RECONNECT_BASE_MS
+ * up to CONFIG_MQTT_RECONNECT_MAX_S; the delay is drawn uniformly between 0
+ * and the ceiling (full jitter), so a fleet that lost the broker together
+ * does not come back together. The ceiling only drops back once a
+ * connection has lasted CONFIG_MQTT_RECONNECT_STABLE_S.
+ * 
+ * @param rng Random number source for the jitter (esp_random)
+ */
+void mqtt_reconnect_init(uint32_t (*rng)(void));
+
+/**
+ * @brief Feed an event
+ * 
+ * Does not block or log, so it may be called under a spinlock; the caller
+ * carries out the returned action afterwards.
+ * 
+ * @param event Event
+ * @param now_us Current time (timebase_now_us())
+ * @return mqtt_reconnect_action_t Action to take
+ */
+mqtt_reconnect_action_t mqtt_reconnect_event(mqtt_reconnect_event_t event, int64_t now_us);
+
+/**
+ * @brief Get the current state
+ */
+mqtt_reconnect_state_t mqtt_reconnect_get_state(void);
+
+/**
+ * @brief Get outcome statistics
+ * 
+ * @param stats Destination
+ */
+void mqtt_reconnect_get_stats(mqtt_reconnect_stats_t *stats);
+
+/**
+ * @brief Get a printable state name
+ */
+const char *mqtt_reconnect_state_name(mqtt_reconnect_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MQTT_RECONNECT_H */
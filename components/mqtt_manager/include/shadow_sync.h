@@ -0,0 +1,150 @@
+// smart_plug/components/mqtt_manager/include/shadow_sync.h
+#ifndef SHADOW_SYNC_H
+#define SHADOW_SYNC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Fields of the reported shadow document
+ * 
+ * Fields are grouped by the object they live in; keep each group contiguous.
+ */
+typedef enum {
+    SHADOW_FIELD_WELCOME,
+    SHADOW_FIELD_DEVICE_ID,             // device_details
+    SHADOW_FIELD_LOCAL_IP,
+    SHADOW_FIELD_WIFI_SSID,
+    SHADOW_FIELD_FW_VERSION,            // ota
+    SHADOW_FIELD_NETWORK,               // device_diagnosis
+    SHADOW_FIELD_CONNECTION_ATTEMPT,
+    SHADOW_FIELD_TIMESTAMP,
+    SHADOW_FIELD_LAST_RESET,
+    SHADOW_FIELD_CONNECTED,             // device_status
+    SHADOW_FIELD_RSSI,
+    SHADOW_FIELD_CURRENT,               // meter_details
+    SHADOW_FIELD_POWER,
+    SHADOW_FIELD_ENERGY_TOTAL,
+    SHADOW_FIELD_ENERGY_TOTAL_UWH,
+    SHADOW_FIELD_VOLTAGE,
+    SHADOW_FIELD_TEMPERATURE,
+    SHADOW_FIELD_RELAY_STATUS,
+    SHADOW_FIELD_COUNT
+} shadow_field_t;
+
+/**
+ * @brief Sync statistics
+ */
+typedef struct {
+    int64_t version;                    // Last shadow version seen, -1 if unknown
+    uint32_t updates;                   // Update documents published
+    uint32_t full_updates;              // Of which complete documents
+    uint32_t fields_sent;
+    uint32_t fields_skipped;            // Unchanged fields left out of updates
+    uint32_t accepted;
+    uint32_t rejected;
+    uint32_t timeouts;                  // Updates resent for lack of a response
+    uint32_t resumed;                   // Sessions that skipped the complete document
+} shadow_sync_stats_t;
+
+/**
+ * @brief Reset the engine (at boot)
+ */
+void shadow_sync_init(void);
+
+/**
+ * @brief Start a new session (on connect)
+ * 
+ * Marks every field changed and forgets any update in flight. No update is
+ * built until shadow_sync_set_version() reports the version from
+ * get/accepted, or 10 s pass: if the shadow is still at
+ * the version of our last accepted update, only the fields changed since
+ * are sent, otherwise the complete document.
+ * 
+ * @param now_ms Current time (timebase_now_ms())
+ */
+void shadow_sync_reset(int64_t now_ms);
+
+/**
+ * @brief Set a string field, marking it changed if the value differs
+ * 
+ * Values longer than 23 characters are truncated.
+ */
+void shadow_sync_set_str(shadow_field_t field, const char *value);
+
+/**
+ * @brief Set a numeric field, marking it changed if the value differs
+ */
+void shadow_sync_set_int(shadow_field_t field, int64_t value);
+
+/**
+ * @brief Check whether a retry is due
+ * 
+ * True once an update got no response for 10 s, or fields are waiting
+ * (rejected, refused by the client, or a new session) and 2 s passed since
+ * the last update.
+ * 
+ * @param now_ms Current time (timebase_now_ms())
+ */
+bool shadow_sync_pending(int64_t now_ms);
+
+/**
+ * @brief Build an update with the changed fields
+ * 
+ * The document carries a clientToken that shadow_sync_accepted() and
+ * shadow_sync_rejected() match against. When the relay status is among
+ * the changes (outside the first, complete document), desired.relay_status
+ * is cleared so a stale command cannot produce a delta later.
+ * 
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @param len Receives the document length
+ * @param now_ms Current time (timebase_now_ms())
+ * @return const char* Document, or NULL if nothing changed or it did not fit
+ */
+const char *shadow_sync_build(char *buf, size_t size, size_t *len, int64_t now_ms);
+
+/**
+ * @brief Record the result of publishing the last built update
+ * 
+ * @param ok false if the client refused the message (fields are retried)
+ */
+void shadow_sync_published(bool ok);
+
+/**
+ * @brief Handle update/accepted
+ * 
+ * @param token clientToken of the response (not NUL-terminated)
+ * @param token_len Token length
+ * @param version Shadow version in the response, or -1
+ * @param reported true if the update wrote state.reported
+ */
+void shadow_sync_accepted(const char *token, size_t token_len, int64_t version, bool reported);
+
+/**
+ * @brief Handle update/rejected; fields of our updates in flight are resent
+ */
+void shadow_sync_rejected(const char *token, size_t token_len);
+
+/**
+ * @brief Record the version from get/accepted
+ */
+void shadow_sync_set_version(int64_t version);
+
+/**
+ * @brief Get sync statistics
+ * 
+ * @param stats Destination
+ */
+void shadow_sync_get_stats(shadow_sync_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SHADOW_SYNC_H */
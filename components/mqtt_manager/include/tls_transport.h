@@ -0,0 +1,68 @@
+// smart_plug/components/mqtt_manager/include/tls_transport.h
+#ifndef TLS_TRANSPORT_H
+#define TLS_TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_transport.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Certificates for mutual TLS (PEM, lengths without the NUL)
+ */
+typedef struct {
+    const char *ca_cert;
+    size_t ca_cert_len;
+    const char *client_cert;
+    size_t client_cert_len;
+    const char *client_key;
+    size_t client_key_len;
+} tls_transport_config_t;
+
+/**
+ * @brief Handshake statistics
+ */
+typedef struct {
+    uint32_t full;                      // Full handshakes (certificate exchange and RSA)
+    uint32_t resumed;                   // Abbreviated handshakes from the cached session
+    uint32_t failed;
+    uint32_t full_ms;                   // Last full handshake, TCP connect included
+    uint32_t resumed_ms;                // Last resumed handshake, TCP connect included
+    uint32_t full_mean_ms;
+    uint32_t resumed_mean_ms;
+    bool session_cached;                // A session is ready for the next connect
+    bool session_from_rtc;              // The first session came from before a reset
+} tls_transport_stats_t;
+
+/**
+ * @brief Create the TLS transport for the MQTT client
+ * 
+ * Certificates are parsed on the first connect, in the client's task, and
+ * kept for every connection after that. After each handshake the session
+ * (ticket) is cached in RAM and in RTC memory, and offered on the next
+ * connect, so reconnects and soft resets skip the certificate exchange
+ * when the broker accepts it.
+ * 
+ * Only one connection exists at a time.
+ * 
+ * @param config Certificates (copied on the first call; the PEM data must stay valid)
+ * @return esp_transport_handle_t Transport, NULL on error
+ */
+esp_transport_handle_t tls_transport_create(const tls_transport_config_t *config);
+
+/**
+ * @brief Get handshake statistics
+ * 
+ * @param stats Destination
+ */
+void tls_transport_get_stats(tls_transport_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TLS_TRANSPORT_H */
@@ -6,12 +6,19 @@
 #include "mqtt_client.h"
 #include "esp_tls.h"
 #include "esp_event.h"
-#include "cJSON.h"
-#include "nvs_flash.h"
 #include "esp_timer.h"
+#include "esp_random.h"
+#include "nvs_flash.h"
+#include "timebase.h"
+#include "json_writer.h"
+#include "json_reader.h"
+#include "shadow_sync.h"
+#include "tls_transport.h"
+#include "mqtt_reconnect.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_sntp.h"  
 #include <string.h>
 #include <time.h>
@@ -35,40 +42,167 @@ static const char *TAG = "MQTT_MGR";
 #define CONFIG_FIRMWARE_VERSION "1.2.0"
 #endif
 
+#ifndef CONFIG_PUBLISH_INTERVAL_MS
+#define CONFIG_PUBLISH_INTERVAL_MS 1000
+#endif
+
+#ifndef CONFIG_SHADOW_INTERVAL_S
+#define CONFIG_SHADOW_INTERVAL_S 300
+#endif
+
+#ifndef CONFIG_STATS_INTERVAL_S
+#define CONFIG_STATS_INTERVAL_S 300
+#endif
+
+#ifndef CONFIG_TELEMETRY_CBOR
+#define CONFIG_TELEMETRY_CBOR 0
+#endif
+
+#ifndef CONFIG_ENF_CBOR
+#define CONFIG_ENF_CBOR 0
+#endif
+
+#ifndef CONFIG_STATS_CBOR
+#define CONFIG_STATS_CBOR 0
+#endif
+
 /*===============================================================================
   Topics
   ===============================================================================*/
 
-#define TOPIC_SHADOW_UPDATE     "$aws/things/" CONFIG_THING_NAME "/shadow/update"
-#define TOPIC_SHADOW_DELTA      "$aws/things/" CONFIG_THING_NAME "/shadow/update/delta"
+#define TOPIC_SHADOW            "$aws/things/" CONFIG_THING_NAME "/shadow"
+#define TOPIC_SHADOW_UPDATE     TOPIC_SHADOW "/update"
+#define TOPIC_SHADOW_DELTA      TOPIC_SHADOW "/update/delta"
+#define TOPIC_SHADOW_ACCEPTED   TOPIC_SHADOW "/update/accepted"
+#define TOPIC_SHADOW_REJECTED   TOPIC_SHADOW "/update/rejected"
+#define TOPIC_SHADOW_GET        TOPIC_SHADOW "/get"
+#define TOPIC_SHADOW_GET_ACCEPTED TOPIC_SHADOW "/get/accepted"
 #define TOPIC_TELEMETRY         "smartplug/telemetry"
+#define TOPIC_BACKLOG           "smartplug/telemetry/backlog"
+#define TOPIC_ENF               "smartplug/enf"
+#define TOPIC_STATS             "smartplug/stats"
 #define TOPIC_CONTROL           "smartplug/control"
+#define TOPIC_SCHEMA            "smartplug/schema"
 #define TOPIC_LWT               "device/" CONFIG_THING_NAME "/state"
 
+typedef struct {
+    const char *name;
+    const char *topic_json;
+    const char *topic_cbor;
+    const char *topic_schema;
+} stream_topics_t;
+
+static const stream_topics_t stream_topics[MQTT_STREAM_COUNT] = {
+    [MQTT_STREAM_TELEMETRY] = { "telemetry", TOPIC_TELEMETRY, TOPIC_TELEMETRY "/cbor",
+                                TOPIC_SCHEMA "/telemetry" },
+    [MQTT_STREAM_ENF]       = { "enf", TOPIC_ENF, TOPIC_ENF "/cbor", TOPIC_SCHEMA "/enf" },
+    [MQTT_STREAM_STATS]     = { "stats", TOPIC_STATS, TOPIC_STATS "/cbor", TOPIC_SCHEMA "/stats" },
+};
+
+// Topic ids of outbox messages; also stored with spilled messages, so only append
+typedef enum {
+    OUTBOX_TOPIC_TELEMETRY_JSON,
+    OUTBOX_TOPIC_TELEMETRY_CBOR,
+    OUTBOX_TOPIC_BACKLOG,
+    OUTBOX_TOPIC_COUNT
+} outbox_topic_t;
+
+static const char *const outbox_topics[OUTBOX_TOPIC_COUNT] = {
+    [OUTBOX_TOPIC_TELEMETRY_JSON] = TOPIC_TELEMETRY,
+    [OUTBOX_TOPIC_TELEMETRY_CBOR] = TOPIC_TELEMETRY "/cbor",
+    [OUTBOX_TOPIC_BACKLOG]        = TOPIC_BACKLOG,
+};
+
+static const mqtt_traffic_t outbox_traffic[OUTBOX_TOPIC_COUNT] = {
+    [OUTBOX_TOPIC_TELEMETRY_JSON] = MQTT_TRAFFIC_TELEMETRY,
+    [OUTBOX_TOPIC_TELEMETRY_CBOR] = MQTT_TRAFFIC_TELEMETRY,
+    [OUTBOX_TOPIC_BACKLOG]        = MQTT_TRAFFIC_BACKLOG,
+};
+
 /*===============================================================================
   Static Variables
   ===============================================================================*/
 
 static esp_mqtt_client_handle_t mqtt_client = NULL;
+static bool client_started = false;     // Started once, then reconnected in place
 static mqtt_status_t current_status = MQTT_DISCONNECTED;
 static shadow_state_t shadow_state = {0};
 static bool shadow_initialized = false;
 
+// Shadow documents are built in place. Updates come from both the MQTT task
+// and the MQTT event task (relay commands, shadow responses), so the buffer
+// and the sync state share a lock.
+static char shadow_buf[1024];
+static SemaphoreHandle_t shadow_mutex = NULL;
+
+// Written by the MQTT event task (control topic), read by publishers
+static volatile payload_format_t stream_format[MQTT_STREAM_COUNT] = {
+    [MQTT_STREAM_TELEMETRY] = CONFIG_TELEMETRY_CBOR ? PAYLOAD_CBOR : PAYLOAD_JSON,
+    [MQTT_STREAM_ENF]       = CONFIG_ENF_CBOR ? PAYLOAD_CBOR : PAYLOAD_JSON,
+    [MQTT_STREAM_STATS]     = CONFIG_STATS_CBOR ? PAYLOAD_CBOR : PAYLOAD_JSON,
+};
+
+// Written by the MQTT event task (control topic), read by the MQTT task
+static volatile uint32_t schedule_ms[MQTT_SCHEDULE_COUNT] = {
+    [MQTT_SCHEDULE_TELEMETRY] = CONFIG_PUBLISH_INTERVAL_MS,
+    [MQTT_SCHEDULE_SHADOW]    = CONFIG_SHADOW_INTERVAL_S * 1000,
+    [MQTT_SCHEDULE_STATS]     = CONFIG_STATS_INTERVAL_S * 1000,
+};
+
+static const char *const schedule_names[MQTT_SCHEDULE_COUNT] = {
+    [MQTT_SCHEDULE_TELEMETRY] = "telemetry",
+    [MQTT_SCHEDULE_SHADOW]    = "shadow",
+    [MQTT_SCHEDULE_STATS]     = "stats",
+};
+
+// Publishes come from several tasks
+static mqtt_traffic_stats_t traffic[MQTT_TRAFFIC_COUNT];
+static portMUX_TYPE traffic_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *const traffic_names[MQTT_TRAFFIC_COUNT] = {
+    [MQTT_TRAFFIC_TELEMETRY] = "telemetry",
+    [MQTT_TRAFFIC_SHADOW]    = "shadow",
+    [MQTT_TRAFFIC_BACKLOG]   = "backlog",
+    [MQTT_TRAFFIC_ENF]       = "enf",
+    [MQTT_TRAFFIC_STATS]     = "stats",
+    [MQTT_TRAFFIC_SCHEMA]    = "schema",
+    [MQTT_TRAFFIC_CONTROL]   = "control",
+    [MQTT_TRAFFIC_STATUS]    = "status",
+};
+
+// PUBACKs and dropped messages, passed from the MQTT event task to the outbox
+typedef struct {
+    int msg_id;
+    int64_t at_us;
+    bool deleted;                       // Dropped from the client's outbox, resend
+} outbox_ack_t;
+
+#define ACK_QUEUE_LEN   16
+
+static QueueHandle_t ack_queue = NULL;
+
 // Callbacks
 static void (*relay_callback)(bool state) = NULL;
 static void (*energy_reset_callback)(void) = NULL;
 static void (*shadow_update_callback)(const shadow_state_t *state) = NULL;
+static void (*backlog_ack_callback)(const void *payload, size_t len) = NULL;
 
 // Time sync
 static time_t last_time_sync = 0;
 static SemaphoreHandle_t time_sync_semaphore = NULL;
 static bool sntp_initialized = false;
 
-// Reconnect
-static uint32_t reconnect_attempts = 0;
-static uint32_t last_reconnect_attempt = 0;
-#define RECONNECT_INTERVAL_MS 10000
-#define MAX_RECONNECT_ATTEMPTS 5
+// Reconnect: mqtt_reconnect paces the attempts; see "Reconnect" below
+static esp_timer_handle_t reconnect_timer = NULL;
+static bool network_up = false;                 // As last reported to mqtt_reconnect
+static volatile bool client_wanted = false;     // An attempt found no client to start
+
+// Connection timing; attempts start in the MQTT task, results arrive as events
+static mqtt_link_stats_t link_stats;
+static int64_t attempt_start_us = 0;
+static int64_t link_lost_us = 0;
+static bool link_up = false;
+static portMUX_TYPE link_mux = portMUX_INITIALIZER_UNLOCKED;
 
 // LWT message
 #define LWT_MESSAGE_DISCONNECTED "{\"state\":{\"reported\":{\"device_status\":{\"connected\":\"false\"}}}}"
@@ -76,7 +210,6 @@ static uint32_t last_reconnect_attempt = 0;
 
 // Boot time tracking
 static time_t boot_timestamp = 0;  // When the device booted (epoch time)
-static uint32_t boot_time_ms = 0;  // When the device booted (milliseconds since boot)
 
 /*===============================================================================
   Forward Declarations
@@ -122,8 +255,7 @@ static void verify_certificates(void)
 void mqtt_manager_set_boot_time(time_t boot_epoch)
 {
     boot_timestamp = boot_epoch;
-    boot_time_ms = esp_timer_get_time() / 1000;
-    ESP_LOGI(TAG, "Boot timestamp set: %ld (epoch), boot_ms: %lu", boot_timestamp, boot_time_ms);
+    ESP_LOGI(TAG, "Boot timestamp set: %ld (epoch)", (long)boot_timestamp);
 }
 
 time_t mqtt_manager_get_boot_time(void)
@@ -133,12 +265,7 @@ time_t mqtt_manager_get_boot_time(void)
 
 uint32_t mqtt_manager_get_uptime_seconds(void)
 {
-    if (boot_time_ms == 0) {
-        return 0;
-    }
-    
-    uint32_t now_ms = esp_timer_get_time() / 1000;
-    return (now_ms - boot_time_ms) / 1000;
+    return timebase_uptime_s();
 }
 
 /*===============================================================================
@@ -203,9 +330,7 @@ bool mqtt_manager_sync_time(void)
     
     // Set boot timestamp if not already set
     if (boot_timestamp == 0) {
-        // Calculate approximate boot time based on uptime
-        uint32_t uptime_sec = mqtt_manager_get_uptime_seconds();
-        mqtt_manager_set_boot_time(now - uptime_sec);
+        mqtt_manager_set_boot_time(timebase_boot_wall_s());
     }
     
     return true;
@@ -213,12 +338,7 @@ bool mqtt_manager_sync_time(void)
 
 time_t mqtt_manager_get_current_time(void)
 {
-    time_t now;
-    time(&now);
-    if (now < 1000000000) {
-        return 0;
-    }
-    return now;
+    return timebase_wall_s();
 }
 
 /*===============================================================================
@@ -232,6 +352,11 @@ static void mqtt_destroy_client(void)
         esp_mqtt_client_stop(mqtt_client);
         esp_mqtt_client_destroy(mqtt_client);
         mqtt_client = NULL;
+        client_started = false;
+        
+        // Unacknowledged messages went with the client's own outbox
+        if (ack_queue) xQueueReset(ack_queue);
+        mqtt_outbox_resend_all();
     }
     current_status = MQTT_DISCONNECTED;
 }
@@ -245,27 +370,30 @@ static bool mqtt_create_client(void)
     
     ESP_LOGI(TAG, "Creating new MQTT client");
     
-    char client_id[64];
-    uint32_t random_suffix = esp_random() & 0xFFFF;
-    snprintf(client_id, sizeof(client_id), "%s_%04" PRIX32, CONFIG_THING_NAME, random_suffix);
+    // Certificates live in the transport, which also resumes TLS sessions
+    const tls_transport_config_t tls_cfg = {
+        .ca_cert = aws_cert_ca,
+        .ca_cert_len = aws_cert_ca_len,
+        .client_cert = aws_cert_crt,
+        .client_cert_len = aws_cert_crt_len,
+        .client_key = aws_cert_private,
+        .client_key_len = aws_cert_private_len,
+    };
+    esp_transport_handle_t transport = tls_transport_create(&tls_cfg);
+    if (!transport) {
+        ESP_LOGE(TAG, "Failed to create TLS transport");
+        return false;
+    }
     
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker = {
             .address = {
                 .uri = "mqtts://" CONFIG_AWS_IOT_ENDPOINT ":8883",
             },
-            .verification = {
-                .certificate = aws_cert_ca,
-                .skip_cert_common_name_check = false,
-                .use_global_ca_store = false,
-            },
         },
         .credentials = {
-            .client_id = client_id,
-            .authentication = {
-                .certificate = aws_cert_crt,
-                .key = aws_cert_private,
-            },
+            // Stable, so the broker sees one device rather than a new one per attempt
+            .client_id = CONFIG_THING_NAME,
         },
         .session = {
             .keepalive = 15,
@@ -284,12 +412,15 @@ static bool mqtt_create_client(void)
         },
         .network = {
             .timeout_ms = 10000,
+            .disable_auto_reconnect = true,     // mqtt_reconnect schedules attempts
+            .transport = transport,
         },
     };
     
     mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     if (!mqtt_client) {
         ESP_LOGE(TAG, "Failed to create MQTT client");
+        esp_transport_destroy(transport);
         return false;
     }
     
@@ -299,10 +430,370 @@ static bool mqtt_create_client(void)
     return true;
 }
 
+/*===============================================================================
+  Connection Statistics
+  ===============================================================================*/
+
+static void link_attempt(void)
+{
+    int64_t now_us = timebase_now_us();
+    
+    portENTER_CRITICAL(&link_mux);
+    attempt_start_us = now_us;
+    portEXIT_CRITICAL(&link_mux);
+}
+
+static void link_connected(void)
+{
+    int64_t now_us = timebase_now_us();
+    
+    portENTER_CRITICAL(&link_mux);
+    link_stats.connects++;
+    link_up = true;
+    if (attempt_start_us) {
+        link_stats.connect_ms = (uint32_t)((now_us - attempt_start_us) / 1000);
+        if (link_stats.connect_ms > link_stats.connect_max_ms) {
+            link_stats.connect_max_ms = link_stats.connect_ms;
+        }
+        attempt_start_us = 0;
+    }
+    if (link_lost_us) {
+        link_stats.outage_ms = (uint32_t)((now_us - link_lost_us) / 1000);
+        if (link_stats.outage_ms > link_stats.outage_max_ms) {
+            link_stats.outage_max_ms = link_stats.outage_ms;
+        }
+        link_lost_us = 0;
+    }
+    portEXIT_CRITICAL(&link_mux);
+}
+
+// Also called for failed attempts; only an established link starts an outage
+static void link_disconnected(void)
+{
+    int64_t now_us = timebase_now_us();
+    
+    portENTER_CRITICAL(&link_mux);
+    if (link_up) {
+        link_stats.disconnects++;
+        link_lost_us = now_us;
+        link_up = false;
+    }
+    portEXIT_CRITICAL(&link_mux);
+}
+
+/*===============================================================================
+  Reconnect
+
+  mqtt_reconnect decides when to try (capped exponential backoff with full
+  jitter); this carries out what it asks for. Its events come from the MQTT
+  event task, the timer task and the MQTT task, so it runs under link_mux
+  and its actions run after the lock is released.
+  ===============================================================================*/
+
+// Hand the client one attempt; the outcome arrives as an MQTT event
+static bool start_attempt(void)
+{
+    ESP_LOGI(TAG, "Connecting to AWS IoT...");
+    current_status = MQTT_CONNECTING;
+    link_attempt();
+    
+    // The client is started once and then reconnected in place, keeping its
+    // transport and with it the cached TLS session
+    esp_err_t err = client_started ? esp_mqtt_client_reconnect(mqtt_client)
+                                   : esp_mqtt_client_start(mqtt_client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to %s MQTT client: %s",
+                 client_started ? "reconnect" : "start", esp_err_to_name(err));
+        current_status = MQTT_ERROR;
+        return false;
+    }
+    client_started = true;
+    return true;
+}
+
+static void reconnect_post(mqtt_reconnect_event_t event)
+{
+    int64_t now_us = timebase_now_us();
+    
+    portENTER_CRITICAL(&link_mux);
+    mqtt_reconnect_action_t action = mqtt_reconnect_event(event, now_us);
+    portEXIT_CRITICAL(&link_mux);
+    
+    // A timer that fires late from an earlier action is ignored by the state machine
+    if (action.timer_us >= 0 && reconnect_timer) {
+        esp_timer_stop(reconnect_timer);
+        if (action.timer_us > 0) {
+            esp_timer_start_once(reconnect_timer, action.timer_us);
+        }
+        if (action.timer_us > 0 && !action.connect) {
+            ESP_LOGI(TAG, "Next MQTT attempt in %lu ms", (unsigned long)(action.timer_us / 1000));
+        }
+    }
+    
+    if (!action.connect) return;
+    if (!mqtt_client) {
+        // Created by the MQTT task; waiting for it is not a failed attempt
+        client_wanted = true;
+        reconnect_post(MQTT_RECONNECT_EV_DEFERRED);
+    } else if (!start_attempt()) {
+        reconnect_post(MQTT_RECONNECT_EV_START_FAILED);
+    }
+}
+
+static void reconnect_timer_cb(void *arg)
+{
+    reconnect_post(MQTT_RECONNECT_EV_TIMER);
+}
+
+/*===============================================================================
+  Traffic Accounting
+  ===============================================================================*/
+
+static void count_traffic(mqtt_traffic_t cls, bool tx, size_t len)
+{
+    portENTER_CRITICAL(&traffic_mux);
+    if (tx) {
+        traffic[cls].tx_messages++;
+        traffic[cls].tx_bytes += len;
+    } else {
+        traffic[cls].rx_messages++;
+        traffic[cls].rx_bytes += len;
+    }
+    portEXIT_CRITICAL(&traffic_mux);
+}
+
+// esp_mqtt_client_publish() plus accounting; len 0 means a NUL-terminated payload
+static int publish(mqtt_traffic_t cls, const char *topic, const void *data, size_t len,
+                   int qos, int retain)
+{
+    if (len == 0 && data) len = strlen(data);
+    
+    int msg_id = esp_mqtt_client_publish(mqtt_client, topic, data, (int)len, qos, retain);
+    if (msg_id >= 0) {
+        count_traffic(cls, true, len);
+    }
+    return msg_id;
+}
+
+/*===============================================================================
+  Outbox
+  
+  Telemetry and backlog batches go out with QoS 1 through mqtt_outbox,
+  which bounds the messages in flight, times PUBACKs and spills to flash
+  when RAM is full. The outbox only runs in the MQTT task; acks reach it
+  through ack_queue.
+  ===============================================================================*/
+
+static int outbox_send(uint8_t topic, const void *data, size_t len)
+{
+    if (!mqtt_client || current_status != MQTT_CONNECTED || topic >= OUTBOX_TOPIC_COUNT) {
+        return -1;
+    }
+    return publish(outbox_traffic[topic], outbox_topics[topic], data, len, 1, 0);
+}
+
+// The backlog cursor only moves once the broker has a batch
+static void outbox_acked(uint8_t topic, const void *data, size_t len)
+{
+    if (topic == OUTBOX_TOPIC_BACKLOG && backlog_ack_callback) {
+        backlog_ack_callback(data, len);
+    }
+}
+
+static void post_ack(int msg_id, bool deleted)
+{
+    if (!ack_queue) return;
+    
+    // A lost ack only delays the message until its ack timeout
+    outbox_ack_t ack = { .msg_id = msg_id, .at_us = timebase_now_us(), .deleted = deleted };
+    xQueueSend(ack_queue, &ack, 0);
+}
+
+static void outbox_handle(void)
+{
+    outbox_ack_t ack;
+    while (ack_queue && xQueueReceive(ack_queue, &ack, 0) == pdTRUE) {
+        if (ack.deleted) {
+            mqtt_outbox_resend(ack.msg_id);
+        } else {
+            mqtt_outbox_acked(ack.msg_id, ack.at_us);
+        }
+    }
+    mqtt_outbox_pump(current_status == MQTT_CONNECTED, timebase_now_us());
+}
+
+/*===============================================================================
+  Inbound Messages
+  
+  Payloads are tokenized in place (no heap) and fields looked up by path.
+  ===============================================================================*/
+
+// get/accepted carries the whole document plus metadata for every field
+#define RX_MAX_TOKENS   256
+
+// Only used from the MQTT event task
+static json_tok_t rx_tokens[RX_MAX_TOKENS];
+
+static int parse_payload(const char *data, int len)
+{
+    int count = json_reader_parse(data, len, rx_tokens, RX_MAX_TOKENS);
+    if (count < 0) {
+        ESP_LOGW(TAG, "Ignoring malformed payload (error %d, %d bytes)", count, len);
+    }
+    return count;
+}
+
+// Apply desired fields found under obj (a delta "state" object)
+static void apply_desired(const char *data, int count, int obj)
+{
+    bool value;
+    int tok = json_reader_find(data, rx_tokens, count, obj, "relay_status");
+    if (tok >= 0 && json_reader_get_bool(data, &rx_tokens[tok], &value)) {
+        if (value != shadow_state.power) {
+            shadow_state.power = value;
+            if (relay_callback) {
+                relay_callback(value);
+            }
+        }
+    }
+    
+    tok = json_reader_find(data, rx_tokens, count, obj, "reset_energy");
+    if (tok >= 0 && json_reader_get_bool(data, &rx_tokens[tok], &value) && value) {
+        if (energy_reset_callback) {
+            energy_reset_callback();
+        }
+        shadow_state.energy_uwh = 0;
+        shadow_state.last_reset_timestamp = time(NULL);
+    }
+}
+
+static int64_t get_version(const char *data, int count)
+{
+    int64_t version;
+    int tok = json_reader_find(data, rx_tokens, count, 0, "version");
+    if (tok < 0 || !json_reader_get_int(data, &rx_tokens[tok], &version)) {
+        return -1;
+    }
+    return version;
+}
+
+static void handle_shadow_delta(const char *data, int len)
+{
+    int count = parse_payload(data, len);
+    if (count < 0) return;
+    
+    int state = json_reader_find(data, rx_tokens, count, 0, "state");
+    if (state >= 0) {
+        apply_desired(data, count, state);
+    }
+}
+
+// Full document requested on connect: commands sent while offline are in "delta"
+static void handle_shadow_get_accepted(const char *data, int len)
+{
+    int count = parse_payload(data, len);
+    if (count < 0) return;
+    
+    int64_t version = get_version(data, count);
+    if (xSemaphoreTake(shadow_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+        shadow_sync_set_version(version);
+        xSemaphoreGive(shadow_mutex);
+    }
+    ESP_LOGI(TAG, "Shadow version %" PRId64, version);
+    
+    int delta = json_reader_find(data, rx_tokens, count, 0, "state.delta");
+    if (delta >= 0) {
+        apply_desired(data, count, delta);
+    }
+}
+
+static void handle_shadow_response(const char *data, int len, bool accepted)
+{
+    int count = parse_payload(data, len);
+    if (count < 0) return;
+    
+    // Updates from other clients carry their own token or none
+    const char *token = NULL;
+    size_t token_len = 0;
+    int tok = json_reader_find(data, rx_tokens, count, 0, "clientToken");
+    if (tok >= 0 && rx_tokens[tok].type == JSON_TOK_STRING) {
+        token = data + rx_tokens[tok].start;
+        token_len = rx_tokens[tok].end - rx_tokens[tok].start;
+    }
+    
+    bool reported = json_reader_find(data, rx_tokens, count, 0, "state.reported") >= 0;
+    
+    if (xSemaphoreTake(shadow_mutex, pdMS_TO_TICKS(100)) != pdTRUE) return;
+    if (accepted) {
+        shadow_sync_accepted(token, token_len, get_version(data, count), reported);
+    } else {
+        shadow_sync_rejected(token, token_len);
+    }
+    xSemaphoreGive(shadow_mutex);
+}
+
+static void handle_control(const char *data, int len)
+{
+    int count = parse_payload(data, len);
+    if (count < 0) return;
+    
+    bool value;
+    int tok = json_reader_find(data, rx_tokens, count, 0, "relay_state");
+    if (tok >= 0 && rx_tokens[tok].type == JSON_TOK_PRIMITIVE &&
+        json_reader_get_bool(data, &rx_tokens[tok], &value)) {
+        if (relay_callback) {
+            relay_callback(value);
+        }
+    }
+    
+    tok = json_reader_find(data, rx_tokens, count, 0, "reset_energy");
+    if (tok >= 0 && rx_tokens[tok].type == JSON_TOK_PRIMITIVE &&
+        json_reader_get_bool(data, &rx_tokens[tok], &value) && value) {
+        if (energy_reset_callback) {
+            energy_reset_callback();
+        }
+    }
+    
+    // {"format": {"<stream>": "json" | "cbor"}}
+    int formats = json_reader_find(data, rx_tokens, count, 0, "format");
+    for (int s = 0; formats >= 0 && s < MQTT_STREAM_COUNT; s++) {
+        tok = json_reader_find(data, rx_tokens, count, formats, stream_topics[s].name);
+        if (tok < 0 || rx_tokens[tok].type != JSON_TOK_STRING) continue;
+        
+        payload_format_t format;
+        const json_tok_t *t = &rx_tokens[tok];
+        if (payload_format_from_name(data + t->start, t->end - t->start, &format)) {
+            mqtt_manager_set_format((mqtt_stream_t)s, format);
+        } else {
+            ESP_LOGW(TAG, "Unknown %s format: %.*s", stream_topics[s].name,
+                     (int)(t->end - t->start), data + t->start);
+        }
+    }
+    
+    // {"interval_ms": {"telemetry": <ms>, "shadow": <ms>, "stats": <ms>}}
+    int intervals = json_reader_find(data, rx_tokens, count, 0, "interval_ms");
+    for (int i = 0; intervals >= 0 && i < MQTT_SCHEDULE_COUNT; i++) {
+        int64_t ms;
+        tok = json_reader_find(data, rx_tokens, count, intervals, schedule_names[i]);
+        if (tok < 0 || !json_reader_get_int(data, &rx_tokens[tok], &ms)) continue;
+        
+        if (ms < 0 || ms > UINT32_MAX || !mqtt_manager_set_interval_ms((mqtt_schedule_t)i, (uint32_t)ms)) {
+            ESP_LOGW(TAG, "Invalid %s interval: %" PRId64 " ms", schedule_names[i], ms);
+        }
+    }
+}
+
 /*===============================================================================
   MQTT Event Handler
   ===============================================================================*/
 
+// Exact match; several shadow topics share a prefix
+static bool topic_is(esp_mqtt_event_handle_t event, const char *topic)
+{
+    return (size_t)event->topic_len == strlen(topic) &&
+           memcmp(event->topic, topic, event->topic_len) == 0;
+}
+
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                                int32_t event_id, void *event_data)
 {
@@ -312,24 +803,33 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
         case MQTT_EVENT_CONNECTED:
             ESP_LOGI(TAG, "MQTT connected");
             current_status = MQTT_CONNECTED;
-            reconnect_attempts = 0;
+            link_connected();
+            reconnect_post(MQTT_RECONNECT_EV_CONNECTED);
+            
+            // Next shadow update waits for the version from get/accepted
+            if (xSemaphoreTake(shadow_mutex, pdMS_TO_TICKS(100)) == pdTRUE) {
+                shadow_sync_reset(timebase_now_ms());
+                xSemaphoreGive(shadow_mutex);
+            }
             
             esp_mqtt_client_subscribe(mqtt_client, TOPIC_SHADOW_DELTA, 1);
-            ESP_LOGI(TAG, "Subscribed to: %s", TOPIC_SHADOW_DELTA);
+            esp_mqtt_client_subscribe(mqtt_client, TOPIC_SHADOW_ACCEPTED, 0);
+            esp_mqtt_client_subscribe(mqtt_client, TOPIC_SHADOW_REJECTED, 0);
+            esp_mqtt_client_subscribe(mqtt_client, TOPIC_SHADOW_GET_ACCEPTED, 0);
+            ESP_LOGI(TAG, "Subscribed to: %s (delta, accepted, rejected, get)", TOPIC_SHADOW);
             
             esp_mqtt_client_subscribe(mqtt_client, TOPIC_CONTROL, 1);
             ESP_LOGI(TAG, "Subscribed to: %s", TOPIC_CONTROL);
             
-            esp_mqtt_client_publish(mqtt_client, TOPIC_LWT,
-                                    LWT_MESSAGE_CONNECTED, 0, 1, 1);
-            
-            esp_mqtt_client_publish(mqtt_client, "$aws/things/" CONFIG_THING_NAME "/shadow/get",
-                                    "", 0, 0, 0);
+            publish(MQTT_TRAFFIC_STATUS, TOPIC_LWT, LWT_MESSAGE_CONNECTED, 0, 1, 1);
+            publish(MQTT_TRAFFIC_STATUS, TOPIC_SHADOW_GET, "", 0, 0, 0);
             break;
             
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "MQTT disconnected");
+            link_disconnected();
             current_status = MQTT_DISCONNECTED;
+            reconnect_post(MQTT_RECONNECT_EV_DISCONNECTED);
             break;
             
         case MQTT_EVENT_SUBSCRIBED:
@@ -342,59 +842,40 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
             
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGD(TAG, "MQTT published, msg_id=%d", event->msg_id);
+            post_ack(event->msg_id, false);
+            break;
+        
+        case MQTT_EVENT_DELETED:
+            ESP_LOGW(TAG, "MQTT message expired unacknowledged, msg_id=%d", event->msg_id);
+            post_ack(event->msg_id, true);
             break;
             
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "MQTT data received, topic: %.*s", event->topic_len, event->topic);
             
-            if (strncmp(event->topic, TOPIC_SHADOW_DELTA, event->topic_len) == 0) {
-                cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
-                if (root) {
-                    cJSON *state = cJSON_GetObjectItem(root, "state");
-                    if (state) {
-                        cJSON *relay = cJSON_GetObjectItem(state, "relay_status");
-                        if (relay && cJSON_IsString(relay)) {
-                            bool new_state = (strcmp(relay->valuestring, "true") == 0);
-                            if (new_state != shadow_state.power) {
-                                shadow_state.power = new_state;
-                                if (relay_callback) {
-                                    relay_callback(new_state);
-                                }
-                            }
-                        }
-                        
-                        cJSON *reset = cJSON_GetObjectItem(state, "reset_energy");
-                        if (reset && cJSON_IsString(reset) && 
-                            strcmp(reset->valuestring, "true") == 0) {
-                            if (energy_reset_callback) {
-                                energy_reset_callback();
-                            }
-                            shadow_state.energy_total = 0;
-                            shadow_state.last_reset_timestamp = time(NULL);
-                        }
-                    }
-                    cJSON_Delete(root);
-                }
+            if (event->data_len < event->total_data_len) {
+                // Larger than the receive buffer (e.g. a shadow with metadata)
+                ESP_LOGW(TAG, "Ignoring fragmented message (%d bytes)", event->total_data_len);
+            }
+            else if (topic_is(event, TOPIC_SHADOW_DELTA)) {
+                count_traffic(MQTT_TRAFFIC_SHADOW, false, event->data_len);
+                handle_shadow_delta(event->data, event->data_len);
+            }
+            else if (topic_is(event, TOPIC_SHADOW_ACCEPTED)) {
+                count_traffic(MQTT_TRAFFIC_SHADOW, false, event->data_len);
+                handle_shadow_response(event->data, event->data_len, true);
             }
-            else if (strncmp(event->topic, TOPIC_CONTROL, event->topic_len) == 0) {
-                cJSON *root = cJSON_ParseWithLength(event->data, event->data_len);
-                if (root) {
-                    cJSON *relay = cJSON_GetObjectItem(root, "relay_state");
-                    if (relay && cJSON_IsBool(relay)) {
-                        bool new_state = cJSON_IsTrue(relay);
-                        if (relay_callback) {
-                            relay_callback(new_state);
-                        }
-                    }
-                    
-                    cJSON *reset = cJSON_GetObjectItem(root, "reset_energy");
-                    if (reset && cJSON_IsBool(reset) && cJSON_IsTrue(reset)) {
-                        if (energy_reset_callback) {
-                            energy_reset_callback();
-                        }
-                    }
-                }
-                cJSON_Delete(root);
+            else if (topic_is(event, TOPIC_SHADOW_REJECTED)) {
+                count_traffic(MQTT_TRAFFIC_SHADOW, false, event->data_len);
+                handle_shadow_response(event->data, event->data_len, false);
+            }
+            else if (topic_is(event, TOPIC_SHADOW_GET_ACCEPTED)) {
+                count_traffic(MQTT_TRAFFIC_SHADOW, false, event->data_len);
+                handle_shadow_get_accepted(event->data, event->data_len);
+            }
+            else if (topic_is(event, TOPIC_CONTROL)) {
+                count_traffic(MQTT_TRAFFIC_CONTROL, false, event->data_len);
+                handle_control(event->data, event->data_len);
             }
             break;
             
@@ -422,9 +903,30 @@ bool mqtt_manager_init(void)
     shadow_state.overload_protection = true;
     shadow_state.energy_monitoring = true;
     
-    // Record boot time in milliseconds since boot
-    boot_time_ms = esp_timer_get_time() / 1000;
-    ESP_LOGI(TAG, "Boot time recorded: %lu ms since boot", boot_time_ms);
+    shadow_mutex = xSemaphoreCreateMutex();
+    if (!shadow_mutex) {
+        ESP_LOGE(TAG, "Failed to create shadow mutex");
+        return false;
+    }
+    shadow_sync_init();
+    
+    ack_queue = xQueueCreate(ACK_QUEUE_LEN, sizeof(outbox_ack_t));
+    if (!ack_queue) {
+        ESP_LOGE(TAG, "Failed to create ack queue");
+        return false;
+    }
+    mqtt_outbox_init(outbox_send);
+    mqtt_outbox_set_ack_handler(outbox_acked);
+    
+    mqtt_reconnect_init(esp_random);
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconnect_timer_cb,
+        .name = "mqtt_reconnect",
+    };
+    if (esp_timer_create(&timer_args, &reconnect_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create reconnect timer");
+        return false;
+    }
     
     return true;
 }
@@ -443,7 +945,8 @@ bool mqtt_manager_start(void)
         ESP_LOGI(TAG, "SNTP already initialized, skipping time sync");
     }
     
-    return mqtt_create_client();
+    // Created once and reused across reconnects
+    return mqtt_client || mqtt_create_client();
 }
 
 void mqtt_manager_stop(void)
@@ -463,106 +966,91 @@ bool mqtt_manager_connect(void)
         return false;
     }
     
-    // Check current state
-    if (current_status == MQTT_CONNECTED) {
-        ESP_LOGI(TAG, "MQTT already connected");
-        return true;
-    }
-    
-    if (current_status == MQTT_CONNECTING) {
-        ESP_LOGD(TAG, "MQTT already connecting");
-        return false;
-    }
-    
-    ESP_LOGI(TAG, "Connecting to AWS IoT...");
-    current_status = MQTT_CONNECTING;
-    reconnect_attempts++;
-    
-    esp_err_t err = esp_mqtt_client_start(mqtt_client);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(err));
-        current_status = MQTT_ERROR;
-        
-        // If client start fails, destroy it so it gets recreated next time
-        mqtt_destroy_client();
-        return false;
+    // Callers only start the state machine; it times every attempt itself
+    if (!network_up) {
+        network_up = true;
+        reconnect_post(MQTT_RECONNECT_EV_NETWORK_UP);
     }
-    
     return true;
 }
 
 void mqtt_manager_disconnect(void)
 {
+    // No further attempts until mqtt_manager_connect() or the network returns
+    network_up = false;
+    reconnect_post(MQTT_RECONNECT_EV_NETWORK_DOWN);
+    
     if (mqtt_client && current_status == MQTT_CONNECTED) {
         ESP_LOGI(TAG, "Disconnecting MQTT client...");
         
-        esp_mqtt_client_publish(mqtt_client, TOPIC_LWT,
-                                LWT_MESSAGE_DISCONNECTED, 0, 1, 1);
+        publish(MQTT_TRAFFIC_STATUS, TOPIC_LWT, LWT_MESSAGE_DISCONNECTED, 0, 1, 1);
         vTaskDelay(pdMS_TO_TICKS(100));
-        
+    }
+    
+    // Also stops a client that is still retrying
+    if (mqtt_client && client_started) {
         esp_err_t err = esp_mqtt_client_stop(mqtt_client);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to stop MQTT client: %s", esp_err_to_name(err));
         } else {
             ESP_LOGI(TAG, "MQTT client stopped");
         }
+        client_started = false;
     }
     current_status = MQTT_DISCONNECTED;
 }
 
+// Publish the fields waiting in shadow_sync; call with shadow_mutex held
+static bool shadow_flush(void)
+{
+    size_t json_len;
+    const char *json_str = shadow_sync_build(shadow_buf, sizeof(shadow_buf), &json_len,
+                                             timebase_now_ms());
+    if (!json_str) return true;
+    
+    // The client is done with the payload once publish returns
+    int msg_id = publish(MQTT_TRAFFIC_SHADOW, TOPIC_SHADOW_UPDATE, json_str, json_len, 1, 0);
+    shadow_sync_published(msg_id >= 0);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish shadow update");
+        return false;
+    }
+    
+    ESP_LOGD(TAG, "Shadow updated (%u bytes), msg_id=%d", (unsigned)json_len, msg_id);
+    return true;
+}
+
 void mqtt_manager_handle(void)
 {
-    uint32_t now = esp_timer_get_time() / 1000;
+    outbox_handle();
+    
+    // Unanswered and rejected updates are resent here rather than with the
+    // next scheduled update
+    if (mqtt_client && current_status == MQTT_CONNECTED && shadow_mutex &&
+        xSemaphoreTake(shadow_mutex, 0) == pdTRUE) {
+        if (shadow_sync_pending(timebase_now_ms())) {
+            shadow_flush();
+        }
+        xSemaphoreGive(shadow_mutex);
+    }
+    
+    // Attempts are timed by mqtt_reconnect; this only tells it when the
+    // network comes and goes (no reconnects in setup mode)
+    bool up = wifi_manager_is_connected() && !wifi_manager_is_setup_mode();
     
-    // Don't auto-reconnect in setup mode
-    if (wifi_manager_is_setup_mode()) {
-        return;
+    // The client is kept across attempts; create it if start-up could not
+    if (up && !mqtt_client && (client_wanted || !network_up)) {
+        client_wanted = false;
+        mqtt_create_client();
     }
     
-    // Reset reconnect attempts if WiFi is not connected
-    if (!wifi_manager_is_connected()) {
-        reconnect_attempts = 0;
-        return;
-    }
-    
-    // Handle different states
-    switch (current_status) {
-        case MQTT_DISCONNECTED:
-        case MQTT_ERROR:
-            // Try to reconnect
-            if (now - last_reconnect_attempt > RECONNECT_INTERVAL_MS) {
-                last_reconnect_attempt = now;
-                
-                if (reconnect_attempts < MAX_RECONNECT_ATTEMPTS) {
-                    ESP_LOGI(TAG, "Attempting MQTT reconnection (attempt %lu/%d)", 
-                             reconnect_attempts + 1, MAX_RECONNECT_ATTEMPTS);
-                    
-                    // Recreate client if it doesn't exist
-                    if (!mqtt_client) {
-                        ESP_LOGI(TAG, "Creating new MQTT client");
-                        mqtt_create_client();
-                    }
-                    
-                    if (mqtt_client) {
-                        mqtt_manager_connect();
-                    }
-                } else {
-                    // Too many attempts, reset the client completely
-                    ESP_LOGW(TAG, "Max reconnection attempts reached, resetting client");
-                    mqtt_destroy_client();
-                    reconnect_attempts = 0;
-                }
-            }
-            break;
-            
-        case MQTT_CONNECTING:
-            // Already connecting, just wait
-            break;
-            
-        case MQTT_CONNECTED:
-            // All good, reset reconnect attempts
-            reconnect_attempts = 0;
-            break;
+    // The first attempt needs a client to hand to; until one exists the
+    // network does not count as up (creation is retried on the next call)
+    if (!mqtt_client) up = false;
+    
+    if (up != network_up) {
+        network_up = up;
+        reconnect_post(up ? MQTT_RECONNECT_EV_NETWORK_UP : MQTT_RECONNECT_EV_NETWORK_DOWN);
     }
 }
 
@@ -576,129 +1064,248 @@ mqtt_status_t mqtt_manager_get_status(void)
     return current_status;
 }
 
-bool mqtt_manager_publish_telemetry(const char *json_payload)
+bool mqtt_manager_publish_telemetry(const void *payload, size_t len, payload_format_t format,
+                                    mqtt_priority_t priority)
 {
-    if (!mqtt_client || current_status != MQTT_CONNECTED) {
-        ESP_LOGW(TAG, "Cannot publish: not connected");
+    uint8_t topic = format == PAYLOAD_CBOR ? OUTBOX_TOPIC_TELEMETRY_CBOR : OUTBOX_TOPIC_TELEMETRY_JSON;
+    if (!mqtt_outbox_enqueue(topic, payload, len, priority)) {
+        ESP_LOGE(TAG, "Failed to queue telemetry");
         return false;
     }
     
-    int msg_id = esp_mqtt_client_publish(mqtt_client, TOPIC_TELEMETRY,
-                                         json_payload, 0, 0, 0);
+    ESP_LOGD(TAG, "Telemetry queued (%s, %u bytes)", payload_format_name(format), (unsigned)len);
     
-    if (msg_id < 0) {
-        ESP_LOGE(TAG, "Failed to publish telemetry");
+    // Send now rather than on the next handle() pass
+    outbox_handle();
+    return true;
+}
+
+bool mqtt_manager_publish_backlog(const char *payload, size_t len)
+{
+    if (!mqtt_outbox_enqueue(OUTBOX_TOPIC_BACKLOG, payload, len, MQTT_PRIORITY_BULK)) {
+        ESP_LOGE(TAG, "Failed to queue backlog batch");
         return false;
     }
     
-    ESP_LOGD(TAG, "Telemetry published, msg_id=%d", msg_id);
+    ESP_LOGD(TAG, "Backlog batch queued (%u bytes)", (unsigned)len);
+    
+    outbox_handle();
     return true;
 }
 
-bool mqtt_manager_update_shadow(float voltage, float current, float power,
-                                float energy, float temp, bool relay_state)
+bool mqtt_manager_publish_enf(const void *payload, size_t len, payload_format_t format)
 {
     if (!mqtt_client || current_status != MQTT_CONNECTED) {
         return false;
     }
     
-    shadow_state.voltage_reading = voltage;
-    shadow_state.current_reading = current;
-    shadow_state.power_reading = power;
-    shadow_state.energy_total = energy;
-    shadow_state.temperature = temp;
-    shadow_state.power = relay_state;
+    const stream_topics_t *t = &stream_topics[MQTT_STREAM_ENF];
+    int msg_id = publish(MQTT_TRAFFIC_ENF,
+                         format == PAYLOAD_CBOR ? t->topic_cbor : t->topic_json,
+                         payload, len, 0, 0);
     
-    if (shadow_state.last_wake_up_time == 0) {
-        shadow_state.last_wake_up_time = time(NULL);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish ENF message");
+        return false;
     }
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON *state = cJSON_AddObjectToObject(root, "state");
-    cJSON *reported = cJSON_AddObjectToObject(state, "reported");
-    
-    cJSON_AddStringToObject(reported, "welcome", "aws-iot");
-    
-    cJSON *device_details = cJSON_AddObjectToObject(reported, "device_details");
-    cJSON_AddStringToObject(device_details, "device_id", CONFIG_THING_NAME);
-    cJSON_AddStringToObject(device_details, "local_ip", wifi_manager_get_ip());
-    cJSON_AddStringToObject(device_details, "wifi_ssid", wifi_manager_get_ssid());
+    ESP_LOGD(TAG, "ENF message published (%u bytes), msg_id=%d", (unsigned)len, msg_id);
+    return true;
+}
+
+bool mqtt_manager_publish_stats(const void *payload, size_t len, payload_format_t format)
+{
+    if (!mqtt_client || current_status != MQTT_CONNECTED) {
+        return false;
+    }
     
-    cJSON *ota = cJSON_AddObjectToObject(reported, "ota");
-    cJSON_AddStringToObject(ota, "fw_version", CONFIG_FIRMWARE_VERSION);
+    // QoS 0: a lost message is superseded by the next one
+    const stream_topics_t *t = &stream_topics[MQTT_STREAM_STATS];
+    int msg_id = publish(MQTT_TRAFFIC_STATS,
+                         format == PAYLOAD_CBOR ? t->topic_cbor : t->topic_json,
+                         payload, len, 0, 0);
     
-    cJSON *diagnosis = cJSON_AddObjectToObject(reported, "device_diagnosis");
-    cJSON_AddStringToObject(diagnosis, "network", "WiFi");
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish stats");
+        return false;
+    }
     
-    // Use uint32_t for connection_attempt to avoid format issues
-    char conn_attempt_str[16];
-    snprintf(conn_attempt_str, sizeof(conn_attempt_str), "%lu", reconnect_attempts);
-    cJSON_AddStringToObject(diagnosis, "connection_attempt", conn_attempt_str);
+    ESP_LOGD(TAG, "Stats published (%u bytes), msg_id=%d", (unsigned)len, msg_id);
+    return true;
+}
+
+bool mqtt_manager_publish_schema(mqtt_stream_t stream, const char *schema)
+{
+    if (!mqtt_client || current_status != MQTT_CONNECTED || stream >= MQTT_STREAM_COUNT) {
+        return false;
+    }
     
-    time_t now = time(NULL);
-    if (now > 0) {
-        cJSON_AddNumberToObject(diagnosis, "timestamp", now);
-    } else {
-        // Time not synced, use uptime as timestamp fallback
-        cJSON_AddNumberToObject(diagnosis, "timestamp", esp_timer_get_time() / 1000000);
+    // Retained, so consumers that subscribe later can still decode
+    int msg_id = publish(MQTT_TRAFFIC_SCHEMA, stream_topics[stream].topic_schema,
+                         schema, 0, 1, 1);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Failed to publish %s schema", stream_topics[stream].name);
+        return false;
     }
     
-    // Calculate device uptime in seconds (time since last power cycle/reboot)
-    uint32_t uptime_seconds = mqtt_manager_get_uptime_seconds();
-    cJSON_AddNumberToObject(diagnosis, "last_reset", uptime_seconds);
+    ESP_LOGI(TAG, "Published %s schema", stream_topics[stream].name);
+    return true;
+}
+
+payload_format_t mqtt_manager_get_format(mqtt_stream_t stream)
+{
+    return stream < MQTT_STREAM_COUNT ? stream_format[stream] : PAYLOAD_JSON;
+}
+
+bool mqtt_manager_set_format(mqtt_stream_t stream, payload_format_t format)
+{
+    if (stream >= MQTT_STREAM_COUNT || (format != PAYLOAD_JSON && format != PAYLOAD_CBOR)) {
+        return false;
+    }
     
-    cJSON *status = cJSON_AddObjectToObject(reported, "device_status");
-    cJSON_AddStringToObject(status, "connected", 
-                           wifi_manager_is_connected() ? "true" : "false");
+    if (stream_format[stream] != format) {
+        stream_format[stream] = format;
+        ESP_LOGI(TAG, "%s encoding: %s", stream_topics[stream].name,
+                 payload_format_name(format));
+    }
+    return true;
+}
+
+uint32_t mqtt_manager_get_interval_ms(mqtt_schedule_t schedule)
+{
+    return schedule < MQTT_SCHEDULE_COUNT ? schedule_ms[schedule] : 0;
+}
+
+bool mqtt_manager_set_interval_ms(mqtt_schedule_t schedule, uint32_t interval_ms)
+{
+    bool valid;
+    switch (schedule) {
+        case MQTT_SCHEDULE_TELEMETRY:
+            valid = interval_ms >= 500 && interval_ms <= 3600000;
+            break;
+        case MQTT_SCHEDULE_SHADOW:
+            valid = interval_ms == 0 || (interval_ms >= 10000 && interval_ms <= 86400000);
+            break;
+        case MQTT_SCHEDULE_STATS:
+            valid = interval_ms >= 10000 && interval_ms <= 86400000;
+            break;
+        default:
+            valid = false;
+            break;
+    }
+    if (!valid) return false;
     
-    char rssi_str[16];
-    snprintf(rssi_str, sizeof(rssi_str), "%d", wifi_manager_get_rssi());
-    cJSON_AddStringToObject(status, "rssi", rssi_str);
+    if (schedule_ms[schedule] != interval_ms) {
+        schedule_ms[schedule] = interval_ms;
+        ESP_LOGI(TAG, "%s interval: %lu ms", schedule_names[schedule], (unsigned long)interval_ms);
+    }
+    return true;
+}
+
+void mqtt_manager_get_traffic(mqtt_traffic_stats_t *stats)
+{
+    if (!stats) return;
     
-    cJSON *meter = cJSON_AddObjectToObject(reported, "meter_details");
+    portENTER_CRITICAL(&traffic_mux);
+    memcpy(stats, traffic, sizeof(traffic));
+    portEXIT_CRITICAL(&traffic_mux);
+}
+
+void mqtt_manager_get_link_stats(mqtt_link_stats_t *stats)
+{
+    if (!stats) return;
     
-    // Convert float values to strings for JSON 
-    char str_buf[32];
-    snprintf(str_buf, sizeof(str_buf), "%.3f", current);
-    cJSON_AddStringToObject(meter, "current_reading", str_buf);
+    portENTER_CRITICAL(&link_mux);
+    *stats = link_stats;
+    mqtt_reconnect_get_stats(&stats->reconnect);
+    portEXIT_CRITICAL(&link_mux);
+    tls_transport_get_stats(&stats->tls);
+}
+
+const char *mqtt_manager_traffic_name(mqtt_traffic_t cls)
+{
+    return cls < MQTT_TRAFFIC_COUNT ? traffic_names[cls] : "unknown";
+}
+
+// Format a reading into buf (24 bytes) the same way as a JSON number
+static const char *reading_str(char *buf, float value, uint8_t decimals)
+{
+    json_writer_t num;
+    json_writer_init(&num, buf, 24);
+    json_writer_float(&num, NULL, value, decimals);
+    return json_writer_finish(&num, NULL);
+}
+
+bool mqtt_manager_update_shadow(float voltage, float current, float power,
+                                int64_t energy_uwh, float temp, bool relay_state)
+{
+    if (!mqtt_client || current_status != MQTT_CONNECTED) {
+        return false;
+    }
     
-    snprintf(str_buf, sizeof(str_buf), "%.3f", power);
-    cJSON_AddStringToObject(meter, "power_reading", str_buf);
+    shadow_state.voltage_reading = voltage;
+    shadow_state.current_reading = current;
+    shadow_state.power_reading = power;
+    shadow_state.energy_uwh = energy_uwh;
+    shadow_state.temperature = temp;
+    shadow_state.power = relay_state;
     
-    snprintf(str_buf, sizeof(str_buf), "%.3f", energy);
-    cJSON_AddStringToObject(meter, "energy_total", str_buf);
+    if (shadow_state.last_wake_up_time == 0) {
+        shadow_state.last_wake_up_time = time(NULL);
+    }
     
-    snprintf(str_buf, sizeof(str_buf), "%.3f", voltage);
-    cJSON_AddStringToObject(meter, "voltage_reading", str_buf);
+    if (!shadow_mutex || xSemaphoreTake(shadow_mutex, pdMS_TO_TICKS(100)) != pdTRUE) {
+        ESP_LOGW(TAG, "Shadow update busy, skipped");
+        return false;
+    }
     
-    snprintf(str_buf, sizeof(str_buf), "%.3f", temp);
-    cJSON_AddStringToObject(meter, "temperature", str_buf);
+    // Only fields whose text differs from the last update are published
+    shadow_sync_set_str(SHADOW_FIELD_WELCOME, "aws-iot");
+    shadow_sync_set_str(SHADOW_FIELD_DEVICE_ID, CONFIG_THING_NAME);
+    shadow_sync_set_str(SHADOW_FIELD_LOCAL_IP, wifi_manager_get_ip());
+    shadow_sync_set_str(SHADOW_FIELD_WIFI_SSID, wifi_manager_get_ssid());
+    shadow_sync_set_str(SHADOW_FIELD_FW_VERSION, CONFIG_FIRMWARE_VERSION);
+    shadow_sync_set_str(SHADOW_FIELD_NETWORK, "WiFi");
+    
+    char str_buf[24];
+    mqtt_link_stats_t link;
+    mqtt_manager_get_link_stats(&link);
+    snprintf(str_buf, sizeof(str_buf), "%lu", (unsigned long)link.reconnect.attempts);
+    shadow_sync_set_str(SHADOW_FIELD_CONNECTION_ATTEMPT, str_buf);
+    
+    // Time not synced, use uptime as timestamp fallback
+    time_t now = time(NULL);
+    shadow_sync_set_int(SHADOW_FIELD_TIMESTAMP, now > 0 ? now : timebase_uptime_s());
     
-    cJSON_AddStringToObject(reported, "relay_status", relay_state ? "true" : "false");
+    // Device uptime in seconds (time since last power cycle/reboot)
+    shadow_sync_set_int(SHADOW_FIELD_LAST_RESET, mqtt_manager_get_uptime_seconds());
     
-    cJSON *desired = cJSON_AddObjectToObject(state, "desired");
-    cJSON_AddStringToObject(desired, "welcome", "aws-iot");
-    cJSON_AddStringToObject(desired, "relay_status", relay_state ? "true" : "false");
+    shadow_sync_set_str(SHADOW_FIELD_CONNECTED, wifi_manager_is_connected() ? "true" : "false");
+    snprintf(str_buf, sizeof(str_buf), "%d", wifi_manager_get_rssi());
+    shadow_sync_set_str(SHADOW_FIELD_RSSI, str_buf);
     
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+    // Readings stay strings, as the cloud side expects
+    shadow_sync_set_str(SHADOW_FIELD_CURRENT, reading_str(str_buf, current, 3));
+    shadow_sync_set_str(SHADOW_FIELD_POWER, reading_str(str_buf, power, 3));
     
-    if (!json_str) {
-        ESP_LOGE(TAG, "Failed to create shadow JSON");
-        return false;
-    }
+    // Formatted from the integer counter so large totals keep every digit
+    json_writer_t num;
+    json_writer_init(&num, str_buf, sizeof(str_buf));
+    json_writer_fixed(&num, NULL, energy_uwh / 1000, 3);
+    shadow_sync_set_str(SHADOW_FIELD_ENERGY_TOTAL, json_writer_finish(&num, NULL));
     
-    int msg_id = esp_mqtt_client_publish(mqtt_client, TOPIC_SHADOW_UPDATE,
-                                         json_str, 0, 0, 0);
+    json_writer_init(&num, str_buf, sizeof(str_buf));
+    json_writer_int(&num, NULL, energy_uwh);
+    shadow_sync_set_str(SHADOW_FIELD_ENERGY_TOTAL_UWH, json_writer_finish(&num, NULL));
     
-    free(json_str);
+    shadow_sync_set_str(SHADOW_FIELD_VOLTAGE, reading_str(str_buf, voltage, 3));
+    shadow_sync_set_str(SHADOW_FIELD_TEMPERATURE, reading_str(str_buf, temp, 3));
+    shadow_sync_set_str(SHADOW_FIELD_RELAY_STATUS, relay_state ? "true" : "false");
     
-    if (msg_id < 0) {
-        ESP_LOGE(TAG, "Failed to publish shadow update");
-        return false;
-    }
+    bool ok = shadow_flush();
+    xSemaphoreGive(shadow_mutex);
+    if (!ok) return false;
     
-    ESP_LOGD(TAG, "Shadow updated, msg_id=%d", msg_id);
     shadow_initialized = true;
     
     if (shadow_update_callback) {
@@ -713,6 +1320,34 @@ const shadow_state_t* mqtt_manager_get_shadow_state(void)
     return &shadow_state;
 }
 
+bool mqtt_manager_shadow_pending(void)
+{
+    if (!shadow_mutex || xSemaphoreTake(shadow_mutex, 0) != pdTRUE) return false;
+    
+    bool pending = shadow_sync_pending(timebase_now_ms());
+    xSemaphoreGive(shadow_mutex);
+    return pending;
+}
+
+void mqtt_manager_get_shadow_stats(shadow_sync_stats_t *stats)
+{
+    if (!stats || !shadow_mutex) return;
+    
+    xSemaphoreTake(shadow_mutex, portMAX_DELAY);
+    shadow_sync_get_stats(stats);
+    xSemaphoreGive(shadow_mutex);
+}
+
+void mqtt_manager_set_outbox_spill(const mqtt_outbox_spill_t *spill)
+{
+    mqtt_outbox_set_spill(spill);
+}
+
+void mqtt_manager_get_outbox_stats(mqtt_outbox_stats_t *stats)
+{
+    mqtt_outbox_get_stats(stats);
+}
+
 void mqtt_manager_set_relay_callback(void (*callback)(bool state))
 {
     relay_callback = callback;
@@ -727,3 +1362,8 @@ void mqtt_manager_set_shadow_update_callback(void (*callback)(const shadow_state
 {
     shadow_update_callback = callback;
 }
+
+void mqtt_manager_set_backlog_ack_callback(void (*callback)(const void *payload, size_t len))
+{
+    backlog_ack_callback = callback;
+}
@@ -0,0 +1,402 @@
+// smart_plug/components/mqtt_manager/mqtt_outbox.c
+#include "mqtt_outbox.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "MQTT_OUTBOX";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_MQTT_OUTBOX_INFLIGHT
+#define CONFIG_MQTT_OUTBOX_INFLIGHT 4
+#endif
+
+#ifndef CONFIG_MQTT_OUTBOX_SLOTS
+#define CONFIG_MQTT_OUTBOX_SLOTS 16
+#endif
+
+#ifndef CONFIG_MQTT_OUTBOX_RAM_BYTES
+#define CONFIG_MQTT_OUTBOX_RAM_BYTES 16384
+#endif
+
+/*===============================================================================
+  Constants
+  ===============================================================================*/
+
+// Resend a message whose PUBACK never came (the client retransmits sooner
+// on its own while connected; this covers acks lost with the connection)
+#define ACK_TIMEOUT_US      30000000LL
+
+static const uint32_t rtt_bounds_ms[MQTT_OUTBOX_RTT_BUCKETS - 1] = {
+    50, 100, 200, 500, 1000, 2000, 5000
+};
+
+static const char *const rtt_names[MQTT_OUTBOX_RTT_BUCKETS] = {
+    "le_50ms", "le_100ms", "le_200ms", "le_500ms", "le_1000ms", "le_2000ms", "le_5000ms",
+    "gt_5000ms",
+};
+
+typedef enum {
+    ENTRY_FREE,
+    ENTRY_QUEUED,
+    ENTRY_INFLIGHT,
+} entry_state_t;
+
+typedef struct {
+    uint8_t *data;                  // In the arena
+    uint16_t len;
+    uint8_t topic;
+    uint8_t priority;
+    uint8_t state;
+    bool from_spill;                // RAM copy of the oldest spilled message
+    int msg_id;
+    uint32_t seq;                   // Queue order
+    int64_t sent_us;
+} entry_t;
+
+/*===============================================================================
+  Static Variables
+
+  Only used from the MQTT task, so nothing here is locked. PUBACKs reach
+  it through mqtt_manager's ack queue.
+  
+  Payloads live in a static arena and are allocated at its top. Released
+  payloads leave holes; when the top runs out the live ones are slid down
+  (the client has its own copy of anything in flight, so moving is safe).
+  ===============================================================================*/
+
+static entry_t entries[CONFIG_MQTT_OUTBOX_SLOTS];
+static uint8_t arena[CONFIG_MQTT_OUTBOX_RAM_BYTES];
+static uint32_t arena_top = 0;                  // End of the highest payload
+static uint32_t queued_bytes = 0;               // Live payload bytes
+static uint32_t next_seq = 0;
+static uint16_t inflight = 0;
+
+static mqtt_outbox_send_t send_fn = NULL;
+static const mqtt_outbox_spill_t *spill = NULL;
+static mqtt_outbox_ack_t ack_fn = NULL;
+
+static mqtt_outbox_stats_t stats;
+static uint64_t rtt_sum_ms = 0;
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static entry_t *free_slot(void)
+{
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        if (entries[i].state == ENTRY_FREE) return &entries[i];
+    }
+    return NULL;
+}
+
+static bool fits(size_t len)
+{
+    return free_slot() && queued_bytes + len <= CONFIG_MQTT_OUTBOX_RAM_BYTES;
+}
+
+static entry_t *oldest_queued(mqtt_priority_t priority)
+{
+    entry_t *oldest = NULL;
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        entry_t *e = &entries[i];
+        if (e->state != ENTRY_QUEUED || e->priority != priority) continue;
+        if (!oldest || (int32_t)(e->seq - oldest->seq) < 0) {
+            oldest = e;
+        }
+    }
+    return oldest;
+}
+
+static entry_t *find_restored(void)
+{
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        if (entries[i].state != ENTRY_FREE && entries[i].from_spill) return &entries[i];
+    }
+    return NULL;
+}
+
+static entry_t *find_inflight(int msg_id)
+{
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        if (entries[i].state == ENTRY_INFLIGHT && entries[i].msg_id == msg_id) return &entries[i];
+    }
+    return NULL;
+}
+
+// Slide the live payloads to the bottom of the arena, in address order
+static void compact(void)
+{
+    uint32_t top = 0;
+    uint8_t *floor = arena;
+    
+    for (;;) {
+        entry_t *lowest = NULL;
+        for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+            entry_t *e = &entries[i];
+            if (e->state != ENTRY_FREE && e->data >= floor && (!lowest || e->data < lowest->data)) {
+                lowest = e;
+            }
+        }
+        if (!lowest) break;
+        
+        floor = lowest->data + lowest->len;
+        memmove(arena + top, lowest->data, lowest->len);
+        lowest->data = arena + top;
+        top += lowest->len;
+    }
+    arena_top = top;
+}
+
+// Take a slot and arena space; the caller fills in the payload (fits() first)
+static entry_t *store(uint8_t topic, size_t len, mqtt_priority_t priority)
+{
+    entry_t *e = free_slot();
+    if (!e) return NULL;
+    
+    if (arena_top + len > sizeof(arena)) {
+        compact();
+    }
+    
+    e->data = arena + arena_top;
+    arena_top += len;
+    e->len = (uint16_t)len;
+    e->topic = topic;
+    e->priority = priority;
+    e->state = ENTRY_QUEUED;
+    e->from_spill = false;
+    e->msg_id = -1;
+    e->seq = next_seq++;
+    queued_bytes += len;
+    return e;
+}
+
+static void release(entry_t *e)
+{
+    if (e->state == ENTRY_INFLIGHT) inflight--;
+    queued_bytes -= e->len;
+    
+    // Cheap reclaim when the top payload goes; other holes wait for compact()
+    if (queued_bytes == 0) {
+        arena_top = 0;
+    } else if (e->data + e->len == arena + arena_top) {
+        arena_top -= e->len;
+    }
+    memset(e, 0, sizeof(*e));
+}
+
+static bool spill_message(uint8_t topic, const void *data, size_t len)
+{
+    if (spill && spill->push(topic, data, len)) {
+        stats.spilled++;
+        
+        // A push into a full ring can overwrite the message restored from it;
+        // the RAM copy is then the only one left and must not pop another
+        entry_t *e = find_restored();
+        if (e && !spill->peeked()) {
+            e->from_spill = false;
+        }
+        return true;
+    }
+    stats.dropped++;
+    return false;
+}
+
+// Make room in RAM; a restored copy is simply forgotten, it is still on flash
+static void evict(entry_t *e)
+{
+    if (!e->from_spill) {
+        spill_message(e->topic, e->data, e->len);
+    }
+    release(e);
+}
+
+// Bring the oldest spilled message back into RAM; released from flash on PUBACK
+static entry_t *restore(void)
+{
+    if (!spill) return NULL;
+    
+    uint8_t topic;
+    size_t len = spill->peek(&topic, NULL, 0);
+    if (len == 0 || !fits(len)) return NULL;
+    
+    entry_t *e = store(topic, len, MQTT_PRIORITY_BULK);
+    if (spill->peek(&topic, e->data, len) != len) {
+        release(e);
+        return NULL;
+    }
+    e->from_spill = true;
+    stats.restored++;
+    return e;
+}
+
+// Alarms first, then the oldest spilled message, then bulk (also while that one
+// is in flight, so the window stays full)
+static entry_t *next_to_send(void)
+{
+    entry_t *e = oldest_queued(MQTT_PRIORITY_ALARM);
+    if (e) return e;
+    
+    e = find_restored();
+    if (e) return e->state == ENTRY_QUEUED ? e : oldest_queued(MQTT_PRIORITY_BULK);
+    
+    e = restore();
+    return e ? e : oldest_queued(MQTT_PRIORITY_BULK);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void mqtt_outbox_init(mqtt_outbox_send_t send)
+{
+    memset(entries, 0, sizeof(entries));
+    memset(&stats, 0, sizeof(stats));
+    arena_top = 0;
+    queued_bytes = 0;
+    inflight = 0;
+    rtt_sum_ms = 0;
+    send_fn = send;
+}
+
+void mqtt_outbox_set_spill(const mqtt_outbox_spill_t *ops)
+{
+    spill = ops;
+}
+
+void mqtt_outbox_set_ack_handler(mqtt_outbox_ack_t handler)
+{
+    ack_fn = handler;
+}
+
+bool mqtt_outbox_enqueue(uint8_t topic, const void *data, size_t len, mqtt_priority_t priority)
+{
+    if (priority >= MQTT_PRIORITY_COUNT) return false;
+    
+    if (len == 0 || len > UINT16_MAX || len > CONFIG_MQTT_OUTBOX_RAM_BYTES) {
+        ESP_LOGE(TAG, "Message of %u bytes not queued", (unsigned)len);
+        stats.dropped++;
+        return false;
+    }
+    stats.enqueued[priority]++;
+    
+    // Bulk gives way first; alarms only displace older alarms
+    while (!fits(len)) {
+        entry_t *victim = oldest_queued(MQTT_PRIORITY_BULK);
+        if (!victim && priority == MQTT_PRIORITY_ALARM) {
+            victim = oldest_queued(MQTT_PRIORITY_ALARM);
+        }
+        if (!victim) break;
+        evict(victim);
+    }
+    
+    if (fits(len)) {
+        entry_t *e = store(topic, len, priority);
+        memcpy(e->data, data, len);
+        return true;
+    }
+    
+    // Everything in RAM is in flight (or more urgent)
+    return spill_message(topic, data, len);
+}
+
+void mqtt_outbox_pump(bool connected, int64_t now_us)
+{
+    if (!connected || !send_fn) return;
+    
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        entry_t *e = &entries[i];
+        if (e->state == ENTRY_INFLIGHT && now_us - e->sent_us > ACK_TIMEOUT_US) {
+            ESP_LOGW(TAG, "No PUBACK for msg_id=%d, resending", e->msg_id);
+            e->state = ENTRY_QUEUED;
+            inflight--;
+            stats.retried++;
+        }
+    }
+    
+    while (inflight < CONFIG_MQTT_OUTBOX_INFLIGHT) {
+        entry_t *e = next_to_send();
+        if (!e) break;
+        
+        int msg_id = send_fn(e->topic, e->data, e->len);
+        if (msg_id < 0) break;      // Client busy; try again on the next pump
+        
+        e->state = ENTRY_INFLIGHT;
+        e->msg_id = msg_id;
+        e->sent_us = now_us;
+        inflight++;
+        if (inflight > stats.inflight_max) {
+            stats.inflight_max = inflight;
+        }
+    }
+}
+
+void mqtt_outbox_acked(int msg_id, int64_t at_us)
+{
+    entry_t *e = find_inflight(msg_id);
+    if (!e) return;
+    
+    int64_t rtt_us = at_us - e->sent_us;
+    uint32_t rtt_ms = rtt_us > 0 ? (uint32_t)(rtt_us / 1000) : 0;
+    
+    int bucket = 0;
+    while (bucket < MQTT_OUTBOX_RTT_BUCKETS - 1 && rtt_ms > rtt_bounds_ms[bucket]) {
+        bucket++;
+    }
+    stats.rtt_hist[bucket]++;
+    if (stats.acked == 0 || rtt_ms < stats.rtt_min_ms) stats.rtt_min_ms = rtt_ms;
+    if (rtt_ms > stats.rtt_max_ms) stats.rtt_max_ms = rtt_ms;
+    rtt_sum_ms += rtt_ms;
+    stats.acked++;
+    
+    if (ack_fn) {
+        ack_fn(e->topic, e->data, e->len);
+    }
+    if (e->from_spill && spill) {
+        spill->pop();
+    }
+    release(e);
+}
+
+void mqtt_outbox_resend(int msg_id)
+{
+    entry_t *e = find_inflight(msg_id);
+    if (!e) return;
+    
+    e->state = ENTRY_QUEUED;
+    inflight--;
+    stats.retried++;
+}
+
+void mqtt_outbox_resend_all(void)
+{
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        if (entries[i].state == ENTRY_INFLIGHT) {
+            entries[i].state = ENTRY_QUEUED;
+            stats.retried++;
+        }
+    }
+    inflight = 0;
+}
+
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *out)
+{
+    if (!out) return;
+    
+    *out = stats;
+    out->queued = 0;
+    for (int i = 0; i < CONFIG_MQTT_OUTBOX_SLOTS; i++) {
+        if (entries[i].state == ENTRY_QUEUED) out->queued++;
+    }
+    out->inflight = inflight;
+    out->ram_bytes = queued_bytes;
+    out->rtt_mean_ms = stats.acked ? (uint32_t)(rtt_sum_ms / stats.acked) : 0;
+}
+
+const char *mqtt_outbox_rtt_bucket_name(int bucket)
+{
+    return bucket >= 0 && bucket < MQTT_OUTBOX_RTT_BUCKETS ? rtt_names[bucket] : "unknown";
+}
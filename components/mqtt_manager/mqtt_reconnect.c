@@ -0,0 +1,220 @@
+// smart_plug/components/mqtt_manager/mqtt_reconnect.c
+#include "mqtt_reconnect.h"
+#include <stddef.h>
+#include <string.h>
+
+// No IDF header is needed here, so sdkconfig.h must be included directly
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+
+/*===============================================================================
+  Configuration (from Kconfig; defaults for the host tests)
+  ===============================================================================*/
+
+#ifndef CONFIG_MQTT_RECONNECT_BASE_MS
+#define CONFIG_MQTT_RECONNECT_BASE_MS 1000
+#endif
+
+#ifndef CONFIG_MQTT_RECONNECT_MAX_S
+#define CONFIG_MQTT_RECONNECT_MAX_S 300
+#endif
+
+#ifndef CONFIG_MQTT_RECONNECT_STABLE_S
+#define CONFIG_MQTT_RECONNECT_STABLE_S 60
+#endif
+
+/*===============================================================================
+  Constants
+  ===============================================================================*/
+
+// An attempt with no outcome by then counts as failed (TCP, TLS and CONNACK
+// each time out well before)
+#define ATTEMPT_TIMEOUT_US  30000000LL
+
+// Timer events more than this early are left over from an earlier action
+#define TIMER_SLACK_US      1000LL
+
+#define MAX_MS              ((uint32_t)CONFIG_MQTT_RECONNECT_MAX_S * 1000)
+
+static const char *const state_names[MQTT_RECONNECT_STATE_COUNT] = {
+    [MQTT_RECONNECT_OFFLINE]    = "offline",
+    [MQTT_RECONNECT_WAITING]    = "waiting",
+    [MQTT_RECONNECT_CONNECTING] = "connecting",
+    [MQTT_RECONNECT_CONNECTED]  = "connected",
+};
+
+/*===============================================================================
+  Static Variables
+
+  Not locked; mqtt_manager serializes calls.
+  ===============================================================================*/
+
+static mqtt_reconnect_state_t state = MQTT_RECONNECT_OFFLINE;
+static int64_t deadline_us = 0;         // When the pending timer is due
+static int64_t connected_us = 0;
+static uint32_t (*random_fn)(void) = NULL;
+
+static mqtt_reconnect_stats_t stats;
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+// Base doubled once per failure in the streak, capped
+static uint32_t ceiling_ms(uint32_t streak)
+{
+    uint32_t ceiling = CONFIG_MQTT_RECONNECT_BASE_MS;
+    for (uint32_t i = 0; i < streak && ceiling < MAX_MS; i++) {
+        ceiling *= 2;
+    }
+    return ceiling < MAX_MS ? ceiling : MAX_MS;
+}
+
+static mqtt_reconnect_action_t backoff(int64_t now_us)
+{
+    uint32_t ceiling = ceiling_ms(stats.streak);
+    uint32_t delay_ms = random_fn ? random_fn() % (ceiling + 1) : ceiling;
+    
+    stats.last_delay_ms = delay_ms;
+    stats.ceiling_ms = ceiling_ms(stats.streak + 1);
+    
+    // The timer needs a non-zero period
+    int64_t delay_us = delay_ms > 0 ? (int64_t)delay_ms * 1000 : 1;
+    state = MQTT_RECONNECT_WAITING;
+    deadline_us = now_us + delay_us;
+    return (mqtt_reconnect_action_t){ .connect = false, .timer_us = delay_us };
+}
+
+static mqtt_reconnect_action_t attempt(int64_t now_us)
+{
+    stats.attempts++;
+    state = MQTT_RECONNECT_CONNECTING;
+    deadline_us = now_us + ATTEMPT_TIMEOUT_US;
+    return (mqtt_reconnect_action_t){ .connect = true, .timer_us = ATTEMPT_TIMEOUT_US };
+}
+
+// Nothing reached the broker: retry at the base delay, leaving the streak
+// and the attempt count as they were
+static mqtt_reconnect_action_t deferred(int64_t now_us)
+{
+    int64_t delay_us = (int64_t)CONFIG_MQTT_RECONNECT_BASE_MS * 1000;
+    
+    stats.attempts--;
+    state = MQTT_RECONNECT_WAITING;
+    deadline_us = now_us + delay_us;
+    return (mqtt_reconnect_action_t){ .connect = false, .timer_us = delay_us };
+}
+
+static mqtt_reconnect_action_t failed(int64_t now_us)
+{
+    stats.failed++;
+    stats.streak++;
+    if (stats.streak > stats.streak_max) {
+        stats.streak_max = stats.streak;
+    }
+    return backoff(now_us);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void mqtt_reconnect_init(uint32_t (*rng)(void))
+{
+    random_fn = rng;
+    state = MQTT_RECONNECT_OFFLINE;
+    deadline_us = 0;
+    connected_us = 0;
+    memset(&stats, 0, sizeof(stats));
+    stats.ceiling_ms = ceiling_ms(0);
+}
+
+mqtt_reconnect_action_t mqtt_reconnect_event(mqtt_reconnect_event_t event, int64_t now_us)
+{
+    const mqtt_reconnect_action_t none = { .connect = false, .timer_us = -1 };
+    const mqtt_reconnect_action_t stop = { .connect = false, .timer_us = 0 };
+    
+    switch (event) {
+        case MQTT_RECONNECT_EV_NETWORK_UP:
+            if (state != MQTT_RECONNECT_OFFLINE) return none;
+            
+            // A local outage is not the broker's fault; start from the base,
+            // still jittered since the whole site may have lost its AP
+            stats.streak = 0;
+            return backoff(now_us);
+        
+        case MQTT_RECONNECT_EV_NETWORK_DOWN:
+            if (state == MQTT_RECONNECT_CONNECTED) {
+                stats.lost++;
+            }
+            state = MQTT_RECONNECT_OFFLINE;
+            return stop;
+        
+        case MQTT_RECONNECT_EV_TIMER:
+            if (now_us < deadline_us - TIMER_SLACK_US) return none;
+            
+            if (state == MQTT_RECONNECT_WAITING) {
+                return attempt(now_us);
+            }
+            if (state == MQTT_RECONNECT_CONNECTING) {
+                stats.timeouts++;
+                return failed(now_us);
+            }
+            return none;
+        
+        case MQTT_RECONNECT_EV_START_FAILED:
+            return state == MQTT_RECONNECT_CONNECTING ? failed(now_us) : none;
+        
+        case MQTT_RECONNECT_EV_DEFERRED:
+            return state == MQTT_RECONNECT_CONNECTING ? deferred(now_us) : none;
+        
+        case MQTT_RECONNECT_EV_CONNECTED:
+            // Also taken from other states: the client is the authority
+            if (state == MQTT_RECONNECT_CONNECTED) return none;
+            stats.connected++;
+            state = MQTT_RECONNECT_CONNECTED;
+            connected_us = now_us;
+            return stop;
+        
+        case MQTT_RECONNECT_EV_DISCONNECTED:
+            if (state == MQTT_RECONNECT_CONNECTING) {
+                return failed(now_us);
+            }
+            if (state != MQTT_RECONNECT_CONNECTED) return none;
+            
+            // A connection the broker drops straight away keeps the backoff growing
+            stats.lost++;
+            if (now_us - connected_us < (int64_t)CONFIG_MQTT_RECONNECT_STABLE_S * 1000000) {
+                stats.flapped++;
+                stats.streak++;
+                if (stats.streak > stats.streak_max) {
+                    stats.streak_max = stats.streak;
+                }
+            } else {
+                stats.streak = 0;
+            }
+            return backoff(now_us);
+        
+        default:
+            return none;
+    }
+}
+
+mqtt_reconnect_state_t mqtt_reconnect_get_state(void)
+{
+    return state;
+}
+
+void mqtt_reconnect_get_stats(mqtt_reconnect_stats_t *out)
+{
+    if (!out) return;
+    
+    *out = stats;
+    out->state = state;
+}
+
+const char *mqtt_reconnect_state_name(mqtt_reconnect_state_t s)
+{
+    return s < MQTT_RECONNECT_STATE_COUNT ? state_names[s] : "unknown";
+}
@@ -0,0 +1,301 @@
+// smart_plug/components/mqtt_manager/shadow_sync.c
+#include "shadow_sync.h"
+#include "json_writer.h"
+#include "esp_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "SHADOW_SYNC";
+
+/*===============================================================================
+  Constants
+  ===============================================================================*/
+
+#define VALUE_LEN           24
+#define TOKEN_PREFIX        "sp-"
+
+// Resend the fields of an update nobody answered
+#define RESPONSE_TIMEOUT_MS 10000
+
+// Least time between an update and the resend of its rejected fields
+#define RETRY_DELAY_MS      2000
+
+#define FIELD_BIT(f)        (1UL << (f))
+
+_Static_assert(SHADOW_FIELD_COUNT <= 32, "field masks are 32 bits");
+
+typedef struct {
+    const char *group;                  // Enclosing object under reported, or NULL
+    const char *key;
+    bool number;                        // Written as a JSON number, else a string
+} field_desc_t;
+
+static const field_desc_t fields[SHADOW_FIELD_COUNT] = {
+    [SHADOW_FIELD_WELCOME]            = { NULL, "welcome", false },
+    [SHADOW_FIELD_DEVICE_ID]          = { "device_details", "device_id", false },
+    [SHADOW_FIELD_LOCAL_IP]           = { "device_details", "local_ip", false },
+    [SHADOW_FIELD_WIFI_SSID]          = { "device_details", "wifi_ssid", false },
+    [SHADOW_FIELD_FW_VERSION]         = { "ota", "fw_version", false },
+    [SHADOW_FIELD_NETWORK]            = { "device_diagnosis", "network", false },
+    [SHADOW_FIELD_CONNECTION_ATTEMPT] = { "device_diagnosis", "connection_attempt", false },
+    [SHADOW_FIELD_TIMESTAMP]          = { "device_diagnosis", "timestamp", true },
+    [SHADOW_FIELD_LAST_RESET]         = { "device_diagnosis", "last_reset", true },
+    [SHADOW_FIELD_CONNECTED]          = { "device_status", "connected", false },
+    [SHADOW_FIELD_RSSI]               = { "device_status", "rssi", false },
+    [SHADOW_FIELD_CURRENT]            = { "meter_details", "current_reading", false },
+    [SHADOW_FIELD_POWER]              = { "meter_details", "power_reading", false },
+    [SHADOW_FIELD_ENERGY_TOTAL]       = { "meter_details", "energy_total", false },
+    [SHADOW_FIELD_ENERGY_TOTAL_UWH]   = { "meter_details", "energy_total_uwh", false },
+    [SHADOW_FIELD_VOLTAGE]            = { "meter_details", "voltage_reading", false },
+    [SHADOW_FIELD_TEMPERATURE]        = { "meter_details", "temperature", false },
+    [SHADOW_FIELD_RELAY_STATUS]       = { NULL, "relay_status", false },
+};
+
+/*===============================================================================
+  Static Variables
+
+  Not locked: mqtt_manager serializes every call under its shadow mutex.
+  ===============================================================================*/
+
+static char text[SHADOW_FIELD_COUNT][VALUE_LEN];
+static int64_t number[SHADOW_FIELD_COUNT];
+static uint32_t set_mask;               // Fields given a value at least once
+static uint32_t dirty_mask;             // Changed since last published
+static uint32_t inflight_mask;          // Published, waiting for update/accepted
+static uint32_t built_mask;             // In the last built document
+static uint32_t confirmed_mask;         // Values the shadow held at stats.version
+static bool full_pending;               // Next update is the complete document
+static bool awaiting_get;               // Session started, get/accepted not seen yet
+static int64_t session_ms;
+
+static uint32_t token_seq;
+static char token[16];
+static int64_t sent_ms;
+
+static shadow_sync_stats_t stats;
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static void mark(shadow_field_t field, bool changed)
+{
+    uint32_t bit = FIELD_BIT(field);
+    if (changed || !(set_mask & bit)) {
+        dirty_mask |= bit;
+        confirmed_mask &= ~bit;
+    }
+    set_mask |= bit;
+}
+
+static void see_version(int64_t version)
+{
+    if (version > stats.version) {
+        stats.version = version;
+    }
+}
+
+static bool is_our_token(const char *tok, size_t len)
+{
+    size_t n = strlen(token);
+    return n > 0 && len == n && memcmp(tok, token, n) == 0;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+void shadow_sync_init(void)
+{
+    memset(text, 0, sizeof(text));
+    memset(number, 0, sizeof(number));
+    memset(&stats, 0, sizeof(stats));
+    set_mask = 0;
+    confirmed_mask = 0;
+    token_seq = 0;
+    stats.version = -1;
+    shadow_sync_reset(0);
+}
+
+void shadow_sync_reset(int64_t now_ms)
+{
+    dirty_mask = set_mask;
+    inflight_mask = 0;
+    built_mask = 0;
+    full_pending = true;
+    awaiting_get = true;
+    session_ms = now_ms;
+    token[0] = '\0';
+}
+
+void shadow_sync_set_str(shadow_field_t field, const char *value)
+{
+    if (field >= SHADOW_FIELD_COUNT) return;
+    if (!value) value = "";
+    
+    bool changed = strncmp(text[field], value, VALUE_LEN - 1) != 0;
+    if (changed) {
+        strncpy(text[field], value, VALUE_LEN - 1);
+        text[field][VALUE_LEN - 1] = '\0';
+    }
+    mark(field, changed);
+}
+
+void shadow_sync_set_int(shadow_field_t field, int64_t value)
+{
+    if (field >= SHADOW_FIELD_COUNT) return;
+    
+    bool changed = number[field] != value;
+    number[field] = value;
+    mark(field, changed);
+}
+
+bool shadow_sync_pending(int64_t now_ms)
+{
+    if (inflight_mask && now_ms - sent_ms > RESPONSE_TIMEOUT_MS) return true;
+    if (!(dirty_mask & set_mask)) return false;
+    if (awaiting_get) return now_ms - session_ms > RESPONSE_TIMEOUT_MS;
+    return now_ms - sent_ms >= RETRY_DELAY_MS;
+}
+
+const char *shadow_sync_build(char *buf, size_t size, size_t *len, int64_t now_ms)
+{
+    if (inflight_mask && now_ms - sent_ms > RESPONSE_TIMEOUT_MS) {
+        ESP_LOGW(TAG, "No response to update %s, resending its fields", token);
+        dirty_mask |= inflight_mask;
+        inflight_mask = 0;
+        stats.timeouts++;
+    }
+    
+    // The version in get/accepted decides whether the complete document is needed
+    if (awaiting_get) {
+        if (now_ms - session_ms <= RESPONSE_TIMEOUT_MS) return NULL;
+        ESP_LOGW(TAG, "No shadow version, sending the complete document");
+        awaiting_get = false;
+    }
+    
+    uint32_t send = dirty_mask & set_mask;
+    if (!send) return NULL;
+    
+    json_writer_t w;
+    json_writer_init(&w, buf, size);
+    json_writer_begin_object(&w, NULL);
+    json_writer_begin_object(&w, "state");
+    json_writer_begin_object(&w, "reported");
+    
+    const char *group = NULL;
+    for (int f = 0; f < SHADOW_FIELD_COUNT; f++) {
+        if (!(send & FIELD_BIT(f))) continue;
+        
+        if (fields[f].group != group) {
+            if (group) json_writer_end_object(&w);
+            group = fields[f].group;
+            if (group) json_writer_begin_object(&w, group);
+        }
+        
+        if (fields[f].number) {
+            json_writer_int(&w, fields[f].key, number[f]);
+        } else {
+            json_writer_string(&w, fields[f].key, text[f]);
+        }
+    }
+    if (group) json_writer_end_object(&w);
+    json_writer_end_object(&w);
+    
+    // A local relay change supersedes any command still in desired
+    bool clear_desired = !full_pending && (send & FIELD_BIT(SHADOW_FIELD_RELAY_STATUS));
+    if (clear_desired) {
+        json_writer_begin_object(&w, "desired");
+        json_writer_null(&w, "relay_status");
+        json_writer_end_object(&w);
+    }
+    json_writer_end_object(&w);
+    
+    char next_token[sizeof(token)];
+    snprintf(next_token, sizeof(next_token), TOKEN_PREFIX "%lu", (unsigned long)(token_seq + 1));
+    json_writer_string(&w, "clientToken", next_token);
+    json_writer_end_object(&w);
+    
+    const char *doc = json_writer_finish(&w, len);
+    if (!doc) {
+        ESP_LOGE(TAG, "Shadow update exceeds %u bytes", (unsigned)size);
+        return NULL;
+    }
+    
+    token_seq++;
+    strcpy(token, next_token);
+    built_mask = send;
+    dirty_mask &= ~send;
+    sent_ms = now_ms;
+    return doc;
+}
+
+void shadow_sync_published(bool ok)
+{
+    if (!built_mask) return;
+    
+    if (!ok) {
+        dirty_mask |= built_mask;
+        built_mask = 0;
+        return;
+    }
+    
+    int sent = __builtin_popcount(built_mask);
+    stats.updates++;
+    stats.fields_sent += sent;
+    stats.fields_skipped += SHADOW_FIELD_COUNT - sent;
+    if (full_pending) {
+        stats.full_updates++;
+        full_pending = false;
+    }
+    
+    inflight_mask |= built_mask;
+    built_mask = 0;
+}
+
+void shadow_sync_accepted(const char *tok, size_t token_len, int64_t version, bool reported)
+{
+    see_version(version);
+    
+    // Earlier updates are covered by the latest one being accepted
+    if (tok && is_our_token(tok, token_len)) {
+        confirmed_mask |= inflight_mask & ~dirty_mask;
+        inflight_mask = 0;
+        stats.accepted++;
+    } else if (reported && !(tok && token_len >= sizeof(TOKEN_PREFIX) - 1 &&
+                             memcmp(tok, TOKEN_PREFIX, sizeof(TOKEN_PREFIX) - 1) == 0)) {
+        // Another client wrote reported: what it holds is no longer known
+        confirmed_mask = 0;
+    }
+}
+
+void shadow_sync_rejected(const char *tok, size_t token_len)
+{
+    if (!tok || token_len < sizeof(TOKEN_PREFIX) - 1 ||
+        memcmp(tok, TOKEN_PREFIX, sizeof(TOKEN_PREFIX) - 1) != 0) {
+        return;
+    }
+    
+    ESP_LOGW(TAG, "Update %.*s rejected, resending its fields", (int)token_len, tok);
+    dirty_mask |= inflight_mask;
+    inflight_mask = 0;
+    stats.rejected++;
+}
+
+void shadow_sync_set_version(int64_t version)
+{
+    // Unchanged since our last accepted update: only the fields changed
+    // meanwhile need sending, not the complete document
+    if (awaiting_get && version >= 0 && version == stats.version && confirmed_mask) {
+        dirty_mask &= ~confirmed_mask;
+        full_pending = false;
+        stats.resumed++;
+    }
+    awaiting_get = false;
+    see_version(version);
+}
+
+void shadow_sync_get_stats(shadow_sync_stats_t *out)
+{
+    if (out) *out = stats;
+}
@@ -0,0 +1,435 @@
+// smart_plug/components/mqtt_manager/tls_transport.c
+#include "tls_transport.h"
+#include <string.h>
+#include <stddef.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_rom_crc.h"
+#include "esp_tls.h"
+#include "timebase.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/sockets.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/net_sockets.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/x509_crt.h"
+#include "mbedtls/pk.h"
+
+static const char *TAG = "TLS_TRANSPORT";
+
+/*===============================================================================
+  RTC Session Cache
+
+  Same scheme as rtc_state: RTC slow memory without initialisation, checked
+  by CRC, ignored after power-on. Holds the session serialized by mbedTLS,
+  which stays small as long as the peer certificate is not kept
+  (CONFIG_MBEDTLS_SSL_KEEP_PEER_CERTIFICATE=n).
+  ===============================================================================*/
+
+#define RTC_SESSION_MAGIC   0x544C5353  // "TLSS"
+#define RTC_SESSION_BYTES   1024
+
+typedef struct {
+    uint32_t magic;
+    uint32_t len;
+    uint8_t data[RTC_SESSION_BYTES];
+    uint32_t crc;           // CRC32 of the fields above
+} rtc_session_t;
+
+static RTC_NOINIT_ATTR rtc_session_t rtc_session;
+
+/*===============================================================================
+  Static Variables
+
+  The transport is only driven from the esp-mqtt task; the statistics and
+  the session flags are also read from the MQTT task, so they are written
+  under stats_mux.
+  ===============================================================================*/
+
+// Parsed on the first connect (esp-mqtt task stack), shared by every connection
+static tls_transport_config_t certs;
+static bool have_certs = false;
+static bool configured = false;
+static mbedtls_ssl_config ssl_conf;
+static mbedtls_x509_crt ca_cert;
+static mbedtls_x509_crt client_cert;
+static mbedtls_pk_context client_key;
+static mbedtls_entropy_context entropy;
+static mbedtls_ctr_drbg_context ctr_drbg;
+
+// Current connection
+static mbedtls_ssl_context ssl;
+static mbedtls_net_context net;
+static bool conn_open = false;
+
+// Certificates are only verified in a full handshake
+static bool peer_verified = false;
+
+static mbedtls_ssl_session session;
+static bool have_session = false;
+
+static tls_transport_stats_t stats;
+static uint64_t full_sum_ms = 0;
+static uint64_t resumed_sum_ms = 0;
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/*===============================================================================
+  Session Cache
+  ===============================================================================*/
+
+static void set_have_session(bool cached, bool from_rtc)
+{
+    portENTER_CRITICAL(&stats_mux);
+    have_session = cached;
+    if (from_rtc) stats.session_from_rtc = true;
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+static uint32_t rtc_session_crc(void)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)&rtc_session, offsetof(rtc_session_t, crc));
+}
+
+static void session_clear(void)
+{
+    if (have_session) {
+        set_have_session(false, false);
+        mbedtls_ssl_session_free(&session);
+    }
+    rtc_session.magic = 0;
+}
+
+static void session_save(void)
+{
+    session_clear();
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_get_session(&ssl, &session) != 0) {
+        mbedtls_ssl_session_free(&session);
+        return;
+    }
+    set_have_session(true, false);
+    
+    size_t len = 0;
+    int ret = mbedtls_ssl_session_save(&session, rtc_session.data, sizeof(rtc_session.data), &len);
+    if (ret != 0) {
+        ESP_LOGW(TAG, "Session not kept in RTC memory: -0x%04x", -ret);
+        return;
+    }
+    rtc_session.len = len;
+    rtc_session.magic = RTC_SESSION_MAGIC;
+    rtc_session.crc = rtc_session_crc();
+}
+
+static void session_restore(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_UNKNOWN) {
+        rtc_session.magic = 0;
+        return;
+    }
+    
+    if (rtc_session.magic != RTC_SESSION_MAGIC || rtc_session.len > sizeof(rtc_session.data) ||
+        rtc_session.crc != rtc_session_crc()) {
+        return;
+    }
+    
+    // Also rejects sessions saved by a build with different TLS options
+    mbedtls_ssl_session_init(&session);
+    if (mbedtls_ssl_session_load(&session, rtc_session.data, rtc_session.len) != 0) {
+        mbedtls_ssl_session_free(&session);
+        rtc_session.magic = 0;
+        return;
+    }
+    set_have_session(true, true);
+    ESP_LOGI(TAG, "TLS session restored from RTC memory");
+}
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+static int verify_cb(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    peer_verified = true;
+    return 0;               // Leave the verdict in flags to mbedTLS
+}
+
+static bool configure(const tls_transport_config_t *config)
+{
+    mbedtls_ssl_config_init(&ssl_conf);
+    mbedtls_x509_crt_init(&ca_cert);
+    mbedtls_x509_crt_init(&client_cert);
+    mbedtls_pk_init(&client_key);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    
+    // PEM lengths must include the terminating NUL
+    int ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, NULL, 0);
+    if (ret == 0) {
+        ret = mbedtls_x509_crt_parse(&ca_cert, (const unsigned char *)config->ca_cert,
+                                     config->ca_cert_len + 1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_x509_crt_parse(&client_cert, (const unsigned char *)config->client_cert,
+                                     config->client_cert_len + 1);
+    }
+    if (ret == 0) {
+        ret = mbedtls_pk_parse_key(&client_key, (const unsigned char *)config->client_key,
+                                   config->client_key_len + 1, NULL, 0,
+                                   mbedtls_ctr_drbg_random, &ctr_drbg);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ssl_config_defaults(&ssl_conf, MBEDTLS_SSL_IS_CLIENT,
+                                          MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret == 0) {
+        ret = mbedtls_ssl_conf_own_cert(&ssl_conf, &client_cert, &client_key);
+    }
+    if (ret != 0) {
+        ESP_LOGE(TAG, "TLS setup failed: -0x%04x", -ret);
+        mbedtls_ssl_config_free(&ssl_conf);
+        mbedtls_x509_crt_free(&ca_cert);
+        mbedtls_x509_crt_free(&client_cert);
+        mbedtls_pk_free(&client_key);
+        mbedtls_ctr_drbg_free(&ctr_drbg);
+        mbedtls_entropy_free(&entropy);
+        return false;
+    }
+    
+    mbedtls_ssl_conf_authmode(&ssl_conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&ssl_conf, &ca_cert, NULL);
+    mbedtls_ssl_conf_rng(&ssl_conf, mbedtls_ctr_drbg_random, &ctr_drbg);
+    mbedtls_ssl_conf_verify(&ssl_conf, verify_cb, NULL);
+    mbedtls_ssl_conf_session_tickets(&ssl_conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+    
+    session_restore();
+    return true;
+}
+
+static void count_handshake(bool ok, bool resumed, uint32_t ms)
+{
+    portENTER_CRITICAL(&stats_mux);
+    if (!ok) {
+        stats.failed++;
+    } else if (resumed) {
+        stats.resumed++;
+        stats.resumed_ms = ms;
+        resumed_sum_ms += ms;
+    } else {
+        stats.full++;
+        stats.full_ms = ms;
+        full_sum_ms += ms;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+// Failures that say nothing about the session: the network or the clock
+// ended the handshake, not the broker
+static bool transport_failure(int ret)
+{
+    switch (ret) {
+        case MBEDTLS_ERR_SSL_WANT_READ:
+        case MBEDTLS_ERR_SSL_WANT_WRITE:
+        case MBEDTLS_ERR_SSL_TIMEOUT:
+        case MBEDTLS_ERR_NET_SEND_FAILED:
+        case MBEDTLS_ERR_NET_RECV_FAILED:
+        case MBEDTLS_ERR_NET_CONN_RESET:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// >0 ready, 0 timeout, <0 error
+static int poll_socket(bool write, int timeout_ms)
+{
+    fd_set ready;
+    fd_set errors;
+    FD_ZERO(&ready);
+    FD_ZERO(&errors);
+    FD_SET(net.fd, &ready);
+    FD_SET(net.fd, &errors);
+    
+    struct timeval tv = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+    int ret = select(net.fd + 1, write ? NULL : &ready, write ? &ready : NULL, &errors,
+                     timeout_ms >= 0 ? &tv : NULL);
+    if (ret > 0 && FD_ISSET(net.fd, &errors)) {
+        return -1;
+    }
+    return ret;
+}
+
+/*===============================================================================
+  Transport Functions
+  ===============================================================================*/
+
+static int tls_close(esp_transport_handle_t t)
+{
+    if (!conn_open) return 0;
+    
+    mbedtls_ssl_close_notify(&ssl);
+    mbedtls_ssl_free(&ssl);
+    mbedtls_net_free(&net);
+    conn_open = false;
+    return 0;
+}
+
+static int tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    tls_close(t);
+    if (!configured) {
+        if (!configure(&certs)) {
+            count_handshake(false, false, 0);
+            return -1;
+        }
+        configured = true;
+    }
+    int64_t start_us = timebase_now_us();
+    
+    esp_tls_cfg_t tcp_cfg = { .timeout_ms = timeout_ms };
+    esp_tls_last_error_t tcp_error = {0};
+    int fd = -1;
+    if (esp_tls_plain_tcp_connect(host, strlen(host), port, &tcp_cfg, &tcp_error, &fd) != ESP_OK) {
+        ESP_LOGE(TAG, "TCP connect to %s:%d failed", host, port);
+        count_handshake(false, false, 0);
+        return -1;
+    }
+    
+    mbedtls_net_init(&net);
+    net.fd = fd;
+    mbedtls_ssl_init(&ssl);
+    conn_open = true;
+    
+    bool offered = have_session;
+    int ret = mbedtls_ssl_setup(&ssl, &ssl_conf);
+    if (ret == 0) ret = mbedtls_ssl_set_hostname(&ssl, host);
+    if (ret == 0 && offered) ret = mbedtls_ssl_set_session(&ssl, &session);
+    
+    if (ret == 0) {
+        mbedtls_ssl_set_bio(&ssl, &net, mbedtls_net_send, mbedtls_net_recv, NULL);
+        
+        // The socket has send and receive timeouts; bound the whole handshake too
+        peer_verified = false;
+        do {
+            ret = mbedtls_ssl_handshake(&ssl);
+        } while ((ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) &&
+                 timebase_now_us() - start_us < (int64_t)timeout_ms * 1000);
+    }
+    
+    if (ret != 0) {
+        ESP_LOGE(TAG, "TLS handshake with %s failed: -0x%04x", host, -ret);
+        count_handshake(false, false, 0);
+        tls_close(t);
+        
+        // A session the broker rejected must not fail the next attempt too;
+        // one cut short by the network or the timeout is still good
+        if (offered && !transport_failure(ret)) session_clear();
+        return -1;
+    }
+    
+    uint32_t ms = (uint32_t)((timebase_now_us() - start_us) / 1000);
+    bool resumed = offered && !peer_verified;
+    count_handshake(true, resumed, ms);
+    ESP_LOGI(TAG, "TLS %s handshake in %lu ms", resumed ? "resumed" : "full", (unsigned long)ms);
+    
+    // Keep the latest ticket; the broker may have issued a new one
+    session_save();
+    return 0;
+}
+
+static int tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    if (!conn_open) return -1;
+    if (mbedtls_ssl_get_bytes_avail(&ssl) > 0) return 1;
+    return poll_socket(false, timeout_ms);
+}
+
+static int tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    if (!conn_open) return -1;
+    return poll_socket(true, timeout_ms);
+}
+
+static int tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    if (!conn_open) return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    
+    if (mbedtls_ssl_get_bytes_avail(&ssl) == 0) {
+        int ready = poll_socket(false, timeout_ms);
+        if (ready <= 0) return ready;
+    }
+    
+    int ret = mbedtls_ssl_read(&ssl, (unsigned char *)buffer, len);
+    if (ret > 0) return ret;
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0 || ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+    ESP_LOGE(TAG, "TLS read failed: -0x%04x", -ret);
+    return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+}
+
+static int tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    if (!conn_open) return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    
+    int ready = tls_poll_write(t, timeout_ms);
+    if (ready <= 0) return ready;
+    
+    int ret = mbedtls_ssl_write(&ssl, (const unsigned char *)buffer, len);
+    if (ret >= 0) return ret;
+    if (ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    ESP_LOGE(TAG, "TLS write failed: -0x%04x", -ret);
+    return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+}
+
+// Certificates and the session outlive the handle; a new client reuses them
+static int tls_destroy(esp_transport_handle_t t)
+{
+    return tls_close(t);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+esp_transport_handle_t tls_transport_create(const tls_transport_config_t *config)
+{
+    if (!have_certs) {
+        if (!config) return NULL;
+        certs = *config;
+        have_certs = true;
+    }
+    
+    esp_transport_handle_t t = esp_transport_init();
+    if (!t) {
+        ESP_LOGE(TAG, "Failed to create transport");
+        return NULL;
+    }
+    esp_transport_set_func(t, tls_connect, tls_read, tls_write, tls_close,
+                           tls_poll_read, tls_poll_write, tls_destroy);
+    esp_transport_set_default_port(t, 8883);
+    return t;
+}
+
+void tls_transport_get_stats(tls_transport_stats_t *out)
+{
+    if (!out) return;
+    
+    portENTER_CRITICAL(&stats_mux);
+    *out = stats;
+    out->full_mean_ms = stats.full ? (uint32_t)(full_sum_ms / stats.full) : 0;
+    out->resumed_mean_ms = stats.resumed ? (uint32_t)(resumed_sum_ms / stats.resumed) : 0;
+    out->session_cached = have_session;
+    portEXIT_CRITICAL(&stats_mux);
+}
@@ -0,0 +1,377 @@
+// smart_plug/components/storage/energy_journal.c
+#include "energy_journal.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "ENERGY_JRNL";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_ENERGY_JOURNAL_PARTITION_LABEL
+#define CONFIG_ENERGY_JOURNAL_PARTITION_LABEL "energy"
+#endif
+
+#ifndef CONFIG_ENERGY_JOURNAL_WRITES_PER_HOUR
+#define CONFIG_ENERGY_JOURNAL_WRITES_PER_HOUR 60
+#endif
+
+/*===============================================================================
+  Flash Layout
+
+  The partition is a ring of 4 KB sectors, each holding 128 fixed 32-byte
+  records written in sequence order. When the last slot of a sector is
+  written the next sector is erased straight away, so the next write always
+  lands on an erased slot.
+  ===============================================================================*/
+
+#define EJ_SECTOR_SIZE          4096
+#define EJ_ERASED_SEQ           0xFFFFFFFF
+#define EJ_ENDURANCE_CYCLES     100000
+
+typedef struct __attribute__((packed)) {
+    uint32_t seq;           // Monotonic sequence number (0xFFFFFFFF = erased)
+    int64_t energy_uwh;     // Cumulative energy (micro-Wh)
+    uint32_t timestamp;     // Epoch seconds
+    uint32_t uptime_s;      // Seconds since boot when written
+    uint8_t relay_on;
+    uint8_t reason;
+    uint8_t reserved[2];    // Left erased
+    uint32_t latency_us;    // POWER_LOSS: interrupt to handler start
+    uint32_t crc;           // CRC32 of the fields above
+} ej_slot_t;
+
+_Static_assert(sizeof(ej_slot_t) == 32, "journal slot must be 32 bytes");
+
+#define EJ_SLOTS_PER_SECTOR     (EJ_SECTOR_SIZE / sizeof(ej_slot_t))
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+static const esp_partition_t *partition = NULL;
+static SemaphoreHandle_t journal_mutex = NULL;
+static uint32_t sector_count = 0;
+
+static uint32_t head_sector = 0;        // Sector of the next write
+static uint32_t head_slot = 0;          // Slot of the next write
+static uint32_t next_seq = 1;
+
+static energy_journal_entry_t latest;
+static bool have_latest = false;
+
+static bool head_needs_erase = false;  // Head sector still has to be erased
+
+static int64_t last_periodic_us = 0;
+static bool periodic_written = false;
+
+static energy_journal_stats_t stats = {0};
+
+/*===============================================================================
+  Flash Helpers
+  ===============================================================================*/
+
+static uint32_t slot_crc(const ej_slot_t *slot)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)slot, offsetof(ej_slot_t, crc));
+}
+
+static size_t slot_offset(uint32_t sector, uint32_t slot)
+{
+    return (size_t)sector * EJ_SECTOR_SIZE + (size_t)slot * sizeof(ej_slot_t);
+}
+
+static bool read_slot(uint32_t sector, uint32_t slot, ej_slot_t *out)
+{
+    stats.mount_reads++;
+    return esp_partition_read(partition, slot_offset(sector, slot), out, sizeof(*out)) == ESP_OK;
+}
+
+static bool slot_valid(const ej_slot_t *slot)
+{
+    return slot->seq != EJ_ERASED_SEQ && slot->crc == slot_crc(slot);
+}
+
+static bool slot_erased(uint32_t sector, uint32_t slot)
+{
+    ej_slot_t raw;
+    if (!read_slot(sector, slot, &raw)) return false;
+    
+    const uint8_t *p = (const uint8_t *)&raw;
+    for (size_t i = 0; i < sizeof(raw); i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static bool erase_sector(uint32_t sector)
+{
+    esp_err_t err = esp_partition_erase_range(partition, (size_t)sector * EJ_SECTOR_SIZE,
+                                              EJ_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of sector %lu failed: %s", (unsigned long)sector, esp_err_to_name(err));
+        stats.write_errors++;
+        return false;
+    }
+    stats.sectors_erased++;
+    return true;
+}
+
+// First erased slot in a sector (slots are filled in order)
+static uint32_t used_slots(uint32_t sector)
+{
+    uint32_t lo = 0, hi = EJ_SLOTS_PER_SECTOR;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        ej_slot_t slot;
+        if (!read_slot(sector, mid, &slot) || slot.seq == EJ_ERASED_SEQ) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+static void slot_to_entry(const ej_slot_t *slot, energy_journal_entry_t *entry)
+{
+    entry->seq = slot->seq;
+    entry->energy_uwh = slot->energy_uwh;
+    entry->timestamp = slot->timestamp;
+    entry->relay_on = slot->relay_on != 0;
+    entry->reason = (energy_journal_reason_t)slot->reason;
+    entry->latency_us = (slot->latency_us == 0xFFFFFFFF) ? 0 : slot->latency_us;
+}
+
+// Newest valid record at or before (sector, count-1), looking back one sector at most
+static bool find_latest(uint32_t sector, uint32_t count)
+{
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t s = count; s > 0; s--) {
+            ej_slot_t slot;
+            if (!read_slot(sector, s - 1, &slot)) continue;
+            if (slot_valid(&slot)) {
+                slot_to_entry(&slot, &latest);
+                return true;
+            }
+            stats.torn_records++;
+        }
+        sector = (sector + sector_count - 1) % sector_count;
+        count = EJ_SLOTS_PER_SECTOR;
+    }
+    return false;
+}
+
+/*===============================================================================
+  Write Path
+  ===============================================================================*/
+
+// Program the head slot. With defer_erase the next sector is
+// only marked for erasing, so an urgent write never waits behind an erase.
+static bool write_record(int64_t energy_uwh, bool relay_on, uint32_t timestamp,
+                         energy_journal_reason_t reason, uint32_t latency_us, bool defer_erase)
+{
+    int64_t now_us = esp_timer_get_time();
+    
+    if (head_slot == 0 && head_needs_erase) {
+        if (defer_erase) return false;
+        head_needs_erase = !erase_sector(head_sector);
+        if (head_needs_erase) return false;
+    }
+    
+    ej_slot_t slot;
+    memset(&slot, 0xFF, sizeof(slot));
+    slot.seq = next_seq;
+    slot.energy_uwh = energy_uwh;
+    slot.timestamp = timestamp;
+    slot.uptime_s = now_us / 1000000;
+    slot.relay_on = relay_on ? 1 : 0;
+    slot.reason = reason;
+    slot.latency_us = latency_us;
+    slot.crc = slot_crc(&slot);
+    
+    esp_err_t err = esp_partition_write(partition, slot_offset(head_sector, head_slot),
+                                        &slot, sizeof(slot));
+    
+    int64_t written_us = esp_timer_get_time();
+    
+    // The slot is consumed even if the write failed
+    head_slot++;
+    if (head_slot >= EJ_SLOTS_PER_SECTOR) {
+        head_sector = (head_sector + 1) % sector_count;
+        head_slot = 0;
+        head_needs_erase = defer_erase || !erase_sector(head_sector);
+    }
+    
+    bool ok = (err == ESP_OK);
+    if (ok) {
+        next_seq++;
+        slot_to_entry(&slot, &latest);
+        have_latest = true;
+        stats.records_written++;
+        if (reason == ENERGY_JOURNAL_PERIODIC) {
+            last_periodic_us = now_us;
+            periodic_written = true;
+        }
+    } else {
+        ESP_LOGE(TAG, "Write failed: %s", esp_err_to_name(err));
+        stats.write_errors++;
+    }
+    
+    stats.last_write_us = written_us - now_us;
+    if (stats.last_write_us > stats.max_write_us) {
+        stats.max_write_us = stats.last_write_us;
+    }
+    return ok;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool energy_journal_init(void)
+{
+    int64_t start = esp_timer_get_time();
+    
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         CONFIG_ENERGY_JOURNAL_PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGE(TAG, "Partition '%s' not found", CONFIG_ENERGY_JOURNAL_PARTITION_LABEL);
+        return false;
+    }
+    
+    sector_count = partition->size / EJ_SECTOR_SIZE;
+    if (sector_count < 2) {
+        ESP_LOGE(TAG, "Partition too small (%lu bytes)", (unsigned long)partition->size);
+        partition = NULL;
+        return false;
+    }
+    
+    if (!journal_mutex) {
+        journal_mutex = xSemaphoreCreateMutex();
+    }
+    
+    // Newest sector = highest sequence number in slot 0
+    uint32_t max_seq = 0;
+    bool found = false;
+    for (uint32_t s = 0; s < sector_count; s++) {
+        ej_slot_t slot;
+        if (read_slot(s, 0, &slot) && slot_valid(&slot) && (!found || slot.seq > max_seq)) {
+            max_seq = slot.seq;
+            head_sector = s;
+            found = true;
+        }
+    }
+    
+    have_latest = false;
+    if (found) {
+        head_slot = used_slots(head_sector);
+        have_latest = find_latest(head_sector, head_slot);
+        next_seq = (have_latest ? latest.seq : max_seq) + 1;
+    } else {
+        head_sector = 0;
+        head_slot = 0;
+        next_seq = 1;
+    }
+    
+    // Skip slots left dirty by an interrupted write
+    while (head_slot < EJ_SLOTS_PER_SECTOR && !slot_erased(head_sector, head_slot)) {
+        head_slot++;
+    }
+    if (head_slot >= EJ_SLOTS_PER_SECTOR) {
+        head_sector = (head_sector + 1) % sector_count;
+        head_slot = 0;
+    }
+    head_needs_erase = false;
+    if (head_slot == 0 && !slot_erased(head_sector, 0)) {
+        head_needs_erase = !erase_sector(head_sector);
+    }
+    
+    stats.mount_time_us = esp_timer_get_time() - start;
+    
+    if (have_latest) {
+        ESP_LOGI(TAG, "Mounted '%s': seq %lu, %lld uWh, relay %s (%lu reads, %lu us)",
+                 partition->label, (unsigned long)latest.seq, (long long)latest.energy_uwh,
+                 latest.relay_on ? "ON" : "OFF", (unsigned long)stats.mount_reads,
+                 (unsigned long)stats.mount_time_us);
+    } else {
+        ESP_LOGI(TAG, "Mounted '%s': empty", partition->label);
+    }
+    return true;
+}
+
+bool energy_journal_latest(energy_journal_entry_t *entry)
+{
+    if (!entry || !have_latest) return false;
+    
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    *entry = latest;
+    xSemaphoreGive(journal_mutex);
+    return true;
+}
+
+bool energy_journal_append(int64_t energy_uwh, bool relay_on, uint32_t timestamp,
+                           energy_journal_reason_t reason)
+{
+    if (!partition) return false;
+    
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    
+    // Spread periodic saves evenly over the hour
+    if (reason == ENERGY_JOURNAL_PERIODIC && periodic_written &&
+        esp_timer_get_time() - last_periodic_us < 3600000000LL / CONFIG_ENERGY_JOURNAL_WRITES_PER_HOUR) {
+        stats.records_deferred++;
+        xSemaphoreGive(journal_mutex);
+        return false;
+    }
+    
+    bool ok = write_record(energy_uwh, relay_on, timestamp, reason, 0, false);
+    
+    xSemaphoreGive(journal_mutex);
+    return ok;
+}
+
+bool energy_journal_append_urgent(int64_t energy_uwh, bool relay_on, uint32_t timestamp,
+                                  uint32_t latency_us)
+{
+    if (!partition) return false;
+    
+    // A normal append may be mid-erase; do not wait out a sector erase
+    if (xSemaphoreTake(journal_mutex, 1) != pdTRUE) {
+        stats.urgent_busy++;
+        return false;
+    }
+    
+    bool ok = write_record(energy_uwh, relay_on, timestamp, ENERGY_JOURNAL_POWER_LOSS,
+                           latency_us, true);
+    
+    xSemaphoreGive(journal_mutex);
+    return ok;
+}
+
+void energy_journal_get_stats(energy_journal_stats_t *out)
+{
+    if (!out) return;
+    
+    if (journal_mutex) xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    
+    *out = stats;
+    out->sector_count = sector_count;
+    out->slots_per_sector = EJ_SLOTS_PER_SECTOR;
+    out->budget_per_hour = CONFIG_ENERGY_JOURNAL_WRITES_PER_HOUR;
+    
+    uint32_t ring_slots = sector_count * EJ_SLOTS_PER_SECTOR;
+    if (ring_slots > 0) {
+        out->erase_cycles = next_seq / ring_slots;
+        float cycles_per_year = (float)CONFIG_ENERGY_JOURNAL_WRITES_PER_HOUR * 24 * 365 / ring_slots;
+        out->projected_years = ((float)EJ_ENDURANCE_CYCLES - out->erase_cycles) / cycles_per_year;
+    }
+    
+    if (journal_mutex) xSemaphoreGive(journal_mutex);
+}
@@ -0,0 +1,460 @@
+// smart_plug/components/storage/enf_log.c
+#include "enf_log.h"
+#include "ts_codec.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "timebase.h"
+#include "payload_writer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "ENF_LOG";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_THING_NAME
+#define CONFIG_THING_NAME "Smart_Plug_1"
+#endif
+
+#ifndef CONFIG_ENF_BLOCK_BYTES
+#define CONFIG_ENF_BLOCK_BYTES 1024
+#endif
+
+#ifndef CONFIG_ENF_BLOCKS
+#define CONFIG_ENF_BLOCKS 8
+#endif
+
+#ifndef CONFIG_ENF_BLOCK_MAX_S
+#define CONFIG_ENF_BLOCK_MAX_S 30
+#endif
+
+#ifndef CONFIG_ENF_NOMINAL_HZ
+#define CONFIG_ENF_NOMINAL_HZ 50
+#endif
+
+#ifndef CONFIG_ENF_EVENT_DEV_MHZ
+#define CONFIG_ENF_EVENT_DEV_MHZ 200
+#endif
+
+#ifndef CONFIG_ENF_EVENT_HYST_MHZ
+#define CONFIG_ENF_EVENT_HYST_MHZ 20
+#endif
+
+#ifndef CONFIG_ENF_EVENT_CYCLES
+#define CONFIG_ENF_EVENT_CYCLES 5
+#endif
+
+#define ENF_EVENT_QUEUE     8
+
+// Longer than this between edges means the detector went quiet: a gap
+#define ENF_MAX_GAP_US      100000
+
+// Valid mains band; anything outside is a glitched edge, not grid frequency
+#define ENF_MIN_PERIOD_US   15384   // 65 Hz
+#define ENF_MAX_PERIOD_US   22222   // 45 Hz
+
+/*===============================================================================
+  Static Variables
+  
+  Blocks form a ring: [tail, head) are closed and waiting for upload, and the
+  slot at head is being filled while block_open is set. The ENF task in
+  main writes, the MQTT task uploads; both hold enf_mutex only briefly.
+  ===============================================================================*/
+
+typedef struct {
+    int64_t t0_us;              // First edge of the block
+    uint32_t cycles;            // Periods in the block
+    uint16_t bytes;             // Encoded length
+    uint8_t data[CONFIG_ENF_BLOCK_BYTES];
+} enf_block_t;
+
+static enf_log_publish_t publish_fn = NULL;
+static SemaphoreHandle_t enf_mutex = NULL;
+static enf_log_stats_t stats = {0};
+
+static enf_block_t blocks[CONFIG_ENF_BLOCKS];
+static uint32_t head = 0;
+static uint32_t tail = 0;
+static bool block_open = false;
+static ts_codec_t codec;
+static int64_t last_edge_us = 0;            // 0 = no reference edge
+
+// Upload copy, so encoding and publishing happen outside the lock
+static enf_block_t sending;
+// Outgoing message: a base64 block plus the JSON envelope, or raw in CBOR
+static uint8_t msg_buf[((CONFIG_ENF_BLOCK_BYTES + 2) / 3) * 4 + 256];
+
+// Event thresholds as periods: longer than under_* is under-frequency
+static uint32_t under_start_us, under_end_us;
+static uint32_t over_start_us, over_end_us;
+
+// Event detector state
+static bool in_event = false;
+static enf_event_t active;
+static enf_event_type_t run_type;
+static uint32_t run_cycles = 0;         // Consecutive out-of-band cycles before an event
+static uint32_t back_cycles = 0;        // Consecutive in-band cycles during an event
+static int64_t back_since_us = 0;
+static uint32_t extreme_period = 0;
+
+static enf_event_t event_queue[ENF_EVENT_QUEUE];
+static uint32_t event_head = 0;
+static uint32_t event_tail = 0;
+static enf_event_t last_event;
+static bool have_last_event = false;
+
+/*===============================================================================
+  Blocks
+  ===============================================================================*/
+
+static void open_block(int64_t t0_us)
+{
+    static const ts_codec_type_t types[] = { TS_CODEC_INT };
+    
+    // RAM full: the oldest unsent block makes room
+    if (head - tail >= CONFIG_ENF_BLOCKS) {
+        tail++;
+        stats.blocks_overwritten++;
+    }
+    
+    enf_block_t *b = &blocks[head % CONFIG_ENF_BLOCKS];
+    b->t0_us = t0_us;
+    b->cycles = 0;
+    b->bytes = 0;
+    ts_codec_init(&codec, types, 1, b->data, sizeof(b->data));
+    block_open = true;
+}
+
+static void close_block(void)
+{
+    if (!block_open) return;
+    block_open = false;
+    
+    enf_block_t *b = &blocks[head % CONFIG_ENF_BLOCKS];
+    if (b->cycles == 0) return;
+    
+    b->bytes = (uint16_t)ts_codec_bytes(&codec);
+    head++;
+    stats.blocks_closed++;
+    stats.bytes_encoded += b->bytes;
+}
+
+static bool put_period(int64_t start_us, int64_t end_us)
+{
+    if (!block_open) {
+        open_block(start_us);
+    } else if (end_us - blocks[head % CONFIG_ENF_BLOCKS].t0_us >
+               (int64_t)CONFIG_ENF_BLOCK_MAX_S * 1000000) {
+        close_block();
+        open_block(start_us);
+    }
+    
+    ts_codec_value_t v = { .i = end_us - start_us };
+    if (!ts_codec_put(&codec, &v)) {
+        close_block();
+        open_block(start_us);
+        if (!ts_codec_put(&codec, &v)) return false;
+    }
+    
+    blocks[head % CONFIG_ENF_BLOCKS].cycles++;
+    stats.cycles_logged++;
+    return true;
+}
+
+/*===============================================================================
+  Event Detection
+  ===============================================================================*/
+
+static void queue_event(const enf_event_t *ev)
+{
+    if (event_head - event_tail >= ENF_EVENT_QUEUE) {
+        event_tail++;
+        stats.events_dropped++;
+    }
+    event_queue[event_head % ENF_EVENT_QUEUE] = *ev;
+    event_head++;
+    last_event = *ev;
+    have_last_event = true;
+}
+
+static void check_event(uint32_t period, int64_t start_us)
+{
+    if (period < ENF_MIN_PERIOD_US || period > ENF_MAX_PERIOD_US) return;
+    
+    if (!in_event) {
+        enf_event_type_t type;
+        if (period > under_start_us) {
+            type = ENF_EVENT_UNDER_FREQUENCY;
+        } else if (period < over_start_us) {
+            type = ENF_EVENT_OVER_FREQUENCY;
+        } else {
+            run_cycles = 0;
+            return;
+        }
+        
+        if (run_cycles == 0 || type != run_type) {
+            run_type = type;
+            run_cycles = 0;
+            active.start_us = start_us;
+            extreme_period = period;
+        }
+        run_cycles++;
+        if (type == ENF_EVENT_UNDER_FREQUENCY ? period > extreme_period
+                                              : period < extreme_period) {
+            extreme_period = period;
+        }
+        
+        if (run_cycles >= CONFIG_ENF_EVENT_CYCLES) {
+            in_event = true;
+            back_cycles = 0;
+            active.type = type;
+            active.cycles = run_cycles;
+            if (type == ENF_EVENT_UNDER_FREQUENCY) {
+                stats.events_under++;
+            } else {
+                stats.events_over++;
+            }
+            ESP_LOGW(TAG, "%s-frequency excursion started (%.3f Hz)",
+                     type == ENF_EVENT_UNDER_FREQUENCY ? "Under" : "Over",
+                     1000000.0 / extreme_period);
+        }
+        return;
+    }
+    
+    active.cycles++;
+    bool back = (active.type == ENF_EVENT_UNDER_FREQUENCY) ? period < under_end_us
+                                                           : period > over_end_us;
+    if (!back) {
+        back_cycles = 0;
+        if (active.type == ENF_EVENT_UNDER_FREQUENCY ? period > extreme_period
+                                                     : period < extreme_period) {
+            extreme_period = period;
+        }
+        return;
+    }
+    
+    if (back_cycles++ == 0) {
+        back_since_us = start_us;
+    }
+    if (back_cycles < CONFIG_ENF_EVENT_CYCLES) return;
+    
+    // Back in band long enough: the excursion ended where recovery began
+    active.cycles -= back_cycles;
+    active.duration_ms = (uint32_t)((back_since_us - active.start_us) / 1000);
+    active.extreme_hz = (float)(1000000.0 / extreme_period);
+    in_event = false;
+    run_cycles = 0;
+    queue_event(&active);
+    
+    ESP_LOGW(TAG, "%s-frequency excursion ended: %lu ms, extreme %.3f Hz",
+             active.type == ENF_EVENT_UNDER_FREQUENCY ? "Under" : "Over",
+             (unsigned long)active.duration_ms, active.extreme_hz);
+}
+
+/*===============================================================================
+  Messages
+  ===============================================================================*/
+
+// Keys are CBOR map keys (schema version ENF_SCHEMA_VERSION)
+static void write_block(payload_writer_t *w, const enf_block_t *b)
+{
+    payload_writer_bool(w, 2, "enf", true);
+    payload_writer_string(w, 3, "encoding", "tsc1");
+    payload_writer_begin_array(w, 4, "fields");
+    payload_writer_string(w, 0, NULL, "period_us:int");
+    payload_writer_end_array(w);
+    payload_writer_int(w, 5, "nominal_hz", CONFIG_ENF_NOMINAL_HZ);
+    payload_writer_int(w, 6, "t0_us", b->t0_us);
+    payload_writer_int(w, 7, "t0_wall_us", timebase_mono_to_wall_us(b->t0_us));
+    payload_writer_int(w, 8, "count", b->cycles);
+    payload_writer_bytes(w, 9, "data", b->data, b->bytes);
+}
+
+static void write_event(payload_writer_t *w, const enf_event_t *ev)
+{
+    payload_writer_begin_map(w, 10, "enf_event");
+    payload_writer_string(w, 1, "type", ev->type == ENF_EVENT_UNDER_FREQUENCY ?
+                          "under_frequency" : "over_frequency");
+    payload_writer_int(w, 2, "start_us", ev->start_us);
+    payload_writer_int(w, 3, "start_wall_us", timebase_mono_to_wall_us(ev->start_us));
+    payload_writer_int(w, 4, "duration_ms", ev->duration_ms);
+    payload_writer_int(w, 5, "cycles", ev->cycles);
+    payload_writer_float(w, 6, "extreme_hz", ev->extreme_hz, 4);
+    payload_writer_end_map(w);
+}
+
+// Block when ev is NULL, otherwise the event
+static const void *build_message(payload_format_t format, const enf_block_t *b,
+                                 const enf_event_t *ev, size_t *len)
+{
+    payload_writer_t w;
+    payload_writer_init(&w, format, msg_buf, sizeof(msg_buf));
+    payload_writer_begin_map(&w, 0, NULL);
+    payload_writer_string(&w, 1, "device_id", CONFIG_THING_NAME);
+    if (ev) {
+        write_event(&w, ev);
+    } else {
+        write_block(&w, b);
+    }
+    payload_writer_end_map(&w);
+    return payload_writer_finish(&w, len);
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool enf_log_init(enf_log_publish_t publish)
+{
+    publish_fn = publish;
+    
+    enf_mutex = xSemaphoreCreateMutex();
+    if (!enf_mutex) {
+        ESP_LOGE(TAG, "Failed to create mutex");
+        return false;
+    }
+    
+    int32_t nominal_mhz = CONFIG_ENF_NOMINAL_HZ * 1000;
+    int32_t dev = CONFIG_ENF_EVENT_DEV_MHZ;
+    int32_t end_dev = CONFIG_ENF_EVENT_DEV_MHZ - CONFIG_ENF_EVENT_HYST_MHZ;
+    if (end_dev < 0) end_dev = 0;
+    under_start_us = (uint32_t)(1000000000LL / (nominal_mhz - dev));
+    under_end_us = (uint32_t)(1000000000LL / (nominal_mhz - end_dev));
+    over_start_us = (uint32_t)(1000000000LL / (nominal_mhz + dev));
+    over_end_us = (uint32_t)(1000000000LL / (nominal_mhz + end_dev));
+    
+    ESP_LOGI(TAG, "ENF log: %d x %d byte blocks, events beyond %d Hz +/- %d mHz",
+             CONFIG_ENF_BLOCKS, CONFIG_ENF_BLOCK_BYTES,
+             CONFIG_ENF_NOMINAL_HZ, CONFIG_ENF_EVENT_DEV_MHZ);
+    return true;
+}
+
+void enf_log_feed(const int64_t *edges, size_t count, uint32_t dropped)
+{
+    if (!enf_mutex || (count == 0 && dropped == 0)) return;
+    
+    int64_t start = timebase_now_us();
+    xSemaphoreTake(enf_mutex, portMAX_DELAY);
+    
+    if (dropped) {
+        stats.edges_dropped += dropped;
+        close_block();
+        last_edge_us = 0;
+        run_cycles = 0;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        int64_t edge = edges[i];
+        if (last_edge_us == 0 || edge - last_edge_us > ENF_MAX_GAP_US) {
+            close_block();
+            last_edge_us = edge;
+            run_cycles = 0;
+            continue;
+        }
+        
+        if (put_period(last_edge_us, edge)) {
+            check_event((uint32_t)(edge - last_edge_us), last_edge_us);
+        }
+        last_edge_us = edge;
+    }
+    
+    stats.feed_time_us += timebase_now_us() - start;
+    xSemaphoreGive(enf_mutex);
+}
+
+void enf_log_handle(bool connected, payload_format_t format)
+{
+    if (!enf_mutex) return;
+    
+    xSemaphoreTake(enf_mutex, portMAX_DELAY);
+    // Close an idle or aged block so it does not wait for the next edge
+    if (block_open && timebase_now_us() - blocks[head % CONFIG_ENF_BLOCKS].t0_us >
+                      (int64_t)CONFIG_ENF_BLOCK_MAX_S * 1000000) {
+        close_block();
+    }
+    xSemaphoreGive(enf_mutex);
+    
+    if (!connected || !publish_fn) return;
+    
+    // Events first, they are small and time-critical
+    while (1) {
+        enf_event_t ev;
+        uint32_t seq;
+        xSemaphoreTake(enf_mutex, portMAX_DELAY);
+        bool have = event_tail != event_head;
+        seq = event_tail;
+        if (have) ev = event_queue[seq % ENF_EVENT_QUEUE];
+        xSemaphoreGive(enf_mutex);
+        if (!have) break;
+        
+        size_t len;
+        const void *payload = build_message(format, NULL, &ev, &len);
+        if (!payload || !publish_fn(payload, len, format)) return;
+        
+        xSemaphoreTake(enf_mutex, portMAX_DELAY);
+        if (event_tail == seq) event_tail++;
+        xSemaphoreGive(enf_mutex);
+    }
+    
+    xSemaphoreTake(enf_mutex, portMAX_DELAY);
+    bool have = tail != head;
+    uint32_t seq = tail;
+    if (have) sending = blocks[seq % CONFIG_ENF_BLOCKS];
+    xSemaphoreGive(enf_mutex);
+    if (!have) return;
+    
+    size_t len;
+    const void *payload = build_message(format, &sending, NULL, &len);
+    if (!payload) {
+        ESP_LOGE(TAG, "Failed to build ENF block");
+        return;
+    }
+    bool sent = publish_fn(payload, len, format);
+    
+    xSemaphoreTake(enf_mutex, portMAX_DELAY);
+    if (!sent) {
+        stats.blocks_failed++;
+    } else {
+        stats.blocks_sent++;
+        // Skip the advance if the block was overwritten while publishing
+        if (tail == seq) tail++;
+    }
+    xSemaphoreGive(enf_mutex);
+}
+
+const char *enf_log_schema(char *buf, size_t size)
+{
+    static const enf_block_t block = {0};
+    static const enf_event_t event = {0};
+    
+    payload_writer_t w;
+    payload_writer_init_schema(&w, buf, size, "enf", ENF_SCHEMA_VERSION);
+    payload_writer_begin_map(&w, 0, NULL);
+    payload_writer_string(&w, 1, "device_id", CONFIG_THING_NAME);
+    write_block(&w, &block);
+    write_event(&w, &event);
+    payload_writer_end_map(&w);
+    return payload_writer_finish(&w, NULL);
+}
+
+bool enf_log_get_last_event(enf_event_t *event)
+{
+    if (!event || !have_last_event) return false;
+    *event = last_event;
+    return true;
+}
+
+void enf_log_get_stats(enf_log_stats_t *out)
+{
+    if (!out) return;
+    
+    *out = stats;
+    out->excursion_active = in_event;
+    if (stats.cycles_logged > 0) {
+        out->cpu_us_per_hour = (uint32_t)(stats.feed_time_us * 3600ULL *
+                                          CONFIG_ENF_NOMINAL_HZ / stats.cycles_logged);
+    }
+}
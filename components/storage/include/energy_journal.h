@@ -0,0 +1,123 @@
+// smart_plug/components/storage/include/energy_journal.h
+#ifndef ENERGY_JOURNAL_H
+#define ENERGY_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Why a journal record was written
+ */
+typedef enum {
+    ENERGY_JOURNAL_PERIODIC = 0,    // Energy delta or save interval (rate limited)
+    ENERGY_JOURNAL_RELAY,           // Relay state changed
+    ENERGY_JOURNAL_RESET,           // Energy counter reset
+    ENERGY_JOURNAL_FORCED,          // Explicit save (e.g. before setup mode)
+    ENERGY_JOURNAL_MIGRATED,        // Imported from the legacy NVS blob
+    ENERGY_JOURNAL_POWER_LOSS,      // Last-gasp write on a supply dip
+} energy_journal_reason_t;
+
+/**
+ * @brief One journal entry
+ */
+typedef struct {
+    uint32_t seq;                   // Monotonic sequence number
+    int64_t energy_uwh;             // Cumulative energy (micro-Wh)
+    uint32_t timestamp;             // Epoch seconds (0 if time was not synced)
+    bool relay_on;
+    energy_journal_reason_t reason;
+    uint32_t latency_us;            // POWER_LOSS: interrupt to handler start (else 0)
+} energy_journal_entry_t;
+
+/**
+ * @brief Journal statistics and flash-write budget
+ * 
+ * Each sector is erased once per (sector_count * slots_per_sector) records,
+ * so erase_cycles is derived from the sequence number and survives reboots.
+ */
+typedef struct {
+    uint32_t records_written;       // Records programmed since boot
+    uint32_t records_deferred;      // Periodic saves refused by the rate budget
+    uint32_t sectors_erased;        // Sector erases since boot
+    uint32_t write_errors;          // Failed flash operations
+    uint32_t torn_records;          // Records with a bad CRC found at mount
+    uint32_t sector_count;          // Sectors in the journal partition
+    uint32_t slots_per_sector;      // Records per sector
+    uint32_t erase_cycles;          // Estimated erase cycles per sector (lifetime)
+    uint32_t budget_per_hour;       // Periodic writes allowed per hour
+    float projected_years;          // Years to 100k erase cycles at the budget
+    uint32_t mount_reads;           // Flash reads needed to find the latest record
+    uint32_t mount_time_us;         // Time taken to mount
+    uint32_t last_write_us;         // Duration of the last record write
+    uint32_t max_write_us;          // Longest record write
+    uint32_t urgent_busy;           // Urgent writes dropped because the journal was busy
+} energy_journal_stats_t;
+
+/**
+ * @brief Mount the journal and locate the latest record
+ * 
+ * Reads the first record of every sector, then binary searches the newest
+ * sector for the write position.
+ * 
+ * @return true if the partition was found and mounted
+ */
+bool energy_journal_init(void);
+
+/**
+ * @brief Get the latest valid record
+ * 
+ * @param entry Destination
+ * @return true if the journal holds a record
+ */
+bool energy_journal_latest(energy_journal_entry_t *entry);
+
+/**
+ * @brief Append a record
+ * 
+ * ENERGY_JOURNAL_PERIODIC records are limited to CONFIG_ENERGY_JOURNAL_WRITES_PER_HOUR
+ * (evenly spaced); all other reasons are always written. The next slot is
+ * kept erased, so a write never waits for a sector erase of its own.
+ * 
+ * @param energy_uwh Cumulative energy (micro-Wh)
+ * @param relay_on Relay state
+ * @param timestamp Epoch seconds (0 if unknown)
+ * @param reason Why the record is written
+ * @return true if the record was written
+ */
+bool energy_journal_append(int64_t energy_uwh, bool relay_on, uint32_t timestamp,
+                           energy_journal_reason_t reason);
+
+/**
+ * @brief Append a power-loss record as fast as possible
+ * 
+ * Programs the already-erased head slot without waiting for the journal
+ * lock (gives up if another write holds it) and defers any sector erase to
+ * the next normal append.
+ * 
+ * @param energy_uwh Cumulative energy (micro-Wh)
+ * @param relay_on Relay state
+ * @param timestamp Epoch seconds (0 if unknown)
+ * @param latency_us Dispatch latency, power-fail interrupt to the last-gasp
+ *                   handler start; stored with the record, so it excludes
+ *                   the write itself
+ * @return true if the record was written
+ */
+bool energy_journal_append_urgent(int64_t energy_uwh, bool relay_on, uint32_t timestamp,
+                                  uint32_t latency_us);
+
+/**
+ * @brief Get journal statistics
+ * 
+ * @param stats Destination
+ */
+void energy_journal_get_stats(energy_journal_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ENERGY_JOURNAL_H */
@@ -0,0 +1,158 @@
+// smart_plug/components/storage/include/enf_log.h
+#ifndef ENF_LOG_H
+#define ENF_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "payload_writer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Grid Frequency (ENF) Log
+  
+  Every mains cycle period measured by the zero-crossing ISR is kept at full
+  (1 us) resolution. Periods are packed with ts_codec as one integer column,
+  so each is stored as the zigzag varint of its difference from the previous
+  period: one byte per cycle while the grid and ISR latency stay within
+  +/-63 us of the last cycle, two bytes up to +/-8 ms.
+  
+  Cycles go into fixed RAM blocks. A block closes when it is full or
+  CONFIG_ENF_BLOCK_MAX_S old, and is uploaded while connected:
+  
+  {"device_id": "...", "enf": true, "encoding": "tsc1",
+   "fields": ["period_us:int"], "t0_us": <esp_timer us of first edge>,
+   "t0_wall_us": <epoch us of first edge, 0 if unknown>, "count": N,
+   "data": "<base64>"}
+  
+  Edge k of the block is t0 + sum of the first k periods. A gap in the edge
+  stream (edges lost or detector silent) always starts a new block.
+  
+  Under/over-frequency events are detected on the same per-cycle periods and
+  published as {"device_id": "...", "enf_event": {...}}.
+  
+  Cost (50 Hz, defaults; figures from test/host/bench_enf_log.c, which
+  fails if they stop holding):
+  - RAM:  CONFIG_ENF_BLOCKS * CONFIG_ENF_BLOCK_BYTES plus ~200 bytes, fixed
+  - Data: 180,000 cycles/h at ~1.0 byte each, ~176 KiB/h encoded,
+          ~265 KiB/h as JSON messages (base64), ~188 KiB/h as CBOR
+  - CPU:  one ts_codec_put and one threshold compare per cycle. The time
+          measured on the device is reported as feed_time_us, and
+          cpu_us_per_hour extrapolates it to an hour of logging
+  
+  The ZC edge ring must be drained faster than it fills; main does so from
+  a task of its own (see ENF_DRAIN_MS).
+  ===============================================================================*/
+
+// Bump when ENF message keys change (see enf_log_schema())
+#define ENF_SCHEMA_VERSION  1
+
+/**
+ * @brief Publish function used for blocks and events
+ * 
+ * @param payload Message
+ * @param len Payload length in bytes
+ * @param format Encoding of the payload
+ * @return true if the message was handed to the MQTT client
+ */
+typedef bool (*enf_log_publish_t)(const void *payload, size_t len, payload_format_t format);
+
+/**
+ * @brief Frequency excursion type
+ */
+typedef enum {
+    ENF_EVENT_UNDER_FREQUENCY,
+    ENF_EVENT_OVER_FREQUENCY,
+} enf_event_type_t;
+
+/**
+ * @brief One under/over-frequency excursion
+ */
+typedef struct {
+    enf_event_type_t type;
+    int64_t start_us;           // First out-of-band edge (esp_timer us)
+    uint32_t duration_ms;       // Time until the frequency returned in band
+    uint32_t cycles;            // Cycles spent out of band
+    float extreme_hz;           // Lowest (under) or highest (over) cycle frequency
+} enf_event_t;
+
+/**
+ * @brief ENF log statistics
+ */
+typedef struct {
+    uint32_t cycles_logged;         // Periods stored in blocks
+    uint32_t edges_dropped;         // Edges lost before they were read (gaps)
+    uint32_t blocks_closed;         // Blocks completed
+    uint32_t blocks_sent;           // Blocks published
+    uint32_t blocks_failed;         // Block publishes rejected by the client
+    uint32_t blocks_overwritten;    // Unsent blocks dropped when RAM filled
+    uint64_t bytes_encoded;         // Encoded payload of closed blocks
+    uint64_t feed_time_us;          // Time spent encoding and checking cycles
+    uint32_t cpu_us_per_hour;       // feed_time_us scaled to one hour of cycles
+    uint32_t events_under;          // Under-frequency events detected
+    uint32_t events_over;           // Over-frequency events detected
+    uint32_t events_dropped;        // Events lost before they were published
+    bool excursion_active;          // An event is in progress
+} enf_log_stats_t;
+
+/**
+ * @brief Initialize the ENF log
+ * 
+ * @param publish Function used to send blocks and events
+ * @return true if successful
+ */
+bool enf_log_init(enf_log_publish_t publish);
+
+/**
+ * @brief Feed consecutive zero-crossing edges
+ * 
+ * Call from one task with the output of zero_crossing_read_edges().
+ * 
+ * @param edges Rising-edge timestamps (esp_timer us), oldest first
+ * @param count Number of edges
+ * @param dropped Edges lost immediately before edges[0]
+ */
+void enf_log_feed(const int64_t *edges, size_t count, uint32_t dropped);
+
+/**
+ * @brief Upload handler (call periodically from the MQTT task)
+ * 
+ * Publishes pending events and at most one closed block per call.
+ * 
+ * @param connected true if the MQTT client is connected
+ * @param format Encoding for the messages (PAYLOAD_JSON or PAYLOAD_CBOR)
+ */
+void enf_log_handle(bool connected, payload_format_t format);
+
+/**
+ * @brief Write the schema describing the CBOR keys of ENF messages
+ * 
+ * @param buf Output buffer
+ * @param size Buffer size
+ * @return const char* JSON schema, or NULL if it did not fit
+ */
+const char *enf_log_schema(char *buf, size_t size);
+
+/**
+ * @brief Get the most recent frequency event
+ * 
+ * @param event Destination
+ * @return true if an event has been detected since boot
+ */
+bool enf_log_get_last_event(enf_event_t *event);
+
+/**
+ * @brief Get ENF log statistics
+ * 
+ * @param stats Destination
+ */
+void enf_log_get_stats(enf_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ENF_LOG_H */
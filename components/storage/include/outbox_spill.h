@@ -0,0 +1,92 @@
+// smart_plug/components/storage/include/outbox_spill.h
+#ifndef OUTBOX_SPILL_H
+#define OUTBOX_SPILL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Spill statistics
+ */
+typedef struct {
+    uint32_t records_written;       // Messages spilled since boot
+    uint32_t records_read;          // Messages handed back and released
+    uint32_t records_dropped;       // Overwritten when the ring was full, too large or corrupt
+    uint32_t sectors_erased;
+    uint32_t write_errors;          // Failed flash operations
+    uint32_t pending;               // Messages waiting on flash
+    uint32_t sector_count;          // Sectors in the spill partition
+} outbox_spill_stats_t;
+
+/**
+ * @brief Mount the spill ring on its partition
+ * 
+ * Messages left by a previous boot are kept and returned first.
+ * 
+ * @return true if the partition was found and mounted
+ */
+bool outbox_spill_init(void);
+
+/**
+ * @brief Append a message
+ * 
+ * When the ring is full its oldest sector is erased, dropping the messages
+ * in it.
+ * 
+ * @param tag Caller-defined message tag (e.g. the topic)
+ * @param data Message payload
+ * @param len Payload length (at most one sector minus headers)
+ * @return true if written
+ */
+bool outbox_spill_push(uint8_t tag, const void *data, size_t len);
+
+/**
+ * @brief Read the oldest message without releasing it
+ * 
+ * Call with size 0 to learn the length first.
+ * 
+ * @param tag Receives the tag (may be NULL)
+ * @param buf Destination (may be NULL if size is 0)
+ * @param size Size of buf
+ * @return size_t Message length (copied only if it fits), 0 if empty
+ */
+size_t outbox_spill_peek(uint8_t *tag, void *buf, size_t size);
+
+/**
+ * @brief Release the message returned by outbox_spill_peek()
+ * 
+ * Does nothing if that message has since been dropped by an overwrite.
+ */
+void outbox_spill_pop(void);
+
+/**
+ * @brief Check that the message returned by outbox_spill_peek() is still held
+ * 
+ * A push into a full ring drops the oldest sector, which may hold it.
+ * 
+ * @return true until it is popped or dropped
+ */
+bool outbox_spill_peeked(void);
+
+/**
+ * @brief Get the number of messages waiting on flash
+ */
+uint32_t outbox_spill_pending(void);
+
+/**
+ * @brief Get spill statistics
+ * 
+ * @param stats Destination
+ */
+void outbox_spill_get_stats(outbox_spill_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OUTBOX_SPILL_H */
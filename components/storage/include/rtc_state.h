@@ -0,0 +1,52 @@
+// smart_plug/components/storage/include/rtc_state.h
+#ifndef RTC_STATE_H
+#define RTC_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief State kept in RTC memory across soft resets
+ */
+typedef struct {
+    int64_t energy_uwh;     // Cumulative energy (micro-Wh)
+    bool relay_on;          // Relay state
+    uint32_t epoch_s;       // Wall-clock time of the last update (0 if unknown)
+    int64_t uptime_us;      // Uptime of the last update in the previous boot
+    uint32_t restores;      // Consecutive warm boots restored from this block
+} rtc_state_t;
+
+/**
+ * @brief Restore state left by the previous boot
+ * 
+ * Valid only after a warm reset (software, panic, watchdog, deep sleep...)
+ * and if the block CRC matches. Call once at boot, before the first update.
+ * 
+ * @param state Destination
+ * @return true if state was restored
+ */
+bool rtc_state_restore(rtc_state_t *state);
+
+/**
+ * @brief Update the RTC block (cheap enough to call on every sample)
+ * 
+ * @param energy_uwh Cumulative energy (micro-Wh)
+ * @param relay_on Relay state
+ * @param epoch_s Wall-clock time (0 if unknown)
+ */
+void rtc_state_update(int64_t energy_uwh, bool relay_on, uint32_t epoch_s);
+
+/**
+ * @brief Invalidate the RTC block (next boot restores from flash)
+ */
+void rtc_state_invalidate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RTC_STATE_H */
@@ -0,0 +1,112 @@
+// smart_plug/components/storage/include/store_forward.h
+#ifndef STORE_FORWARD_H
+#define STORE_FORWARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Backfill Message
+  
+  {"device_id": "...", "backfill": true, "encoding": "tsc1",
+   "fields": ["timestamp:int", "rms_v:float", ...], "count": N, "data": "<base64>"}
+  
+  "data" holds N rows compressed with ts_codec using the column types listed
+  in "fields", in the same format as the time-series log frames.
+  ===============================================================================*/
+
+/**
+ * @brief Publish function used for replay batches
+ * 
+ * The batch must be delivered with QoS 1; store_forward_acked() is called
+ * with it once the broker has acknowledged it.
+ * 
+ * @param payload Batch message (NUL-terminated)
+ * @param len Payload length in bytes
+ * @return true if the batch was queued
+ */
+typedef bool (*store_forward_publish_t)(const char *payload, size_t len);
+
+/**
+ * @brief Store-and-forward statistics
+ */
+typedef struct {
+    uint32_t records_captured;      // Records stored while offline
+    uint32_t records_replayed;      // Records sent in backfill batches
+    uint32_t batches_sent;          // Backfill messages acknowledged by the broker
+    uint32_t batches_failed;        // Backfill messages not queued or never acknowledged
+    uint64_t bytes_raw;             // Uncompressed size of replayed records
+    uint64_t bytes_encoded;         // Compressed size before base64
+    uint32_t pending_from;          // Oldest unsent record (epoch, 0 if idle)
+    uint32_t pending_to;            // Newest record to replay (epoch, 0 while offline)
+} store_forward_stats_t;
+
+/**
+ * @brief Initialize store-and-forward (restores any pending backlog from NVS)
+ * 
+ * Records are kept in the time-series log, which must be mounted first.
+ * 
+ * @param publish Function used to send replay batches
+ * @return true if successful
+ */
+bool store_forward_init(store_forward_publish_t publish);
+
+/**
+ * @brief Capture one telemetry record while the broker is unreachable
+ * 
+ * @param timestamp Epoch seconds
+ * @param voltage Voltage RMS (V)
+ * @param current Current RMS (A)
+ * @param power Active power (W)
+ * @param energy_uwh Cumulative energy (micro-Wh)
+ * @return true if stored
+ */
+bool store_forward_capture(uint32_t timestamp, float voltage, float current,
+                           float power, int64_t energy_uwh);
+
+/**
+ * @brief Replay handler (call periodically from the MQTT task)
+ * 
+ * Sends at most one batch per replay interval while connected, so live
+ * telemetry keeps priority. The next batch waits for the PUBACK of the
+ * last; one not acknowledged within five minutes is sent again.
+ * 
+ * @param connected true if the MQTT client is connected
+ * @param now Current epoch time (0 if unknown)
+ */
+void store_forward_handle(bool connected, uint32_t now);
+
+/**
+ * @brief Report the PUBACK of a backlog batch
+ * 
+ * Replay moves past the batch only now, and the position is saved to NVS.
+ * 
+ * @param payload Payload as published
+ * @param len Payload length in bytes
+ */
+void store_forward_acked(const void *payload, size_t len);
+
+/**
+ * @brief Check if records are waiting to be replayed
+ * 
+ * @return true if a backlog exists
+ */
+bool store_forward_pending(void);
+
+/**
+ * @brief Get store-and-forward statistics
+ * 
+ * @param stats Destination
+ */
+void store_forward_get_stats(store_forward_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORE_FORWARD_H */
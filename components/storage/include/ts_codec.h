@@ -0,0 +1,108 @@
+// smart_plug/components/storage/include/ts_codec.h
+#ifndef TS_CODEC_H
+#define TS_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Time-Series Codec
+  
+  Rows of up to TS_CODEC_MAX_COLUMNS values are packed row by row into one
+  bit stream. Each column is encoded against its previous value:
+  
+  - TS_CODEC_INT:   delta, zigzag, then varint (7 data bits + 1 continuation
+                    bit per group)
+  - TS_CODEC_FLOAT: Gorilla XOR for float32. '0' = same value; '10' + bits =
+                    XOR fits the previous leading/trailing zero window;
+                    '11' + 5-bit leading zeros + 5-bit (length - 1) + bits.
+  
+  The first row is encoded against zero. The row count is not stored in the
+  stream; callers keep it in their own framing.
+  ===============================================================================*/
+
+#define TS_CODEC_MAX_COLUMNS    8
+
+/**
+ * @brief Column encoding
+ */
+typedef enum {
+    TS_CODEC_INT,       // Integer channel (delta + zigzag + varint)
+    TS_CODEC_FLOAT,     // float32 channel (Gorilla XOR)
+} ts_codec_type_t;
+
+/**
+ * @brief One column value
+ */
+typedef union {
+    int64_t i;
+    float f;
+} ts_codec_value_t;
+
+/**
+ * @brief Encoder/decoder state (one per stream)
+ */
+typedef struct {
+    ts_codec_type_t types[TS_CODEC_MAX_COLUMNS];
+    uint8_t columns;
+    uint8_t *buf;
+    size_t cap_bits;
+    size_t bit_pos;
+    uint32_t rows;
+    int64_t prev_int[TS_CODEC_MAX_COLUMNS];
+    uint32_t prev_float[TS_CODEC_MAX_COLUMNS];
+    uint8_t prev_lead[TS_CODEC_MAX_COLUMNS];
+    uint8_t prev_trail[TS_CODEC_MAX_COLUMNS];
+} ts_codec_t;
+
+/**
+ * @brief Start a stream over a caller-provided buffer
+ * 
+ * For encoding the buffer is overwritten; for decoding it holds the stream.
+ * 
+ * @param codec Codec state
+ * @param types Column types
+ * @param columns Number of columns (1..TS_CODEC_MAX_COLUMNS)
+ * @param buf Stream buffer
+ * @param len Buffer size in bytes
+ * @return true if the column layout is valid
+ */
+bool ts_codec_init(ts_codec_t *codec, const ts_codec_type_t *types, uint8_t columns,
+                   uint8_t *buf, size_t len);
+
+/**
+ * @brief Encode one row
+ * 
+ * Either the whole row is written or, if it does not fit, the stream is left
+ * unchanged.
+ * 
+ * @param codec Codec state
+ * @param row One value per column
+ * @return true if the row was written
+ */
+bool ts_codec_put(ts_codec_t *codec, const ts_codec_value_t *row);
+
+/**
+ * @brief Decode the next row
+ * 
+ * @param codec Codec state
+ * @param row Destination, one value per column
+ * @return true if a complete row was decoded
+ */
+bool ts_codec_get(ts_codec_t *codec, ts_codec_value_t *row);
+
+/**
+ * @brief Bytes used by the stream so far (rounded up)
+ */
+size_t ts_codec_bytes(const ts_codec_t *codec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TS_CODEC_H */
@@ -0,0 +1,150 @@
+// smart_plug/components/storage/include/ts_log.h
+#ifndef TS_LOG_H
+#define TS_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Measurement record
+ * 
+ * On flash, records are compressed with ts_codec into page-sized frames
+ * (see ts_log.c). Column order: timestamp (int), voltage, current, power
+ * (float), energy_dwh (int).
+ */
+typedef struct {
+    uint32_t timestamp;     // Epoch seconds
+    float voltage;          // Voltage RMS (V)
+    float current;          // Current RMS (A)
+    float power;            // Active power (W)
+    uint32_t energy_dwh;    // Cumulative energy in 0.1 Wh
+} ts_record_t;
+
+/**
+ * @brief Log statistics (write amplification, compression and throughput)
+ * 
+ * Compression ratio   = bytes_appended / bytes_encoded
+ * Write amplification = (bytes_programmed + sectors_erased * 4096) / bytes_appended
+ */
+typedef struct {
+    uint32_t records_appended;      // Records accepted by ts_log_append()
+    uint32_t records_overwritten;   // Oldest records dropped when the log wrapped
+    uint64_t bytes_appended;        // Uncompressed record bytes
+    uint64_t bytes_encoded;         // Compressed payload bytes in closed frames
+    uint64_t bytes_programmed;      // Bytes written to flash (frames + block headers)
+    uint32_t page_writes;           // Flash program operations
+    uint32_t sectors_erased;        // Flash sector erases
+    uint32_t min_erase_count;       // Lowest per-block erase count
+    uint32_t max_erase_count;       // Highest per-block erase count
+    uint64_t encode_time_us;        // Total time spent compressing records
+    uint64_t write_time_us;         // Total time spent programming
+    uint64_t erase_time_us;         // Total time spent erasing
+    uint32_t write_errors;          // Failed flash operations
+    uint32_t frame_errors;          // Frames skipped on read (bad CRC or length)
+    uint32_t blocks_total;          // Blocks in the partition
+    uint32_t blocks_used;           // Blocks currently holding data
+} ts_log_stats_t;
+
+/**
+ * @brief Mount the log on its partition
+ * 
+ * Scans the block headers once and locates the write position by
+ * binary search over the frames of the newest block.
+ * 
+ * @return true if the partition was found and mounted
+ */
+bool ts_log_init(void);
+
+/**
+ * @brief Append one record (compressed into RAM until the frame fills a page
+ *        or reaches CONFIG_TS_LOG_FRAME_MAX_AGE_S)
+ * 
+ * @param timestamp Epoch seconds (clamped to the newest logged timestamp
+ *                  so the log stays in time order)
+ * @param voltage Voltage RMS (V)
+ * @param current Current RMS (A)
+ * @param power Active power (W)
+ * @param energy_uwh Cumulative energy (micro-Wh, stored as 0.1 Wh)
+ * @return true if accepted
+ */
+bool ts_log_append(uint32_t timestamp, float voltage, float current,
+                   float power, int64_t energy_uwh);
+
+/**
+ * @brief Write any buffered records to flash now
+ * 
+ * @return true if successful
+ */
+bool ts_log_flush(void);
+
+/**
+ * @brief Read records in a time range, oldest first
+ * 
+ * Blocks are found by binary search; inside a block only the frames that
+ * can overlap the range are decompressed.
+ * 
+ * @param from_ts First timestamp (inclusive)
+ * @param to_ts Last timestamp (inclusive)
+ * @param out Destination array
+ * @param max_records Capacity of out
+ * @return size_t Number of records written
+ */
+size_t ts_log_query(uint32_t from_ts, uint32_t to_ts,
+                    ts_record_t *out, size_t max_records);
+
+/**
+ * @brief Read records in a time range, leaving out the first few at from_ts
+ * 
+ * Timestamps repeat (ts_log_append() clamps them), so a reader that stopped
+ * in the middle of a run resumes at its timestamp and skips what it has.
+ * 
+ * @param from_ts First timestamp (inclusive)
+ * @param skip Records stamped from_ts to leave out
+ * @param to_ts Last timestamp (inclusive)
+ * @param out Destination array
+ * @param max_records Capacity of out
+ * @return size_t Number of records written
+ */
+size_t ts_log_query_from(uint32_t from_ts, uint32_t skip, uint32_t to_ts,
+                         ts_record_t *out, size_t max_records);
+
+/**
+ * @brief Compress records in the log's frame format
+ * 
+ * Used for backfill uploads so the wire and flash formats match. Stops at
+ * the first record that does not fit.
+ * 
+ * @param records Records to encode
+ * @param count Number of records
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @param encoded Number of records written (may be NULL)
+ * @return size_t Bytes used in buf
+ */
+size_t ts_log_encode(const ts_record_t *records, size_t count,
+                     uint8_t *buf, size_t len, size_t *encoded);
+
+/**
+ * @brief Erase the whole log
+ * 
+ * @return true if successful
+ */
+bool ts_log_erase(void);
+
+/**
+ * @brief Get log statistics
+ * 
+ * @param stats Destination
+ */
+void ts_log_get_stats(ts_log_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TS_LOG_H */
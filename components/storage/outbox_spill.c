@@ -0,0 +1,400 @@
+// smart_plug/components/storage/outbox_spill.c
+#include "outbox_spill.h"
+#include <stddef.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "OUTBOX_SPILL";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_OUTBOX_SPILL_PARTITION_LABEL
+#define CONFIG_OUTBOX_SPILL_PARTITION_LABEL "outbox"
+#endif
+
+/*===============================================================================
+  Flash Layout
+
+  The partition is a FIFO ring of 4 KB sectors. Each sector starts with a
+  header carrying a sequence number, followed by variable-length records
+  packed on 4-byte boundaries; records never span sectors, so an erased
+  marker ends a sector. A record is released by programming its state word
+  to zero, which needs no erase. When the ring is full the oldest sector is
+  erased for reuse.
+  ===============================================================================*/
+
+#define OS_SECTOR_SIZE          4096
+#define OS_SECTOR_MAGIC         0x4F425831  // "OBX1"
+#define OS_RECORD_MARKER        0xA5
+#define OS_ERASED_MARKER        0xFF
+#define OS_STATE_PENDING        0xFFFFFFFF
+#define OS_STATE_RELEASED       0x00000000
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;           // Monotonic sector sequence number
+    uint32_t reserved;      // Left erased
+    uint32_t crc;           // CRC32 of the fields above
+} os_sector_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t marker;         // OS_RECORD_MARKER (0xFF = erased)
+    uint8_t tag;
+    uint16_t length;        // Payload bytes
+    uint32_t crc;           // CRC32 of marker, tag, length and the payload
+    uint32_t state;         // OS_STATE_PENDING until released
+} os_record_header_t;
+
+_Static_assert(sizeof(os_sector_header_t) == 16, "sector header must be 16 bytes");
+_Static_assert(sizeof(os_record_header_t) == 12, "record header must be 12 bytes");
+
+#define OS_MAX_PAYLOAD  (OS_SECTOR_SIZE - sizeof(os_sector_header_t) - sizeof(os_record_header_t))
+
+/*===============================================================================
+  Static Variables
+
+  Only used from the MQTT task, so nothing here is locked.
+  ===============================================================================*/
+
+static const esp_partition_t *partition = NULL;
+static uint32_t sector_count = 0;
+static uint32_t next_seq = 1;
+
+static uint32_t head_sector = 0;        // Sector of the next write
+static uint32_t head_offset = 0;        // 0 = head sector not opened yet
+static uint32_t tail_sector = 0;        // Oldest pending record
+static uint32_t tail_offset = 0;
+
+// Record returned by the last peek, checked again before it is released
+static uint32_t peeked_size = 0;        // 0 = none
+static uint32_t peeked_sector = 0;
+static uint32_t peeked_offset = 0;
+static uint32_t peeked_seq = 0;         // Sequence number of its sector
+
+static outbox_spill_stats_t stats = {0};
+
+/*===============================================================================
+  Flash Helpers
+  ===============================================================================*/
+
+static uint32_t record_size(uint16_t length)
+{
+    return (sizeof(os_record_header_t) + length + 3) & ~3u;
+}
+
+static size_t sector_offset(uint32_t sector)
+{
+    return (size_t)sector * OS_SECTOR_SIZE;
+}
+
+static uint32_t sector_header_crc(const os_sector_header_t *hdr)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(os_sector_header_t, crc));
+}
+
+static uint32_t record_crc(const os_record_header_t *hdr, const void *data)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(os_record_header_t, crc));
+    return esp_rom_crc32_le(crc, data, hdr->length);
+}
+
+static bool read_sector_header(uint32_t sector, os_sector_header_t *hdr)
+{
+    return esp_partition_read(partition, sector_offset(sector), hdr, sizeof(*hdr)) == ESP_OK &&
+           hdr->magic == OS_SECTOR_MAGIC && hdr->crc == sector_header_crc(hdr);
+}
+
+// false at the end of the written part of a sector
+static bool read_record_header(uint32_t sector, uint32_t offset, os_record_header_t *hdr)
+{
+    if (offset + sizeof(*hdr) > OS_SECTOR_SIZE) return false;
+    if (esp_partition_read(partition, sector_offset(sector) + offset, hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->marker == OS_RECORD_MARKER && hdr->length <= OS_MAX_PAYLOAD;
+}
+
+static uint32_t count_pending(uint32_t sector, uint32_t offset, uint32_t *first)
+{
+    uint32_t count = 0;
+    os_record_header_t hdr;
+    while (read_record_header(sector, offset, &hdr)) {
+        if (hdr.state == OS_STATE_PENDING) {
+            if (count == 0 && first) *first = offset;
+            count++;
+        }
+        offset += record_size(hdr.length);
+    }
+    return count;
+}
+
+// Erase the sector after the head and start writing there
+static bool open_next_sector(void)
+{
+    uint32_t next = head_offset == 0 ? head_sector : (head_sector + 1) % sector_count;
+    
+    // Ring full: the oldest sector is overwritten
+    if (stats.pending > 0 && next == tail_sector && head_offset != 0) {
+        uint32_t lost = count_pending(tail_sector, tail_offset, NULL);
+        stats.records_dropped += lost;
+        stats.pending -= lost < stats.pending ? lost : stats.pending;
+        if (peeked_size != 0 && peeked_sector == tail_sector) {
+            peeked_size = 0;            // The caller learns through outbox_spill_peeked()
+        }
+        tail_sector = (tail_sector + 1) % sector_count;
+        tail_offset = sizeof(os_sector_header_t);
+        ESP_LOGW(TAG, "Spill ring full, dropped %lu messages", (unsigned long)lost);
+    }
+    
+    // The sector is used up either way, so a failed write does not retry it forever
+    head_sector = next;
+    head_offset = OS_SECTOR_SIZE;
+    
+    esp_err_t err = esp_partition_erase_range(partition, sector_offset(next), OS_SECTOR_SIZE);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of sector %lu failed: %s", (unsigned long)next, esp_err_to_name(err));
+        stats.write_errors++;
+        return false;
+    }
+    stats.sectors_erased++;
+    
+    os_sector_header_t hdr = {
+        .magic = OS_SECTOR_MAGIC,
+        .seq = next_seq++,
+        .reserved = 0xFFFFFFFF,
+    };
+    hdr.crc = sector_header_crc(&hdr);
+    if (esp_partition_write(partition, sector_offset(next), &hdr, sizeof(hdr)) != ESP_OK) {
+        stats.write_errors++;
+        return false;
+    }
+    
+    head_offset = sizeof(os_sector_header_t);
+    return true;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool outbox_spill_init(void)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         CONFIG_OUTBOX_SPILL_PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGE(TAG, "Partition '%s' not found", CONFIG_OUTBOX_SPILL_PARTITION_LABEL);
+        return false;
+    }
+    
+    sector_count = partition->size / OS_SECTOR_SIZE;
+    if (sector_count < 2) {
+        ESP_LOGE(TAG, "Partition too small (%lu bytes)", (unsigned long)partition->size);
+        partition = NULL;
+        return false;
+    }
+    
+    // Newest sector = highest sequence number
+    uint32_t max_seq = 0;
+    bool found = false;
+    for (uint32_t s = 0; s < sector_count; s++) {
+        os_sector_header_t hdr;
+        if (read_sector_header(s, &hdr) && (!found || hdr.seq > max_seq)) {
+            max_seq = hdr.seq;
+            head_sector = s;
+            found = true;
+        }
+    }
+    
+    stats.pending = 0;
+    if (!found) {
+        head_sector = 0;
+        head_offset = 0;
+        tail_sector = 0;
+        tail_offset = 0;
+        next_seq = 1;
+        ESP_LOGI(TAG, "Mounted '%s': empty", partition->label);
+        return true;
+    }
+    next_seq = max_seq + 1;
+    
+    // Write position: first erased record slot of the newest sector. Anything
+    // unreadable (a torn write) closes the sector.
+    head_offset = sizeof(os_sector_header_t);
+    os_record_header_t rec;
+    while (read_record_header(head_sector, head_offset, &rec)) {
+        head_offset += record_size(rec.length);
+    }
+    if (head_offset + sizeof(rec) <= OS_SECTOR_SIZE && rec.marker != OS_ERASED_MARKER) {
+        head_offset = OS_SECTOR_SIZE;
+    }
+    
+    // Oldest sector first, ending with the head
+    bool have_tail = false;
+    for (uint32_t k = 1; k <= sector_count; k++) {
+        uint32_t s = (head_sector + k) % sector_count;
+        os_sector_header_t hdr;
+        if (!read_sector_header(s, &hdr) || hdr.seq > max_seq || max_seq - hdr.seq >= sector_count) {
+            continue;
+        }
+        
+        uint32_t first = 0;
+        uint32_t count = count_pending(s, sizeof(os_sector_header_t), &first);
+        if (count > 0 && !have_tail) {
+            tail_sector = s;
+            tail_offset = first;
+            have_tail = true;
+        }
+        stats.pending += count;
+    }
+    if (!have_tail) {
+        tail_sector = head_sector;
+        tail_offset = head_offset;
+    }
+    
+    ESP_LOGI(TAG, "Mounted '%s': %lu messages pending", partition->label,
+             (unsigned long)stats.pending);
+    return true;
+}
+
+bool outbox_spill_push(uint8_t tag, const void *data, size_t len)
+{
+    if (!partition) return false;
+    
+    if (len > OS_MAX_PAYLOAD) {
+        stats.records_dropped++;
+        return false;
+    }
+    
+    uint32_t size = record_size(len);
+    if (head_offset == 0 || head_offset + size > OS_SECTOR_SIZE) {
+        if (!open_next_sector()) return false;
+    }
+    
+    os_record_header_t hdr = {
+        .marker = OS_RECORD_MARKER,
+        .tag = tag,
+        .length = (uint16_t)len,
+        .state = OS_STATE_PENDING,
+    };
+    hdr.crc = record_crc(&hdr, data);
+    
+    // The slot is consumed even if the write failed
+    uint32_t offset = head_offset;
+    head_offset += size;
+    
+    size_t addr = sector_offset(head_sector) + offset;
+    if (esp_partition_write(partition, addr, &hdr, sizeof(hdr)) != ESP_OK ||
+        esp_partition_write(partition, addr + sizeof(hdr), data, len) != ESP_OK) {
+        ESP_LOGE(TAG, "Write failed");
+        stats.write_errors++;
+        return false;
+    }
+    
+    if (stats.pending == 0) {
+        tail_sector = head_sector;
+        tail_offset = offset;
+    }
+    stats.pending++;
+    stats.records_written++;
+    return true;
+}
+
+size_t outbox_spill_peek(uint8_t *tag, void *buf, size_t size)
+{
+    peeked_size = 0;
+    if (!partition) return 0;
+    
+    while (stats.pending > 0) {
+        if (tail_sector == head_sector && tail_offset >= head_offset) break;
+        
+        os_record_header_t hdr;
+        if (!read_record_header(tail_sector, tail_offset, &hdr)) {
+            if (tail_sector == head_sector) break;
+            tail_sector = (tail_sector + 1) % sector_count;
+            tail_offset = sizeof(os_sector_header_t);
+            continue;
+        }
+        
+        uint32_t rec_size = record_size(hdr.length);
+        if (hdr.state != OS_STATE_PENDING) {
+            tail_offset += rec_size;
+            continue;
+        }
+        
+        if (tag) *tag = hdr.tag;
+        if (size < hdr.length) return hdr.length;
+        
+        size_t addr = sector_offset(tail_sector) + tail_offset + sizeof(hdr);
+        os_sector_header_t sec;
+        if (esp_partition_read(partition, addr, buf, hdr.length) == ESP_OK &&
+            hdr.crc == record_crc(&hdr, buf) && read_sector_header(tail_sector, &sec)) {
+            peeked_size = rec_size;
+            peeked_sector = tail_sector;
+            peeked_offset = tail_offset;
+            peeked_seq = sec.seq;
+            return hdr.length;
+        }
+        
+        // Corrupt: skip it
+        stats.records_dropped++;
+        stats.pending--;
+        tail_offset += rec_size;
+    }
+    
+    // Nothing readable left
+    stats.pending = 0;
+    return 0;
+}
+
+void outbox_spill_pop(void)
+{
+    if (!partition || peeked_size == 0) return;
+    
+    uint32_t size = peeked_size;
+    peeked_size = 0;
+    
+    // Only release the record that was peeked: same sector generation, still
+    // pending, same size
+    os_sector_header_t sec;
+    os_record_header_t hdr;
+    if (!read_sector_header(peeked_sector, &sec) || sec.seq != peeked_seq ||
+        !read_record_header(peeked_sector, peeked_offset, &hdr) ||
+        hdr.state != OS_STATE_PENDING || record_size(hdr.length) != size) {
+        ESP_LOGW(TAG, "Peeked record is gone, not released");
+        return;
+    }
+    
+    uint32_t released = OS_STATE_RELEASED;
+    size_t addr = sector_offset(peeked_sector) + peeked_offset + offsetof(os_record_header_t, state);
+    if (esp_partition_write(partition, addr, &released, sizeof(released)) != ESP_OK) {
+        stats.write_errors++;
+    }
+    
+    if (tail_sector == peeked_sector && tail_offset == peeked_offset) {
+        tail_offset += size;
+    }
+    if (stats.pending > 0) stats.pending--;
+    stats.records_read++;
+}
+
+bool outbox_spill_peeked(void)
+{
+    return peeked_size != 0;
+}
+
+uint32_t outbox_spill_pending(void)
+{
+    return stats.pending;
+}
+
+void outbox_spill_get_stats(outbox_spill_stats_t *out)
+{
+    if (!out) return;
+    
+    *out = stats;
+    out->sector_count = sector_count;
+}
@@ -0,0 +1,103 @@
+// smart_plug/components/storage/rtc_state.c
+#include "rtc_state.h"
+#include <stddef.h>
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "RTC_STATE";
+
+/*===============================================================================
+  RTC Block
+
+  Lives in RTC slow memory without initialisation, so it keeps its contents
+  across every reset except power-on. The CRC rejects the random contents
+  left after power-up and any update interrupted by a reset.
+  ===============================================================================*/
+
+#define RTC_STATE_MAGIC     0x52544353  // "RTCS"
+#define RTC_STATE_VERSION   1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t relay_on;
+    int64_t energy_uwh;
+    int64_t uptime_us;
+    uint32_t epoch_s;
+    uint32_t restores;
+    uint32_t crc;           // CRC32 of the fields above
+} rtc_block_t;
+
+static RTC_NOINIT_ATTR rtc_block_t rtc_block;
+static portMUX_TYPE rtc_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t restores = 0;
+
+static uint32_t block_crc(const rtc_block_t *block)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)block, offsetof(rtc_block_t, crc));
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool rtc_state_restore(rtc_state_t *state)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    
+    // RTC memory is undefined after power-up even if the CRC happens to match
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_UNKNOWN) {
+        rtc_state_invalidate();
+        return false;
+    }
+    
+    if (rtc_block.magic != RTC_STATE_MAGIC || rtc_block.version != RTC_STATE_VERSION ||
+        rtc_block.crc != block_crc(&rtc_block)) {
+        ESP_LOGW(TAG, "No valid RTC state after reset reason %d", reason);
+        return false;
+    }
+    
+    restores = rtc_block.restores + 1;
+    
+    if (state) {
+        state->energy_uwh = rtc_block.energy_uwh;
+        state->relay_on = rtc_block.relay_on != 0;
+        state->epoch_s = rtc_block.epoch_s;
+        state->uptime_us = rtc_block.uptime_us;
+        state->restores = restores;
+    }
+    
+    ESP_LOGI(TAG, "Restored after reset reason %d: %lld uWh, relay %s (restore #%lu)",
+             reason, (long long)rtc_block.energy_uwh, rtc_block.relay_on ? "ON" : "OFF",
+             (unsigned long)restores);
+    return true;
+}
+
+void rtc_state_update(int64_t energy_uwh, bool relay_on, uint32_t epoch_s)
+{
+    int64_t now_us = esp_timer_get_time();
+    
+    portENTER_CRITICAL(&rtc_lock);
+    rtc_block.magic = RTC_STATE_MAGIC;
+    rtc_block.version = RTC_STATE_VERSION;
+    rtc_block.relay_on = relay_on ? 1 : 0;
+    rtc_block.energy_uwh = energy_uwh;
+    rtc_block.uptime_us = now_us;
+    rtc_block.epoch_s = epoch_s;
+    rtc_block.restores = restores;
+    rtc_block.crc = block_crc(&rtc_block);
+    portEXIT_CRITICAL(&rtc_lock);
+}
+
+void rtc_state_invalidate(void)
+{
+    portENTER_CRITICAL(&rtc_lock);
+    rtc_block.magic = 0;
+    rtc_block.crc = 0;
+    portEXIT_CRITICAL(&rtc_lock);
+}
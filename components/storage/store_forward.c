@@ -0,0 +1,303 @@
+// smart_plug/components/storage/store_forward.c
+#include "store_forward.h"
+#include "ts_log.h"
+#include "json_writer.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "nvs_flash.h"
+
+static const char *TAG = "STORE_FWD";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_THING_NAME
+#define CONFIG_THING_NAME "Smart_Plug_1"
+#endif
+
+#ifndef CONFIG_NVS_NS_METER_DATA
+#define CONFIG_NVS_NS_METER_DATA "meter_data"
+#endif
+
+#ifndef CONFIG_SF_BATCH_RECORDS
+#define CONFIG_SF_BATCH_RECORDS 50
+#endif
+
+#ifndef CONFIG_SF_REPLAY_INTERVAL_MS
+#define CONFIG_SF_REPLAY_INTERVAL_MS 2000
+#endif
+
+// A batch without a PUBACK by then was dropped by the outbox and is built again
+#define BATCH_ACK_TIMEOUT_US    (300LL * 1000000)
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+static store_forward_publish_t publish_fn = NULL;
+static store_forward_stats_t stats = {0};
+
+// Backlog range in the time-series log: [pending_from, pending_to].
+// pending_to == 0 means the outage is still ongoing. Timestamps repeat, so
+// replay resumes at the last one sent and skips the records already sent
+// with it.
+static uint32_t pending_from = 0;
+static uint32_t pending_to = 0;
+static uint32_t pending_skip = 0;
+
+static int64_t last_replay_us = 0;
+
+// The batch waiting for its PUBACK. The cursor only moves when it arrives,
+// so nothing is lost with a batch the outbox drops; a reboot in between
+// sends it again (at-least-once).
+static struct {
+    bool active;
+    uint32_t crc;                   // Identifies the acked payload
+    size_t len;
+    int64_t sent_us;
+    uint32_t count;                 // Records in the batch
+    bool last;                      // Short batch: the range is done once it lands
+    uint32_t next_from;             // Cursor after the batch
+    uint32_t next_skip;
+} inflight;
+
+static ts_record_t batch[CONFIG_SF_BATCH_RECORDS];
+
+// Compressed batch (usually well under the raw size) and the message
+// carrying it as base64, with room for the fixed members
+static uint8_t batch_bin[CONFIG_SF_BATCH_RECORDS * sizeof(ts_record_t)];
+static char batch_json[((sizeof(batch_bin) + 2) / 3) * 4 + 256];
+
+/*===============================================================================
+  NVS Persistence
+  ===============================================================================*/
+
+static void save_range(void)
+{
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(CONFIG_NVS_NS_METER_DATA, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
+        return;
+    }
+    
+    nvs_set_u32(nvs, "sf_from", pending_from);
+    nvs_set_u32(nvs, "sf_to", pending_to);
+    nvs_set_u32(nvs, "sf_skip", pending_skip);
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void load_range(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(CONFIG_NVS_NS_METER_DATA, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    
+    if (nvs_get_u32(nvs, "sf_from", &pending_from) != ESP_OK) {
+        pending_from = 0;
+    }
+    if (nvs_get_u32(nvs, "sf_to", &pending_to) != ESP_OK) {
+        pending_to = 0;
+    }
+    if (nvs_get_u32(nvs, "sf_skip", &pending_skip) != ESP_OK) {
+        pending_skip = 0;
+    }
+    nvs_close(nvs);
+}
+
+/*===============================================================================
+  Batch Encoding
+  ===============================================================================*/
+
+// Returns the JSON payload in batch_json; *count is reduced if the batch did not fit
+static const char *build_batch(const ts_record_t *records, size_t *count, size_t *len)
+{
+    size_t encoded = 0;
+    size_t bin_len = ts_log_encode(records, *count, batch_bin, sizeof(batch_bin), &encoded);
+    if (encoded == 0) return NULL;
+    
+    json_writer_t w;
+    json_writer_init(&w, batch_json, sizeof(batch_json));
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device_id", CONFIG_THING_NAME);
+    json_writer_bool(&w, "backfill", true);
+    
+    // Column order and types of the encoded rows (see ts_codec.h)
+    json_writer_string(&w, "encoding", "tsc1");
+    json_writer_begin_array(&w, "fields");
+    json_writer_string(&w, NULL, "timestamp:int");
+    json_writer_string(&w, NULL, "rms_v:float");
+    json_writer_string(&w, NULL, "rms_a:float");
+    json_writer_string(&w, NULL, "active_w:float");
+    json_writer_string(&w, NULL, "cumulative_dwh:int");
+    json_writer_end_array(&w);
+    
+    json_writer_int(&w, "count", encoded);
+    json_writer_base64(&w, "data", batch_bin, bin_len);
+    json_writer_end_object(&w);
+    
+    const char *json = json_writer_finish(&w, len);
+    if (!json) return NULL;
+    
+    stats.bytes_raw += encoded * sizeof(ts_record_t);
+    stats.bytes_encoded += bin_len;
+    *count = encoded;
+    return json;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool store_forward_init(store_forward_publish_t publish)
+{
+    publish_fn = publish;
+    load_range();
+    
+    if (pending_from != 0) {
+        ESP_LOGI(TAG, "Backlog pending from %lu to %lu",
+                 (unsigned long)pending_from, (unsigned long)pending_to);
+    }
+    return true;
+}
+
+bool store_forward_capture(uint32_t timestamp, float voltage, float current,
+                           float power, int64_t energy_uwh)
+{
+    if (timestamp == 0) return false;
+    
+    if (!ts_log_append(timestamp, voltage, current, power, energy_uwh)) {
+        return false;
+    }
+    stats.records_captured++;
+    
+    // First record of a new outage: remember where replay has to start
+    if (pending_from == 0) {
+        pending_from = timestamp;
+        pending_to = 0;
+        pending_skip = 0;
+        save_range();
+        ESP_LOGI(TAG, "Offline, capturing telemetry from %lu", (unsigned long)timestamp);
+    } else if (pending_to != 0) {
+        // Outage while a previous backlog is still replaying: extend it
+        pending_to = 0;
+        save_range();
+    }
+    
+    return true;
+}
+
+void store_forward_handle(bool connected, uint32_t now)
+{
+    if (!connected || pending_from == 0 || !publish_fn) return;
+    
+    // Outage over: everything up to now belongs to the backlog
+    if (pending_to == 0) {
+        if (now == 0) return;
+        pending_to = now;
+        ts_log_flush();
+        save_range();
+        ESP_LOGI(TAG, "Reconnected, replaying %lu..%lu",
+                 (unsigned long)pending_from, (unsigned long)pending_to);
+    }
+    
+    int64_t now_us = esp_timer_get_time();
+    if (inflight.active) {
+        if (now_us - inflight.sent_us < BATCH_ACK_TIMEOUT_US) return;
+        
+        ESP_LOGW(TAG, "Backfill batch not acknowledged, sending it again");
+        inflight.active = false;
+        stats.batches_failed++;
+    }
+    if (now_us - last_replay_us < (int64_t)CONFIG_SF_REPLAY_INTERVAL_MS * 1000) {
+        return;
+    }
+    last_replay_us = now_us;
+    
+    size_t queried = ts_log_query_from(pending_from, pending_skip, pending_to,
+                                       batch, CONFIG_SF_BATCH_RECORDS);
+    if (queried == 0) {
+        ESP_LOGI(TAG, "Backlog replay complete (%lu records)",
+                 (unsigned long)stats.records_replayed);
+        pending_from = 0;
+        pending_to = 0;
+        pending_skip = 0;
+        save_range();
+        return;
+    }
+    
+    size_t count = queried;
+    size_t len = 0;
+    const char *payload = build_batch(batch, &count, &len);
+    if (!payload) {
+        ESP_LOGE(TAG, "Failed to build backfill batch");
+        return;
+    }
+    
+    inflight.crc = esp_rom_crc32_le(0, (const uint8_t *)payload, len);
+    inflight.len = len;
+    if (!publish_fn(payload, len)) {
+        stats.batches_failed++;
+        return;
+    }
+    
+    // Resume at the last timestamp sent, past the records already sent with it
+    uint32_t last_ts = batch[count - 1].timestamp;
+    uint32_t sent_at_last = 0;
+    for (size_t i = count; i > 0 && batch[i - 1].timestamp == last_ts; i--) {
+        sent_at_last++;
+    }
+    inflight.next_skip = (last_ts == pending_from) ? pending_skip + sent_at_last : sent_at_last;
+    inflight.next_from = last_ts;
+    inflight.count = count;
+    inflight.last = (count == queried && queried < CONFIG_SF_BATCH_RECORDS);
+    inflight.sent_us = now_us;
+    inflight.active = true;
+}
+
+void store_forward_acked(const void *payload, size_t len)
+{
+    // Only the batch in flight; a copy left over from before a reboot or a
+    // resend already counted is ignored
+    if (!inflight.active || len != inflight.len ||
+        esp_rom_crc32_le(0, payload, len) != inflight.crc) {
+        return;
+    }
+    inflight.active = false;
+    
+    stats.batches_sent++;
+    stats.records_replayed += inflight.count;
+    
+    // A short batch that was sent whole emptied the range, unless a new
+    // outage began meanwhile and extended it
+    if (inflight.last && pending_to != 0) {
+        pending_from = 0;
+        pending_to = 0;
+        pending_skip = 0;
+        ESP_LOGI(TAG, "Backlog replay complete (%lu records)",
+                 (unsigned long)stats.records_replayed);
+    } else {
+        pending_from = inflight.next_from;
+        pending_skip = inflight.next_skip;
+    }
+    save_range();
+}
+
+bool store_forward_pending(void)
+{
+    return pending_from != 0;
+}
+
+void store_forward_get_stats(store_forward_stats_t *out)
+{
+    if (!out) return;
+    
+    *out = stats;
+    out->pending_from = pending_from;
+    out->pending_to = pending_to;
+}
@@ -0,0 +1,235 @@
+// smart_plug/components/storage/ts_codec.c
+#include "ts_codec.h"
+#include <string.h>
+
+#define NO_WINDOW 0xFF
+
+/*===============================================================================
+  Bit Stream
+  ===============================================================================*/
+
+static bool put_bits(ts_codec_t *c, uint64_t value, unsigned nbits)
+{
+    if (c->bit_pos + nbits > c->cap_bits) {
+        return false;
+    }
+    
+    // MSB first
+    while (nbits > 0) {
+        size_t byte = c->bit_pos >> 3;
+        unsigned used = c->bit_pos & 7;
+        unsigned space = 8 - used;
+        unsigned take = (nbits < space) ? nbits : space;
+        uint8_t chunk = (uint8_t)((value >> (nbits - take)) & ((1u << take) - 1));
+        
+        if (used == 0) {
+            c->buf[byte] = 0;
+        }
+        c->buf[byte] |= (uint8_t)(chunk << (space - take));
+        
+        c->bit_pos += take;
+        nbits -= take;
+    }
+    return true;
+}
+
+static bool get_bits(ts_codec_t *c, unsigned nbits, uint64_t *value)
+{
+    if (c->bit_pos + nbits > c->cap_bits) {
+        return false;
+    }
+    
+    uint64_t v = 0;
+    while (nbits > 0) {
+        size_t byte = c->bit_pos >> 3;
+        unsigned used = c->bit_pos & 7;
+        unsigned space = 8 - used;
+        unsigned take = (nbits < space) ? nbits : space;
+        uint8_t chunk = (uint8_t)((c->buf[byte] >> (space - take)) & ((1u << take) - 1));
+        
+        v = (v << take) | chunk;
+        c->bit_pos += take;
+        nbits -= take;
+    }
+    *value = v;
+    return true;
+}
+
+/*===============================================================================
+  Integer Channel: delta + zigzag + varint
+  ===============================================================================*/
+
+static bool put_int(ts_codec_t *c, int col, int64_t value)
+{
+    int64_t delta = (int64_t)((uint64_t)value - (uint64_t)c->prev_int[col]);
+    uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    
+    do {
+        uint8_t group = zz & 0x7F;
+        zz >>= 7;
+        if (zz) group |= 0x80;
+        if (!put_bits(c, group, 8)) return false;
+    } while (zz);
+    
+    c->prev_int[col] = value;
+    return true;
+}
+
+static bool get_int(ts_codec_t *c, int col, int64_t *value)
+{
+    uint64_t zz = 0;
+    unsigned shift = 0;
+    uint64_t group;
+    
+    do {
+        if (shift > 63 || !get_bits(c, 8, &group)) return false;
+        zz |= (group & 0x7F) << shift;
+        shift += 7;
+    } while (group & 0x80);
+    
+    int64_t delta = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+    *value = (int64_t)((uint64_t)c->prev_int[col] + (uint64_t)delta);
+    c->prev_int[col] = *value;
+    return true;
+}
+
+/*===============================================================================
+  Float Channel: Gorilla XOR
+  ===============================================================================*/
+
+static bool put_float(ts_codec_t *c, int col, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t x = bits ^ c->prev_float[col];
+    
+    if (x == 0) {
+        return put_bits(c, 0, 1);
+    }
+    
+    unsigned lead = __builtin_clz(x);
+    unsigned trail = __builtin_ctz(x);
+    if (lead > 31) lead = 31;
+    
+    uint8_t plead = c->prev_lead[col];
+    uint8_t ptrail = c->prev_trail[col];
+    
+    if (plead != NO_WINDOW && lead >= plead && trail >= ptrail) {
+        // Reuse the previous window
+        unsigned len = 32 - plead - ptrail;
+        if (!put_bits(c, 0x2, 2)) return false;
+        if (!put_bits(c, x >> ptrail, len)) return false;
+    } else {
+        unsigned len = 32 - lead - trail;
+        if (!put_bits(c, 0x3, 2)) return false;
+        if (!put_bits(c, lead, 5)) return false;
+        if (!put_bits(c, len - 1, 5)) return false;
+        if (!put_bits(c, x >> trail, len)) return false;
+        c->prev_lead[col] = lead;
+        c->prev_trail[col] = trail;
+    }
+    
+    c->prev_float[col] = bits;
+    return true;
+}
+
+static bool get_float(ts_codec_t *c, int col, float *value)
+{
+    uint64_t bit, v;
+    uint32_t x = 0;
+    
+    if (!get_bits(c, 1, &bit)) return false;
+    
+    if (bit) {
+        if (!get_bits(c, 1, &bit)) return false;
+        
+        if (bit == 0) {
+            uint8_t plead = c->prev_lead[col];
+            uint8_t ptrail = c->prev_trail[col];
+            if (plead == NO_WINDOW) return false;
+            if (!get_bits(c, 32 - plead - ptrail, &v)) return false;
+            x = (uint32_t)v << ptrail;
+        } else {
+            uint64_t lead, len;
+            if (!get_bits(c, 5, &lead) || !get_bits(c, 5, &len)) return false;
+            len += 1;
+            if (lead + len > 32) return false;
+            if (!get_bits(c, len, &v)) return false;
+            unsigned trail = 32 - lead - len;
+            x = (uint32_t)v << trail;
+            c->prev_lead[col] = lead;
+            c->prev_trail[col] = trail;
+        }
+    }
+    
+    uint32_t bits = c->prev_float[col] ^ x;
+    memcpy(value, &bits, sizeof(bits));
+    c->prev_float[col] = bits;
+    return true;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool ts_codec_init(ts_codec_t *codec, const ts_codec_type_t *types, uint8_t columns,
+                   uint8_t *buf, size_t len)
+{
+    if (!codec || !types || !buf || columns == 0 || columns > TS_CODEC_MAX_COLUMNS) {
+        return false;
+    }
+    
+    memset(codec, 0, sizeof(*codec));
+    memcpy(codec->types, types, columns * sizeof(ts_codec_type_t));
+    memset(codec->prev_lead, NO_WINDOW, sizeof(codec->prev_lead));
+    codec->columns = columns;
+    codec->buf = buf;
+    codec->cap_bits = len * 8;
+    return true;
+}
+
+bool ts_codec_put(ts_codec_t *codec, const ts_codec_value_t *row)
+{
+    if (!codec || !row) return false;
+    
+    // Roll back on overflow so a partial row never lands in the stream
+    ts_codec_t saved = *codec;
+    
+    for (int col = 0; col < codec->columns; col++) {
+        bool ok = (codec->types[col] == TS_CODEC_INT) ?
+                  put_int(codec, col, row[col].i) :
+                  put_float(codec, col, row[col].f);
+        if (!ok) {
+            // put_bits() may already have filled the rest of the current byte
+            *codec = saved;
+            unsigned used = codec->bit_pos & 7;
+            if (used) {
+                codec->buf[codec->bit_pos >> 3] &= (uint8_t)(0xFF << (8 - used));
+            }
+            return false;
+        }
+    }
+    
+    codec->rows++;
+    return true;
+}
+
+bool ts_codec_get(ts_codec_t *codec, ts_codec_value_t *row)
+{
+    if (!codec || !row) return false;
+    
+    for (int col = 0; col < codec->columns; col++) {
+        bool ok = (codec->types[col] == TS_CODEC_INT) ?
+                  get_int(codec, col, &row[col].i) :
+                  get_float(codec, col, &row[col].f);
+        if (!ok) return false;
+    }
+    
+    codec->rows++;
+    return true;
+}
+
+size_t ts_codec_bytes(const ts_codec_t *codec)
+{
+    return codec ? (codec->bit_pos + 7) / 8 : 0;
+}
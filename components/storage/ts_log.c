@@ -0,0 +1,661 @@
+// smart_plug/components/storage/ts_log.c
+#include "ts_log.h"
+#include "ts_codec.h"
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "TS_LOG";
+
+/*===============================================================================
+  Configuration (from Kconfig)
+  ===============================================================================*/
+
+#ifndef CONFIG_TS_LOG_PARTITION_LABEL
+#define CONFIG_TS_LOG_PARTITION_LABEL "storage"
+#endif
+
+#ifndef CONFIG_TS_LOG_FRAME_MAX_AGE_S
+#define CONFIG_TS_LOG_FRAME_MAX_AGE_S 1800
+#endif
+
+/*===============================================================================
+  Flash Layout
+
+  The partition is a circular sequence of 4 KB blocks (one flash sector each).
+  Every block starts with a header, followed by one frame per 256-byte flash
+  page. A frame is a header plus ts_codec-compressed records, built in RAM and
+  programmed once it fills its page (or ages out). Frames never span pages,
+  so an erased page marks the write position.
+  ===============================================================================*/
+
+#define TS_BLOCK_SIZE           4096
+#define TS_PAGE_SIZE            256
+#define TS_PAGES_PER_BLOCK      (TS_BLOCK_SIZE / TS_PAGE_SIZE)
+#define TS_BLOCK_MAGIC          0x54534C32  // "TSL2"
+#define TS_FRAME_MARKER         0xA5
+#define TS_ERASED_TS            0xFFFFFFFF
+#define TS_FRAME_MAX_RECORDS    254
+#define TS_RAW_RECORD_SIZE      20          // Uncompressed size (5 x 32-bit)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint32_t seq;           // Monotonic block sequence number
+    uint32_t erase_count;   // Times this sector has been erased by the log
+    uint32_t crc;           // CRC32 of the fields above
+} ts_block_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t marker;         // TS_FRAME_MARKER (0xFF = erased page)
+    uint8_t records;        // Records in the frame
+    uint16_t length;        // Compressed payload bytes
+    uint32_t first_ts;      // Timestamp of the first record
+    uint32_t crc;           // CRC32 of the fields above and the payload
+} ts_frame_header_t;
+
+_Static_assert(sizeof(ts_block_header_t) == 16, "block header must be 16 bytes");
+_Static_assert(sizeof(ts_frame_header_t) == 12, "frame header must be 12 bytes");
+
+typedef struct {
+    uint32_t seq;           // 0 = block holds no valid data
+    uint32_t first_ts;      // Timestamp of the first record (TS_ERASED_TS if empty)
+    uint32_t erase_count;
+} ts_block_info_t;
+
+static const ts_codec_type_t record_columns[] = {
+    TS_CODEC_INT,       // timestamp
+    TS_CODEC_FLOAT,     // voltage
+    TS_CODEC_FLOAT,     // current
+    TS_CODEC_FLOAT,     // power
+    TS_CODEC_INT,       // energy_dwh
+};
+
+#define TS_COLUMNS (sizeof(record_columns) / sizeof(record_columns[0]))
+
+/*===============================================================================
+  Static Variables
+  ===============================================================================*/
+
+static const esp_partition_t *partition = NULL;
+static SemaphoreHandle_t log_mutex = NULL;
+static ts_block_info_t *blocks = NULL;
+static uint32_t block_count = 0;
+
+static uint32_t cur_block = 0;          // Block being filled
+static uint32_t cur_page = 0;           // Next free page in cur_block
+static bool block_open = false;
+static uint32_t max_seq = 0;
+static uint32_t last_ts = 0;            // Newest timestamp in the log
+
+static uint8_t frame_buf[TS_PAGE_SIZE]; // Frame being built for cur_page
+static ts_codec_t frame_codec;
+static ts_frame_header_t frame_hdr;     // frame_hdr.records == 0: nothing staged
+
+static uint8_t read_buf[TS_PAGE_SIZE];  // Page read buffer (under log_mutex)
+
+static ts_log_stats_t stats = {0};
+
+/*===============================================================================
+  Record Conversion
+  ===============================================================================*/
+
+static void record_to_row(const ts_record_t *rec, ts_codec_value_t *row)
+{
+    row[0].i = rec->timestamp;
+    row[1].f = rec->voltage;
+    row[2].f = rec->current;
+    row[3].f = rec->power;
+    row[4].i = rec->energy_dwh;
+}
+
+static void row_to_record(const ts_codec_value_t *row, ts_record_t *rec)
+{
+    rec->timestamp = (uint32_t)row[0].i;
+    rec->voltage = row[1].f;
+    rec->current = row[2].f;
+    rec->power = row[3].f;
+    rec->energy_dwh = (uint32_t)row[4].i;
+}
+
+/*===============================================================================
+  Flash Helpers
+  ===============================================================================*/
+
+static uint32_t header_crc(const ts_block_header_t *hdr)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(ts_block_header_t, crc));
+}
+
+static uint32_t frame_crc(const ts_frame_header_t *hdr, const uint8_t *payload)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)hdr, offsetof(ts_frame_header_t, crc));
+    return esp_rom_crc32_le(crc, payload, hdr->length);
+}
+
+static size_t block_offset(uint32_t block)
+{
+    return (size_t)block * TS_BLOCK_SIZE;
+}
+
+// Page 0 shares its space with the block header
+static size_t frame_offset(uint32_t block, uint32_t page)
+{
+    return block_offset(block) + (size_t)page * TS_PAGE_SIZE +
+           (page == 0 ? sizeof(ts_block_header_t) : 0);
+}
+
+static size_t frame_payload_cap(uint32_t page)
+{
+    return TS_PAGE_SIZE - sizeof(ts_frame_header_t) - (page == 0 ? sizeof(ts_block_header_t) : 0);
+}
+
+static bool read_frame_header(uint32_t block, uint32_t page, ts_frame_header_t *hdr)
+{
+    if (esp_partition_read(partition, frame_offset(block, page), hdr, sizeof(*hdr)) != ESP_OK) {
+        return false;
+    }
+    return hdr->marker == TS_FRAME_MARKER;
+}
+
+static bool program(size_t offset, const void *data, size_t len)
+{
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_write(partition, offset, data, len);
+    stats.write_time_us += esp_timer_get_time() - start;
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Write failed at 0x%x: %s", (unsigned)offset, esp_err_to_name(err));
+        stats.write_errors++;
+        return false;
+    }
+    
+    stats.page_writes++;
+    stats.bytes_programmed += len;
+    return true;
+}
+
+// Count written frames in a block: pages are filled in order, so find the first erased one
+static uint32_t used_pages(uint32_t block)
+{
+    uint32_t lo = 0, hi = TS_PAGES_PER_BLOCK;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        ts_frame_header_t hdr;
+        if (esp_partition_read(partition, frame_offset(block, mid), &hdr, sizeof(hdr)) != ESP_OK ||
+            hdr.marker == 0xFF) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+static uint32_t count_records(uint32_t block)
+{
+    uint32_t n = 0;
+    uint32_t pages = used_pages(block);
+    for (uint32_t p = 0; p < pages; p++) {
+        ts_frame_header_t hdr;
+        if (read_frame_header(block, p, &hdr)) {
+            n += hdr.records;
+        }
+    }
+    return n;
+}
+
+/*===============================================================================
+  Frame Decoding
+  ===============================================================================*/
+
+static bool load_frame(uint32_t block, uint32_t page, const ts_frame_header_t *hdr)
+{
+    if (hdr->length > frame_payload_cap(page)) {
+        stats.frame_errors++;
+        return false;
+    }
+    
+    size_t offset = frame_offset(block, page) + sizeof(ts_frame_header_t);
+    if (esp_partition_read(partition, offset, read_buf, hdr->length) != ESP_OK) {
+        return false;
+    }
+    
+    // A torn write (power lost while programming) fails the CRC
+    if (frame_crc(hdr, read_buf) != hdr->crc) {
+        stats.frame_errors++;
+        return false;
+    }
+    return true;
+}
+
+// Decode records in [from_ts, to_ts], passing over the first *skip of those
+// at from_ts; returns true once a record past to_ts is seen
+static bool decode_frame(const ts_frame_header_t *hdr, uint8_t *payload,
+                         uint32_t from_ts, uint32_t to_ts, uint32_t *skip,
+                         ts_record_t *out, size_t *n, size_t max_records)
+{
+    ts_codec_t codec;
+    ts_codec_init(&codec, record_columns, TS_COLUMNS, payload, hdr->length);
+    
+    for (uint32_t i = 0; i < hdr->records && *n < max_records; i++) {
+        ts_codec_value_t row[TS_COLUMNS];
+        if (!ts_codec_get(&codec, row)) {
+            stats.frame_errors++;
+            break;
+        }
+        
+        ts_record_t rec;
+        row_to_record(row, &rec);
+        if (rec.timestamp > to_ts) return true;
+        if (rec.timestamp < from_ts) continue;
+        
+        if (*skip > 0 && rec.timestamp == from_ts) {
+            (*skip)--;
+            continue;
+        }
+        *skip = 0;
+        out[(*n)++] = rec;
+    }
+    return false;
+}
+
+/*===============================================================================
+  Write Path
+  ===============================================================================*/
+
+static void start_frame(void)
+{
+    memset(&frame_hdr, 0, sizeof(frame_hdr));
+    ts_codec_init(&frame_codec, record_columns, TS_COLUMNS,
+                  frame_buf, frame_payload_cap(cur_page));
+}
+
+static bool flush_frame(void)
+{
+    if (frame_hdr.records == 0) return true;
+    
+    frame_hdr.marker = TS_FRAME_MARKER;
+    frame_hdr.length = ts_codec_bytes(&frame_codec);
+    frame_hdr.crc = frame_crc(&frame_hdr, frame_buf);
+    
+    // Header and payload go out in a single page program
+    static uint8_t page[TS_PAGE_SIZE];
+    memcpy(page, &frame_hdr, sizeof(frame_hdr));
+    memcpy(page + sizeof(frame_hdr), frame_buf, frame_hdr.length);
+    
+    bool ok = program(frame_offset(cur_block, cur_page), page,
+                      sizeof(frame_hdr) + frame_hdr.length);
+    stats.bytes_encoded += frame_hdr.length;
+    
+    // Never reuse a page, even after a failed program
+    cur_page++;
+    frame_hdr.records = 0;
+    return ok;
+}
+
+static bool open_block(uint32_t block)
+{
+    ts_block_header_t old;
+    uint32_t erase_count = 0;
+    
+    if (esp_partition_read(partition, block_offset(block), &old, sizeof(old)) == ESP_OK &&
+        old.magic == TS_BLOCK_MAGIC && old.crc == header_crc(&old)) {
+        erase_count = old.erase_count;
+        if (blocks[block].seq != 0) {
+            stats.records_overwritten += count_records(block);
+        }
+    }
+    
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_partition_erase_range(partition, block_offset(block), TS_BLOCK_SIZE);
+    stats.erase_time_us += esp_timer_get_time() - start;
+    
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of block %lu failed: %s", (unsigned long)block, esp_err_to_name(err));
+        stats.write_errors++;
+        blocks[block].seq = 0;
+        return false;
+    }
+    stats.sectors_erased++;
+    
+    ts_block_header_t hdr = {
+        .magic = TS_BLOCK_MAGIC,
+        .seq = ++max_seq,
+        .erase_count = erase_count + 1,
+    };
+    hdr.crc = header_crc(&hdr);
+    
+    if (!program(block_offset(block), &hdr, sizeof(hdr))) {
+        blocks[block].seq = 0;
+        return false;
+    }
+    
+    blocks[block].seq = hdr.seq;
+    blocks[block].first_ts = TS_ERASED_TS;
+    blocks[block].erase_count = hdr.erase_count;
+    
+    cur_block = block;
+    cur_page = 0;
+    block_open = true;
+    return true;
+}
+
+// Make sure a frame is open on a free page, moving to the next block if needed
+static bool ensure_frame(void)
+{
+    if (frame_hdr.records > 0) return true;
+    
+    if (!block_open || cur_page >= TS_PAGES_PER_BLOCK) {
+        uint32_t next = (!block_open && max_seq == 0) ? 0 : (cur_block + 1) % block_count;
+        if (!open_block(next)) return false;
+    }
+    
+    start_frame();
+    return true;
+}
+
+/*===============================================================================
+  Block Index
+  ===============================================================================*/
+
+// Blocks in age order are cur_block+1, cur_block+2, ... cur_block. Blocks that
+// have never been written can only appear at the start of that order.
+static uint32_t logical_to_block(uint32_t logical)
+{
+    return (cur_block + 1 + logical) % block_count;
+}
+
+static uint32_t first_valid_logical(void)
+{
+    uint32_t k = 0;
+    while (k < block_count && blocks[logical_to_block(k)].seq == 0) {
+        k++;
+    }
+    return k;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool ts_log_init(void)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         CONFIG_TS_LOG_PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGE(TAG, "Partition '%s' not found", CONFIG_TS_LOG_PARTITION_LABEL);
+        return false;
+    }
+    
+    block_count = partition->size / TS_BLOCK_SIZE;
+    if (block_count < 2) {
+        ESP_LOGE(TAG, "Partition too small (%lu bytes)", (unsigned long)partition->size);
+        partition = NULL;
+        return false;
+    }
+    
+    free(blocks);
+    blocks = calloc(block_count, sizeof(ts_block_info_t));
+    if (!blocks) {
+        ESP_LOGE(TAG, "Failed to allocate block index");
+        partition = NULL;
+        return false;
+    }
+    
+    if (!log_mutex) {
+        log_mutex = xSemaphoreCreateMutex();
+    }
+    
+    // Scan block headers, remember the newest block
+    max_seq = 0;
+    cur_block = block_count - 1;
+    for (uint32_t b = 0; b < block_count; b++) {
+        ts_block_header_t hdr;
+        ts_frame_header_t frame;
+        blocks[b].first_ts = TS_ERASED_TS;
+        if (esp_partition_read(partition, block_offset(b), &hdr, sizeof(hdr)) != ESP_OK) {
+            continue;
+        }
+        if (hdr.magic != TS_BLOCK_MAGIC || hdr.crc != header_crc(&hdr)) {
+            continue;
+        }
+        blocks[b].seq = hdr.seq;
+        blocks[b].erase_count = hdr.erase_count;
+        if (read_frame_header(b, 0, &frame)) {
+            blocks[b].first_ts = frame.first_ts;
+        }
+        if (hdr.seq > max_seq) {
+            max_seq = hdr.seq;
+            cur_block = b;
+        }
+    }
+    
+    // Resume after the last written frame; its last record is the newest timestamp
+    last_ts = 0;
+    block_open = (max_seq > 0);
+    cur_page = block_open ? used_pages(cur_block) : 0;
+    frame_hdr.records = 0;
+    
+    for (uint32_t p = cur_page; p > 0 && last_ts == 0; p--) {
+        ts_frame_header_t hdr;
+        if (read_frame_header(cur_block, p - 1, &hdr) && load_frame(cur_block, p - 1, &hdr)) {
+            ts_codec_t codec;
+            ts_codec_value_t row[TS_COLUMNS];
+            ts_codec_init(&codec, record_columns, TS_COLUMNS, read_buf, hdr.length);
+            last_ts = hdr.first_ts;
+            while (codec.rows < hdr.records && ts_codec_get(&codec, row)) {
+                last_ts = (uint32_t)row[0].i;
+            }
+        }
+    }
+    
+    ESP_LOGI(TAG, "Mounted '%s': %lu blocks, newest block %lu (seq %lu, %lu frames)",
+             partition->label, (unsigned long)block_count, (unsigned long)cur_block,
+             (unsigned long)max_seq, (unsigned long)cur_page);
+    return true;
+}
+
+bool ts_log_append(uint32_t timestamp, float voltage, float current,
+                   float power, int64_t energy_uwh)
+{
+    if (!partition || timestamp == TS_ERASED_TS) return false;
+    
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    
+    // Lookups rely on time order, so never let a record go backwards
+    if (timestamp < last_ts) {
+        timestamp = last_ts;
+    }
+    last_ts = timestamp;
+    
+    ts_record_t rec = {
+        .timestamp = timestamp,
+        .voltage = voltage,
+        .current = current,
+        .power = power,
+        .energy_dwh = energy_uwh > 0 ? (uint32_t)((energy_uwh + 50000) / 100000) : 0,
+    };
+    ts_codec_value_t row[TS_COLUMNS];
+    record_to_row(&rec, row);
+    
+    int64_t start = esp_timer_get_time();
+    bool ok = ensure_frame();
+    bool added = ok && ts_codec_put(&frame_codec, row);
+    
+    // Frame full: program it and start a new one on the next page
+    if (ok && !added) {
+        ok = flush_frame() && ensure_frame();
+        added = ok && ts_codec_put(&frame_codec, row);
+    }
+    stats.encode_time_us += esp_timer_get_time() - start;
+    
+    if (added) {
+        if (frame_hdr.records++ == 0) {
+            frame_hdr.first_ts = timestamp;
+        }
+        if (blocks[cur_block].first_ts == TS_ERASED_TS) {
+            blocks[cur_block].first_ts = timestamp;
+        }
+        stats.records_appended++;
+        stats.bytes_appended += TS_RAW_RECORD_SIZE;
+        
+        // Bound what a power cut can lose from a slowly filling frame
+        bool aged = CONFIG_TS_LOG_FRAME_MAX_AGE_S > 0 &&
+                    timestamp - frame_hdr.first_ts >= CONFIG_TS_LOG_FRAME_MAX_AGE_S;
+        if (aged || frame_hdr.records >= TS_FRAME_MAX_RECORDS) {
+            ok = flush_frame();
+        }
+    }
+    
+    xSemaphoreGive(log_mutex);
+    return ok && added;
+}
+
+bool ts_log_flush(void)
+{
+    if (!partition) return false;
+    
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    bool ok = flush_frame();
+    xSemaphoreGive(log_mutex);
+    
+    return ok;
+}
+
+size_t ts_log_query(uint32_t from_ts, uint32_t to_ts,
+                    ts_record_t *out, size_t max_records)
+{
+    return ts_log_query_from(from_ts, 0, to_ts, out, max_records);
+}
+
+size_t ts_log_query_from(uint32_t from_ts, uint32_t skip, uint32_t to_ts,
+                         ts_record_t *out, size_t max_records)
+{
+    if (!partition || !out || max_records == 0 || from_ts > to_ts) return 0;
+    
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    
+    size_t n = 0;
+    bool past_end = false;
+    uint32_t first = first_valid_logical();
+    
+    if (first < block_count) {
+        // Last block (in age order) whose first record is <= from_ts
+        uint32_t lo = first, hi = block_count;
+        while (hi - lo > 1) {
+            uint32_t mid = (lo + hi) / 2;
+            if (blocks[logical_to_block(mid)].first_ts <= from_ts) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+        
+        for (uint32_t k = lo; k < block_count && n < max_records && !past_end; k++) {
+            uint32_t b = logical_to_block(k);
+            if (blocks[b].seq == 0) continue;
+            
+            uint32_t pages = (b == cur_block) ? cur_page : used_pages(b);
+            ts_frame_header_t hdr, next;
+            bool have_next = pages > 0 && read_frame_header(b, 0, &next);
+            
+            for (uint32_t p = 0; p < pages && n < max_records && !past_end; p++) {
+                hdr = next;
+                bool valid = have_next;
+                have_next = (p + 1 < pages) && read_frame_header(b, p + 1, &next);
+                if (!valid) continue;
+                
+                // Skip frames that end before the range starts
+                if (have_next && next.first_ts < from_ts) continue;
+                if (hdr.first_ts > to_ts) {
+                    past_end = true;
+                    break;
+                }
+                
+                if (load_frame(b, p, &hdr)) {
+                    past_end = decode_frame(&hdr, read_buf, from_ts, to_ts, &skip,
+                                            out, &n, max_records);
+                }
+            }
+        }
+        
+        // Records staged in RAM are not on flash yet
+        if (!past_end && frame_hdr.records > 0) {
+            ts_frame_header_t staged = frame_hdr;
+            staged.length = ts_codec_bytes(&frame_codec);
+            decode_frame(&staged, frame_buf, from_ts, to_ts, &skip, out, &n, max_records);
+        }
+    }
+    
+    xSemaphoreGive(log_mutex);
+    return n;
+}
+
+size_t ts_log_encode(const ts_record_t *records, size_t count,
+                     uint8_t *buf, size_t len, size_t *encoded)
+{
+    ts_codec_t codec;
+    size_t i = 0;
+    
+    if (records && ts_codec_init(&codec, record_columns, TS_COLUMNS, buf, len)) {
+        for (; i < count; i++) {
+            ts_codec_value_t row[TS_COLUMNS];
+            record_to_row(&records[i], row);
+            if (!ts_codec_put(&codec, row)) break;
+        }
+    }
+    
+    if (encoded) *encoded = i;
+    return i > 0 ? ts_codec_bytes(&codec) : 0;
+}
+
+bool ts_log_erase(void)
+{
+    if (!partition) return false;
+    
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    esp_err_t err = esp_partition_erase_range(partition, 0, block_count * TS_BLOCK_SIZE);
+    if (err == ESP_OK) {
+        memset(blocks, 0, block_count * sizeof(ts_block_info_t));
+        max_seq = 0;
+        cur_block = block_count - 1;
+        cur_page = 0;
+        block_open = false;
+        frame_hdr.records = 0;
+        last_ts = 0;
+        stats.sectors_erased += block_count;
+    } else {
+        stats.write_errors++;
+    }
+    xSemaphoreGive(log_mutex);
+    
+    ESP_LOGI(TAG, "Log erased: %s", esp_err_to_name(err));
+    return err == ESP_OK;
+}
+
+void ts_log_get_stats(ts_log_stats_t *out)
+{
+    if (!out) return;
+    
+    if (log_mutex) xSemaphoreTake(log_mutex, portMAX_DELAY);
+    
+    *out = stats;
+    out->blocks_total = block_count;
+    out->blocks_used = 0;
+    out->min_erase_count = UINT32_MAX;
+    out->max_erase_count = 0;
+    for (uint32_t b = 0; b < block_count; b++) {
+        if (blocks[b].seq != 0) out->blocks_used++;
+        if (blocks[b].erase_count < out->min_erase_count) out->min_erase_count = blocks[b].erase_count;
+        if (blocks[b].erase_count > out->max_erase_count) out->max_erase_count = blocks[b].erase_count;
+    }
+    if (block_count == 0) out->min_erase_count = 0;
+    
+    if (log_mutex) xSemaphoreGive(log_mutex);
+}
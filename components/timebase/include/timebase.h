@@ -0,0 +1,98 @@
+// smart_plug/components/timebase/include/timebase.h
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*===============================================================================
+  Monotonic Time
+  
+  All interval and deadline arithmetic uses signed 64-bit microseconds from
+  boot, which do not wrap for ~292,000 years. Keep timestamps in int64_t;
+  truncating to uint32_t brings back the 71 minute (us) or 49 day (ms) wrap.
+  ===============================================================================*/
+
+/**
+ * @brief Monotonic time since boot (microseconds)
+ */
+static inline int64_t timebase_now_us(void)
+{
+    return esp_timer_get_time();
+}
+
+/**
+ * @brief Monotonic time since boot (milliseconds)
+ */
+static inline int64_t timebase_now_ms(void)
+{
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief Milliseconds elapsed since a timebase_now_ms() timestamp
+ */
+static inline int64_t timebase_since_ms(int64_t since_ms)
+{
+    return timebase_now_ms() - since_ms;
+}
+
+/**
+ * @brief Whole seconds since boot
+ */
+uint32_t timebase_uptime_s(void);
+
+/*===============================================================================
+  Wall Clock
+  ===============================================================================*/
+
+/**
+ * @brief Check whether the wall clock is set (SNTP or kept across a reset)
+ */
+bool timebase_wall_valid(void);
+
+/**
+ * @brief Current wall-clock time
+ * 
+ * @return time_t Epoch seconds, or 0 if the clock is not set
+ */
+time_t timebase_wall_s(void);
+
+/**
+ * @brief Map a monotonic timestamp to wall-clock time
+ * 
+ * Uses the current offset between the two clocks, so timestamps taken
+ * before SNTP synchronisation map correctly once it has completed.
+ * 
+ * @param mono_us Timestamp from timebase_now_us()
+ * @return time_t Epoch seconds, or 0 if the clock is not set
+ */
+time_t timebase_mono_to_wall(int64_t mono_us);
+
+/**
+ * @brief Map a monotonic timestamp to wall-clock microseconds
+ * 
+ * Same as timebase_mono_to_wall() at full resolution, for sub-second
+ * alignment of event timestamps.
+ * 
+ * @param mono_us Timestamp from timebase_now_us()
+ * @return int64_t Epoch microseconds, or 0 if the clock is not set
+ */
+int64_t timebase_mono_to_wall_us(int64_t mono_us);
+
+/**
+ * @brief Epoch seconds of boot, or 0 if the clock is not set
+ */
+time_t timebase_boot_wall_s(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMEBASE_H */
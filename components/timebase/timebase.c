@@ -0,0 +1,66 @@
+// smart_plug/components/timebase/timebase.c
+#include "timebase.h"
+#include <sys/time.h>
+
+// Earliest epoch accepted as a set clock (2001-09-09)
+#define WALL_VALID_MIN_S    1000000000LL
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+// Wall clock minus monotonic clock in microseconds, or 0 if the clock is unset.
+// Read fresh every time so SNTP steps and slews are followed.
+static int64_t wall_offset_us(void)
+{
+    struct timeval tv;
+    int64_t mono_us = timebase_now_us();
+    gettimeofday(&tv, NULL);
+    
+    if (tv.tv_sec < WALL_VALID_MIN_S) {
+        return 0;
+    }
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - mono_us;
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+uint32_t timebase_uptime_s(void)
+{
+    return (uint32_t)(timebase_now_us() / 1000000);
+}
+
+bool timebase_wall_valid(void)
+{
+    return wall_offset_us() != 0;
+}
+
+time_t timebase_wall_s(void)
+{
+    return timebase_mono_to_wall(timebase_now_us());
+}
+
+time_t timebase_mono_to_wall(int64_t mono_us)
+{
+    int64_t offset_us = wall_offset_us();
+    if (offset_us == 0) {
+        return 0;
+    }
+    return (time_t)((mono_us + offset_us) / 1000000);
+}
+
+int64_t timebase_mono_to_wall_us(int64_t mono_us)
+{
+    int64_t offset_us = wall_offset_us();
+    if (offset_us == 0) {
+        return 0;
+    }
+    return mono_us + offset_us;
+}
+
+time_t timebase_boot_wall_s(void)
+{
+    return timebase_mono_to_wall(0);
+}
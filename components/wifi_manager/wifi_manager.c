@@ -5,7 +5,7 @@
 #include "esp_event.h"
 #include "esp_log.h"
 #include "esp_netif.h"
-#include "esp_timer.h"
+#include "timebase.h"
 #include "nvs_flash.h"
 #include "esp_mac.h"
 #include "freertos/FreeRTOS.h"
@@ -212,8 +212,8 @@ void wifi_manager_stop(void)
 
 void wifi_manager_handle(void)
 {
-    static uint32_t last_reconnect = 0;
-    uint32_t now = esp_timer_get_time() / 1000;
+    static int64_t last_reconnect = 0;
+    int64_t now = timebase_now_ms();
     
     if (setup_mode) {
         return;
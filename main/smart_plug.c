@@ -12,7 +12,6 @@
 #include "esp_timer.h"
 #include "nvs_flash.h"
 #include "driver/gpio.h"
-#include "cJSON.h"
 
 // Define HIGH/LOW for Arduino compatibility
 #ifndef LOW
@@ -27,8 +26,24 @@
 #include "led.h"
 #include "button.h"
 #include "zero_crossing.h"
+#include "sample_sched.h"
 #include "wifi_manager.h"
 #include "mqtt_manager.h"
+#include "meter_stats.h"
+#include "meter_rollup.h"
+#include "meter_rate.h"
+#include "meter_report.h"
+#include "meter_batch.h"
+#include "meter_telemetry.h"
+#include "ts_log.h"
+#include "store_forward.h"
+#include "enf_log.h"
+#include "energy_journal.h"
+#include "outbox_spill.h"
+#include "rtc_state.h"
+#include "last_gasp.h"
+#include "timebase.h"
+#include "payload_writer.h"
 
 static const char *TAG = "SMART_PLUG";
 
@@ -38,11 +53,29 @@ static const char *TAG = "SMART_PLUG";
 
 // Timing
 #define MEASUREMENT_INTERVAL_MS     CONFIG_MEASUREMENT_INTERVAL_MS
-#define PUBLISH_INTERVAL_MS         CONFIG_PUBLISH_INTERVAL_MS
 #define STORAGE_SAVE_INTERVAL_MS    CONFIG_STORAGE_SAVE_INTERVAL_MS
 #define OFFLINE_SAVE_INTERVAL_MS    CONFIG_OFFLINE_SAVE_INTERVAL_MS
 #define DEBUG_INTERVAL_MS           CONFIG_DEBUG_INTERVAL_MS
 #define LED_BLINK_INTERVAL_MS       CONFIG_LED_BLINK_INTERVAL_MS
+#define SHADOW_RETRY_INTERVAL_MS    CONFIG_SHADOW_RETRY_MS
+
+// Largest telemetry document (readings and window, ~800 bytes as JSON, plus the
+// sample batch)
+#if CONFIG_TELEMETRY_BATCH
+#define TELEMETRY_BATCH             true
+#define TELEMETRY_BUF_SIZE          (1280 + CONFIG_BATCH_MAX_BYTES)
+#else
+#define TELEMETRY_BATCH             false
+#define TELEMETRY_BUF_SIZE          1280
+#endif
+
+// Stats documents and the key tables published on connect share one buffer.
+// The largest is the stats key table with every option enabled (~9 KB); the
+// stats document itself stays under 5 KB as JSON
+#define STATS_BUF_SIZE              10240
+
+// Bump when stats keys change (telemetry is versioned in meter_telemetry.h)
+#define STATS_SCHEMA_VERSION        1
 
 // Pins
 #define PIN_CS          CONFIG_CS_PIN
@@ -51,6 +84,7 @@ static const char *TAG = "SMART_PLUG";
 #define PIN_LED         CONFIG_STATUS_LED_PIN
 #define PIN_BUTTON      CONFIG_BUTTON_PIN
 #define PIN_ZC          CONFIG_ZC_PIN
+#define PIN_ADE_IRQ     CONFIG_ADE_IRQ_PIN
 #define PIN_SPI_MOSI    CONFIG_SPI_MOSI_PIN
 #define PIN_SPI_MISO    CONFIG_SPI_MISO_PIN
 #define PIN_SPI_SCK     CONFIG_SPI_SCK_PIN
@@ -101,16 +135,19 @@ typedef struct {
     float power_factor;
     float frequency;
     float temperature;
-    float energy_wh;
+    int64_t energy_uwh;
     bool waveform_clipped;
     
     int32_t avg_raw_voltage_rms;
     uint32_t avg_raw_current_rms;
     int32_t avg_raw_active_power;
     int32_t avg_raw_energy;
+    int32_t raw_energy_delta;   // AWATTHR_HI of the newest sample (clear-on-read)
     
+    int64_t sample_us;          // Scheduled sample time (timebase_now_us())
     bool synchronized;
-    uint32_t zc_timestamp;
+    int64_t zc_timestamp;
+    zc_frequency_t zc_freq;
     float voltage_at_zc;
     float current_at_zc;
 } measurements_t;
@@ -130,20 +167,40 @@ static bool ade_initialized = false;
 static bool measurement_valid = false;
 static bool zc_sync_enabled = true;
 
-static float cumulative_energy = 0;
-static uint32_t last_energy_calc_time = 0;
-static uint32_t last_publish_time = 0;
-static uint32_t last_storage_save = 0;
-static uint32_t last_debug_print = 0;
-static uint32_t system_start_time = 0;
+// Micro-Wh: a float in Wh stops accumulating small increments above ~16 MWh
+static int64_t cumulative_energy_uwh = 0;
+static int64_t last_energy_calc_us = 0;
+// Monotonic milliseconds (timebase_now_ms())
+static int64_t last_publish_time = 0;
+static int64_t last_storage_save = 0;
+static int64_t last_debug_print = 0;
+static int64_t system_start_time = 0;
 
 static TaskHandle_t measurement_task_handle = NULL;
 static TaskHandle_t mqtt_task_handle = NULL;
 
+// Telemetry, stats and schemas are only built by the MQTT task, one at a time
+static char telemetry_buf[TELEMETRY_BUF_SIZE];
+static char stats_buf[STATS_BUF_SIZE];
+
 /*===============================================================================
-  NVS Storage Functions
+  Energy Persistence
+
+  Energy and relay state go to the append-only energy journal. The legacy
+  NVS blob is only written when the journal partition is missing, and is
+  imported into the journal once on first boot. An RTC memory copy is
+  refreshed on every sample so warm reboots restore without losing energy.
   ===============================================================================*/
 
+static bool journal_ready = false;
+
+#if CONFIG_LAST_GASP_ENABLE
+// Power-loss record this boot started from; the RAM last-gasp stats die
+// with the supply, so this is all that is left of that outage to report
+static bool booted_from_power_loss = false;
+static energy_journal_entry_t power_loss_entry;
+#endif
+
 static void save_energy_to_nvs(void)
 {
     nvs_handle_t nvs;
@@ -153,13 +210,16 @@ static void save_energy_to_nvs(void)
         return;
     }
     
-    err = nvs_set_blob(nvs, "energy_total", &cumulative_energy, sizeof(float));
+    err = nvs_set_i64(nvs, "energy_uwh", cumulative_energy_uwh);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save energy: %s", esp_err_to_name(err));
         nvs_close(nvs);
         return;
     }
     
+    // Superseded by energy_uwh
+    nvs_erase_key(nvs, "energy_total");
+    
     uint8_t relay_state = relay_get_state() ? 1 : 0;
     err = nvs_set_u8(nvs, "relay_state", relay_state);
     if (err != ESP_OK) {
@@ -173,7 +233,7 @@ static void save_energy_to_nvs(void)
         ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
     } else {
         ESP_LOGI(TAG, "SAVED to NVS: energy=%.3f Wh, relay=%s", 
-                 cumulative_energy, relay_state ? "ON" : "OFF");
+                 cumulative_energy_uwh / 1e6, relay_state ? "ON" : "OFF");
     }
     
     nvs_close(nvs);
@@ -188,11 +248,18 @@ static void load_energy_from_nvs(void)
         return;
     }
     
-    size_t len = sizeof(float);
-    err = nvs_get_blob(nvs, "energy_total", &cumulative_energy, &len);
+    err = nvs_get_i64(nvs, "energy_uwh", &cumulative_energy_uwh);
     if (err != ESP_OK) {
-        ESP_LOGD(TAG, "No energy_total found");
-        cumulative_energy = 0;
+        // Firmware before micro-Wh accounting stored a float in Wh
+        float legacy_wh = 0;
+        size_t len = sizeof(float);
+        if (nvs_get_blob(nvs, "energy_total", &legacy_wh, &len) == ESP_OK) {
+            cumulative_energy_uwh = llround((double)legacy_wh * 1e6);
+            ESP_LOGI(TAG, "Converted legacy float energy %.3f Wh", legacy_wh);
+        } else {
+            ESP_LOGD(TAG, "No energy_total found");
+            cumulative_energy_uwh = 0;
+        }
     }
     
     uint8_t relay_state = 0;
@@ -207,8 +274,110 @@ static void load_energy_from_nvs(void)
     
     nvs_close(nvs);
     
-    ESP_LOGI(TAG, "Loaded from NVS: energy=%.3f Wh", cumulative_energy);
+    ESP_LOGI(TAG, "Loaded from NVS: energy=%.3f Wh", cumulative_energy_uwh / 1e6);
+}
+
+static void erase_legacy_energy(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NS_METER, NVS_READWRITE, &nvs) != ESP_OK) return;
+    
+    nvs_erase_key(nvs, "energy_uwh");
+    nvs_erase_key(nvs, "energy_total");
+    nvs_erase_key(nvs, "relay_state");
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void update_rtc_state(void)
+{
+#if CONFIG_RTC_STATE_ENABLE
+    rtc_state_update(cumulative_energy_uwh, relay_get_state(),
+                     mqtt_manager_get_current_time());
+#endif
+}
+
+static bool save_energy_state(energy_journal_reason_t reason)
+{
+    update_rtc_state();
+    
+    if (!journal_ready) {
+        save_energy_to_nvs();
+        return true;
+    }
+    
+    bool relay_on = relay_get_state();
+    
+    if (!energy_journal_append(cumulative_energy_uwh, relay_on,
+                               mqtt_manager_get_current_time(), reason)) {
+        return false;
+    }
+    
+    ESP_LOGI(TAG, "SAVED to journal: energy=%.3f Wh, relay=%s",
+             cumulative_energy_uwh / 1e6, relay_on ? "ON" : "OFF");
+    return true;
+}
+
+static void load_energy_state(void)
+{
+    energy_journal_entry_t entry;
+    
+#if CONFIG_RTC_STATE_ENABLE
+    // Warm reboot: RTC memory holds the state as of the last sample
+    rtc_state_t rtc;
+    if (rtc_state_restore(&rtc)) {
+        cumulative_energy_uwh = rtc.energy_uwh;
+        meas.energy_uwh = cumulative_energy_uwh;
+        relay_set(rtc.relay_on);
+        ESP_LOGI(TAG, "Restored from RTC: energy=%.3f Wh, relay=%s",
+                 cumulative_energy_uwh / 1e6, rtc.relay_on ? "ON" : "OFF");
+        return;
+    }
+#endif
+    
+    if (!journal_ready || !energy_journal_latest(&entry)) {
+        load_energy_from_nvs();
+        
+        // First boot with the journal: import the NVS values once
+        if (journal_ready && save_energy_state(ENERGY_JOURNAL_MIGRATED)) {
+            erase_legacy_energy();
+            ESP_LOGI(TAG, "Migrated NVS energy into the journal");
+        }
+        return;
+    }
+    
+    cumulative_energy_uwh = entry.energy_uwh;
+    meas.energy_uwh = cumulative_energy_uwh;
+    relay_set(entry.relay_on);
+    
+    ESP_LOGI(TAG, "Loaded from journal: energy=%.3f Wh, relay=%s (seq %lu)",
+             cumulative_energy_uwh / 1e6, entry.relay_on ? "ON" : "OFF", (unsigned long)entry.seq);
+    if (entry.reason == ENERGY_JOURNAL_POWER_LOSS) {
+        ESP_LOGI(TAG, "Last shutdown was a power loss, handler ran %lu us after the dip",
+                 (unsigned long)entry.latency_us);
+#if CONFIG_LAST_GASP_ENABLE
+        booted_from_power_loss = true;
+        power_loss_entry = entry;
+#endif
+    }
+    update_rtc_state();
+}
+
+#if CONFIG_LAST_GASP_ENABLE
+// Runs at top priority on a supply dip: one write to a pre-erased journal slot.
+// latency_us is the dispatch latency (interrupt to this call); the write
+// itself is timed only in RAM, since it is the last thing that completes.
+static void last_gasp_handler(uint32_t latency_us)
+{
+    bool relay_on = relay_get_state();
+    
+    if (journal_ready) {
+        energy_journal_append_urgent(cumulative_energy_uwh, relay_on,
+                                     mqtt_manager_get_current_time(), latency_us);
+    }
+    update_rtc_state();
 }
+#endif
 
 static void save_offline_data(void)
 {
@@ -220,13 +389,9 @@ static void save_offline_data(void)
     nvs_set_blob(nvs, "last_current", &meas.current_rms, sizeof(float));
     nvs_set_blob(nvs, "last_power", &meas.active_power, sizeof(float));
     nvs_set_blob(nvs, "last_temp", &meas.temperature, sizeof(float));
-    nvs_set_blob(nvs, "energy_total", &cumulative_energy, sizeof(float));
-    
-    uint8_t relay_state = relay_get_state() ? 1 : 0;
-    nvs_set_u8(nvs, "relay_state", relay_state);
     
-    uint32_t now = esp_timer_get_time() / 1000;
-    nvs_set_u32(nvs, "last_save", now);
+    // Seconds since boot (milliseconds overflowed a u32 after 49 days)
+    nvs_set_u32(nvs, "last_save", timebase_uptime_s());
     
     nvs_commit(nvs);
     nvs_close(nvs);
@@ -297,7 +462,12 @@ static bool initialize_ade9153a(void)
     ESP_LOGI(TAG, "[Step %d] Additional configuration", init_step);
     ade9153a_write_16(&ade_dev, REG_AI_PGAGAIN, 0x000A);
     ade9153a_write_32(&ade_dev, REG_CONFIG0, 0);
+#if CONFIG_ADAPTIVE_SAMPLING
+    // Energy accumulates in the ADE and clears on read, so samples can be sparse
+    ade9153a_write_16(&ade_dev, REG_EP_CFG, ADE9153A_EP_CFG_RD_RST);
+#else
     ade9153a_write_16(&ade_dev, REG_EP_CFG, ADE9153A_EP_CFG);
+#endif
     ade9153a_write_16(&ade_dev, REG_EGY_TIME, ADE9153A_EGY_TIME);
     ade9153a_write_32(&ade_dev, REG_AVGAIN, 0xFFF36B16);
     ade9153a_write_32(&ade_dev, REG_AIGAIN, 7316126);
@@ -393,6 +563,7 @@ static bool read_measurements(void)
         measurement_valid = false;
         return false;
     }
+    meas.raw_energy_delta = raw_buffer[buffer_index].raw_energy;
     
     buffer_index++;
     if (buffer_index >= CONFIG_DEFAULT_AVERAGE_SAMPLES) {
@@ -405,6 +576,108 @@ static bool read_measurements(void)
     return true;
 }
 
+#if CONFIG_LAST_GASP_ENABLE
+static void arm_last_gasp(void)
+{
+    // DIP_LVL is compared against the half-cycle RMS, which shares AVRMS scaling
+    uint32_t dip_lvl = (uint32_t)(CONFIG_LAST_GASP_DIP_VOLTS * 1000000.0f /
+                                  cal.voltage_coefficient);
+    
+    ade9153a_enable_dip_irq(&ade_dev, dip_lvl, CONFIG_LAST_GASP_DIP_HALF_CYCLES);
+    if (!last_gasp_init(PIN_ADE_IRQ, last_gasp_handler)) {
+        ESP_LOGE(TAG, "Failed to arm last-gasp interrupt");
+        return;
+    }
+    ESP_LOGI(TAG, "Last-gasp armed: dip below %d V for %d half cycles (DIP_LVL=0x%08lX)",
+             CONFIG_LAST_GASP_DIP_VOLTS, CONFIG_LAST_GASP_DIP_HALF_CYCLES,
+             (unsigned long)dip_lvl);
+}
+#endif
+
+#if CONFIG_RELAY_ZC_SYNC
+#define CONTACT_MAX_WINDOWS     12
+#define CONTACT_POLL_US         200
+#define CONTACT_MIN_CURRENT_A   0.2f
+
+// Share of a half-cycle's sin^2 energy that lies before phase theta (0..pi)
+static float sin2_energy_before(float theta)
+{
+    return (theta - sinf(theta) * cosf(theta)) / (float)M_PI;
+}
+
+static float phase_for_energy(float fraction)
+{
+    float lo = 0.0f, hi = (float)M_PI;
+    for (int i = 0; i < 20; i++) {
+        float mid = 0.5f * (lo + hi);
+        if (sin2_energy_before(mid) < fraction) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return 0.5f * (lo + hi);
+}
+
+// Relay contact observer: AIRMS_OC is a half-cycle RMS updated at each zero
+// crossing, so the first (make) or last (break) partial window gives the
+// contact instant within that half cycle from the share of sin^2 energy it holds
+static int64_t observe_relay_contact(const relay_switch_t *sw)
+{
+    int64_t half = sw->half_cycle_us;
+    int64_t end_us = sw->target_us + 4 * half;
+    int64_t win_end[CONTACT_MAX_WINDOWS];
+    float win_rms[CONTACT_MAX_WINDOWS];
+    int n = 0;
+    
+    uint32_t last = ade9153a_read_32(&ade_dev, REG_AIRMS_OC);
+    int64_t last_poll = timebase_now_us();
+    while (last_poll < end_us && n < CONTACT_MAX_WINDOWS) {
+        esp_rom_delay_us(CONTACT_POLL_US);
+        uint32_t v = ade9153a_read_32(&ade_dev, REG_AIRMS_OC);
+        int64_t now = timebase_now_us();
+        
+        // Preempted long enough to miss a window: timing is unusable
+        if (now - last_poll > half / 2) return 0;
+        last_poll = now;
+        
+        if (v != last) {
+            // Updates land on zero crossings; snap to the boundary just passed
+            int64_t k = (now - sw->target_us + 4 * half) / half - 4;
+            win_end[n] = sw->target_us + k * half;
+            win_rms[n] = (float)v;
+            n++;
+            last = v;
+        }
+    }
+    if (n < 3) return 0;
+    
+    float min_raw = CONTACT_MIN_CURRENT_A * 1000000.0f / cal.current_coefficient;
+    int j;
+    float d_frac;
+    
+    if (sw->state) {
+        // Make: the first window with current holds it only after the closure
+        float settled = win_rms[n - 1];
+        if (settled < min_raw) return 0;
+        for (j = 0; j < n && win_rms[j] < settled * 0.05f; j++) {}
+        if (j == n) return 0;
+        float r = fminf(win_rms[j] / settled, 1.0f);
+        d_frac = phase_for_energy(1.0f - r * r) / (float)M_PI;
+    } else {
+        // Break: the last window with current holds it only before the opening
+        float base = win_rms[0];
+        if (base < min_raw) return 0;
+        for (j = 1; j < n && win_rms[j] > base * 0.95f; j++) {}
+        if (j == n) return 0;
+        float r = fminf(win_rms[j] / base, 1.0f);
+        d_frac = phase_for_energy(r * r) / (float)M_PI;
+    }
+    
+    return win_end[j] - half + (int64_t)(d_frac * half);
+}
+#endif
+
 static void calculate_measurements(void)
 {
     if (!measurement_valid) return;
@@ -432,17 +705,9 @@ static void calculate_measurements(void)
         meas.reactive_power = 0.0f;
     }
     
-    float zc_frequency = zero_crossing_calculate_frequency();
-    if (zc_frequency > 0.0f) {
-        meas.frequency = zc_frequency;
-    } else {
-        uint32_t period_raw = ade9153a_read_32(&ade_dev, REG_APERIOD);
-        if (period_raw > 0) {
-            meas.frequency = (4000.0f * 65536.0f) / (float)(period_raw + 1);
-        } else {
-            meas.frequency = 0.0f;
-        }
-    }
+    // Multi-cycle estimate from the edge ring; 0 while edges are missing
+    zero_crossing_get_frequency(&meas.zc_freq);
+    meas.frequency = meas.zc_freq.frequency_hz;
     
     int32_t powerFactor_raw = (int32_t)ade9153a_read_32(&ade_dev, REG_APF);
     meas.power_factor = fabsf((float)powerFactor_raw / 134217728.0f);
@@ -455,41 +720,56 @@ static void calculate_measurements(void)
                            (meas.avg_raw_current_rms > 8000000);
     
     if (zc_sync_enabled && zero_crossing_detected()) {
-        meas.synchronized = true;
         meas.zc_timestamp = zero_crossing_get_last_time();
         zero_crossing_reset_flag();
     } else {
-        meas.synchronized = false;
         meas.zc_timestamp = 0;
     }
 }
 
 static void update_energy_accumulation(void)
 {
-    uint32_t now = esp_timer_get_time() / 1000;
+    int64_t now_us = meas.sample_us;
+    int64_t now = now_us / 1000;
     
-    if (last_energy_calc_time == 0) {
-        last_energy_calc_time = now;
+    if (last_energy_calc_us == 0) {
+        last_energy_calc_us = now_us;
         return;
     }
     
-    float delta_hours = (float)(now - last_energy_calc_time) / 3600000.0f;
-    float energy_increment = meas.active_power * delta_hours;
+    // The sub-uWh remainder carries to the next sample
+    static double residual_uwh = 0;
+#if CONFIG_ADAPTIVE_SAMPLING
+    // Energy since the previous read, from the ADE accumulator: exact at any
+    // sampling rate, including transients between sparse samples
+    double increment_uwh = fabs((double)meas.raw_energy_delta) * cal.energy_coefficient;
+#else
+    // W * us / 3600 = uWh
+    double increment_uwh = meas.active_power * (double)(now_us - last_energy_calc_us) / 3600.0;
+#endif
     
-    if (energy_increment > 0 && relay_get_state()) {
-        cumulative_energy += energy_increment;
-        meas.energy_wh = cumulative_energy;
+    if (increment_uwh > 0 && relay_get_state()) {
+        increment_uwh += residual_uwh;
+        int64_t whole_uwh = (int64_t)increment_uwh;
+        residual_uwh = increment_uwh - whole_uwh;
         
-        static float last_saved_energy = 0;
-        if (fabsf(cumulative_energy - last_saved_energy) > 0.1f || 
+        cumulative_energy_uwh += whole_uwh;
+        meas.energy_uwh = cumulative_energy_uwh;
+        
+        // The journal spreads these out to stay within its write budget
+        static int64_t last_saved_uwh = 0;
+        if (llabs(cumulative_energy_uwh - last_saved_uwh) >=
+                (int64_t)CONFIG_ENERGY_SAVE_DELTA_WH * 1000000 || 
             now - last_storage_save > STORAGE_SAVE_INTERVAL_MS) {
-            save_energy_to_nvs();
-            last_saved_energy = cumulative_energy;
-            last_storage_save = now;
+            if (save_energy_state(ENERGY_JOURNAL_PERIODIC)) {
+                last_saved_uwh = cumulative_energy_uwh;
+                last_storage_save = now;
+            }
         }
     }
     
-    last_energy_calc_time = now;
+    update_rtc_state();
+    last_energy_calc_us = now_us;
 }
 
 static void validate_measurements(void)
@@ -512,14 +792,65 @@ static void validate_measurements(void)
     measurement_valid = true;
 }
 
+static void aggregate_sample(void)
+{
+    float values[METER_CH_COUNT];
+    values[METER_CH_VOLTAGE] = meas.voltage_rms;
+    values[METER_CH_CURRENT] = meas.current_rms;
+    values[METER_CH_POWER] = meas.active_power;
+    values[METER_CH_POWER_FACTOR] = meas.power_factor;
+    values[METER_CH_FREQUENCY] = meas.frequency;
+    
+    meter_stats_add(values);
+    meter_rollup_add(meas.sample_us, meas.voltage_rms, meas.current_rms,
+                     meas.active_power, cumulative_energy_uwh);
+}
+
+#if CONFIG_ENF_LOG_ENABLE
+// The ZC ring holds 2^CONFIG_ZC_RING_BITS edges (~2.5 s of 50 Hz cycles by
+// default) while adaptive sampling can idle the measurement task for 10 s,
+// so the ring is drained by a task of its own, four times per ring span
+#define ENF_DRAIN_MS    ((1000 << CONFIG_ZC_RING_BITS) / (4 * CONFIG_ENF_NOMINAL_HZ))
+
+_Static_assert(ENF_DRAIN_MS >= 20, "ZC edge ring too small to drain between ticks");
+
+static void feed_enf_log(void)
+{
+    static uint32_t cursor = 0;
+    static bool started = false;
+    int64_t edges[32];
+    uint32_t dropped;
+    size_t n;
+    
+    if (!started) {
+        cursor = zero_crossing_get_counter();
+        started = true;
+    }
+    
+    do {
+        n = zero_crossing_read_edges(&cursor, edges, 32, &dropped);
+        enf_log_feed(edges, n, dropped);
+    } while (n == 32);
+}
+
+static void enf_task(void *pvParameters)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+    
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(ENF_DRAIN_MS));
+        feed_enf_log();
+    }
+}
+#endif
+
 static void check_zc_synchronization(void)
 {
-    static uint32_t last_zc_check = 0;
+    static int64_t last_zc_check = 0;
     static uint32_t last_zc_count = 0;
-    uint32_t now = esp_timer_get_time() / 1000;
     
-    if (now - last_zc_check > 10000) {
-        last_zc_check = now;
+    if (timebase_since_ms(last_zc_check) > 10000) {
+        last_zc_check = timebase_now_ms();
         
         uint32_t current_count = zero_crossing_get_counter();
         uint32_t zc_events = current_count - last_zc_count;
@@ -555,7 +886,7 @@ static void print_measurements(void)
         ESP_LOGI(TAG, "   Power (Apparent): %5.3f VA", meas.apparent_power);
     }
     ESP_LOGI(TAG, "\nENERGY & QUALITY");
-    ESP_LOGI(TAG, "   Energy Total:  %.3f Wh", cumulative_energy);
+    ESP_LOGI(TAG, "   Energy Total:  %.3f Wh", cumulative_energy_uwh / 1e6);
     ESP_LOGI(TAG, "   Power Factor:  %.3f", meas.power_factor);
     ESP_LOGI(TAG, "\nSTATUS INDICATORS");
     ESP_LOGI(TAG, "   Waveform:     %s", meas.waveform_clipped ? "CLIPPED" : "Clean");
@@ -578,7 +909,8 @@ static void wifi_reset_task(void *pvParameters)
     
     // Save current state before clearing
     ESP_LOGI(TAG, "Saving current state...");
-    save_energy_to_nvs();
+    save_energy_state(ENERGY_JOURNAL_FORCED);
+    ts_log_flush();
     vTaskDelay(pdMS_TO_TICKS(100));
     
     ESP_LOGI(TAG, "Clearing WiFi credentials from NVS...");
@@ -587,11 +919,10 @@ static void wifi_reset_task(void *pvParameters)
     vTaskDelay(pdMS_TO_TICKS(500));
     ESP_LOGI(TAG, "WiFi credentials cleared successfully");
     
-    if (mqtt_manager_is_connected()) {
-        ESP_LOGI(TAG, "Disconnecting MQTT...");
-        mqtt_manager_disconnect();
-        vTaskDelay(pdMS_TO_TICKS(200));
-    }
+    // Also cancels a scheduled reconnect; mqtt_manager_handle() is not run in setup mode
+    ESP_LOGI(TAG, "Disconnecting MQTT...");
+    mqtt_manager_disconnect();
+    vTaskDelay(pdMS_TO_TICKS(200));
     
     ESP_LOGI(TAG, "Disconnecting from WiFi...");
     wifi_manager_disconnect();
@@ -615,10 +946,22 @@ static void wifi_reset_task(void *pvParameters)
   Button Callback
   ===============================================================================*/
 
+// Capture the switching transient at the fastest sampling rate
+static void relay_changed(void)
+{
+#if CONFIG_ADAPTIVE_SAMPLING
+    uint32_t interval_ms = meter_rate_trigger_burst(timebase_now_us());
+    sample_sched_set_interval(interval_ms * 1000);
+#endif
+#if CONFIG_REPORT_BY_EXCEPTION
+    meter_report_force();
+#endif
+}
+
 static void button_event_handler(button_event_t event, uint32_t param)
 {
-    static uint32_t last_valid_press = 0;
-    uint32_t now = esp_timer_get_time() / 1000;
+    static int64_t last_valid_press = 0;
+    int64_t now = timebase_now_ms();
     
     switch (event) {
         case BUTTON_EVENT_SHORT_PRESS:
@@ -626,13 +969,14 @@ static void button_event_handler(button_event_t event, uint32_t param)
                 last_valid_press = now;
                 ESP_LOGI(TAG, "Button short press - toggling relay");
                 relay_toggle();
+                relay_changed();
                 
-                ESP_LOGI(TAG, "Forcing immediate NVS save after button press");
-                save_energy_to_nvs();
+                ESP_LOGI(TAG, "Saving relay state after button press");
+                save_energy_state(ENERGY_JOURNAL_RELAY);
                 
                 if (wifi_manager_is_connected() && mqtt_manager_is_connected()) {
                     mqtt_manager_update_shadow(meas.voltage_rms, meas.current_rms,
-                                               meas.active_power, cumulative_energy,
+                                               meas.active_power, cumulative_energy_uwh,
                                                meas.temperature, relay_get_state());
                 }
             }
@@ -687,19 +1031,20 @@ static void button_event_handler(button_event_t event, uint32_t param)
 
 static void mqtt_relay_callback(bool state)
 {
-    static uint32_t last_relay_callback = 0;
-    uint32_t now = esp_timer_get_time() / 1000;
+    static int64_t last_relay_callback = 0;
+    int64_t now = timebase_now_ms();
     
     if (now - last_relay_callback < 500) return;
     last_relay_callback = now;
     
     ESP_LOGI(TAG, "MQTT relay command: %s", state ? "ON" : "OFF");
     relay_set(state);
-    save_energy_to_nvs();
+    relay_changed();
+    save_energy_state(ENERGY_JOURNAL_RELAY);
     
     if (mqtt_manager_is_connected()) {
         mqtt_manager_update_shadow(meas.voltage_rms, meas.current_rms,
-                                   meas.active_power, cumulative_energy,
+                                   meas.active_power, cumulative_energy_uwh,
                                    meas.temperature, state);
     }
 }
@@ -707,27 +1052,27 @@ static void mqtt_relay_callback(bool state)
 static void mqtt_energy_reset_callback(void)
 {
     ESP_LOGI(TAG, "MQTT energy reset command");
-    cumulative_energy = 0.0f;
-    meas.energy_wh = 0.0f;
-    save_energy_to_nvs();
+    cumulative_energy_uwh = 0;
+    meas.energy_uwh = 0;
+    save_energy_state(ENERGY_JOURNAL_RESET);
     
     if (mqtt_manager_is_connected()) {
         mqtt_manager_update_shadow(meas.voltage_rms, meas.current_rms,
-                                   meas.active_power, cumulative_energy,
+                                   meas.active_power, cumulative_energy_uwh,
                                    meas.temperature, relay_get_state());
     }
 }
 
 static void mqtt_shadow_callback(const shadow_state_t *state)
 {
-    static uint32_t last_shadow_update = 0;
+    static int64_t last_shadow_update = 0;
     
-    if (esp_timer_get_time()/1000 - last_shadow_update < 1000) {
+    if (timebase_since_ms(last_shadow_update) < 1000) {
         ESP_LOGD(TAG, "Shadow update too frequent");
         return;
     }
     
-    last_shadow_update = esp_timer_get_time()/1000;
+    last_shadow_update = timebase_now_ms();
     ESP_LOGD(TAG, "Shadow updated");
 }
 
@@ -780,54 +1125,535 @@ static void wifi_state_monitor(void)
   Telemetry Publishing
   ===============================================================================*/
 
-static void publish_telemetry(void)
+#if CONFIG_REPORT_BY_EXCEPTION
+// Alarm bits watched by the report filter
+#define ALARM_WAVEFORM_CLIPPED  (1 << 0)
+#define ALARM_OUT_OF_RANGE      (1 << 1)
+#define ALARM_FREQUENCY         (1 << 2)
+
+static void get_report_values(float *values)
+{
+    uint32_t alarms = 0;
+    if (meas.waveform_clipped) alarms |= ALARM_WAVEFORM_CLIPPED;
+    if (ade_initialized && !measurement_valid) alarms |= ALARM_OUT_OF_RANGE;
+#if CONFIG_ENF_LOG_ENABLE
+    enf_log_stats_t enf;
+    enf_log_get_stats(&enf);
+    if (enf.excursion_active) alarms |= ALARM_FREQUENCY;
+#endif
+    
+    values[REPORT_FIELD_VOLTAGE] = meas.voltage_rms;
+    values[REPORT_FIELD_CURRENT] = meas.current_rms;
+    values[REPORT_FIELD_POWER] = meas.active_power;
+    values[REPORT_FIELD_POWER_FACTOR] = meas.power_factor;
+    values[REPORT_FIELD_FREQUENCY] = meas.frequency;
+    values[REPORT_FIELD_ENERGY] = cumulative_energy_uwh / 1e6f;
+    values[REPORT_FIELD_TEMPERATURE] = meas.temperature;
+    values[REPORT_FIELD_RELAY] = relay_get_state() ? 1.0f : 0.0f;
+    values[REPORT_FIELD_ALARM] = (float)alarms;
+}
+#endif
+
+static void get_reading(meter_reading_t *r, time_t now)
+{
+    r->device_id = CONFIG_THING_NAME;
+    r->firmware_version = CONFIG_FIRMWARE_VERSION;
+    r->timestamp = now;
+    r->temperature = meas.temperature;
+    r->relay_state = relay_get_state();
+    r->voltage_rms = meas.voltage_rms;
+    r->current_rms = meas.current_rms;
+    r->active_power = meas.active_power;
+    r->reactive_power = meas.reactive_power;
+    r->apparent_power = meas.apparent_power;
+    r->energy_uwh = cumulative_energy_uwh;
+    r->power_factor = meas.power_factor;
+    r->frequency = meas.frequency;
+    r->period_jitter_us = meas.zc_freq.period_stddev_us;
+    r->zc_outliers = meas.zc_freq.outliers_total;
+}
+
+static bool send_telemetry(mqtt_priority_t priority)
+{
+    time_t now = mqtt_manager_get_current_time();
+    if (now == 0) now = timebase_uptime_s();
+    
+    meter_reading_t reading;
+    get_reading(&reading, now);
+    
+    // Min/max/mean/stddev of every sample since the previous publish
+    meter_window_t window;
+    bool have_window = meter_stats_take(&window);
+    
+    payload_format_t format = mqtt_manager_get_format(MQTT_STREAM_TELEMETRY);
+    payload_writer_t w;
+    payload_writer_init(&w, format, telemetry_buf, sizeof(telemetry_buf));
+    meter_telemetry_write(&w, &reading, have_window ? &window : NULL, TELEMETRY_BATCH);
+    
+    size_t len;
+    const void *payload = payload_writer_finish(&w, &len);
+    if (!payload) {
+        ESP_LOGE(TAG, "Telemetry exceeds %u bytes, not published", (unsigned)sizeof(telemetry_buf));
+        return false;
+    }
+    return mqtt_manager_publish_telemetry(payload, len, format, priority);
+}
+
+#if CONFIG_TELEMETRY_BATCH
+static bool flush_batch(batch_flush_t reason)
+{
+    if (meter_batch_count() == 0) return true;
+    
+    ESP_LOGD(TAG, "Flushing %u samples (%s)", (unsigned)meter_batch_count(),
+             meter_batch_reason_name(reason));
+    mqtt_priority_t priority = reason == BATCH_FLUSH_EVENT ? MQTT_PRIORITY_ALARM : MQTT_PRIORITY_BULK;
+    bool ok = send_telemetry(priority);
+    meter_batch_flushed(reason, ok);
+    return ok;
+}
+#endif
+
+// With batching, each call adds a sample and a message goes out only when
+// the batch is full or an event needs to be seen now. Returns false if the
+// reading was not handed to MQTT (offline, or the publish or flush failed);
+// a sample waiting in the batch counts as handed on.
+static bool publish_telemetry(bool event)
+{
+    if (!wifi_manager_is_connected() || !mqtt_manager_is_connected()) return false;
+    
+#if CONFIG_TELEMETRY_BATCH
+    batch_flush_t reason = meter_batch_add(timebase_now_ms(), meas.voltage_rms, meas.current_rms,
+                                           meas.active_power, meas.power_factor, meas.frequency,
+                                           cumulative_energy_uwh, relay_get_state(),
+                                           mqtt_manager_get_format(MQTT_STREAM_TELEMETRY));
+    if (event) reason = BATCH_FLUSH_EVENT;
+    if (reason == BATCH_FLUSH_NONE) return true;
+    return flush_batch(reason);
+#else
+    return send_telemetry(event ? MQTT_PRIORITY_ALARM : MQTT_PRIORITY_BULK);
+#endif
+}
+
+// Readings go out at the shadow interval; relay and energy changes update
+// the shadow directly from their handlers
+static bool update_shadow(void)
+{
+    return mqtt_manager_update_shadow(meas.voltage_rms, meas.current_rms,
+                                      meas.active_power, cumulative_energy_uwh,
+                                      meas.temperature, relay_get_state());
+}
+
+#if CONFIG_REPORT_BY_EXCEPTION
+// Publish only when something changed, on events, or at the heartbeat
+static void report_telemetry(int64_t now)
+{
+    float values[REPORT_FIELD_COUNT];
+    get_report_values(values);
+    
+    report_reason_t reason = meter_report_check(values, now,
+                                                mqtt_manager_get_interval_ms(MQTT_SCHEDULE_TELEMETRY));
+    if (reason == REPORT_REASON_NONE) return;
+    
+    last_publish_time = now;
+    
+    // Only a reading that went out becomes the new deadband reference, so a
+    // failed publish is retried on the next check instead of suppressed
+    if (publish_telemetry(reason == REPORT_REASON_FORCED)) {
+        meter_report_sent(values, now, reason);
+    }
+}
+#endif
+
+/*===============================================================================
+  Stats Publishing
+  ===============================================================================*/
+
+// Diagnostic counters, sent every stats interval instead of with each
+// reading. Integer keys are used in CBOR; each map numbers its members from 1
+static void write_stats(payload_writer_t *w, time_t now)
 {
-    if (!wifi_manager_is_connected() || !mqtt_manager_is_connected()) return;
+    payload_writer_begin_map(w, 0, NULL);
+    payload_writer_string(w, 1, "device_id", CONFIG_THING_NAME);
+    payload_writer_int(w, 2, "timestamp", now);
+    payload_writer_int(w, 3, "uptime_s", timebase_uptime_s());
+    
+    payload_writer_begin_map(w, 4, "wifi");
+    payload_writer_int(w, 1, "rssi_dbm", wifi_manager_get_rssi());
+    payload_writer_string(w, 2, "ip_address", wifi_manager_get_ip());
+    payload_writer_string(w, 3, "ssid", wifi_manager_get_ssid());
+    payload_writer_end_map(w);
+    
+    sample_sched_stats_t sampling;
+    sample_sched_get_stats(&sampling);
+    payload_writer_begin_map(w, 5, "sampling");
+    payload_writer_fixed(w, 1, "interval_ms", sampling.interval_us, 3);
+    payload_writer_int(w, 2, "samples", sampling.samples);
+    payload_writer_int(w, 3, "deadline_misses", sampling.deadline_misses);
+    payload_writer_int(w, 4, "skipped", sampling.skipped);
+    payload_writer_int(w, 5, "zc_locked", sampling.zc_locked);
+    payload_writer_int(w, 6, "max_latency_us", sampling.max_latency_us);
+    payload_writer_float(w, 7, "jitter_rms_us", sampling.jitter_rms_us, 1);
+    payload_writer_int(w, 8, "jitter_max_us", sampling.jitter_max_us);
+#if CONFIG_ADAPTIVE_SAMPLING
+    meter_rate_stats_t rate;
+    meter_rate_get_stats(&rate);
+    payload_writer_string(w, 9, "mode", meter_rate_mode_name(rate.mode));
+    payload_writer_int(w, 10, "burst_floor_ms", rate.burst_floor_ms);
+    payload_writer_int(w, 11, "bursts", rate.bursts);
+    payload_writer_begin_map(w, 12, "time_in_mode_s");
+    for (int m = 0; m < METER_RATE_MODE_COUNT; m++) {
+        payload_writer_int(w, m + 1, meter_rate_mode_name(m),
+                           (int64_t)(rate.time_in_mode_ms[m] / 1000));
+    }
+    payload_writer_end_map(w);
+#endif
+    payload_writer_end_map(w);
+
+#if CONFIG_ENF_LOG_ENABLE
+    enf_log_stats_t enf;
+    enf_log_get_stats(&enf);
+    payload_writer_begin_map(w, 6, "enf");
+    payload_writer_int(w, 1, "cycles_logged", enf.cycles_logged);
+    payload_writer_int(w, 2, "edges_dropped", enf.edges_dropped);
+    payload_writer_int(w, 3, "blocks_sent", enf.blocks_sent);
+    payload_writer_int(w, 4, "blocks_overwritten", enf.blocks_overwritten);
+    payload_writer_int(w, 5, "cpu_us_per_hour", enf.cpu_us_per_hour);
+    payload_writer_int(w, 6, "events_under", enf.events_under);
+    payload_writer_int(w, 7, "events_over", enf.events_over);
+    payload_writer_bool(w, 8, "excursion_active", enf.excursion_active);
+    payload_writer_end_map(w);
+#endif
+
+#if CONFIG_RELAY_ZC_SYNC
+    relay_sync_stats_t relay_sync;
+    relay_get_sync_stats(&relay_sync);
+    payload_writer_begin_map(w, 7, "relay_switching");
+    payload_writer_int(w, 1, "synced", relay_sync.synced);
+    payload_writer_int(w, 2, "immediate", relay_sync.immediate);
+    payload_writer_int(w, 3, "make_delay_us", relay_sync.make_delay_us);
+    payload_writer_int(w, 4, "break_delay_us", relay_sync.break_delay_us);
+    payload_writer_int(w, 5, "last_error_us", relay_sync.last_contact_error_us);
+    payload_writer_int(w, 6, "mean_abs_error_us", relay_sync.mean_abs_error_us);
+    payload_writer_int(w, 7, "max_abs_error_us", relay_sync.max_abs_error_us);
+    payload_writer_end_map(w);
+#endif
+
+#if CONFIG_REPORT_BY_EXCEPTION
+    report_stats_t report;
+    meter_report_get_stats(&report);
+    payload_writer_begin_map(w, 8, "reporting");
+    payload_writer_int(w, 1, "suppressed", report.suppressed);
+    payload_writer_int(w, 2, "on_change", report.reports[REPORT_REASON_CHANGE]);
+    payload_writer_int(w, 3, "heartbeat", report.reports[REPORT_REASON_HEARTBEAT]);
+    payload_writer_int(w, 4, "forced", report.reports[REPORT_REASON_FORCED]);
+    payload_writer_begin_map(w, 5, "triggers");
+    for (int f = 0; f < REPORT_FIELD_COUNT; f++) {
+        payload_writer_int(w, f + 1, meter_report_field_name(f), report.triggers[f]);
+    }
+    payload_writer_end_map(w);
+    payload_writer_end_map(w);
+#endif
+    
+    shadow_sync_stats_t shadow;
+    mqtt_manager_get_shadow_stats(&shadow);
+    payload_writer_begin_map(w, 9, "shadow");
+    payload_writer_int(w, 1, "version", shadow.version);
+    payload_writer_int(w, 2, "updates", shadow.updates);
+    payload_writer_int(w, 3, "fields_sent", shadow.fields_sent);
+    payload_writer_int(w, 4, "fields_skipped", shadow.fields_skipped);
+    payload_writer_int(w, 5, "rejected", shadow.rejected);
+    payload_writer_int(w, 6, "timeouts", shadow.timeouts);
+    payload_writer_int(w, 7, "resumed", shadow.resumed);
+    payload_writer_end_map(w);
+    
+    // Messages and payload bytes per topic class since boot
+    mqtt_traffic_stats_t traffic[MQTT_TRAFFIC_COUNT];
+    mqtt_manager_get_traffic(traffic);
+    payload_writer_begin_map(w, 10, "traffic");
+    for (int t = 0; t < MQTT_TRAFFIC_COUNT; t++) {
+        payload_writer_begin_map(w, t + 1, mqtt_manager_traffic_name(t));
+        payload_writer_int(w, 1, "tx_messages", traffic[t].tx_messages);
+        payload_writer_int(w, 2, "tx_bytes", traffic[t].tx_bytes);
+        payload_writer_int(w, 3, "rx_messages", traffic[t].rx_messages);
+        payload_writer_int(w, 4, "rx_bytes", traffic[t].rx_bytes);
+        payload_writer_end_map(w);
+    }
+    payload_writer_end_map(w);
+    
+    payload_writer_begin_map(w, 11, "interval_ms");
+    payload_writer_int(w, 1, "telemetry", mqtt_manager_get_interval_ms(MQTT_SCHEDULE_TELEMETRY));
+    payload_writer_int(w, 2, "shadow", mqtt_manager_get_interval_ms(MQTT_SCHEDULE_SHADOW));
+    payload_writer_int(w, 3, "stats", mqtt_manager_get_interval_ms(MQTT_SCHEDULE_STATS));
+    payload_writer_end_map(w);
+
+#if CONFIG_TELEMETRY_BATCH
+    batch_stats_t batching;
+    meter_batch_get_stats(&batching);
+    payload_writer_begin_map(w, 12, "batching");
+    payload_writer_int(w, 1, "samples_sent", batching.samples_sent);
+    payload_writer_int(w, 2, "samples_dropped", batching.samples_dropped);
+    payload_writer_int(w, 3, "failed", batching.failed);
+    payload_writer_begin_map(w, 4, "flushes");
+    for (int r = BATCH_FLUSH_NONE + 1; r < BATCH_FLUSH_REASON_COUNT; r++) {
+        payload_writer_int(w, r, meter_batch_reason_name(r), batching.batches[r]);
+    }
+    payload_writer_end_map(w);
+    payload_writer_end_map(w);
+#endif
     
+    // QoS 1 delivery: queue depth, spill to flash and PUBACK round trips
+    mqtt_outbox_stats_t outbox;
+    mqtt_manager_get_outbox_stats(&outbox);
+    payload_writer_begin_map(w, 13, "outbox");
+    payload_writer_int(w, 1, "queued", outbox.queued);
+    payload_writer_int(w, 2, "inflight", outbox.inflight);
+    payload_writer_int(w, 3, "inflight_max", outbox.inflight_max);
+    payload_writer_int(w, 4, "ram_bytes", outbox.ram_bytes);
+    payload_writer_int(w, 5, "alarms", outbox.enqueued[MQTT_PRIORITY_ALARM]);
+    payload_writer_int(w, 6, "acked", outbox.acked);
+    payload_writer_int(w, 7, "retried", outbox.retried);
+    payload_writer_int(w, 8, "spilled", outbox.spilled);
+    payload_writer_int(w, 9, "restored", outbox.restored);
+    payload_writer_int(w, 10, "dropped", outbox.dropped);
+#if CONFIG_MQTT_OUTBOX_SPILL
+    payload_writer_int(w, 11, "spill_pending", outbox_spill_pending());
+#endif
+    payload_writer_begin_map(w, 12, "rtt_ms");
+    payload_writer_int(w, 1, "min", outbox.rtt_min_ms);
+    payload_writer_int(w, 2, "mean", outbox.rtt_mean_ms);
+    payload_writer_int(w, 3, "max", outbox.rtt_max_ms);
+    payload_writer_end_map(w);
+    payload_writer_begin_map(w, 13, "rtt_hist");
+    for (int b = 0; b < MQTT_OUTBOX_RTT_BUCKETS; b++) {
+        payload_writer_int(w, b + 1, mqtt_outbox_rtt_bucket_name(b), outbox.rtt_hist[b]);
+    }
+    payload_writer_end_map(w);
+    payload_writer_end_map(w);
+    
+    // Reconnect cost: connect latency, outages, TLS session resumption and backoff
+    mqtt_link_stats_t link;
+    mqtt_manager_get_link_stats(&link);
+    payload_writer_begin_map(w, 14, "link");
+    payload_writer_int(w, 1, "connects", link.connects);
+    payload_writer_int(w, 2, "disconnects", link.disconnects);
+    payload_writer_int(w, 3, "connect_ms", link.connect_ms);
+    payload_writer_int(w, 4, "connect_max_ms", link.connect_max_ms);
+    payload_writer_int(w, 5, "outage_ms", link.outage_ms);
+    payload_writer_int(w, 6, "outage_max_ms", link.outage_max_ms);
+    payload_writer_begin_map(w, 7, "tls");
+    payload_writer_int(w, 1, "full", link.tls.full);
+    payload_writer_int(w, 2, "resumed", link.tls.resumed);
+    payload_writer_int(w, 3, "failed", link.tls.failed);
+    payload_writer_int(w, 4, "full_ms", link.tls.full_ms);
+    payload_writer_int(w, 5, "resumed_ms", link.tls.resumed_ms);
+    payload_writer_int(w, 6, "full_mean_ms", link.tls.full_mean_ms);
+    payload_writer_int(w, 7, "resumed_mean_ms", link.tls.resumed_mean_ms);
+    payload_writer_bool(w, 8, "session_cached", link.tls.session_cached);
+    payload_writer_bool(w, 9, "session_from_rtc", link.tls.session_from_rtc);
+    payload_writer_end_map(w);
+    payload_writer_begin_map(w, 8, "reconnect");
+    payload_writer_string(w, 1, "state", mqtt_reconnect_state_name(link.reconnect.state));
+    payload_writer_int(w, 2, "attempts", link.reconnect.attempts);
+    payload_writer_int(w, 3, "connected", link.reconnect.connected);
+    payload_writer_int(w, 4, "failed", link.reconnect.failed);
+    payload_writer_int(w, 5, "timeouts", link.reconnect.timeouts);
+    payload_writer_int(w, 6, "lost", link.reconnect.lost);
+    payload_writer_int(w, 7, "flapped", link.reconnect.flapped);
+    payload_writer_int(w, 8, "streak", link.reconnect.streak);
+    payload_writer_int(w, 9, "streak_max", link.reconnect.streak_max);
+    payload_writer_int(w, 10, "last_delay_ms", link.reconnect.last_delay_ms);
+    payload_writer_int(w, 11, "ceiling_ms", link.reconnect.ceiling_ms);
+    payload_writer_end_map(w);
+    payload_writer_end_map(w);
+    
+    // Flash wear of the energy journal: the write budget, the wear it
+    // projects and the erase rate actually seen since boot
+    energy_journal_stats_t journal;
+    energy_journal_get_stats(&journal);
+    uint32_t uptime_s = timebase_uptime_s();
+    payload_writer_begin_map(w, 15, "journal");
+    payload_writer_bool(w, 1, "mounted", journal_ready);
+    payload_writer_int(w, 2, "records_written", journal.records_written);
+    payload_writer_int(w, 3, "records_deferred", journal.records_deferred);
+    payload_writer_int(w, 4, "sectors_erased", journal.sectors_erased);
+    payload_writer_int(w, 5, "write_errors", journal.write_errors);
+    payload_writer_int(w, 6, "torn_records", journal.torn_records);
+    payload_writer_int(w, 7, "budget_per_hour", journal.budget_per_hour);
+    payload_writer_int(w, 8, "erase_cycles", journal.erase_cycles);
+    payload_writer_float(w, 9, "projected_years", journal.projected_years, 1);
+    payload_writer_float(w, 10, "erases_per_day",
+                         uptime_s ? journal.sectors_erased * 86400.0f / uptime_s : 0.0f, 2);
+    payload_writer_int(w, 11, "max_write_us", journal.max_write_us);
+    payload_writer_int(w, 12, "urgent_busy", journal.urgent_busy);
+    payload_writer_end_map(w);
+    
+#if CONFIG_TS_LOG_ENABLE
+    // Time-series log: fill, compression and write amplification
+    ts_log_stats_t history;
+    ts_log_get_stats(&history);
+    uint64_t history_flash = history.bytes_programmed + (uint64_t)history.sectors_erased * 4096;
+    payload_writer_begin_map(w, 16, "history");
+    payload_writer_int(w, 1, "records_appended", history.records_appended);
+    payload_writer_int(w, 2, "records_overwritten", history.records_overwritten);
+    payload_writer_int(w, 3, "blocks_used", history.blocks_used);
+    payload_writer_int(w, 4, "blocks_total", history.blocks_total);
+    payload_writer_float(w, 5, "compression_ratio", history.bytes_encoded ?
+                         (float)history.bytes_appended / history.bytes_encoded : 0.0f, 2);
+    payload_writer_float(w, 6, "write_amplification", history.bytes_appended ?
+                         (float)history_flash / history.bytes_appended : 0.0f, 2);
+    payload_writer_int(w, 7, "sectors_erased", history.sectors_erased);
+    payload_writer_int(w, 8, "min_erase_count", history.min_erase_count);
+    payload_writer_int(w, 9, "max_erase_count", history.max_erase_count);
+    payload_writer_int(w, 10, "write_errors", history.write_errors);
+    payload_writer_int(w, 11, "frame_errors", history.frame_errors);
+    payload_writer_end_map(w);
+#endif
+    
+#if CONFIG_SF_ENABLE
+    // Offline capture and backfill replay
+    store_forward_stats_t backfill;
+    store_forward_get_stats(&backfill);
+    payload_writer_begin_map(w, 17, "backfill");
+    payload_writer_int(w, 1, "records_captured", backfill.records_captured);
+    payload_writer_int(w, 2, "records_replayed", backfill.records_replayed);
+    payload_writer_int(w, 3, "batches_sent", backfill.batches_sent);
+    payload_writer_int(w, 4, "batches_failed", backfill.batches_failed);
+    payload_writer_float(w, 5, "compression_ratio", backfill.bytes_encoded ?
+                         (float)backfill.bytes_raw / backfill.bytes_encoded : 0.0f, 2);
+    payload_writer_int(w, 6, "pending_from", backfill.pending_from);
+    payload_writer_int(w, 7, "pending_to", backfill.pending_to);
+    payload_writer_end_map(w);
+#endif
+    
+#if CONFIG_LAST_GASP_ENABLE
+    // Last gasp: dispatch is interrupt to handler start, handler is the
+    // journal write, total is both. Dips this boot rode through come from
+    // RAM; an outage that cut power only left its dispatch time in the
+    // journal record this boot was restored from.
+    last_gasp_stats_t gasp;
+    last_gasp_get_stats(&gasp);
+    payload_writer_begin_map(w, 18, "last_gasp");
+    payload_writer_int(w, 1, "events", gasp.events);
+    payload_writer_int(w, 2, "ride_throughs", gasp.ride_throughs);
+    payload_writer_int(w, 3, "last_dispatch_us", gasp.last_dispatch_us);
+    payload_writer_int(w, 4, "max_dispatch_us", gasp.max_dispatch_us);
+    payload_writer_int(w, 5, "last_handler_us", gasp.last_handler_us);
+    payload_writer_int(w, 6, "max_handler_us", gasp.max_handler_us);
+    payload_writer_int(w, 7, "last_total_us", gasp.last_total_us);
+    payload_writer_int(w, 8, "max_total_us", gasp.max_total_us);
+    payload_writer_begin_map(w, 9, "power_loss");
+    payload_writer_bool(w, 1, "recovered", booted_from_power_loss);
+    payload_writer_int(w, 2, "timestamp", booted_from_power_loss ? power_loss_entry.timestamp : 0);
+    payload_writer_int(w, 3, "dispatch_us", booted_from_power_loss ? power_loss_entry.latency_us : 0);
+    payload_writer_int(w, 4, "seq", booted_from_power_loss ? power_loss_entry.seq : 0);
+    payload_writer_end_map(w);
+    payload_writer_end_map(w);
+#endif
+    
+    payload_writer_end_map(w);
+}
+
+static bool publish_stats(void)
+{
     time_t now = mqtt_manager_get_current_time();
-    if (now == 0) now = esp_timer_get_time() / 1000000;
+    if (now == 0) now = timebase_uptime_s();
     
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "device_id", CONFIG_THING_NAME);
-    cJSON_AddNumberToObject(root, "timestamp", now);
-    cJSON_AddNumberToObject(root, "Temperature", meas.temperature);
-    cJSON_AddBoolToObject(root, "relay_state", relay_get_state());
-    cJSON_AddStringToObject(root, "firmware_version", CONFIG_FIRMWARE_VERSION);
+    payload_format_t format = mqtt_manager_get_format(MQTT_STREAM_STATS);
+    payload_writer_t w;
+    payload_writer_init(&w, format, stats_buf, sizeof(stats_buf));
+    write_stats(&w, now);
     
-    cJSON *voltage = cJSON_AddObjectToObject(root, "voltage");
-    cJSON_AddNumberToObject(voltage, "rms_v", meas.voltage_rms);
+    size_t len;
+    const void *payload = payload_writer_finish(&w, &len);
+    if (!payload) {
+        ESP_LOGE(TAG, "Stats exceed %u bytes, not published", (unsigned)sizeof(stats_buf));
+        return false;
+    }
+    return mqtt_manager_publish_stats(payload, len, format);
+}
+
+// Publish the CBOR key tables (retained) so consumers can decode every stream.
+// Each table is built in stats_buf in turn; the client copies it on publish
+static bool publish_schemas(void)
+{
+    char *buf = stats_buf;
+    
+    // The schema pass describes the window without consuming it
+    meter_reading_t reading;
+    get_reading(&reading, 0);
+    static const meter_window_t window = {0};
+    
+    payload_writer_t w;
+    payload_writer_init_schema(&w, buf, sizeof(stats_buf), "telemetry", TELEMETRY_SCHEMA_VERSION);
+    meter_telemetry_write(&w, &reading, &window, TELEMETRY_BATCH);
+    const char *schema = payload_writer_finish(&w, NULL);
+    bool ok = schema && mqtt_manager_publish_schema(MQTT_STREAM_TELEMETRY, schema);
+    
+    payload_writer_init_schema(&w, buf, sizeof(stats_buf), "stats", STATS_SCHEMA_VERSION);
+    write_stats(&w, 0);
+    schema = payload_writer_finish(&w, NULL);
+    ok = ok && schema && mqtt_manager_publish_schema(MQTT_STREAM_STATS, schema);
+#if CONFIG_ENF_LOG_ENABLE
+    schema = enf_log_schema(buf, sizeof(stats_buf));
+    ok = ok && schema && mqtt_manager_publish_schema(MQTT_STREAM_ENF, schema);
+#endif
     
-    cJSON *current = cJSON_AddObjectToObject(root, "current");
-    cJSON_AddNumberToObject(current, "rms_a", meas.current_rms);
+    return ok;
+}
+
+/*===============================================================================
+  Time-Series History
+  ===============================================================================*/
+
+static void log_history(void)
+{
+#if CONFIG_TS_LOG_ENABLE
+    static uint32_t last_logged_start = UINT32_MAX;
     
-    cJSON *power = cJSON_AddObjectToObject(root, "power");
-    cJSON_AddNumberToObject(power, "active_w", meas.active_power);
-    cJSON_AddNumberToObject(power, "reactive_var", meas.reactive_power);
-    cJSON_AddNumberToObject(power, "apparent_va", meas.apparent_power);
+    rollup_bucket_t bucket;
+    if (!meter_rollup_latest(ROLLUP_LEVEL_1M, &bucket) ||
+        bucket.start_s == last_logged_start) {
+        return;
+    }
     
-    cJSON *energy = cJSON_AddObjectToObject(root, "energy");
-    cJSON_AddNumberToObject(energy, "cumulative_wh", cumulative_energy);
+    // Records are indexed by wall-clock time, so wait for SNTP
+    time_t now = mqtt_manager_get_current_time();
+    if (now == 0) return;
     
-    cJSON *quality = cJSON_AddObjectToObject(root, "power_quality");
-    cJSON_AddNumberToObject(quality, "power_factor", meas.power_factor);
-    cJSON_AddNumberToObject(quality, "frequency_hz", meas.frequency);
+    last_logged_start = bucket.start_s;
     
-    cJSON *wifi = cJSON_AddObjectToObject(root, "wifi");
-    cJSON_AddNumberToObject(wifi, "rssi_dbm", wifi_manager_get_rssi());
-    cJSON_AddStringToObject(wifi, "ip_address", wifi_manager_get_ip());
-    cJSON_AddStringToObject(wifi, "ssid", wifi_manager_get_ssid());
+    // While offline the log already receives per-publish records
+    if (!mqtt_manager_is_connected()) return;
     
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+    // Stamp with the bucket end so records stay in time order
+    uint32_t bucket_epoch = timebase_mono_to_wall((int64_t)bucket.start_s * 1000000) +
+                            meter_rollup_period_s(ROLLUP_LEVEL_1M);
     
-    if (json_str) {
-        mqtt_manager_publish_telemetry(json_str);
-        free(json_str);
+    ts_log_append(bucket_epoch, bucket.voltage_mean, bucket.current_mean,
+                  bucket.power_mean, cumulative_energy_uwh);
+#endif
+}
+
+static void capture_offline_telemetry(void)
+{
+#if CONFIG_SF_ENABLE
+    time_t now = mqtt_manager_get_current_time();
+    if (now == 0) return;
+    
+    // Store the window mean so nothing sampled during the outage is lost
+    float voltage = meas.voltage_rms;
+    float current = meas.current_rms;
+    float power = meas.active_power;
+    
+    meter_window_t window;
+    if (meter_stats_take(&window)) {
+        voltage = window.ch[METER_CH_VOLTAGE].mean;
+        current = window.ch[METER_CH_CURRENT].mean;
+        power = window.ch[METER_CH_POWER].mean;
     }
     
-    mqtt_manager_update_shadow(meas.voltage_rms, meas.current_rms,
-                               meas.active_power, cumulative_energy,
-                               meas.temperature, relay_get_state());
+    store_forward_capture(now, voltage, current, power, cumulative_energy_uwh);
+#endif
 }
 
 /*===============================================================================
@@ -836,34 +1662,51 @@ static void publish_telemetry(void)
 
 static void measurement_task(void *pvParameters)
 {
-    TickType_t last_wake = xTaskGetTickCount();
-    const TickType_t interval = pdMS_TO_TICKS(MEASUREMENT_INTERVAL_MS);
-    
     ESP_LOGI(TAG, "Measurement task started, interval=%d ms", MEASUREMENT_INTERVAL_MS);
     
+    // Deadlines come from a hardware timer (phase-aligned to zero crossings
+    // when enabled), so ZC gating never delays or blocks a sample
+    sample_sched_init(MEASUREMENT_INTERVAL_MS * 1000, zc_sync_enabled);
+#if CONFIG_ADAPTIVE_SAMPLING
+    meter_rate_init();
+#endif
+    sample_sched_start();
+    
     while (1) {
-        vTaskDelayUntil(&last_wake, interval);
+        sample_tick_t tick;
+        if (!sample_sched_wait(&tick, 2000)) {
+            continue;
+        }
+        meas.sample_us = tick.start_us;
+        meas.synchronized = tick.zc_locked;
         
         if (ade_initialized) {
-            if (zc_sync_enabled) {
-                if (zero_crossing_wait(50)) {
-                    meas.synchronized = true;
-                    esp_rom_delay_us(100);
-                } else {
-                    meas.synchronized = false;
-                }
+#if CONFIG_LAST_GASP_ENABLE
+            // Release the IRQ line here so only this task talks to the ADE
+            if (last_gasp_take_pending()) {
+                ade9153a_ack_events(&ade_dev);
             }
-            
+#endif
             if (read_measurements()) {
                 calculate_measurements();
                 update_energy_accumulation();
                 validate_measurements();
+                
+                if (measurement_valid) {
+                    aggregate_sample();
+#if CONFIG_ADAPTIVE_SAMPLING
+                    uint32_t busy_us = (uint32_t)(timebase_now_us() - tick.start_us);
+                    uint32_t interval_ms = meter_rate_update(tick.start_us, meas.active_power,
+                                                             busy_us);
+                    sample_sched_set_interval(interval_ms * 1000);
+#endif
+                }
             }
         }
         
         check_zc_synchronization();
         
-        uint32_t now = esp_timer_get_time() / 1000;
+        int64_t now = timebase_now_ms();
         if (now - last_debug_print > DEBUG_INTERVAL_MS) {
             last_debug_print = now;
             print_measurements();
@@ -880,6 +1723,13 @@ static void mqtt_task(void *pvParameters)
     TickType_t last_wake = xTaskGetTickCount();
     const TickType_t interval = pdMS_TO_TICKS(100);
     
+    bool schemas_published = false;
+    bool shadow_synced = false;
+    bool stats_sent = false;
+    int64_t last_shadow_time = 0;
+    int64_t last_stats_time = -SHADOW_RETRY_INTERVAL_MS;
+    int64_t last_shadow_attempt = -SHADOW_RETRY_INTERVAL_MS;
+    
     vTaskDelay(pdMS_TO_TICKS(2000));
     
     while (1) {
@@ -893,23 +1743,64 @@ static void mqtt_task(void *pvParameters)
             mqtt_manager_handle();
         }
         
-        uint32_t now = esp_timer_get_time() / 1000;
+        int64_t now = timebase_now_ms();
+        
+        if (!wifi_manager_is_setup_mode() && !mqtt_manager_is_connected()) {
+            if (now - last_publish_time > mqtt_manager_get_interval_ms(MQTT_SCHEDULE_TELEMETRY)) {
+                last_publish_time = now;
+                capture_offline_telemetry();
+            }
+        }
         
         if (wifi_manager_is_connected() && !wifi_manager_is_setup_mode()) {
             if (mqtt_manager_is_connected()) {
-                if (now - last_publish_time > PUBLISH_INTERVAL_MS) {
+                if (!schemas_published) {
+                    schemas_published = publish_schemas();
+                }
+#if CONFIG_REPORT_BY_EXCEPTION
+                report_telemetry(now);
+#else
+                if (now - last_publish_time > mqtt_manager_get_interval_ms(MQTT_SCHEDULE_TELEMETRY)) {
                     last_publish_time = now;
-                    publish_telemetry();
+                    publish_telemetry(false);
                 }
-            } else {
-                static uint32_t last_mqtt_attempt = 0;
-                if (now - last_mqtt_attempt > 10000) {
-                    last_mqtt_attempt = now;
-                    if (!mqtt_manager_is_connected()) {
-                        ESP_LOGI(TAG, "WiFi connected, attempting MQTT connection...");
-                        mqtt_manager_connect();
-                    }
+#endif
+#if CONFIG_TELEMETRY_BATCH
+                // Bound the latency of a batch that is slow to fill
+                batch_flush_t due = meter_batch_due(now);
+                if (due != BATCH_FLUSH_NONE) {
+                    flush_batch(due);
                 }
+#endif
+                // The first update after connecting carries the whole document.
+                // Failed updates and fields still waiting are retried on a short
+                // tick of their own, whatever the shadow interval
+                uint32_t shadow_interval = mqtt_manager_get_interval_ms(MQTT_SCHEDULE_SHADOW);
+                bool shadow_retry = (!shadow_synced || mqtt_manager_shadow_pending()) &&
+                                    now - last_shadow_attempt >= SHADOW_RETRY_INTERVAL_MS;
+                if (shadow_retry ||
+                    (shadow_interval && now - last_shadow_time >= shadow_interval)) {
+                    last_shadow_time = now;
+                    last_shadow_attempt = now;
+                    shadow_synced = update_shadow();
+                }
+                // Diagnostics go out once per connection (retried on the shadow
+                // retry tick), then on their own slow schedule
+                if ((!stats_sent && now - last_stats_time >= SHADOW_RETRY_INTERVAL_MS) ||
+                    now - last_stats_time >= mqtt_manager_get_interval_ms(MQTT_SCHEDULE_STATS)) {
+                    last_stats_time = now;
+                    stats_sent = publish_stats();
+                }
+#if CONFIG_SF_ENABLE
+                store_forward_handle(true, mqtt_manager_get_current_time());
+#endif
+            } else {
+                // Reconnects are scheduled by mqtt_manager (jittered backoff)
+                schemas_published = false;
+                shadow_synced = false;
+                stats_sent = false;
+                last_shadow_attempt = now - SHADOW_RETRY_INTERVAL_MS;
+                last_stats_time = now - SHADOW_RETRY_INTERVAL_MS;
             }
         } else if (!wifi_manager_is_setup_mode()) {
             if (now - last_storage_save > OFFLINE_SAVE_INTERVAL_MS) {
@@ -919,6 +1810,12 @@ static void mqtt_task(void *pvParameters)
             }
         }
         
+        log_history();
+#if CONFIG_ENF_LOG_ENABLE
+        enf_log_handle(!wifi_manager_is_setup_mode() && mqtt_manager_is_connected(),
+                       mqtt_manager_get_format(MQTT_STREAM_ENF));
+#endif
+        
         led_task_handler();
         button_task_handler();
     }
@@ -944,13 +1841,18 @@ void app_main(void)
     ESP_ERROR_CHECK(ret);
     ESP_LOGI(TAG, "NVS initialized");
     
-    system_start_time = esp_timer_get_time() / 1000;
+    system_start_time = timebase_now_ms();
     
     led_init(PIN_LED);
     button_init(PIN_BUTTON, button_event_handler);
     
-    ESP_LOGI(TAG, "Loading saved state from NVS...");
-    load_energy_from_nvs();
+    journal_ready = energy_journal_init();
+    if (!journal_ready) {
+        ESP_LOGW(TAG, "Energy journal unavailable, falling back to NVS");
+    }
+    
+    ESP_LOGI(TAG, "Loading saved state...");
+    load_energy_state();
     
     relay_init(PIN_RELAY, relay_get_state());
     
@@ -982,6 +1884,38 @@ void app_main(void)
     
     ESP_LOGI(TAG, "Initializing ADE9153A...");
     ade_initialized = initialize_ade9153a();
+#if CONFIG_LAST_GASP_ENABLE
+    if (ade_initialized) {
+        arm_last_gasp();
+    }
+#endif
+#if CONFIG_RELAY_ZC_SYNC
+    if (ade_initialized) {
+        relay_set_contact_observer(observe_relay_contact);
+    }
+#endif
+    
+    meter_stats_init();
+    meter_rollup_init();
+#if CONFIG_REPORT_BY_EXCEPTION
+    meter_report_init();
+#endif
+#if CONFIG_TELEMETRY_BATCH
+    meter_batch_init();
+#endif
+
+#if CONFIG_TS_LOG_ENABLE
+    if (!ts_log_init()) {
+        ESP_LOGW(TAG, "Time-series log unavailable");
+    }
+#endif
+#if CONFIG_SF_ENABLE
+    store_forward_init(mqtt_manager_publish_backlog);
+    mqtt_manager_set_backlog_ack_callback(store_forward_acked);
+#endif
+#if CONFIG_ENF_LOG_ENABLE
+    enf_log_init(mqtt_manager_publish_enf);
+#endif
     
     if (ade_initialized) {
         if (CONFIG_DEFAULT_AVERAGE_SAMPLES > 0) {
@@ -1000,6 +1934,20 @@ void app_main(void)
     
     // Initialize MQTT manager 
     mqtt_manager_init();
+#if CONFIG_MQTT_OUTBOX_SPILL
+    // Telemetry that does not fit the RAM outbox goes to flash, and survives reboots
+    static const mqtt_outbox_spill_t outbox_spill = {
+        .push = outbox_spill_push,
+        .peek = outbox_spill_peek,
+        .pop = outbox_spill_pop,
+        .peeked = outbox_spill_peeked,
+    };
+    if (outbox_spill_init()) {
+        mqtt_manager_set_outbox_spill(&outbox_spill);
+    } else {
+        ESP_LOGW(TAG, "Outbox spill unavailable, telemetry is dropped when the outbox is full");
+    }
+#endif
     
     mqtt_manager_set_relay_callback(mqtt_relay_callback);
     mqtt_manager_set_energy_reset_callback(mqtt_energy_reset_callback);
@@ -1014,7 +1962,7 @@ void app_main(void)
             vTaskDelay(pdMS_TO_TICKS(500));
             
             if (!mqtt_manager_connect()) {
-                ESP_LOGW(TAG, "MQTT connection attempt failed, will retry in background");
+                ESP_LOGW(TAG, "MQTT connection not scheduled, will retry in background");
             }
         } else {
             ESP_LOGE(TAG, "Failed to start MQTT manager");
@@ -1040,19 +1988,19 @@ void app_main(void)
     
     xTaskCreate(measurement_task, "measure", 4096, NULL, 5, &measurement_task_handle);
     xTaskCreate(mqtt_task, "mqtt", 8192, NULL, 4, &mqtt_task_handle);
+#if CONFIG_ENF_LOG_ENABLE
+    xTaskCreate(enf_task, "enf", 3072, NULL, 5, NULL);
+#endif
     
     // Set boot time after MQTT manager is initialized
-    time_t now = time(NULL);
-    if (now > 1000000000) {
-        // Calculate boot time based on current time minus uptime
-        uint32_t uptime_ms = esp_timer_get_time() / 1000;
-        mqtt_manager_set_boot_time(now - (uptime_ms / 1000));
+    if (timebase_wall_valid()) {
+        mqtt_manager_set_boot_time(timebase_boot_wall_s());
         ESP_LOGI(TAG, "Boot time set to: %ld (epoch), uptime: %lu seconds", 
-                 mqtt_manager_get_boot_time(), uptime_ms / 1000);
+                 (long)mqtt_manager_get_boot_time(), (unsigned long)timebase_uptime_s());
     }
     
     ESP_LOGI(TAG, "═══════════════════════════════════════════");
-    ESP_LOGI(TAG, "System ready - Uptime: %lu ms", system_start_time);
+    ESP_LOGI(TAG, "System ready - Uptime: %lld ms", (long long)system_start_time);
     ESP_LOGI(TAG, "Relay final state: %s", relay_get_state() ? "ON" : "OFF");
     ESP_LOGI(TAG, "═══════════════════════════════════════════");
 }
\ No newline at end of file
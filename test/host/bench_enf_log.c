@@ -0,0 +1,133 @@
+// smart_plug/test/host/bench_enf_log.c
+//
+// Cost of an hour of ENF logging at 50 Hz with the default configuration:
+// encoded bytes per cycle, message bytes on the wire (JSON and CBOR), feed
+// CPU time and fixed RAM. Fails if a bound documented in enf_log.h no
+// longer holds.
+#include <string.h>
+#include <time.h>
+#include "esp_timer.h"
+#include "host_test.h"
+#include "enf_log.h"
+
+#define NOMINAL_HZ      50
+#define HOUR_CYCLES     (3600 * NOMINAL_HZ)
+#define CHUNK           32          // Edges per zero_crossing_read_edges() in main
+#define BLOCK_BYTES     1024        // CONFIG_ENF_BLOCK_BYTES default
+#define BLOCKS          8           // CONFIG_ENF_BLOCKS default
+
+// Bounds checked below (enf_log.h documents ~1.0 byte per cycle)
+#define MAX_BYTES_PER_CYCLE     1.10
+#define MAX_HOST_NS_PER_CYCLE   2000.0
+
+static uint64_t sent_bytes[2];
+static uint32_t sent_blocks[2];
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static uint32_t rng_state = 12345;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Uniform in [-range, range]
+static int32_t jitter(int32_t range)
+{
+    return (int32_t)(rng() % (uint32_t)(2 * range + 1)) - range;
+}
+
+static bool publish(const void *payload, size_t len, payload_format_t format)
+{
+    (void)payload;
+    sent_bytes[format == PAYLOAD_CBOR] += len;
+    sent_blocks[format == PAYLOAD_CBOR]++;
+    return true;
+}
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*===============================================================================
+  Benchmark
+  ===============================================================================*/
+
+static void bench_one_hour(void)
+{
+    CHECK(enf_log_init(publish));
+    
+    // Grid frequency wanders within +/-50 mHz; the ISR adds +/-3 us of latency
+    int64_t edges[CHUNK];
+    int64_t ideal_us = esp_timer_get_time();
+    double period_us = 1000000.0 / NOMINAL_HZ;
+    int64_t feed_ns = 0;
+    size_t n = 0;
+    
+    for (uint32_t k = 0; k <= HOUR_CYCLES; k++) {
+        period_us += jitter(2) * 0.01;
+        if (period_us > 20020.0) period_us = 20020.0;
+        if (period_us < 19980.0) period_us = 19980.0;
+        ideal_us += (int64_t)period_us;
+        edges[n++] = ideal_us + jitter(3);
+        
+        if (n == CHUNK || k == HOUR_CYCLES) {
+            int64_t start = cpu_ns();
+            enf_log_feed(edges, n, 0);
+            feed_ns += cpu_ns() - start;
+            n = 0;
+            
+            // Uploads alternate formats so both sizes are measured
+            enf_log_handle(true, (k / CHUNK) % 2 ? PAYLOAD_CBOR : PAYLOAD_JSON);
+        }
+    }
+    for (int i = 0; i < 2 * 8; i++) {
+        enf_log_handle(true, i % 2 ? PAYLOAD_CBOR : PAYLOAD_JSON);
+    }
+    
+    enf_log_stats_t stats;
+    enf_log_get_stats(&stats);
+    
+    double bytes_per_cycle = (double)stats.bytes_encoded / stats.cycles_logged;
+    double json_per_block = (double)sent_bytes[0] / sent_blocks[0];
+    double cbor_per_block = (double)sent_bytes[1] / sent_blocks[1];
+    uint32_t blocks = stats.blocks_closed;
+    double ns_per_cycle = (double)feed_ns / stats.cycles_logged;
+    
+    printf("ENF log, one hour at %d Hz (%u cycles)\n", NOMINAL_HZ, (unsigned)HOUR_CYCLES);
+    printf("  encoded:     %llu bytes (%.3f bytes/cycle, %.1f KiB/h)\n",
+           (unsigned long long)stats.bytes_encoded, bytes_per_cycle,
+           stats.bytes_encoded / 1024.0);
+    printf("  blocks:      %lu of %d bytes\n", (unsigned long)blocks, BLOCK_BYTES);
+    printf("  JSON wire:   %.1f KiB/h (%.0f bytes/block)\n",
+           json_per_block * blocks / 1024.0, json_per_block);
+    printf("  CBOR wire:   %.1f KiB/h (%.0f bytes/block)\n",
+           cbor_per_block * blocks / 1024.0, cbor_per_block);
+    printf("  feed CPU:    %.0f ns/cycle on this host, %.1f ms/h\n",
+           ns_per_cycle, ns_per_cycle * HOUR_CYCLES / 1e6);
+    printf("  RAM blocks:  %u bytes fixed\n",
+           (unsigned)(BLOCKS * (BLOCK_BYTES + 16)));
+    
+    CHECK_EQ(stats.cycles_logged, HOUR_CYCLES);
+    CHECK_EQ(stats.edges_dropped, 0);
+    CHECK_EQ(stats.blocks_overwritten, 0);
+    CHECK_EQ(stats.blocks_sent, blocks);
+    CHECK_EQ(stats.events_under + stats.events_over, 0);
+    CHECK(bytes_per_cycle <= MAX_BYTES_PER_CYCLE);
+    CHECK(ns_per_cycle <= MAX_HOST_NS_PER_CYCLE);
+}
+
+int main(void)
+{
+    RUN_TEST(bench_one_hour);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,74 @@
+// smart_plug/test/host/bench_json_reader.c
+//
+// Cost of decoding a shadow delta the way mqtt_event_handler() does:
+// tokenize the receive buffer, then look up the fields it acts on. Reports
+// parse and lookup time and the tokens used. Fails if a delta needs more
+// than a quarter of the handler's token array or parsing gets slow.
+#include <string.h>
+#include <time.h>
+#include "host_test.h"
+#include "json_reader.h"
+
+#define MAX_TOKS        128         // Token array size in mqtt_manager
+#define ROUNDS          200000
+
+// Bounds checked below
+#define MAX_DELTA_TOKS          (MAX_TOKS / 4)
+#define MAX_HOST_NS_PER_DELTA   5000.0
+
+static const char delta[] =
+    "{\"version\":42,\"timestamp\":1760000000,\"state\":{\"relay_status\":\"true\","
+    "\"reset_energy\":false},\"metadata\":{\"relay_status\":{\"timestamp\":1760000000},"
+    "\"reset_energy\":{\"timestamp\":1760000000}}}";
+
+static json_tok_t toks[MAX_TOKS];
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*===============================================================================
+  Benchmark
+  ===============================================================================*/
+
+static void bench_shadow_delta(void)
+{
+    size_t len = strlen(delta);
+    int count = 0;
+    int hits = 0;
+    
+    int64_t start = cpu_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        count = json_reader_parse(delta, len, toks, MAX_TOKS);
+    }
+    double parse_ns = (double)(cpu_ns() - start) / ROUNDS;
+    
+    start = cpu_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        bool relay, reset;
+        int tok = json_reader_find(delta, toks, count, 0, "state.relay_status");
+        hits += tok >= 0 && json_reader_get_bool(delta, &toks[tok], &relay);
+        tok = json_reader_find(delta, toks, count, 0, "state.reset_energy");
+        hits += tok >= 0 && json_reader_get_bool(delta, &toks[tok], &reset);
+    }
+    double find_ns = (double)(cpu_ns() - start) / ROUNDS;
+    
+    printf("Shadow delta, %zu bytes\n", len);
+    printf("  tokens:   %d of %d\n", count, MAX_TOKS);
+    printf("  parse:    %.0f ns on this host (%.2f ns/byte)\n", parse_ns, parse_ns / len);
+    printf("  lookups:  %.0f ns for two fields\n", find_ns);
+    
+    CHECK(count > 0);
+    CHECK_EQ(hits, 2 * ROUNDS);
+    CHECK(count <= MAX_DELTA_TOKS);
+    CHECK(parse_ns + find_ns <= MAX_HOST_NS_PER_DELTA);
+}
+
+int main(void)
+{
+    RUN_TEST(bench_shadow_delta);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,314 @@
+// smart_plug/test/host/bench_json_writer.c
+//
+// json_writer against a cJSON-style tree for a representative telemetry
+// document: encode time, bytes per message and heap allocations per
+// message. Fails if json_writer allocates or loses its lead.
+//
+// The cJSON sources are not available on the host, so the baseline is a
+// stand-in with cJSON's allocation pattern: one node, one key copy and one
+// string copy per item, then a print buffer that starts at 256 bytes and
+// doubles, with numbers printed as cJSON does (%1.15g, or %1.17g when that
+// does not read back exactly). Allocations are counted by wrapping malloc
+// at link time (-Wl,--wrap).
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host_test.h"
+#include "json_writer.h"
+
+#define ROUNDS                  20000
+#define PUBLISH_INTERVAL_MS     1000        // CONFIG_PUBLISH_INTERVAL_MS default
+
+static uint64_t allocations;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+/*===============================================================================
+  Document
+
+  Readings and window of one telemetry message, as the builders walk them
+  ===============================================================================*/
+
+typedef enum { OP_BEGIN, OP_END, OP_STRING, OP_BOOL, OP_INT, OP_FLOAT } op_type_t;
+
+typedef struct {
+    op_type_t type;
+    const char *key;
+    const char *str;
+    double value;
+    uint8_t decimals;
+} op_t;
+
+#define BEGIN(k)            { OP_BEGIN, k, NULL, 0, 0 }
+#define END                 { OP_END, NULL, NULL, 0, 0 }
+#define STRING(k, s)        { OP_STRING, k, s, 0, 0 }
+#define BOOL(k, v)          { OP_BOOL, k, NULL, v, 0 }
+#define INT(k, v)           { OP_INT, k, NULL, v, 0 }
+#define FLOAT(k, v, d)      { OP_FLOAT, k, NULL, (float)(v), d }
+#define STAT(k, lo, hi, mean, sd, d) \
+    BEGIN(k), FLOAT("min", lo, d), FLOAT("max", hi, d), FLOAT("mean", mean, d), \
+    FLOAT("std", sd, d), END
+
+static const op_t document[] = {
+    BEGIN(NULL),
+    STRING("device_id", "Smart_Plug_1"),
+    INT("timestamp", 1760000000),
+    FLOAT("Temperature", 41.25, 2),
+    BOOL("relay_state", 1),
+    STRING("firmware_version", "1.0.0"),
+    BEGIN("voltage"), FLOAT("rms_v", 230.512, 3), END,
+    BEGIN("current"), FLOAT("rms_a", 4.3471, 4), END,
+    BEGIN("power"),
+        FLOAT("active_w", 998.125, 3),
+        FLOAT("reactive_var", -120.5, 3),
+        FLOAT("apparent_va", 1005.375, 3),
+    END,
+    BEGIN("energy"), INT("cumulative_uwh", 123456789012.0), END,
+    BEGIN("power_quality"),
+        FLOAT("power_factor", 0.9927, 4),
+        FLOAT("frequency_hz", 50.012, 3),
+        FLOAT("period_jitter_us", 3.4, 1),
+        INT("zc_outliers", 2),
+    END,
+    BEGIN("window"),
+        INT("samples", 50),
+        INT("duration_ms", 1000),
+        STAT("voltage", 230.36, 230.66, 230.512, 0.101, 3),
+        STAT("current", 4.3441, 4.3501, 4.3471, 0.0021, 4),
+        STAT("active_power", 997.52, 998.72, 998.125, 0.405, 3),
+        STAT("power_factor", 0.9927, 0.9927, 0.9927, 0.0, 4),
+        STAT("frequency", 50.006, 50.018, 50.012, 0.004, 3),
+    END,
+    END,
+};
+
+#define DOCUMENT_OPS    (sizeof(document) / sizeof(document[0]))
+
+/*===============================================================================
+  Baseline: cJSON-style Tree
+  ===============================================================================*/
+
+typedef struct node {
+    struct node *next;
+    struct node *child;
+    char *key;
+    char *str;
+    double value;
+    op_type_t type;
+} node_t;
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+} printbuf_t;
+
+static char *copy_string(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    char *copy = malloc(len);
+    memcpy(copy, s, len);
+    return copy;
+}
+
+static const op_t *build_tree(const op_t *op, node_t **out)
+{
+    node_t *node = calloc(1, sizeof(*node));
+    node->type = op->type;
+    node->key = op->key ? copy_string(op->key) : NULL;
+    node->str = op->str ? copy_string(op->str) : NULL;
+    node->value = op->value;
+    *out = node;
+    op++;
+    
+    if (node->type == OP_BEGIN) {
+        node_t **tail = &node->child;
+        while (op->type != OP_END) {
+            op = build_tree(op, tail);
+            tail = &(*tail)->next;
+        }
+        op++;
+    }
+    return op;
+}
+
+static void free_tree(node_t *node)
+{
+    while (node) {
+        node_t *next = node->next;
+        free_tree(node->child);
+        free(node->key);
+        free(node->str);
+        free(node);
+        node = next;
+    }
+}
+
+static void put(printbuf_t *p, const char *s, size_t len)
+{
+    if (p->len + len + 1 > p->size) {
+        while (p->len + len + 1 > p->size) p->size *= 2;
+        p->buf = realloc(p->buf, p->size);
+    }
+    memcpy(p->buf + p->len, s, len);
+    p->len += len;
+    p->buf[p->len] = '\0';
+}
+
+static void put_string(printbuf_t *p, const char *s)
+{
+    put(p, "\"", 1);
+    put(p, s, strlen(s));
+    put(p, "\"", 1);
+}
+
+static void print_node(printbuf_t *p, const node_t *node)
+{
+    char num[32];
+    
+    if (node->key) {
+        put_string(p, node->key);
+        put(p, ":", 1);
+    }
+    switch (node->type) {
+        case OP_BEGIN:
+            put(p, "{", 1);
+            for (const node_t *c = node->child; c; c = c->next) {
+                print_node(p, c);
+                if (c->next) put(p, ",", 1);
+            }
+            put(p, "}", 1);
+            break;
+        
+        case OP_STRING:
+            put_string(p, node->str);
+            break;
+        
+        case OP_BOOL:
+            put(p, node->value ? "true" : "false", node->value ? 4 : 5);
+            break;
+        
+        default: {
+            double check = 0;
+            int len = snprintf(num, sizeof(num), "%1.15g", node->value);
+            if (sscanf(num, "%lg", &check) != 1 || check != node->value) {
+                len = snprintf(num, sizeof(num), "%1.17g", node->value);
+            }
+            put(p, num, (size_t)len);
+            break;
+        }
+    }
+}
+
+static char *tree_encode(size_t *len)
+{
+    node_t *root;
+    build_tree(document, &root);
+    
+    printbuf_t p = { .buf = malloc(256), .size = 256, .len = 0 };
+    print_node(&p, root);
+    free_tree(root);
+    
+    *len = p.len;
+    return p.buf;
+}
+
+/*===============================================================================
+  json_writer
+  ===============================================================================*/
+
+static char writer_buf[2048];
+
+static const char *writer_encode(size_t *len)
+{
+    json_writer_t w;
+    json_writer_init(&w, writer_buf, sizeof(writer_buf));
+    
+    for (size_t i = 0; i < DOCUMENT_OPS; i++) {
+        const op_t *op = &document[i];
+        switch (op->type) {
+            case OP_BEGIN:  json_writer_begin_object(&w, op->key); break;
+            case OP_END:    json_writer_end_object(&w); break;
+            case OP_STRING: json_writer_string(&w, op->key, op->str); break;
+            case OP_BOOL:   json_writer_bool(&w, op->key, op->value != 0); break;
+            case OP_INT:    json_writer_int(&w, op->key, (int64_t)op->value); break;
+            case OP_FLOAT:
+                json_writer_float(&w, op->key, (float)op->value, op->decimals);
+                break;
+        }
+    }
+    return json_writer_finish(&w, len);
+}
+
+/*===============================================================================
+  Benchmark
+  ===============================================================================*/
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void bench_against_tree(void)
+{
+    size_t tree_len = 0;
+    size_t writer_len = 0;
+    
+    uint64_t before = allocations;
+    int64_t start = cpu_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        free(tree_encode(&tree_len));
+    }
+    double tree_ns = (double)(cpu_ns() - start) / ROUNDS;
+    double tree_allocs = (double)(allocations - before) / ROUNDS;
+    
+    before = allocations;
+    start = cpu_ns();
+    for (int i = 0; i < ROUNDS; i++) {
+        CHECK(writer_encode(&writer_len) != NULL);
+    }
+    double writer_ns = (double)(cpu_ns() - start) / ROUNDS;
+    double writer_allocs = (double)(allocations - before) / ROUNDS;
+    
+    printf("Telemetry JSON, one document per %d ms (%zu items)\n",
+           PUBLISH_INTERVAL_MS, DOCUMENT_OPS);
+    printf("  tree + print:  %6.0f ns/doc, %4zu B (%4.0f B/s), %5.1f allocs/doc\n",
+           tree_ns, tree_len, tree_len * 1000.0 / PUBLISH_INTERVAL_MS, tree_allocs);
+    printf("  json_writer:   %6.0f ns/doc, %4zu B (%4.0f B/s), %5.1f allocs/doc\n",
+           writer_ns, writer_len, writer_len * 1000.0 / PUBLISH_INTERVAL_MS, writer_allocs);
+    
+    CHECK_EQ(allocations - before, 0);
+    CHECK(tree_allocs > 0);
+    CHECK(writer_len < tree_len);
+    CHECK(writer_ns < tree_ns);
+}
+
+int main(void)
+{
+    RUN_TEST(bench_against_tree);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,326 @@
+// smart_plug/test/host/bench_telemetry.c
+//
+// The telemetry message as meter_telemetry_write() builds it: CBOR decoded
+// back and compared with the readings, the sample batch present exactly
+// when asked for and carried whole when it flushes, then message size (JSON and CBOR), traffic per hour at
+// the default publish interval and encode CPU time. Fails if the JSON form
+// outgrows TELEMETRY_BUF_SIZE in main.
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host_test.h"
+#include "cbor_decode.h"
+#include "json_reader.h"
+#include "meter_batch.h"
+#include "meter_telemetry.h"
+
+#define PUBLISH_INTERVAL_MS     1000        // CONFIG_PUBLISH_INTERVAL_MS default
+#define MESSAGES_PER_HOUR       (3600000 / PUBLISH_INTERVAL_MS)
+#define WINDOW_SAMPLES          50          // Measurement cycles per publish
+#define ENCODE_ROUNDS           20000
+#define BATCH_SAMPLES           3
+#define BATCH_MAX_SAMPLES       10          // CONFIG_BATCH_MAX_SAMPLES default
+
+// Bounds checked below
+#define MAX_JSON_BYTES          1280        // TELEMETRY_BUF_SIZE without batching
+#define MAX_HOST_NS_PER_MESSAGE 20000.0
+
+static const meter_reading_t reading = {
+    .device_id = "Smart_Plug_1",
+    .firmware_version = "1.0.0",
+    .timestamp = 1760000000,
+    .temperature = 41.25f,
+    .relay_state = true,
+    .voltage_rms = 230.512f,
+    .current_rms = 4.3471f,
+    .active_power = 998.125f,
+    .reactive_power = -120.5f,
+    .apparent_power = 1005.375f,
+    .energy_uwh = 123456789012LL,
+    .power_factor = 0.9927f,
+    .frequency = 50.012f,
+    .period_jitter_us = 3.4f,
+    .zc_outliers = 2,
+};
+
+static meter_window_t window;
+static uint8_t buf[2048];
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static void fill_window(void)
+{
+    meter_stats_init();
+    for (int i = 0; i < WINDOW_SAMPLES; i++) {
+        float wobble = (float)(i % 7 - 3);
+        float values[METER_CH_COUNT] = {
+            [METER_CH_VOLTAGE] = reading.voltage_rms + wobble * 0.05f,
+            [METER_CH_CURRENT] = reading.current_rms + wobble * 0.001f,
+            [METER_CH_POWER] = reading.active_power + wobble * 0.2f,
+            [METER_CH_POWER_FACTOR] = reading.power_factor,
+            [METER_CH_FREQUENCY] = reading.frequency + wobble * 0.002f,
+        };
+        meter_stats_add(values);
+    }
+    meter_stats_take(&window);
+}
+
+static size_t encode_batch(payload_format_t format, bool batch, const void **out)
+{
+    payload_writer_t w;
+    payload_writer_init(&w, format, buf, sizeof(buf));
+    meter_telemetry_write(&w, &reading, &window, batch);
+    size_t len = 0;
+    *out = payload_writer_finish(&w, &len);
+    return *out ? len : 0;
+}
+
+static size_t encode(payload_format_t format, const void **out)
+{
+    return encode_batch(format, false, out);
+}
+
+// Floats travel in CBOR as integers scaled by 10^decimals
+static int64_t scaled(float value, int decimals)
+{
+    double x = value;
+    for (int i = 0; i < decimals; i++) x *= 10.0;
+    return llround(x);
+}
+
+// Value of a JSON number token
+static double json_number(const char *doc, const json_tok_t *tok)
+{
+    char text[32];
+    size_t n = tok->end - tok->start;
+    if (n >= sizeof(text)) return NAN;
+    memcpy(text, doc + tok->start, n);
+    text[n] = '\0';
+    return strtod(text, NULL);
+}
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_cbor_round_trip(void)
+{
+    fill_window();
+    const void *doc;
+    size_t len = encode(PAYLOAD_CBOR, &doc);
+    CHECK(len > 0);
+    
+    cbor_item_t root, item;
+    CHECK(cbor_decode(doc, len, &root));
+    CHECK_EQ(root.type, CBOR_ITEM_MAP);
+    
+    CHECK(cbor_path(&root, &item, 1, 1));
+    CHECK_EQ(item.type, CBOR_ITEM_TEXT);
+    CHECK(item.len == strlen(reading.device_id) &&
+          memcmp(item.data, reading.device_id, item.len) == 0);
+    CHECK(cbor_path(&root, &item, 1, 2));
+    CHECK_EQ(item.value, reading.timestamp);
+    CHECK(cbor_path(&root, &item, 1, 3));
+    CHECK_EQ(item.value, scaled(reading.temperature, 2));
+    CHECK(cbor_path(&root, &item, 1, 4));
+    CHECK_EQ(item.type, CBOR_ITEM_BOOL);
+    CHECK_EQ(item.value, 1);
+    
+    CHECK(cbor_path(&root, &item, 2, 6, 1));
+    CHECK_EQ(item.value, scaled(reading.voltage_rms, 3));
+    CHECK(cbor_path(&root, &item, 2, 7, 1));
+    CHECK_EQ(item.value, scaled(reading.current_rms, 4));
+    CHECK(cbor_path(&root, &item, 2, 8, 1));
+    CHECK_EQ(item.value, scaled(reading.active_power, 3));
+    CHECK(cbor_path(&root, &item, 2, 8, 2));
+    CHECK_EQ(item.value, scaled(reading.reactive_power, 3));
+    CHECK(cbor_path(&root, &item, 2, 9, 1));
+    CHECK_EQ(item.value, reading.energy_uwh);
+    CHECK(!cbor_path(&root, &item, 2, 9, 2));      // JSON only
+    CHECK(cbor_path(&root, &item, 2, 10, 1));
+    CHECK_EQ(item.value, scaled(reading.power_factor, 4));
+    CHECK(cbor_path(&root, &item, 2, 10, 4));
+    CHECK_EQ(item.value, reading.zc_outliers);
+    
+    CHECK(cbor_path(&root, &item, 2, 11, 1));
+    CHECK_EQ(item.value, WINDOW_SAMPLES);
+    CHECK(cbor_path(&root, &item, 3, 11, 3, 1));
+    CHECK_EQ(item.value, scaled(window.ch[METER_CH_VOLTAGE].min, 3));
+    CHECK(cbor_path(&root, &item, 3, 11, 7, 2));
+    CHECK_EQ(item.value, scaled(window.ch[METER_CH_FREQUENCY].max, 3));
+    
+    // Readings only: no batch unless asked for, and the diagnostics went
+    // to the stats message
+    CHECK(!cbor_path(&root, &item, 1, 12));
+    CHECK(!cbor_path(&root, &item, 1, 13));
+}
+
+static void test_batch_key(void)
+{
+    fill_window();
+    meter_batch_init();
+    for (int i = 0; i < BATCH_SAMPLES; i++) {
+        meter_batch_add(1000 + i * 1000, reading.voltage_rms, reading.current_rms,
+                        reading.active_power, reading.power_factor, reading.frequency,
+                        reading.energy_uwh + i * 277, true, PAYLOAD_CBOR);
+    }
+    
+    const void *doc;
+    size_t len = encode_batch(PAYLOAD_CBOR, true, &doc);
+    CHECK(len > 0);
+    cbor_item_t root, item;
+    CHECK(cbor_decode(doc, len, &root));
+    CHECK(cbor_path(&root, &item, 2, 12, 3));
+    CHECK_EQ(item.value, BATCH_SAMPLES);
+    CHECK(cbor_path(&root, &item, 2, 12, 5));
+    CHECK_EQ(item.type, CBOR_ITEM_ARRAY);
+    
+    len = encode_batch(PAYLOAD_JSON, true, &doc);
+    CHECK(len > 0);
+    json_tok_t toks[200];
+    int count = json_reader_parse(doc, len, toks, 200);
+    CHECK(count > 0);
+    int64_t value;
+    int tok = json_reader_find(doc, toks, count, 0, "batch.count");
+    CHECK(tok >= 0 && json_reader_get_int(doc, &toks[tok], &value));
+    CHECK_EQ(value, BATCH_SAMPLES);
+    tok = json_reader_find(doc, toks, count, 0, "batch.rms_v");
+    CHECK(tok >= 0 && toks[tok].type == JSON_TOK_ARRAY);
+    CHECK_EQ(toks[tok].size, BATCH_SAMPLES);
+}
+
+// A batch that fills up is what the next message carries; once published
+// it is counted under its reason and the next message starts empty
+static void test_batch_flush(void)
+{
+    fill_window();
+    meter_batch_init();
+    
+    batch_flush_t reason = BATCH_FLUSH_NONE;
+    for (int i = 0; i < BATCH_MAX_SAMPLES; i++) {
+        CHECK_EQ(reason, BATCH_FLUSH_NONE);
+        reason = meter_batch_add(1000 + i * 1000, 230.0f + i * 0.25f, reading.current_rms,
+                                 reading.active_power, reading.power_factor, reading.frequency,
+                                 reading.energy_uwh + i * 277, true, PAYLOAD_JSON);
+    }
+    CHECK_EQ(reason, BATCH_FLUSH_COUNT);
+    
+    const void *doc;
+    size_t len = encode_batch(PAYLOAD_JSON, true, &doc);
+    CHECK(len > 0);
+    json_tok_t toks[256];
+    int count = json_reader_parse(doc, len, toks, 256);
+    CHECK(count > 0);
+    int64_t value;
+    int tok = json_reader_find(doc, toks, count, 0, "batch.count");
+    CHECK(tok >= 0 && json_reader_get_int(doc, &toks[tok], &value));
+    CHECK_EQ(value, BATCH_MAX_SAMPLES);
+    
+    // Every sample, in order
+    int rms_v = json_reader_find(doc, toks, count, 0, "batch.rms_v");
+    int offsets = json_reader_find(doc, toks, count, 0, "batch.offset_ms");
+    int energy = json_reader_find(doc, toks, count, 0, "batch.energy_uwh");
+    CHECK(rms_v >= 0 && offsets >= 0 && energy >= 0);
+    CHECK_EQ(toks[rms_v].size, BATCH_MAX_SAMPLES);
+    for (int i = 0; i < BATCH_MAX_SAMPLES; i++) {
+        CHECK(json_number(doc, &toks[rms_v + 1 + i]) == 230.0 + i * 0.25);
+        CHECK(json_reader_get_int(doc, &toks[offsets + 1 + i], &value));
+        CHECK_EQ(value, i * 1000);
+        CHECK(json_reader_get_int(doc, &toks[energy + 1 + i], &value));
+        CHECK_EQ(value, i * 277);
+    }
+    
+    // A failed publish keeps the samples for the next attempt
+    meter_batch_flushed(reason, false);
+    CHECK_EQ(meter_batch_count(), BATCH_MAX_SAMPLES);
+    batch_stats_t stats;
+    meter_batch_get_stats(&stats);
+    CHECK_EQ(stats.failed, 1);
+    CHECK_EQ(stats.batches[BATCH_FLUSH_COUNT], 0);
+    
+    meter_batch_flushed(reason, true);
+    meter_batch_get_stats(&stats);
+    CHECK_EQ(meter_batch_count(), 0);
+    CHECK_EQ(stats.batches[BATCH_FLUSH_COUNT], 1);
+    CHECK_EQ(stats.samples_sent, BATCH_MAX_SAMPLES);
+    
+    len = encode_batch(PAYLOAD_JSON, true, &doc);
+    CHECK(len > 0);
+    count = json_reader_parse(doc, len, toks, 256);
+    tok = json_reader_find(doc, toks, count, 0, "batch.count");
+    CHECK(tok >= 0 && json_reader_get_int(doc, &toks[tok], &value));
+    CHECK_EQ(value, 0);
+}
+
+static void test_json_matches(void)
+{
+    fill_window();
+    const void *doc;
+    size_t len = encode(PAYLOAD_JSON, &doc);
+    CHECK(len > 0);
+    
+    json_tok_t toks[160];
+    int count = json_reader_parse(doc, len, toks, 160);
+    CHECK(count > 0);
+    
+    int64_t value;
+    int tok = json_reader_find(doc, toks, count, 0, "energy.cumulative_uwh");
+    CHECK(tok >= 0 && json_reader_get_int(doc, &toks[tok], &value));
+    CHECK_EQ(value, reading.energy_uwh);
+    tok = json_reader_find(doc, toks, count, 0, "window.samples");
+    CHECK(tok >= 0 && json_reader_get_int(doc, &toks[tok], &value));
+    CHECK_EQ(value, WINDOW_SAMPLES);
+    CHECK(json_reader_find(doc, toks, count, 0, "wifi") < 0);
+    CHECK(json_reader_find(doc, toks, count, 0, "traffic") < 0);
+}
+
+static void bench_size_and_speed(void)
+{
+    fill_window();
+    const void *doc;
+    size_t json_len = encode(PAYLOAD_JSON, &doc);
+    size_t cbor_len = encode(PAYLOAD_CBOR, &doc);
+    CHECK(json_len > 0 && cbor_len > 0);
+    
+    double ns[2];
+    for (int f = 0; f < 2; f++) {
+        payload_format_t format = f ? PAYLOAD_CBOR : PAYLOAD_JSON;
+        int64_t start = cpu_ns();
+        for (int i = 0; i < ENCODE_ROUNDS; i++) {
+            encode(format, &doc);
+        }
+        ns[f] = (double)(cpu_ns() - start) / ENCODE_ROUNDS;
+    }
+    
+    printf("Telemetry message, one per %d ms (%d samples per window)\n",
+           PUBLISH_INTERVAL_MS, WINDOW_SAMPLES);
+    printf("  JSON:  %4zu bytes, %.1f KiB/h, %.0f ns to encode on this host\n",
+           json_len, json_len * (double)MESSAGES_PER_HOUR / 1024.0, ns[0]);
+    printf("  CBOR:  %4zu bytes, %.1f KiB/h, %.0f ns to encode on this host\n",
+           cbor_len, cbor_len * (double)MESSAGES_PER_HOUR / 1024.0, ns[1]);
+    
+    CHECK(json_len <= MAX_JSON_BYTES);
+    CHECK(cbor_len < json_len);
+    CHECK(ns[0] <= MAX_HOST_NS_PER_MESSAGE);
+    CHECK(ns[1] <= MAX_HOST_NS_PER_MESSAGE);
+}
+
+int main(void)
+{
+    RUN_TEST(test_cbor_round_trip);
+    RUN_TEST(test_json_matches);
+    RUN_TEST(test_batch_key);
+    RUN_TEST(test_batch_flush);
+    RUN_TEST(bench_size_and_speed);
+    return HOST_TEST_RESULT();
+}
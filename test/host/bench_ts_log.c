@@ -0,0 +1,171 @@
+// smart_plug/test/host/bench_ts_log.c
+//
+// ts_log on an emulated "storage" partition of the shipped size: write
+// amplification, compression and throughput as reported by
+// ts_log_get_stats(), for a day of one-minute rollups and for offline
+// captures at 1 s that wrap the log several times. The traces are
+// generated as in bench_ts_codec. Every record still in the log must read
+// back in order.
+#include <string.h>
+#include <time.h>
+#include "host_test.h"
+#include "flash_emu.h"
+#include "ts_log.h"
+
+#define PARTITION_SIZE  0x58000     // "storage" in partitions.csv
+#define DAY_ROLLUPS     1440
+#define WRAP_CAPTURES   150000
+
+// Bounds checked below
+#define MIN_RATIO               1.5
+#define MAX_WRITE_AMP           1.5
+#define MAX_HOST_NS_PER_RECORD  5000.0
+
+static ts_record_t out[WRAP_CAPTURES];
+
+/*===============================================================================
+  Trace Generation
+  ===============================================================================*/
+
+static uint32_t rng_state = 1234567;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static float noise(float amplitude)
+{
+    return amplitude * ((float)(rng() % 2001) / 1000.0f - 1.0f);
+}
+
+// Compressor runs 20 minutes of every hour; standby draw otherwise
+static ts_record_t next_record(uint32_t t, uint32_t step_s)
+{
+    static float v_slow = 230.0f;
+    static double energy_wh = 12345.6;
+    
+    v_slow += noise(0.05f);
+    if (v_slow > 235.0f) v_slow = 235.0f;
+    if (v_slow < 225.0f) v_slow = 225.0f;
+    
+    bool running = (t / 60) % 60 < 20;
+    float power = running ? 95.0f + noise(3.0f) : 1.2f + noise(0.05f);
+    float voltage = v_slow + noise(0.3f);
+    
+    energy_wh += power * step_s / 3600.0;
+    return (ts_record_t){
+        .timestamp = t,
+        .voltage = voltage,
+        .current = power / (voltage * (running ? 0.92f : 0.45f)),
+        .power = power,
+        .energy_dwh = (uint32_t)(energy_wh * 10.0 + 0.5),
+    };
+}
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static int64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*===============================================================================
+  Benchmark
+  ===============================================================================*/
+
+static void bench_trace(const char *name, uint32_t count, uint32_t step_s)
+{
+    flash_emu_create("storage", PARTITION_SIZE);
+    CHECK(ts_log_init());
+    
+    // Counters are cumulative for the process
+    ts_log_stats_t before;
+    ts_log_get_stats(&before);
+    
+    uint32_t t0 = 1760000000;
+    int64_t start = cpu_ns();
+    for (uint32_t i = 0; i < count; i++) {
+        ts_record_t rec = next_record(t0 + i * step_s, step_s);
+        CHECK(ts_log_append(rec.timestamp, rec.voltage, rec.current, rec.power,
+                            (int64_t)rec.energy_dwh * 100000));
+    }
+    CHECK(ts_log_flush());
+    double append_ns = (double)(cpu_ns() - start) / count;
+    
+    ts_log_stats_t s;
+    ts_log_get_stats(&s);
+    uint32_t appended = s.records_appended - before.records_appended;
+    uint32_t overwritten = s.records_overwritten - before.records_overwritten;
+    uint64_t raw = s.bytes_appended - before.bytes_appended;
+    uint64_t encoded = s.bytes_encoded - before.bytes_encoded;
+    uint64_t programmed = s.bytes_programmed - before.bytes_programmed;
+    uint32_t erased = s.sectors_erased - before.sectors_erased;
+    
+    // Everything not overwritten reads back, oldest first and contiguous
+    start = cpu_ns();
+    size_t n = ts_log_query(t0, UINT32_MAX - 1, out, WRAP_CAPTURES);
+    double query_ns = n ? (double)(cpu_ns() - start) / n : 0;
+    
+    bool ordered = n > 0;
+    for (size_t i = 0; i < n && ordered; i++) {
+        ordered = out[i].timestamp == t0 + (overwritten + i) * step_s;
+    }
+    
+    double ratio = (double)raw / encoded;
+    double write_amp = (double)(programmed + (uint64_t)erased * 4096) / raw;
+    flash_emu_stats_t flash = flash_emu_get_stats("storage");
+    
+    printf("%s (%lu records, %lu blocks)\n", name, (unsigned long)count,
+           (unsigned long)s.blocks_total);
+    printf("  compression:  %llu -> %llu bytes, ratio %.2f\n",
+           (unsigned long long)raw, (unsigned long long)encoded, ratio);
+    printf("  flash:        %llu bytes programmed in %lu writes, %lu erases\n",
+           (unsigned long long)programmed, (unsigned long)(s.page_writes - before.page_writes),
+           (unsigned long)erased);
+    printf("  write amp:    %.2f (programmed + erased / appended)\n", write_amp);
+    printf("  wear:         erase counts %lu..%lu\n",
+           (unsigned long)s.min_erase_count, (unsigned long)s.max_erase_count);
+    printf("  retained:     %zu records, %lu overwritten\n", n, (unsigned long)overwritten);
+    printf("  append:       %.0f ns/record on this host (encode %.1f ms, write %.1f ms, "
+           "erase %.1f ms)\n", append_ns,
+           (s.encode_time_us - before.encode_time_us) / 1000.0,
+           (s.write_time_us - before.write_time_us) / 1000.0,
+           (s.erase_time_us - before.erase_time_us) / 1000.0);
+    printf("  query:        %.0f ns/record, %.2f bytes read per record\n",
+           query_ns, n ? (double)flash.bytes_read / n : 0.0);
+    
+    CHECK_EQ(appended, count);
+    CHECK_EQ(n + overwritten, count);
+    CHECK(ordered);
+    CHECK_EQ(s.write_errors, before.write_errors);
+    CHECK_EQ(s.frame_errors, before.frame_errors);
+    CHECK(s.max_erase_count - s.min_erase_count <= 1);
+    CHECK(ratio >= MIN_RATIO);
+    CHECK(write_amp <= MAX_WRITE_AMP);
+    CHECK(append_ns <= MAX_HOST_NS_PER_RECORD);
+}
+
+static void bench_day_of_rollups(void)
+{
+    bench_trace("One day of 1 minute rollups", DAY_ROLLUPS, 60);
+}
+
+static void bench_wrapping_captures(void)
+{
+    bench_trace("1 s offline captures wrapping the log", WRAP_CAPTURES, 1);
+}
+
+int main(void)
+{
+    RUN_TEST(bench_day_of_rollups);
+    RUN_TEST(bench_wrapping_captures);
+    return HOST_TEST_RESULT();
+}
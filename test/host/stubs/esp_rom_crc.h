@@ -0,0 +1,10 @@
+// smart_plug/test/host/stubs/esp_rom_crc.h
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// Same result as the ROM routine (CRC-32, reflected, 0xEDB88320)
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* ESP_ROM_CRC_H */
@@ -0,0 +1,10 @@
+// smart_plug/test/host/stubs/esp_timer.h
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+
+// Monotonic microseconds (CLOCK_MONOTONIC)
+int64_t esp_timer_get_time(void);
+
+#endif /* ESP_TIMER_H */
@@ -0,0 +1,332 @@
+// smart_plug/test/host/support/broker_standin.c
+#include "broker_standin.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MAX_MESSAGES    512
+#define MAX_PACKET      (70 * 1024)
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+} message_t;
+
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int listen_fd = -1;
+static int conn_fd = -1;
+static volatile bool running = false;
+static volatile bool send_acks = true;
+
+static message_t messages[MAX_MESSAGES];
+static int message_count = 0;
+
+/*===============================================================================
+  Packet I/O
+  ===============================================================================*/
+
+static bool read_exact(int fd, void *buf, size_t len)
+{
+    uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+static bool write_exact(int fd, const void *buf, size_t len)
+{
+    const uint8_t *p = buf;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+// Fixed header: packet type byte and remaining length
+static bool read_packet(int fd, uint8_t *type, uint8_t *body, size_t size, size_t *len)
+{
+    if (!read_exact(fd, type, 1)) return false;
+    
+    size_t remaining = 0;
+    for (int shift = 0; shift < 28; shift += 7) {
+        uint8_t b;
+        if (!read_exact(fd, &b, 1)) return false;
+        remaining |= (size_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+    if (remaining > size) return false;
+    
+    *len = remaining;
+    return remaining == 0 || read_exact(fd, body, remaining);
+}
+
+static size_t put_length(uint8_t *out, size_t len)
+{
+    size_t n = 0;
+    do {
+        uint8_t b = len & 0x7F;
+        len >>= 7;
+        out[n++] = b | (len ? 0x80 : 0);
+    } while (len);
+    return n;
+}
+
+/*===============================================================================
+  Broker Thread
+  ===============================================================================*/
+
+static void record(const uint8_t *data, size_t len)
+{
+    pthread_mutex_lock(&lock);
+    if (message_count < MAX_MESSAGES) {
+        messages[message_count].data = malloc(len ? len : 1);
+        memcpy(messages[message_count].data, data, len);
+        messages[message_count].len = len;
+        message_count++;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+static void serve(int fd)
+{
+    static uint8_t body[MAX_PACKET];
+    uint8_t type;
+    size_t len;
+    
+    while (running && read_packet(fd, &type, body, sizeof(body), &len)) {
+        switch (type >> 4) {
+            case 1: {   // CONNECT
+                const uint8_t connack[] = { 0x20, 0x02, 0x00, 0x00 };
+                write_exact(fd, connack, sizeof(connack));
+                break;
+            }
+            case 3: {   // PUBLISH
+                int qos = (type >> 1) & 3;
+                if (len < 2) return;
+                size_t pos = 2 + ((size_t)body[0] << 8 | body[1]);
+                uint16_t id = 0;
+                if (qos > 0) {
+                    if (pos + 2 > len) return;
+                    id = (uint16_t)(body[pos] << 8 | body[pos + 1]);
+                    pos += 2;
+                }
+                if (pos > len) return;
+                
+                // Recorded before the PUBACK, so a client that saw the ack sees the record
+                record(body + pos, len - pos);
+                if (qos == 1 && send_acks) {
+                    const uint8_t puback[] = { 0x40, 0x02, (uint8_t)(id >> 8), (uint8_t)id };
+                    write_exact(fd, puback, sizeof(puback));
+                }
+                break;
+            }
+            case 14:    // DISCONNECT
+                return;
+            default:
+                break;
+        }
+    }
+}
+
+static void *broker_thread(void *arg)
+{
+    while (running) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) continue;
+        
+        pthread_mutex_lock(&lock);
+        conn_fd = fd;
+        pthread_mutex_unlock(&lock);
+        
+        serve(fd);
+        
+        pthread_mutex_lock(&lock);
+        conn_fd = -1;
+        pthread_mutex_unlock(&lock);
+        close(fd);
+    }
+    return NULL;
+}
+
+/*===============================================================================
+  Broker API
+  ===============================================================================*/
+
+uint16_t broker_standin_start(void)
+{
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) return 0;
+    
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = 0,
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 1) != 0 ||
+        getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        close(listen_fd);
+        listen_fd = -1;
+        return 0;
+    }
+    
+    running = true;
+    send_acks = true;
+    if (pthread_create(&thread, NULL, broker_thread, NULL) != 0) {
+        running = false;
+        close(listen_fd);
+        listen_fd = -1;
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+void broker_standin_stop(void)
+{
+    if (!running) return;
+    
+    running = false;
+    broker_standin_kick();
+    shutdown(listen_fd, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    close(listen_fd);
+    listen_fd = -1;
+    broker_standin_clear();
+}
+
+void broker_standin_set_ack(bool ack)
+{
+    send_acks = ack;
+}
+
+void broker_standin_kick(void)
+{
+    pthread_mutex_lock(&lock);
+    if (conn_fd >= 0) {
+        shutdown(conn_fd, SHUT_RDWR);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void broker_standin_clear(void)
+{
+    pthread_mutex_lock(&lock);
+    for (int i = 0; i < message_count; i++) {
+        free(messages[i].data);
+    }
+    message_count = 0;
+    pthread_mutex_unlock(&lock);
+}
+
+int broker_standin_count(void)
+{
+    pthread_mutex_lock(&lock);
+    int count = message_count;
+    pthread_mutex_unlock(&lock);
+    return count;
+}
+
+size_t broker_standin_message(int index, void *buf, size_t size)
+{
+    size_t len = 0;
+    pthread_mutex_lock(&lock);
+    if (index >= 0 && index < message_count) {
+        len = messages[index].len;
+        memcpy(buf, messages[index].data, len < size ? len : size);
+    }
+    pthread_mutex_unlock(&lock);
+    return len;
+}
+
+/*===============================================================================
+  Client Side
+  ===============================================================================*/
+
+int standin_client_connect(uint16_t port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+        .sin_port = htons(port),
+    };
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    
+    // Protocol "MQTT" level 4, clean session, keepalive 15 s, client id "t"
+    const uint8_t connect_pkt[] = {
+        0x10, 13, 0x00, 0x04, 'M', 'Q', 'T', 'T', 0x04, 0x02, 0x00, 0x0F,
+        0x00, 0x01, 't',
+    };
+    uint8_t type;
+    uint8_t body[8];
+    size_t len;
+    if (!write_exact(fd, connect_pkt, sizeof(connect_pkt)) ||
+        !read_packet(fd, &type, body, sizeof(body), &len) || type != 0x20 || len != 2 || body[1] != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool standin_client_publish(int fd, uint16_t packet_id, const char *topic,
+                            const void *data, size_t len)
+{
+    size_t topic_len = strlen(topic);
+    size_t remaining = 2 + topic_len + 2 + len;
+    uint8_t header[8];
+    size_t n = 0;
+    
+    header[n++] = 0x32;     // PUBLISH, QoS 1
+    n += put_length(header + n, remaining);
+    
+    uint8_t *packet = malloc(n + remaining);
+    if (!packet) return false;
+    
+    uint8_t *p = packet;
+    memcpy(p, header, n);
+    p += n;
+    *p++ = (uint8_t)(topic_len >> 8);
+    *p++ = (uint8_t)topic_len;
+    memcpy(p, topic, topic_len);
+    p += topic_len;
+    *p++ = (uint8_t)(packet_id >> 8);
+    *p++ = (uint8_t)packet_id;
+    memcpy(p, data, len);
+    
+    bool ok = write_exact(fd, packet, n + remaining);
+    free(packet);
+    return ok;
+}
+
+int standin_client_read_puback(int fd, int timeout_ms)
+{
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready == 0) return 0;
+    if (ready < 0) return -1;
+    
+    uint8_t type;
+    uint8_t body[8];
+    size_t len;
+    if (!read_packet(fd, &type, body, sizeof(body), &len) || type != 0x40 || len != 2) return -1;
+    return body[0] << 8 | body[1];
+}
@@ -0,0 +1,86 @@
+// smart_plug/test/host/support/broker_standin.h
+#ifndef BROKER_STANDIN_H
+#define BROKER_STANDIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*===============================================================================
+  Plain-TCP MQTT Broker Stand-in
+
+  Listens on 127.0.0.1 and speaks just enough MQTT 3.1.1 for the outbox:
+  CONNECT/CONNACK, PUBLISH (QoS 0/1) and PUBACK. One connection at a time;
+  every PUBLISH received is recorded in order, duplicates included.
+  ===============================================================================*/
+
+/**
+ * @brief Start the broker thread on an ephemeral port
+ * 
+ * @return uint16_t Port, 0 on error
+ */
+uint16_t broker_standin_start(void);
+
+/**
+ * @brief Stop the broker thread
+ */
+void broker_standin_stop(void);
+
+/**
+ * @brief Answer PUBLISH with PUBACK (default) or leave them unacknowledged
+ */
+void broker_standin_set_ack(bool ack);
+
+/**
+ * @brief Drop the current connection, as on a TCP hiccup
+ */
+void broker_standin_kick(void);
+
+/**
+ * @brief Forget the recorded messages
+ */
+void broker_standin_clear(void);
+
+/**
+ * @brief Number of PUBLISH packets recorded
+ */
+int broker_standin_count(void);
+
+/**
+ * @brief Copy a recorded payload
+ * 
+ * @param index Arrival order
+ * @param buf Destination
+ * @param size Size of buf
+ * @return size_t Payload length, 0 if there is no such message
+ */
+size_t broker_standin_message(int index, void *buf, size_t size);
+
+/*===============================================================================
+  Client Side
+  ===============================================================================*/
+
+/**
+ * @brief Connect and complete CONNECT/CONNACK
+ * 
+ * @return int Socket, -1 on error
+ */
+int standin_client_connect(uint16_t port);
+
+/**
+ * @brief Send a QoS 1 PUBLISH
+ * 
+ * @return true if written to the socket
+ */
+bool standin_client_publish(int fd, uint16_t packet_id, const char *topic,
+                            const void *data, size_t len);
+
+/**
+ * @brief Wait for the next PUBACK
+ * 
+ * @param timeout_ms How long to wait
+ * @return int Packet id, 0 on timeout, -1 if the connection closed
+ */
+int standin_client_read_puback(int fd, int timeout_ms);
+
+#endif /* BROKER_STANDIN_H */
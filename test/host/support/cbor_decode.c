@@ -0,0 +1,146 @@
+// smart_plug/test/host/support/cbor_decode.c
+#include "cbor_decode.h"
+#include <stdarg.h>
+
+#define MAX_DEPTH       16
+#define BREAK           0xff
+
+/*===============================================================================
+  Internal Helpers
+  ===============================================================================*/
+
+// Returns the byte after the item, or NULL if it is malformed
+static const uint8_t *parse(const uint8_t *p, const uint8_t *end, cbor_item_t *item, int depth)
+{
+    if (p >= end || depth > MAX_DEPTH) return NULL;
+    
+    uint8_t major = *p >> 5;
+    uint8_t info = *p & 0x1f;
+    p++;
+    
+    uint64_t arg = 0;
+    bool indefinite = false;
+    if (info < 24) {
+        arg = info;
+    } else if (info <= 27) {
+        size_t n = (size_t)1 << (info - 24);
+        if ((size_t)(end - p) < n) return NULL;
+        for (size_t i = 0; i < n; i++) {
+            arg = arg << 8 | *p++;
+        }
+    } else if (info == 31 && (major == 4 || major == 5)) {
+        indefinite = true;
+    } else {
+        return NULL;
+    }
+    
+    item->value = 0;
+    item->data = NULL;
+    item->len = 0;
+    item->count = 0;
+    
+    switch (major) {
+        case 0:
+        case 1:
+            if (arg > INT64_MAX) return NULL;
+            item->type = CBOR_ITEM_INT;
+            item->value = major == 0 ? (int64_t)arg : -1 - (int64_t)arg;
+            return p;
+        
+        case 2:
+        case 3:
+            if (arg > (uint64_t)(end - p)) return NULL;
+            item->type = major == 2 ? CBOR_ITEM_BYTES : CBOR_ITEM_TEXT;
+            item->data = p;
+            item->len = (size_t)arg;
+            return p + arg;
+        
+        case 4:
+        case 5: {
+            item->type = major == 4 ? CBOR_ITEM_ARRAY : CBOR_ITEM_MAP;
+            item->data = p;
+            int per_member = major == 5 ? 2 : 1;
+            cbor_item_t member;
+            int32_t count = 0;
+            
+            while (indefinite || (uint64_t)count < arg) {
+                if (indefinite && p < end && *p == BREAK) {
+                    p++;
+                    break;
+                }
+                for (int i = 0; i < per_member; i++) {
+                    p = parse(p, end, &member, depth + 1);
+                    if (!p) return NULL;
+                }
+                count++;
+            }
+            
+            item->len = (size_t)(p - item->data);
+            item->count = indefinite ? -1 : count;
+            return p;
+        }
+        
+        case 7:
+            if (info == 20 || info == 21) {
+                item->type = CBOR_ITEM_BOOL;
+                item->value = info == 21;
+                return p;
+            }
+            if (info == 22) {
+                item->type = CBOR_ITEM_NULL;
+                return p;
+            }
+            return NULL;
+        
+        default:
+            return NULL;
+    }
+}
+
+/*===============================================================================
+  Public API
+  ===============================================================================*/
+
+bool cbor_decode(const uint8_t *buf, size_t len, cbor_item_t *item)
+{
+    const uint8_t *end = buf + len;
+    return parse(buf, end, item, 0) == end;
+}
+
+bool cbor_map_get(const cbor_item_t *map, int64_t key, cbor_item_t *value)
+{
+    if (map->type != CBOR_ITEM_MAP) return false;
+    
+    // The map was validated when it was decoded
+    const uint8_t *p = map->data;
+    const uint8_t *end = map->data + map->len;
+    for (int32_t i = 0; map->count < 0 || i < map->count; i++) {
+        if (p >= end || *p == BREAK) break;
+        
+        cbor_item_t k;
+        p = parse(p, end, &k, 0);
+        if (!p) return false;
+        p = parse(p, end, value, 0);
+        if (!p) return false;
+        if (k.type == CBOR_ITEM_INT && k.value == key) return true;
+    }
+    return false;
+}
+
+bool cbor_path(const cbor_item_t *root, cbor_item_t *out, int depth, ...)
+{
+    va_list keys;
+    va_start(keys, depth);
+    
+    cbor_item_t item = *root;
+    cbor_item_t next;
+    bool found = true;
+    for (int i = 0; i < depth && found; i++) {
+        found = cbor_map_get(&item, va_arg(keys, int), &next);
+        item = next;
+    }
+    va_end(keys);
+    
+    if (found) *out = item;
+    return found;
+}
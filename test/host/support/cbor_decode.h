@@ -0,0 +1,69 @@
+// smart_plug/test/host/support/cbor_decode.h
+#ifndef CBOR_DECODE_H
+#define CBOR_DECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*===============================================================================
+  Minimal CBOR Reader
+
+  Enough of RFC 8949 to check what cbor_writer emits: integers, byte and
+  text strings, definite or indefinite maps and arrays, booleans and null.
+  Floats, tags and indefinite strings are rejected.
+  ===============================================================================*/
+
+typedef enum {
+    CBOR_ITEM_INT,
+    CBOR_ITEM_BYTES,
+    CBOR_ITEM_TEXT,
+    CBOR_ITEM_ARRAY,
+    CBOR_ITEM_MAP,
+    CBOR_ITEM_BOOL,
+    CBOR_ITEM_NULL,
+} cbor_item_type_t;
+
+/**
+ * @brief One decoded item
+ * 
+ * For strings data/len is the content. For maps and arrays data points at
+ * the first member and len runs to the end of the container; count is the
+ * number of members (pairs for maps), or -1 if the length was indefinite.
+ */
+typedef struct {
+    cbor_item_type_t type;
+    int64_t value;                  // Integer, or 0/1 for a boolean
+    const uint8_t *data;
+    size_t len;
+    int32_t count;
+} cbor_item_t;
+
+/**
+ * @brief Decode a whole document
+ * 
+ * @param buf Encoded document
+ * @param len Length; trailing bytes fail the decode
+ * @param item Receives the top-level item
+ * @return true if the document is well formed
+ */
+bool cbor_decode(const uint8_t *buf, size_t len, cbor_item_t *item);
+
+/**
+ * @brief Find the value of an integer key in a map
+ * 
+ * @return true if map is a map holding key
+ */
+bool cbor_map_get(const cbor_item_t *map, int64_t key, cbor_item_t *value);
+
+/**
+ * @brief Follow integer keys through nested maps
+ * 
+ * @param root Top-level map
+ * @param out Receives the item at the end of the path
+ * @param depth Number of keys that follow
+ * @return true if every key was found
+ */
+bool cbor_path(const cbor_item_t *root, cbor_item_t *out, int depth, ...);
+
+#endif /* CBOR_DECODE_H */
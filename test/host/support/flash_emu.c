@@ -0,0 +1,140 @@
+// smart_plug/test/host/support/flash_emu.c
+#include "flash_emu.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+#define FLASH_EMU_SECTOR        4096
+#define FLASH_EMU_MAX_PARTS     4
+
+typedef struct {
+    esp_partition_t part;
+    uint8_t *data;
+    flash_emu_stats_t stats;
+} emu_part_t;
+
+static emu_part_t parts[FLASH_EMU_MAX_PARTS];
+
+static emu_part_t *find(const char *label)
+{
+    for (int i = 0; i < FLASH_EMU_MAX_PARTS; i++) {
+        if (parts[i].data && strcmp(parts[i].part.label, label) == 0) return &parts[i];
+    }
+    return NULL;
+}
+
+static emu_part_t *owner(const esp_partition_t *partition)
+{
+    for (int i = 0; i < FLASH_EMU_MAX_PARTS; i++) {
+        if (parts[i].data && &parts[i].part == partition) return &parts[i];
+    }
+    return NULL;
+}
+
+void flash_emu_create(const char *label, uint32_t size)
+{
+    assert(size % FLASH_EMU_SECTOR == 0);
+    
+    emu_part_t *p = find(label);
+    if (!p) {
+        for (int i = 0; i < FLASH_EMU_MAX_PARTS && !p; i++) {
+            if (!parts[i].data) p = &parts[i];
+        }
+        assert(p);
+    }
+    free(p->data);
+    memset(p, 0, sizeof(*p));
+    
+    p->data = malloc(size);
+    assert(p->data);
+    memset(p->data, 0xFF, size);
+    p->part.type = ESP_PARTITION_TYPE_DATA;
+    p->part.subtype = ESP_PARTITION_SUBTYPE_DATA_SPIFFS;
+    p->part.size = size;
+    p->part.erase_size = FLASH_EMU_SECTOR;
+    strncpy(p->part.label, label, sizeof(p->part.label) - 1);
+}
+
+void flash_emu_reset(void)
+{
+    for (int i = 0; i < FLASH_EMU_MAX_PARTS; i++) {
+        free(parts[i].data);
+    }
+    memset(parts, 0, sizeof(parts));
+}
+
+uint8_t *flash_emu_data(const char *label)
+{
+    emu_part_t *p = find(label);
+    return p ? p->data : NULL;
+}
+
+flash_emu_stats_t flash_emu_get_stats(const char *label)
+{
+    emu_part_t *p = find(label);
+    flash_emu_stats_t none = {0};
+    return p ? p->stats : none;
+}
+
+/*===============================================================================
+  esp_partition API
+  ===============================================================================*/
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    emu_part_t *p = label ? find(label) : NULL;
+    return p ? &p->part : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset,
+                             void *dst, size_t size)
+{
+    emu_part_t *p = owner(partition);
+    if (!p || src_offset + size > p->part.size) return ESP_ERR_INVALID_SIZE;
+    
+    memcpy(dst, p->data + src_offset, size);
+    p->stats.bytes_read += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset,
+                              const void *src, size_t size)
+{
+    emu_part_t *p = owner(partition);
+    if (!p || dst_offset + size > p->part.size) return ESP_ERR_INVALID_SIZE;
+    
+    const uint8_t *s = src;
+    for (size_t i = 0; i < size; i++) {
+        p->data[dst_offset + i] &= s[i];
+    }
+    p->stats.bytes_written += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset,
+                                    size_t size)
+{
+    emu_part_t *p = owner(partition);
+    if (!p || offset + size > p->part.size) return ESP_ERR_INVALID_SIZE;
+    if (offset % FLASH_EMU_SECTOR || size % FLASH_EMU_SECTOR) return ESP_ERR_INVALID_ARG;
+    
+    memset(p->data + offset, 0xFF, size);
+    p->stats.sectors_erased += size / FLASH_EMU_SECTOR;
+    return ESP_OK;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,43 @@
+// smart_plug/test/host/support/flash_emu.h
+#ifndef FLASH_EMU_H
+#define FLASH_EMU_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Operation counters, for write amplification figures
+ */
+typedef struct {
+    uint64_t bytes_read;
+    uint64_t bytes_written;
+    uint32_t sectors_erased;
+} flash_emu_stats_t;
+
+/**
+ * @brief Create (or recreate, erased) the partition with this label
+ * 
+ * Several partitions may exist at once. Writes can only clear bits and
+ * erases must be sector aligned, as on NOR flash.
+ * 
+ * @param label Partition label
+ * @param size Size in bytes (a multiple of 4096)
+ */
+void flash_emu_create(const char *label, uint32_t size);
+
+/**
+ * @brief Drop all partitions
+ */
+void flash_emu_reset(void);
+
+/**
+ * @brief Raw contents of a partition (for corrupting it in tests)
+ */
+uint8_t *flash_emu_data(const char *label);
+
+/**
+ * @brief Counters of a partition since it was created
+ */
+flash_emu_stats_t flash_emu_get_stats(const char *label);
+
+#endif /* FLASH_EMU_H */
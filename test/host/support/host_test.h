@@ -0,0 +1,46 @@
+// smart_plug/test/host/support/host_test.h
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/*===============================================================================
+  Minimal Test Macros
+
+  Each test is a void function run by RUN_TEST(); a failed CHECK() prints
+  its location and fails the test executable.
+  ===============================================================================*/
+
+extern int host_test_failures;
+
+#define CHECK(cond)                                                             \
+    do {                                                                        \
+        if (!(cond)) {                                                          \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++;                                               \
+            return;                                                             \
+        }                                                                       \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                          \
+    do {                                                                        \
+        long long _a = (long long)(a), _b = (long long)(b);                     \
+        if (_a != _b) {                                                         \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",   \
+                    __FILE__, __LINE__, #a, #b, _a, _b);                        \
+            host_test_failures++;                                               \
+            return;                                                             \
+        }                                                                       \
+    } while (0)
+
+#define RUN_TEST(fn)                                                            \
+    do {                                                                        \
+        int _before = host_test_failures;                                       \
+        fn();                                                                   \
+        printf("%s %s\n", host_test_failures == _before ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+#define HOST_TEST_RESULT() (host_test_failures ? EXIT_FAILURE : EXIT_SUCCESS)
+
+#endif /* HOST_TEST_H */
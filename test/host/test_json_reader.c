@@ -0,0 +1,267 @@
+// smart_plug/test/host/test_json_reader.c
+//
+// json_reader against a corpus of valid and malformed documents (the edge
+// cases a strict parser must get right), every prefix of the shadow and
+// control payloads, and a fixed-seed mutation run that checks the token
+// invariants on whatever the mutations produce. Inputs are exact-size heap
+// copies, so a sanitizer build catches any overread.
+#include <stdint.h>
+#include <string.h>
+#include "host_test.h"
+#include "json_reader.h"
+
+#define MAX_TOKS        128         // Token array size in mqtt_manager
+#define MUTATIONS       50000
+
+typedef struct {
+    const char *doc;
+    int expect;                     // Token count, or a JSON_ERR_* code
+} corpus_case_t;
+
+static const corpus_case_t corpus[] = {
+    // Valid
+    { "{}", 1 },
+    { "[]", 1 },
+    { "0", 1 },
+    { "-0.5e+3", 1 },
+    { "\"\"", 1 },
+    { " \t\r\n{ \"a\" : [ 1 , true , null , \"x\" ] } \n", 7 },
+    { "{\"a\":{\"b\":{\"c\":{}}}}", 7 },
+    { "{\"s\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\\u00e9\"}", 3 },
+    { "[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]", 16 },
+    { "{\"state\":{\"relay_status\":\"true\"}}", 5 },
+    { "{\"relay_state\":false,\"reset_energy\":true}", 5 },
+    
+    // Malformed
+    { "", JSON_ERR_PART },
+    { "   ", JSON_ERR_PART },
+    { "{", JSON_ERR_PART },
+    { "{\"a\"", JSON_ERR_PART },
+    { "{\"a\":", JSON_ERR_PART },
+    { "{\"a\":1", JSON_ERR_PART },
+    { "\"abc", JSON_ERR_PART },
+    { "\"\\", JSON_ERR_PART },
+    { "\"\\u12", JSON_ERR_PART },
+    { "tru", JSON_ERR_PART },
+    { "1.", JSON_ERR_PART },       // More digits may follow
+    { "}", JSON_ERR_INVAL },
+    { "{]", JSON_ERR_INVAL },
+    { "[}", JSON_ERR_INVAL },
+    { "{1:2}", JSON_ERR_INVAL },
+    { "{\"a\" 1}", JSON_ERR_INVAL },
+    { "{\"a\":1,}", JSON_ERR_INVAL },
+    { "[1,]", JSON_ERR_INVAL },
+    { "[,1]", JSON_ERR_INVAL },
+    { "{\"a\"::1}", JSON_ERR_INVAL },
+    { "{\"a\":1 \"b\":2}", JSON_ERR_INVAL },
+    { "[1 2]", JSON_ERR_INVAL },
+    { "{} {}", JSON_ERR_INVAL },
+    { "[01]", JSON_ERR_INVAL },
+    { "[1.]", JSON_ERR_INVAL },
+    { "[.5]", JSON_ERR_INVAL },
+    { "[1e]", JSON_ERR_INVAL },
+    { "[+1]", JSON_ERR_INVAL },
+    { "[--1]", JSON_ERR_INVAL },
+    { "[True]", JSON_ERR_INVAL },
+    { "[nul]", JSON_ERR_INVAL },
+    { "\"\\x\"", JSON_ERR_INVAL },
+    { "\"\\u12g4\"", JSON_ERR_INVAL },
+    { "\"a\nb\"", JSON_ERR_INVAL },
+    { "{\"a\":1}}", JSON_ERR_INVAL },
+    { "[\"a\":1]", JSON_ERR_INVAL },
+};
+
+// Payloads the device actually receives
+static const char *seeds[] = {
+    "{\"version\":42,\"timestamp\":1760000000,\"state\":{\"relay_status\":\"true\","
+    "\"reset_energy\":false},\"metadata\":{\"relay_status\":{\"timestamp\":1760000000},"
+    "\"reset_energy\":{\"timestamp\":1760000000}}}",
+    "{\"relay_state\":true}",
+    "{\"reset_energy\":true,\"interval_ms\":{\"telemetry\":5000},\"format\":{\"enf\":\"cbor\"}}",
+    "{\"state\":{\"reported\":{\"relay_status\":\"false\",\"ip\":\"10.0.0.2\"}},"
+    "\"clientToken\":\"sp-17\",\"version\":7}",
+};
+
+#define SEED_COUNT      (sizeof(seeds) / sizeof(seeds[0]))
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Parse from an exact-size heap copy so a sanitizer sees any overread
+static int parse_exact(const char *doc, size_t len, json_tok_t *toks, int max)
+{
+    char *copy = malloc(len ? len : 1);
+    memcpy(copy, doc, len);
+    int n = json_reader_parse(copy, len, toks, max);
+    free(copy);
+    return n;
+}
+
+// Structure every successful parse must have
+static bool tokens_consistent(const json_tok_t *toks, int count, size_t len)
+{
+    for (int i = 0; i < count; i++) {
+        const json_tok_t *t = &toks[i];
+        if (t->start > t->end || t->end > len) return false;
+        if (t->parent >= i || (i > 0 && t->parent < 0)) return false;
+        if (t->parent >= 0) {
+            // Values follow their key; everything else lies inside its container
+            const json_tok_t *p = &toks[t->parent];
+            if (p->type == JSON_TOK_STRING) {
+                if (p->size != 1 || t->start <= p->end) return false;
+            } else if (t->start < p->start || t->end > p->end) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void mutate(char *buf, size_t *len, size_t size)
+{
+    static const char alphabet[] = "{}[]:,\"\\ 0123456789-+.eEtrufalsn";
+    size_t pos = *len ? rng() % *len : 0;
+    
+    switch (rng() % 4) {
+        case 0:     // Replace a byte
+            if (*len) buf[pos] = alphabet[rng() % (sizeof(alphabet) - 1)];
+            break;
+        case 1:     // Insert a byte
+            if (*len + 1 < size) {
+                memmove(buf + pos + 1, buf + pos, *len - pos);
+                buf[pos] = alphabet[rng() % (sizeof(alphabet) - 1)];
+                (*len)++;
+            }
+            break;
+        case 2:     // Delete a byte
+            if (*len) {
+                memmove(buf + pos, buf + pos + 1, *len - pos - 1);
+                (*len)--;
+            }
+            break;
+        default:    // Any byte at all
+            if (*len) buf[pos] = (char)rng();
+            break;
+    }
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_corpus(void)
+{
+    json_tok_t toks[MAX_TOKS];
+    for (size_t i = 0; i < sizeof(corpus) / sizeof(corpus[0]); i++) {
+        const char *doc = corpus[i].doc;
+        int n = parse_exact(doc, strlen(doc), toks, MAX_TOKS);
+        if (n != corpus[i].expect) {
+            fprintf(stderr, "corpus case %zu: '%s'\n", i, doc);
+        }
+        CHECK_EQ(n, corpus[i].expect);
+        if (n > 0) CHECK(tokens_consistent(toks, n, strlen(doc)));
+    }
+}
+
+static void test_prefixes_are_partial(void)
+{
+    json_tok_t toks[MAX_TOKS];
+    for (size_t s = 0; s < SEED_COUNT; s++) {
+        size_t len = strlen(seeds[s]);
+        CHECK(parse_exact(seeds[s], len, toks, MAX_TOKS) > 0);
+        
+        // An object cut short anywhere is never accepted
+        for (size_t cut = 0; cut < len; cut++) {
+            int n = parse_exact(seeds[s], cut, toks, MAX_TOKS);
+            CHECK(n == JSON_ERR_PART || n == JSON_ERR_INVAL);
+        }
+    }
+}
+
+static void test_token_limit(void)
+{
+    json_tok_t toks[MAX_TOKS];
+    const char *doc = seeds[0];
+    int n = parse_exact(doc, strlen(doc), toks, MAX_TOKS);
+    CHECK(n > 2);
+    
+    // One token short fails cleanly, without writing past the array
+    json_tok_t *small = malloc(sizeof(json_tok_t) * (n - 1));
+    CHECK_EQ(json_reader_parse(doc, strlen(doc), small, n - 1), JSON_ERR_NOMEM);
+    free(small);
+    CHECK_EQ(json_reader_parse(doc, strlen(doc), toks, n), n);
+    
+    // Lookups on the real payloads
+    bool relay = false;
+    int64_t version = 0;
+    int tok = json_reader_find(doc, toks, n, 0, "state.relay_status");
+    CHECK(tok >= 0 && json_reader_get_bool(doc, &toks[tok], &relay));
+    CHECK(relay);
+    tok = json_reader_find(doc, toks, n, 0, "version");
+    CHECK(tok >= 0 && json_reader_get_int(doc, &toks[tok], &version));
+    CHECK_EQ(version, 42);
+    CHECK_EQ(json_reader_find(doc, toks, n, 0, "state.missing"), -1);
+    CHECK_EQ(json_reader_find(doc, toks, n, 0, "version.inner"), -1);
+}
+
+static void test_mutations(void)
+{
+    json_tok_t toks[MAX_TOKS];
+    char buf[512];
+    char str[64];
+    int accepted = 0;
+    
+    for (int i = 0; i < MUTATIONS; i++) {
+        const char *seed = seeds[i % SEED_COUNT];
+        size_t len = strlen(seed);
+        memcpy(buf, seed, len);
+        
+        int rounds = 1 + rng() % 4;
+        for (int r = 0; r < rounds; r++) {
+            mutate(buf, &len, sizeof(buf));
+        }
+        
+        int n = parse_exact(buf, len, toks, MAX_TOKS);
+        CHECK(n > 0 || n == JSON_ERR_NOMEM || n == JSON_ERR_INVAL || n == JSON_ERR_PART);
+        if (n <= 0) continue;
+        
+        accepted++;
+        CHECK(tokens_consistent(toks, n, len));
+        
+        // Lookups and accessors only read inside the tokens
+        bool b;
+        int64_t v;
+        const char *paths[] = { "state.relay_status", "relay_state", "reset_energy", "version" };
+        for (size_t p = 0; p < sizeof(paths) / sizeof(paths[0]); p++) {
+            int tok = json_reader_find(buf, toks, n, 0, paths[p]);
+            CHECK(tok >= -1 && tok < n);
+            if (tok < 0) continue;
+            json_reader_get_bool(buf, &toks[tok], &b);
+            json_reader_get_int(buf, &toks[tok], &v);
+            json_reader_get_string(buf, &toks[tok], str, sizeof(str));
+        }
+    }
+    
+    // The run must exercise the accepting paths, not only the error returns
+    CHECK(accepted > MUTATIONS / 20);
+}
+
+int main(void)
+{
+    RUN_TEST(test_corpus);
+    RUN_TEST(test_prefixes_are_partial);
+    RUN_TEST(test_token_limit);
+    RUN_TEST(test_mutations);
+    return HOST_TEST_RESULT();
+}
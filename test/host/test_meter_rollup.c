@@ -0,0 +1,55 @@
+// smart_plug/test/host/test_meter_rollup.c
+//
+// meter_rollup: minima, maxima and means carried through the cascade from
+// 1 s buckets up to the hourly level.
+#include "host_test.h"
+#include "meter_rollup.h"
+
+#define US              1000000LL
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_extremes_cascade(void)
+{
+    meter_rollup_init();
+    
+    // Two hours at 1 s, and long enough after for the second to close; one
+    // brief dip and one brief spike in the first hour
+    for (int64_t t = 0; t <= 2 * 3600 + 1000; t++) {
+        float current = 2.0f;
+        if (t == 1234) current = 0.5f;
+        if (t == 2345) current = 7.5f;
+        meter_rollup_add(t * US, 230.0f, current, current * 230.0f, t * 1000);
+    }
+    
+    rollup_bucket_t bucket;
+    CHECK(meter_rollup_latest(ROLLUP_LEVEL_1S, &bucket));
+    CHECK_EQ(bucket.current_min, bucket.current_max);
+    
+    // The first hour saw both; the second neither
+    rollup_bucket_t hours[2];
+    CHECK_EQ(meter_rollup_read(ROLLUP_LEVEL_1H, 0, hours, 2), 2);
+    CHECK(hours[0].current_min == 0.5f);
+    CHECK(hours[0].current_max == 7.5f);
+    CHECK(hours[0].power_min == 0.5f * 230.0f);
+    CHECK(hours[1].current_min == 2.0f);
+    CHECK(hours[1].current_max == 2.0f);
+    CHECK_EQ(hours[0].samples, 3600);
+    
+    // The quarter hours holding the dip and the spike
+    rollup_bucket_t quarters[16];
+    CHECK(meter_rollup_read(ROLLUP_LEVEL_15M, 0, quarters, 16) >= 8);
+    CHECK_EQ(quarters[1].start_s, 900);
+    CHECK(quarters[1].current_min == 0.5f && quarters[1].current_max == 2.0f);
+    CHECK(quarters[2].current_min == 2.0f && quarters[2].current_max == 7.5f);
+    
+    CHECK_EQ(meter_rollup_count(ROLLUP_LEVEL_1M), meter_rollup_capacity(ROLLUP_LEVEL_1M));
+}
+
+int main(void)
+{
+    RUN_TEST(test_extremes_cascade);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,408 @@
+// smart_plug/test/host/test_mqtt_outbox.c
+//
+// mqtt_outbox and outbox_spill against the plain-TCP broker stand-in, with
+// the spill ring on emulated flash.
+#include <string.h>
+#include <unistd.h>
+#include "host_test.h"
+#include "flash_emu.h"
+#include "broker_standin.h"
+#include "mqtt_outbox.h"
+#include "outbox_spill.h"
+
+#define INFLIGHT        4           // CONFIG_MQTT_OUTBOX_INFLIGHT default
+#define MS              1000LL
+#define MAX_INDEX       256
+
+static uint16_t port;
+static int link_fd = -1;
+static uint16_t next_packet_id = 1;
+
+static const mqtt_outbox_spill_t spill_ops = {
+    .push = outbox_spill_push,
+    .peek = outbox_spill_peek,
+    .pop = outbox_spill_pop,
+    .peeked = outbox_spill_peeked,
+};
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+// Payloads carry their index and a pattern derived from it, so a message
+// moved or overwritten in the arena is caught
+static void make_payload(uint8_t *buf, int index, size_t len)
+{
+    buf[0] = (uint8_t)(index >> 8);
+    buf[1] = (uint8_t)index;
+    for (size_t i = 2; i < len; i++) {
+        buf[i] = (uint8_t)(index * 31 + i);
+    }
+}
+
+static int payload_index(const uint8_t *buf, size_t len)
+{
+    if (len < 2) return -1;
+    int index = buf[0] << 8 | buf[1];
+    for (size_t i = 2; i < len; i++) {
+        if (buf[i] != (uint8_t)(index * 31 + i)) return -1;
+    }
+    return index;
+}
+
+static bool enqueue(int index, size_t len, mqtt_priority_t priority)
+{
+    uint8_t buf[4096];
+    make_payload(buf, index, len);
+    return mqtt_outbox_enqueue(0, buf, len, priority);
+}
+
+static int send_cb(uint8_t topic, const void *data, size_t len)
+{
+    if (link_fd < 0) return -1;
+    
+    int id = next_packet_id++;
+    if (next_packet_id == 0) next_packet_id = 1;
+    return standin_client_publish(link_fd, (uint16_t)id, "t/0", data, len) ? id : -1;
+}
+
+static void link_up(void)
+{
+    link_fd = standin_client_connect(port);
+}
+
+static void link_down(void)
+{
+    broker_standin_kick();
+    if (link_fd >= 0) close(link_fd);
+    link_fd = -1;
+}
+
+static uint16_t inflight(void)
+{
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    return stats.inflight;
+}
+
+// Read PUBACKs for everything in flight, stamping them rtt_ms after now
+static void collect_acks(int64_t now_us, uint32_t rtt_ms)
+{
+    while (link_fd >= 0 && inflight() > 0) {
+        int id = standin_client_read_puback(link_fd, 500);
+        if (id <= 0) break;
+        mqtt_outbox_acked(id, now_us + rtt_ms * MS);
+    }
+}
+
+// Pump and acknowledge until nothing is left to send
+static void run_until_idle(int64_t *now_us)
+{
+    for (int round = 0; round < 1000; round++) {
+        int before = broker_standin_count();
+        mqtt_outbox_pump(link_fd >= 0, *now_us);
+        collect_acks(*now_us, 20);
+        *now_us += 100 * MS;
+        if (broker_standin_count() == before && inflight() == 0) break;
+    }
+}
+
+// The broker records asynchronously; wait before cutting the link
+static void wait_for_broker(int count)
+{
+    for (int i = 0; i < 200 && broker_standin_count() < count; i++) {
+        usleep(5000);
+    }
+}
+
+// Indices the broker received, counted (duplicates from resends included)
+static int received(int counts[MAX_INDEX])
+{
+    uint8_t buf[4096];
+    memset(counts, 0, sizeof(int) * MAX_INDEX);
+    
+    int total = broker_standin_count();
+    for (int i = 0; i < total; i++) {
+        size_t len = broker_standin_message(i, buf, sizeof(buf));
+        int index = payload_index(buf, len);
+        if (index < 0 || index >= MAX_INDEX) return -1;
+        counts[index]++;
+    }
+    return total;
+}
+
+// Messages reported to the ack handler, in order
+static int acked_index[MAX_INDEX];
+static int acked_count = 0;
+
+static void ack_cb(uint8_t topic, const void *data, size_t len)
+{
+    if (acked_count < MAX_INDEX) {
+        acked_index[acked_count++] = topic == 0 ? payload_index(data, len) : -1;
+    }
+}
+
+static void setup(uint32_t spill_sectors)
+{
+    link_down();
+    broker_standin_clear();
+    broker_standin_set_ack(true);
+    next_packet_id = 1;
+    
+    flash_emu_create("outbox", spill_sectors * 4096);
+    outbox_spill_init();
+    mqtt_outbox_init(send_cb);
+    mqtt_outbox_set_spill(&spill_ops);
+    mqtt_outbox_set_ack_handler(NULL);
+    acked_count = 0;
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_window_and_rtt(void)
+{
+    setup(4);
+    link_up();
+    CHECK(link_fd >= 0);
+    
+    for (int i = 0; i < 12; i++) {
+        CHECK(enqueue(i, 200, MQTT_PRIORITY_BULK));
+    }
+    
+    int64_t now = 0;
+    mqtt_outbox_pump(true, now);
+    CHECK_EQ(inflight(), INFLIGHT);
+    collect_acks(now, 75);
+    CHECK_EQ(inflight(), 0);
+    run_until_idle(&now);
+    
+    int counts[MAX_INDEX];
+    CHECK_EQ(received(counts), 12);
+    for (int i = 0; i < 12; i++) {
+        uint8_t buf[256];
+        CHECK_EQ(payload_index(buf, broker_standin_message(i, buf, sizeof(buf))), i);
+    }
+    
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    CHECK_EQ(stats.acked, 12);
+    CHECK_EQ(stats.inflight_max, INFLIGHT);
+    CHECK_EQ(stats.rtt_hist[1], 4);     // le_100ms: the first window
+    CHECK_EQ(stats.rtt_hist[0], 8);     // le_50ms
+    CHECK_EQ(stats.rtt_max_ms, 75);
+}
+
+static void test_alarm_first(void)
+{
+    setup(4);
+    for (int i = 0; i < 6; i++) {
+        CHECK(enqueue(i, 300, MQTT_PRIORITY_BULK));
+    }
+    CHECK(enqueue(100, 50, MQTT_PRIORITY_ALARM));
+    
+    link_up();
+    int64_t now = 0;
+    run_until_idle(&now);
+    
+    uint8_t buf[512];
+    CHECK_EQ(payload_index(buf, broker_standin_message(0, buf, sizeof(buf))), 100);
+    CHECK_EQ(broker_standin_count(), 7);
+}
+
+static void test_spill_survives_reboot(void)
+{
+    setup(16);
+    
+    // 30 KB offline: the RAM arena keeps the newest, the oldest go to flash
+    for (int i = 0; i < 30; i++) {
+        CHECK(enqueue(i, 1000, MQTT_PRIORITY_BULK));
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    CHECK_EQ(stats.spilled, 14);
+    CHECK(stats.ram_bytes <= 16384);
+    
+    // Reboot: RAM is lost, flash is mounted again
+    mqtt_outbox_init(send_cb);
+    CHECK(outbox_spill_init());
+    CHECK_EQ(outbox_spill_pending(), 14);
+    
+    link_up();
+    int64_t now = 0;
+    run_until_idle(&now);
+    
+    int counts[MAX_INDEX];
+    CHECK_EQ(received(counts), 14);
+    for (int i = 0; i < 14; i++) {
+        uint8_t buf[1024];
+        CHECK_EQ(payload_index(buf, broker_standin_message(i, buf, sizeof(buf))), i);
+    }
+    CHECK_EQ(outbox_spill_pending(), 0);
+}
+
+static void test_resend_after_lost_acks(void)
+{
+    setup(4);
+    link_up();
+    broker_standin_set_ack(false);
+    
+    for (int i = 0; i < 4; i++) {
+        CHECK(enqueue(i, 100, MQTT_PRIORITY_BULK));
+    }
+    int64_t now = 0;
+    mqtt_outbox_pump(true, now);
+    CHECK_EQ(inflight(), 4);
+    
+    // The connection drops with the acks outstanding
+    wait_for_broker(4);
+    link_down();
+    broker_standin_set_ack(true);
+    link_up();
+    
+    now += 31000 * MS;
+    run_until_idle(&now);
+    
+    int counts[MAX_INDEX];
+    CHECK_EQ(received(counts), 8);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(counts[i], 2);
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    CHECK_EQ(stats.retried, 4);
+    CHECK_EQ(stats.acked, 4);
+}
+
+static void test_arena_compaction(void)
+{
+    setup(32);
+    
+    // Mixed sizes and priorities make holes all over the arena as the oldest
+    // bulk messages are spilled
+    int total = 0;
+    for (int i = 0; i < 60; i++) {
+        size_t len = 300 + (i * 977) % 2700;
+        CHECK(enqueue(i, len, i % 7 == 0 ? MQTT_PRIORITY_ALARM : MQTT_PRIORITY_BULK));
+        total++;
+    }
+    
+    link_up();
+    int64_t now = 0;
+    run_until_idle(&now);
+    
+    // Every payload arrived intact, exactly once
+    int counts[MAX_INDEX];
+    CHECK_EQ(received(counts), total);
+    for (int i = 0; i < total; i++) {
+        CHECK_EQ(counts[i], 1);
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.ram_bytes, 0);
+}
+
+static void test_ring_overwrite_of_restored_message(void)
+{
+    // Two sectors of four 1000-byte records
+    setup(2);
+    
+    // #0 and #1 spill; #2..#17 fill the arena
+    int next = 0;
+    for (; next < 18; next++) {
+        CHECK(enqueue(next, 1000, MQTT_PRIORITY_BULK));
+    }
+    
+    // One acknowledged window makes room, then #0 is restored and stays in flight
+    link_up();
+    int64_t now = 0;
+    mqtt_outbox_pump(true, now);
+    collect_acks(now, 20);
+    broker_standin_set_ack(false);
+    mqtt_outbox_pump(true, now);
+    CHECK_EQ(inflight(), 4);
+    wait_for_broker(8);
+    link_down();
+    
+    // Offline again: the spills wrap the ring and overwrite the sector holding #0
+    for (; next < 28; next++) {
+        CHECK(enqueue(next, 1000, MQTT_PRIORITY_BULK));
+    }
+    outbox_spill_stats_t spill_stats;
+    outbox_spill_get_stats(&spill_stats);
+    CHECK_EQ(spill_stats.records_dropped, 4);
+    
+    // #0's PUBACK must not release another record
+    broker_standin_set_ack(true);
+    broker_standin_clear();
+    link_up();
+    now += 31000 * MS;
+    run_until_idle(&now);
+    
+    int counts[MAX_INDEX];
+    CHECK(received(counts) > 0);
+    for (int i = 0; i < next; i++) {
+        bool lost = (i == 1 || i == 9 || i == 10);     // Overwritten on flash
+        bool sent_before = (i >= 2 && i <= 5);          // Acknowledged in the first window
+        CHECK_EQ(counts[i], (lost || sent_before) ? 0 : 1);
+    }
+    CHECK_EQ(outbox_spill_pending(), 0);
+}
+
+static void test_ack_handler(void)
+{
+    setup(4);
+    mqtt_outbox_set_ack_handler(ack_cb);
+    link_up();
+    broker_standin_set_ack(false);
+    
+    for (int i = 0; i < 6; i++) {
+        CHECK(enqueue(i, 150 + i, MQTT_PRIORITY_BULK));
+    }
+    
+    // Nothing is reported for a message that was only sent
+    int64_t now = 0;
+    mqtt_outbox_pump(true, now);
+    wait_for_broker(4);
+    CHECK_EQ(acked_count, 0);
+    
+    // Every payload is reported once its PUBACK arrives, resends included
+    link_down();
+    broker_standin_set_ack(true);
+    link_up();
+    now += 31000 * MS;
+    run_until_idle(&now);
+    
+    CHECK_EQ(acked_count, 6);
+    int seen[6] = {0};
+    for (int i = 0; i < acked_count; i++) {
+        CHECK(acked_index[i] >= 0 && acked_index[i] < 6);
+        if (acked_index[i] >= 0 && acked_index[i] < 6) seen[acked_index[i]]++;
+    }
+    for (int i = 0; i < 6; i++) {
+        CHECK_EQ(seen[i], 1);
+    }
+}
+
+int main(void)
+{
+    port = broker_standin_start();
+    if (!port) {
+        fprintf(stderr, "broker stand-in failed to start\n");
+        return EXIT_FAILURE;
+    }
+    
+    RUN_TEST(test_window_and_rtt);
+    RUN_TEST(test_alarm_first);
+    RUN_TEST(test_spill_survives_reboot);
+    RUN_TEST(test_resend_after_lost_acks);
+    RUN_TEST(test_arena_compaction);
+    RUN_TEST(test_ring_overwrite_of_restored_message);
+    RUN_TEST(test_ack_handler);
+    
+    link_down();
+    broker_standin_stop();
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,282 @@
+// smart_plug/test/host/test_mqtt_reconnect.c
+//
+// mqtt_reconnect: the first connect, backoff growth and its cap, attempt
+// timeouts, stale timers, flapping connections, network loss, an attempt
+// with no client to start (which must not count as a failure) and the
+// spread of the jittered delays.
+#include <stdint.h>
+#include "host_test.h"
+#include "mqtt_reconnect.h"
+
+// Kconfig defaults in mqtt_reconnect.c
+#define BASE_MS         1000
+#define MAX_MS          300000
+#define STABLE_US       60000000LL
+#define TIMEOUT_US      30000000LL      // ATTEMPT_TIMEOUT_US
+
+static int64_t now_us;
+static mqtt_reconnect_action_t action;
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static uint32_t rng_state = 2463534242u;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void post(mqtt_reconnect_event_t event)
+{
+    action = mqtt_reconnect_event(event, now_us);
+}
+
+// Let the armed timer expire and deliver it
+static void fire_timer(void)
+{
+    now_us += action.timer_us;
+    post(MQTT_RECONNECT_EV_TIMER);
+}
+
+static mqtt_reconnect_stats_t get_stats(void)
+{
+    mqtt_reconnect_stats_t stats;
+    mqtt_reconnect_get_stats(&stats);
+    return stats;
+}
+
+// Without a random source the delay is the ceiling itself
+static void start(uint32_t (*random_fn)(void))
+{
+    now_us = 1000000;
+    mqtt_reconnect_init(random_fn);
+    post(MQTT_RECONNECT_EV_NETWORK_UP);
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_first_connect(void)
+{
+    start(NULL);
+    CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_WAITING);
+    CHECK(!action.connect);
+    CHECK_EQ(action.timer_us, BASE_MS * 1000LL);
+    
+    fire_timer();
+    CHECK(action.connect);
+    CHECK_EQ(action.timer_us, TIMEOUT_US);
+    CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_CONNECTING);
+    
+    now_us += 800000;
+    post(MQTT_RECONNECT_EV_CONNECTED);
+    CHECK(!action.connect);
+    CHECK_EQ(action.timer_us, 0);
+    
+    mqtt_reconnect_stats_t stats = get_stats();
+    CHECK_EQ(stats.state, MQTT_RECONNECT_CONNECTED);
+    CHECK_EQ(stats.attempts, 1);
+    CHECK_EQ(stats.connected, 1);
+    CHECK_EQ(stats.failed, 0);
+    CHECK_EQ(stats.streak, 0);
+}
+
+static void test_backoff_doubles_to_cap(void)
+{
+    start(NULL);
+    int64_t expect_ms = BASE_MS;
+    
+    for (int i = 0; i < 20; i++) {
+        CHECK_EQ(action.timer_us, expect_ms * 1000);
+        fire_timer();
+        CHECK(action.connect);
+        post(MQTT_RECONNECT_EV_DISCONNECTED);
+        CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_WAITING);
+        
+        expect_ms *= 2;
+        if (expect_ms > MAX_MS) expect_ms = MAX_MS;
+    }
+    
+    mqtt_reconnect_stats_t stats = get_stats();
+    CHECK_EQ(action.timer_us, MAX_MS * 1000LL);
+    CHECK_EQ(stats.failed, 20);
+    CHECK_EQ(stats.streak, 20);
+    CHECK_EQ(stats.streak_max, 20);
+    CHECK_EQ(stats.ceiling_ms, MAX_MS);
+    
+    // A local outage starts over from the base
+    post(MQTT_RECONNECT_EV_NETWORK_DOWN);
+    CHECK_EQ(action.timer_us, 0);
+    post(MQTT_RECONNECT_EV_NETWORK_UP);
+    CHECK_EQ(action.timer_us, BASE_MS * 1000LL);
+    CHECK_EQ(get_stats().streak, 0);
+}
+
+static void test_attempt_timeout(void)
+{
+    start(NULL);
+    fire_timer();
+    CHECK(action.connect);
+    
+    // No CONNACK and no error: the attempt timer ends it
+    fire_timer();
+    mqtt_reconnect_stats_t stats = get_stats();
+    CHECK(!action.connect);
+    CHECK_EQ(stats.timeouts, 1);
+    CHECK_EQ(stats.failed, 1);
+    CHECK_EQ(stats.state, MQTT_RECONNECT_WAITING);
+    CHECK_EQ(action.timer_us, 2 * BASE_MS * 1000LL);
+}
+
+static void test_stale_timer_ignored(void)
+{
+    start(NULL);
+    fire_timer();
+    CHECK(action.connect);
+    
+    // A timer from the backoff that fires late, well before the attempt's own
+    now_us += 1000;
+    post(MQTT_RECONNECT_EV_TIMER);
+    CHECK(!action.connect);
+    CHECK_EQ(action.timer_us, -1);
+    CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_CONNECTING);
+    CHECK_EQ(get_stats().timeouts, 0);
+}
+
+static void test_flapping_keeps_backoff(void)
+{
+    start(NULL);
+    fire_timer();
+    post(MQTT_RECONNECT_EV_CONNECTED);
+    
+    // Dropped straight away: counts towards the streak
+    now_us += 5000000;
+    post(MQTT_RECONNECT_EV_DISCONNECTED);
+    mqtt_reconnect_stats_t stats = get_stats();
+    CHECK_EQ(stats.lost, 1);
+    CHECK_EQ(stats.flapped, 1);
+    CHECK_EQ(stats.streak, 1);
+    CHECK_EQ(action.timer_us, 2 * BASE_MS * 1000LL);
+    
+    // Dropped after it was stable: the backoff resets
+    fire_timer();
+    post(MQTT_RECONNECT_EV_CONNECTED);
+    now_us += STABLE_US;
+    post(MQTT_RECONNECT_EV_DISCONNECTED);
+    stats = get_stats();
+    CHECK_EQ(stats.lost, 2);
+    CHECK_EQ(stats.flapped, 1);
+    CHECK_EQ(stats.streak, 0);
+    CHECK_EQ(stats.streak_max, 1);
+    CHECK_EQ(action.timer_us, BASE_MS * 1000LL);
+}
+
+static void test_network_down(void)
+{
+    start(NULL);
+    fire_timer();
+    post(MQTT_RECONNECT_EV_CONNECTED);
+    
+    post(MQTT_RECONNECT_EV_NETWORK_DOWN);
+    CHECK_EQ(action.timer_us, 0);
+    CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_OFFLINE);
+    CHECK_EQ(get_stats().lost, 1);
+    
+    // Nothing is scheduled until the network returns
+    now_us += TIMEOUT_US;
+    post(MQTT_RECONNECT_EV_TIMER);
+    CHECK(!action.connect);
+    post(MQTT_RECONNECT_EV_DISCONNECTED);
+    CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_OFFLINE);
+    CHECK_EQ(get_stats().failed, 0);
+}
+
+static void test_no_client_is_not_a_failure(void)
+{
+    start(NULL);
+    fire_timer();
+    CHECK(action.connect);
+    
+    // The caller had no client to start: retried at the base delay
+    post(MQTT_RECONNECT_EV_DEFERRED);
+    mqtt_reconnect_stats_t stats = get_stats();
+    CHECK(!action.connect);
+    CHECK_EQ(action.timer_us, BASE_MS * 1000LL);
+    CHECK_EQ(stats.state, MQTT_RECONNECT_WAITING);
+    CHECK_EQ(stats.attempts, 0);
+    CHECK_EQ(stats.failed, 0);
+    CHECK_EQ(stats.streak, 0);
+    CHECK_EQ(stats.ceiling_ms, 2 * BASE_MS);
+    
+    fire_timer();
+    CHECK(action.connect);
+    post(MQTT_RECONNECT_EV_CONNECTED);
+    stats = get_stats();
+    CHECK_EQ(stats.attempts, 1);
+    CHECK_EQ(stats.connected, 1);
+    
+    // Only meaningful while an attempt is being started
+    post(MQTT_RECONNECT_EV_DEFERRED);
+    CHECK_EQ(action.timer_us, -1);
+    CHECK_EQ(mqtt_reconnect_get_state(), MQTT_RECONNECT_CONNECTED);
+}
+
+static void test_start_failed_counts(void)
+{
+    start(NULL);
+    fire_timer();
+    post(MQTT_RECONNECT_EV_START_FAILED);
+    mqtt_reconnect_stats_t stats = get_stats();
+    CHECK_EQ(stats.failed, 1);
+    CHECK_EQ(stats.streak, 1);
+    CHECK_EQ(action.timer_us, 2 * BASE_MS * 1000LL);
+}
+
+static void test_jitter_within_ceiling(void)
+{
+    start(rng);
+    
+    // Fail at the cap many times over and look at the delays drawn
+    int64_t min_us = INT64_MAX;
+    int64_t max_us = 0;
+    int64_t sum_us = 0;
+    const int draws = 2000;
+    for (int i = 0; i < draws; i++) {
+        CHECK(action.timer_us > 0);
+        int64_t ceiling_us = (int64_t)(i < 9 ? BASE_MS << i : MAX_MS) * 1000;
+        CHECK(action.timer_us <= ceiling_us);
+        if (i >= 9) {
+            if (action.timer_us < min_us) min_us = action.timer_us;
+            if (action.timer_us > max_us) max_us = action.timer_us;
+            sum_us += action.timer_us;
+        }
+        fire_timer();
+        post(MQTT_RECONNECT_EV_DISCONNECTED);
+    }
+    
+    // Full jitter: spread over the whole range, averaging about half of it
+    double mean_ms = (double)sum_us / (draws - 9) / 1000;
+    CHECK(min_us < MAX_MS * 1000LL / 10);
+    CHECK(max_us > MAX_MS * 1000LL * 9 / 10);
+    CHECK(mean_ms > MAX_MS * 0.4 && mean_ms < MAX_MS * 0.6);
+}
+
+int main(void)
+{
+    RUN_TEST(test_first_connect);
+    RUN_TEST(test_backoff_doubles_to_cap);
+    RUN_TEST(test_attempt_timeout);
+    RUN_TEST(test_stale_timer_ignored);
+    RUN_TEST(test_flapping_keeps_backoff);
+    RUN_TEST(test_network_down);
+    RUN_TEST(test_no_client_is_not_a_failure);
+    RUN_TEST(test_start_failed_counts);
+    RUN_TEST(test_jitter_within_ceiling);
+    return HOST_TEST_RESULT();
+}
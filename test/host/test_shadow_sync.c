@@ -0,0 +1,173 @@
+// smart_plug/test/host/test_shadow_sync.c
+//
+// shadow_sync: retries of unanswered and rejected updates, and resuming a
+// session from the shadow version instead of resending the whole document.
+#include <string.h>
+#include "host_test.h"
+#include "shadow_sync.h"
+
+static char buf[1024];
+static size_t len;
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static void set_fields(int power)
+{
+    char text[16];
+    shadow_sync_set_str(SHADOW_FIELD_DEVICE_ID, "plug");
+    shadow_sync_set_str(SHADOW_FIELD_FW_VERSION, "1.2.0");
+    snprintf(text, sizeof(text), "%d", power);
+    shadow_sync_set_str(SHADOW_FIELD_POWER, text);
+    shadow_sync_set_str(SHADOW_FIELD_RELAY_STATUS, "true");
+}
+
+// Build and publish; returns the document or NULL
+static const char *send(int64_t now_ms)
+{
+    const char *doc = shadow_sync_build(buf, sizeof(buf), &len, now_ms);
+    if (doc) shadow_sync_published(true);
+    return doc;
+}
+
+// clientToken of the last built document
+static const char *last_token(void)
+{
+    static char token[16];
+    const char *p = strstr(buf, "\"clientToken\":\"");
+    if (!p) return "";
+    p += strlen("\"clientToken\":\"");
+    size_t n = strcspn(p, "\"");
+    memcpy(token, p, n);
+    token[n] = '\0';
+    return token;
+}
+
+static void accept_last(int64_t version)
+{
+    const char *tok = last_token();
+    shadow_sync_accepted(tok, strlen(tok), version, true);
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_waits_for_version(void)
+{
+    shadow_sync_init();
+    shadow_sync_reset(1000);
+    set_fields(10);
+    
+    // Nothing goes out before get/accepted, until its timeout
+    CHECK(!shadow_sync_pending(1000));
+    CHECK(send(1000) == NULL);
+    CHECK(shadow_sync_pending(11001));
+    CHECK(send(11001) != NULL);
+    CHECK(strstr(buf, "device_id") != NULL);
+}
+
+static void test_resend_without_response(void)
+{
+    shadow_sync_init();
+    shadow_sync_reset(0);
+    shadow_sync_set_version(3);
+    set_fields(10);
+    CHECK(send(0) != NULL);
+    
+    CHECK(!shadow_sync_pending(5000));
+    CHECK(shadow_sync_pending(10001));
+    CHECK(send(10001) != NULL);
+    CHECK(strstr(buf, "device_id") != NULL);
+    
+    shadow_sync_stats_t stats;
+    shadow_sync_get_stats(&stats);
+    CHECK_EQ(stats.timeouts, 1);
+}
+
+static void test_rejected_fields_retried_after_delay(void)
+{
+    shadow_sync_init();
+    shadow_sync_reset(0);
+    shadow_sync_set_version(3);
+    set_fields(10);
+    CHECK(send(0) != NULL);
+    accept_last(4);
+    
+    set_fields(20);
+    CHECK(send(60000) != NULL);
+    const char *tok = last_token();
+    shadow_sync_rejected(tok, strlen(tok));
+    
+    // Held off briefly so a rejection cannot loop, then only the rejected field
+    CHECK(!shadow_sync_pending(61000));
+    CHECK(shadow_sync_pending(62000));
+    CHECK(send(62000) != NULL);
+    CHECK(strstr(buf, "\"power_reading\":\"20\"") != NULL);
+    CHECK(strstr(buf, "device_id") == NULL);
+    CHECK(!shadow_sync_pending(70000));
+}
+
+static void test_resume_at_same_version(void)
+{
+    shadow_sync_init();
+    shadow_sync_reset(0);
+    shadow_sync_set_version(7);
+    set_fields(10);
+    CHECK(send(0) != NULL);
+    accept_last(8);
+    
+    // Reconnect; one field changed while offline, the shadow did not
+    set_fields(30);
+    shadow_sync_reset(100000);
+    shadow_sync_set_version(8);
+    CHECK(shadow_sync_pending(102000));
+    CHECK(send(102000) != NULL);
+    CHECK(strstr(buf, "power_reading") != NULL);
+    CHECK(strstr(buf, "device_id") == NULL);
+    
+    shadow_sync_stats_t stats;
+    shadow_sync_get_stats(&stats);
+    CHECK_EQ(stats.resumed, 1);
+}
+
+static void test_full_document_after_foreign_write(void)
+{
+    shadow_sync_init();
+    shadow_sync_reset(0);
+    shadow_sync_set_version(7);
+    set_fields(10);
+    CHECK(send(0) != NULL);
+    accept_last(8);
+    
+    // Another client wrote reported, then the shadow moved on while offline
+    shadow_sync_accepted("app-1", 5, 9, true);
+    shadow_sync_reset(100000);
+    shadow_sync_set_version(9);
+    CHECK(send(102000) != NULL);
+    CHECK(strstr(buf, "device_id") != NULL);
+    
+    shadow_sync_init();
+    shadow_sync_reset(0);
+    shadow_sync_set_version(7);
+    set_fields(10);
+    CHECK(send(0) != NULL);
+    accept_last(8);
+    
+    // Version changed with nobody seen writing: complete document
+    shadow_sync_reset(100000);
+    shadow_sync_set_version(12);
+    CHECK(send(102000) != NULL);
+    CHECK(strstr(buf, "device_id") != NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_waits_for_version);
+    RUN_TEST(test_resend_without_response);
+    RUN_TEST(test_rejected_fields_retried_after_delay);
+    RUN_TEST(test_resume_at_same_version);
+    RUN_TEST(test_full_document_after_foreign_write);
+    return HOST_TEST_RESULT();
+}
@@ -0,0 +1,195 @@
+// smart_plug/test/host/test_ts_codec.c
+//
+// ts_codec round trips: random rows with the float and integer extremes
+// (NaN payloads, infinities, -0.0, denormals, INT64_MIN/MAX), constant and
+// alternating columns, and a full buffer, which must refuse a row whole
+// and leave what was written decodable.
+#include <stdint.h>
+#include <string.h>
+#include "host_test.h"
+#include "ts_codec.h"
+
+#define ROWS            4000
+
+static uint8_t stream[ROWS * TS_CODEC_MAX_COLUMNS * 10];
+static ts_codec_value_t rows[ROWS][TS_CODEC_MAX_COLUMNS];
+
+/*===============================================================================
+  Helpers
+  ===============================================================================*/
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint64_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static float float_bits(uint32_t bits)
+{
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static uint32_t bits_of(float f)
+{
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static float random_float(void)
+{
+    static const uint32_t special[] = {
+        0x00000000, 0x80000000,             // +0.0, -0.0
+        0x7f800000, 0xff800000,             // +inf, -inf
+        0x7fc00000, 0x7fa12345, 0xffffffff, // NaNs with different payloads
+        0x00000001, 0x807fffff,             // Denormals
+        0x7f7fffff, 0xff7fffff,             // Largest finite
+    };
+    
+    switch (rng() % 4) {
+        case 0:  return float_bits(special[rng() % (sizeof(special) / sizeof(special[0]))]);
+        case 1:  return float_bits((uint32_t)rng());
+        default: return 230.0f + (float)(rng() % 1000) / 100.0f;
+    }
+}
+
+static int64_t random_int(void)
+{
+    switch (rng() % 4) {
+        case 0:  return (rng() & 1) ? INT64_MAX : INT64_MIN;
+        case 1:  return (int64_t)rng();
+        default: return 1760000000 + (int64_t)(rng() % 120);
+    }
+}
+
+// Encode rows[0..count) and decode them again; false on any mismatch
+static bool round_trip(const ts_codec_type_t *types, uint8_t columns, int count, size_t *bytes)
+{
+    ts_codec_t enc;
+    if (!ts_codec_init(&enc, types, columns, stream, sizeof(stream))) return false;
+    for (int r = 0; r < count; r++) {
+        if (!ts_codec_put(&enc, rows[r])) return false;
+    }
+    *bytes = ts_codec_bytes(&enc);
+    
+    ts_codec_t dec;
+    ts_codec_init(&dec, types, columns, stream, *bytes);
+    for (int r = 0; r < count; r++) {
+        ts_codec_value_t row[TS_CODEC_MAX_COLUMNS];
+        if (!ts_codec_get(&dec, row)) return false;
+        for (int c = 0; c < columns; c++) {
+            bool same = (types[c] == TS_CODEC_INT) ? row[c].i == rows[r][c].i
+                                                   : bits_of(row[c].f) == bits_of(rows[r][c].f);
+            if (!same) {
+                fprintf(stderr, "row %d column %d differs\n", r, c);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+static void test_layout_checks(void)
+{
+    ts_codec_t codec;
+    ts_codec_type_t types[TS_CODEC_MAX_COLUMNS + 1] = {0};
+    CHECK(!ts_codec_init(&codec, types, 0, stream, sizeof(stream)));
+    CHECK(!ts_codec_init(&codec, types, TS_CODEC_MAX_COLUMNS + 1, stream, sizeof(stream)));
+    CHECK(ts_codec_init(&codec, types, TS_CODEC_MAX_COLUMNS, stream, sizeof(stream)));
+}
+
+static void test_random_extremes(void)
+{
+    // Every column count, types mixed
+    for (uint8_t columns = 1; columns <= TS_CODEC_MAX_COLUMNS; columns++) {
+        ts_codec_type_t types[TS_CODEC_MAX_COLUMNS];
+        for (int c = 0; c < columns; c++) {
+            types[c] = (c % 2) ? TS_CODEC_FLOAT : TS_CODEC_INT;
+        }
+        for (int r = 0; r < ROWS; r++) {
+            for (int c = 0; c < columns; c++) {
+                if (types[c] == TS_CODEC_INT) {
+                    rows[r][c].i = random_int();
+                } else {
+                    rows[r][c].f = random_float();
+                }
+            }
+        }
+        size_t bytes;
+        CHECK(round_trip(types, columns, ROWS, &bytes));
+    }
+}
+
+static void test_constant_and_alternating(void)
+{
+    static const ts_codec_type_t types[] = { TS_CODEC_INT, TS_CODEC_FLOAT, TS_CODEC_FLOAT };
+    for (int r = 0; r < ROWS; r++) {
+        rows[r][0].i = 42;
+        rows[r][1].f = 230.5f;
+        rows[r][2].f = (r % 2) ? 0.0f : -0.0f;
+    }
+    
+    // Unchanged columns cost one byte (int) and one bit (float) per row
+    size_t bytes;
+    CHECK(round_trip(types, 3, ROWS, &bytes));
+    CHECK(bytes < (size_t)ROWS * 2);
+}
+
+static void test_full_buffer(void)
+{
+    static const ts_codec_type_t types[] = { TS_CODEC_INT, TS_CODEC_FLOAT };
+    uint8_t small[80];
+    
+    // Many sizes, so refusals land at every bit offset within a byte
+    for (size_t size = 16; size <= sizeof(small); size++) {
+        ts_codec_t enc;
+        CHECK(ts_codec_init(&enc, types, 2, small, size));
+        
+        int written = 0;
+        for (int r = 0; r < ROWS; r++) {
+            rows[r][0].i = random_int();
+            rows[r][1].f = random_float();
+            size_t before = enc.bit_pos;
+            if (!ts_codec_put(&enc, rows[r])) {
+                CHECK_EQ(enc.bit_pos, before);
+                break;
+            }
+            written++;
+        }
+        CHECK(written > 0 && written < ROWS);
+        
+        // A repeat of the last row is the cheapest there is; if it still
+        // fits, the refused row must not have left bits behind for it
+        memcpy(rows[written], rows[written - 1], sizeof(rows[0]));
+        if (ts_codec_put(&enc, rows[written])) written++;
+        CHECK_EQ(enc.rows, written);
+        
+        ts_codec_t dec;
+        ts_codec_init(&dec, types, 2, small, ts_codec_bytes(&enc));
+        for (int r = 0; r < written; r++) {
+            ts_codec_value_t row[2];
+            CHECK(ts_codec_get(&dec, row));
+            CHECK_EQ(row[0].i, rows[r][0].i);
+            CHECK_EQ(bits_of(row[1].f), bits_of(rows[r][1].f));
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_layout_checks);
+    RUN_TEST(test_random_extremes);
+    RUN_TEST(test_constant_and_alternating);
+    RUN_TEST(test_full_buffer);
+    return HOST_TEST_RESULT();
+}
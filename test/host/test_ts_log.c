@@ -0,0 +1,234 @@
+// smart_plug/test/host/test_ts_log.c
+//
+// Time-series log on an emulated "storage" partition: paging through runs
+// of equal timestamps, remounting after a reboot at every write position,
+// wrapping over the oldest blocks and skipping torn or corrupt frames.
+#include <string.h>
+#include "host_test.h"
+#include "flash_emu.h"
+#include "ts_log.h"
+
+#define PARTITION_SIZE  (16 * 4096)
+#define BLOCK_SIZE      4096
+#define PAGE_SIZE       256
+#define PAGES           (BLOCK_SIZE / PAGE_SIZE)
+#define BLOCK_HEADER    16
+#define FRAME_HEADER    12
+#define FRAME_MARKER    0xA5
+
+static void setup(void)
+{
+    flash_emu_create("storage", PARTITION_SIZE);
+    ts_log_init();
+}
+
+static ts_log_stats_t get_stats(void)
+{
+    ts_log_stats_t stats;
+    ts_log_get_stats(&stats);
+    return stats;
+}
+
+// Flash address of a frame (page 0 follows the block header)
+static uint8_t *frame_at(uint32_t block, uint32_t page)
+{
+    return flash_emu_data("storage") + block * BLOCK_SIZE + page * PAGE_SIZE +
+           (page == 0 ? BLOCK_HEADER : 0);
+}
+
+// One record per frame, so frames and pages can be counted
+static bool append_frame(uint32_t ts)
+{
+    return ts_log_append(ts, 230.0f, 1.0f, (float)ts, 0) && ts_log_flush();
+}
+
+/*===============================================================================
+  Tests
+  ===============================================================================*/
+
+// A reader that stops inside a run of equal timestamps resumes at that
+// timestamp and skips what it already has, without losing the rest of the run
+static void test_resume_inside_timestamp_run(void)
+{
+    setup();
+    
+    // 1000..1009, then a run of 30 records clamped to 1010, then 1011..1019
+    uint32_t ts = 1000;
+    int id = 0;
+    for (; id < 10; id++) {
+        CHECK(ts_log_append(ts++, 230.0f, 1.0f, (float)id, 0));
+    }
+    for (int i = 0; i < 30; i++, id++) {
+        CHECK(ts_log_append(ts, 230.0f, 1.0f, (float)id, 0));
+    }
+    ts++;
+    for (; id < 49; id++) {
+        CHECK(ts_log_append(ts++, 230.0f, 1.0f, (float)id, 0));
+    }
+    CHECK(ts_log_flush());
+    
+    // Page through in batches of 7, as store_forward does
+    ts_record_t batch[7];
+    uint32_t from = 1000, skip = 0;
+    int expected = 0;
+    for (;;) {
+        size_t n = ts_log_query_from(from, skip, 2000, batch, 7);
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) {
+            CHECK_EQ((int)batch[i].power, expected);
+            expected++;
+        }
+        
+        uint32_t last = batch[n - 1].timestamp;
+        uint32_t at_last = 0;
+        for (size_t i = n; i > 0 && batch[i - 1].timestamp == last; i--) {
+            at_last++;
+        }
+        skip = (last == from) ? skip + at_last : at_last;
+        from = last;
+    }
+    CHECK_EQ(expected, 49);
+}
+
+static void test_skip_stops_at_later_timestamps(void)
+{
+    setup();
+    for (uint32_t i = 0; i < 5; i++) {
+        CHECK(ts_log_append(2000 + i, 230.0f, 1.0f, (float)i, 0));
+    }
+    
+    // More to skip than there are records at from_ts: later records still come
+    ts_record_t out[8];
+    CHECK_EQ(ts_log_query_from(2000, 3, 3000, out, 8), 4);
+    CHECK_EQ(out[0].timestamp, 2001);
+}
+
+// After a reboot the write position is found by binary search over the
+// pages of the newest block; check it for every fill level
+static void test_remount_finds_write_position(void)
+{
+    for (uint32_t frames = 1; frames <= PAGES; frames++) {
+        setup();
+        for (uint32_t i = 0; i < frames; i++) {
+            CHECK(append_frame(1000 + i));
+        }
+        
+        // Reboot, then an older timestamp is clamped to the newest on flash
+        uint64_t erased = flash_emu_get_stats("storage").sectors_erased;
+        CHECK(ts_log_init());
+        CHECK(ts_log_append(500, 230.0f, 1.0f, 0.0f, 0));
+        CHECK(ts_log_flush());
+        
+        // The new frame lands on the first free page, not over a written one
+        uint32_t block = frames < PAGES ? 0 : 1;
+        uint32_t page = frames < PAGES ? frames : 0;
+        CHECK_EQ(frame_at(block, page)[0], FRAME_MARKER);
+        if (page + 1 < PAGES) {
+            CHECK_EQ(frame_at(block, page + 1)[0], 0xFF);
+        }
+        CHECK_EQ(flash_emu_get_stats("storage").sectors_erased, erased + (block == 1));
+        
+        ts_record_t out[PAGES + 1];
+        CHECK_EQ(ts_log_query(0, 5000, out, PAGES + 1), frames + 1);
+        for (uint32_t i = 0; i < frames; i++) {
+            CHECK_EQ(out[i].timestamp, 1000 + i);
+        }
+        CHECK_EQ(out[frames].timestamp, 1000 + frames - 1);
+    }
+}
+
+// Filling the partition reuses the oldest block, dropping its records
+static void test_wrap_overwrites_oldest(void)
+{
+    setup();
+    ts_log_stats_t before = get_stats();
+    
+    // 16 frames per block, 16 blocks: the last 48 frames reuse blocks 0-2
+    const uint32_t total = 16 * 16 + 48;
+    for (uint32_t i = 0; i < total; i++) {
+        CHECK(append_frame(1000 + i));
+    }
+    
+    ts_log_stats_t stats = get_stats();
+    CHECK_EQ(stats.records_overwritten - before.records_overwritten, 48);
+    CHECK_EQ(stats.blocks_used, 16);
+    CHECK_EQ(stats.min_erase_count, 1);
+    CHECK_EQ(stats.max_erase_count, 2);
+    
+    // The rest reads back oldest first, across the wrap, before and after a reboot
+    static ts_record_t out[16 * 16 + 48];
+    for (int mount = 0; mount < 2; mount++) {
+        CHECK_EQ(ts_log_query(0, 5000, out, total), total - 48);
+        for (uint32_t i = 0; i < total - 48; i++) {
+            CHECK_EQ(out[i].timestamp, 1000 + 48 + i);
+        }
+        CHECK(ts_log_init());
+    }
+    
+    // Writing continues in block 3, which holds the oldest records
+    CHECK(append_frame(1000 + total));
+    CHECK_EQ(get_stats().records_overwritten - before.records_overwritten, 64);
+    CHECK_EQ(ts_log_query(0, 5000, out, total), total - 64 + 1);
+    CHECK_EQ(out[0].timestamp, 1000 + 64);
+}
+
+// Frames that fail their CRC (power lost while programming) or carry an
+// impossible length are skipped and counted, without losing their neighbours
+static void test_bad_frames_skipped(void)
+{
+    setup();
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(append_frame(1000 + i));
+    }
+    ts_log_stats_t before = get_stats();
+    
+    // Page 1: torn, the end of its payload never programmed
+    uint8_t *torn = frame_at(0, 1);
+    uint16_t length = torn[2] | torn[3] << 8;
+    CHECK(length > 2);
+    memset(torn + FRAME_HEADER + length - 2, 0xFF, 2);
+    
+    // Page 2: a length that cannot fit the page
+    frame_at(0, 2)[3] = 0x7F;
+    
+    ts_record_t out[8];
+    CHECK_EQ(ts_log_query(0, 5000, out, 8), 2);
+    CHECK_EQ(out[0].timestamp, 1000);
+    CHECK_EQ(out[1].timestamp, 1003);
+    CHECK_EQ(get_stats().frame_errors - before.frame_errors, 2);
+}
+
+// A frame torn by a reset is not taken as the newest: the clamp uses the
+// last good frame and writing resumes past the torn page
+static void test_torn_last_frame_on_remount(void)
+{
+    setup();
+    for (uint32_t i = 0; i < 3; i++) {
+        CHECK(append_frame(1000 + i * 10));
+    }
+    uint8_t *torn = frame_at(0, 2);
+    uint16_t length = torn[2] | torn[3] << 8;
+    memset(torn + FRAME_HEADER + length / 2, 0xFF, length - length / 2);
+    
+    CHECK(ts_log_init());
+    CHECK(ts_log_append(1005, 230.0f, 1.0f, 0.0f, 0));
+    CHECK(ts_log_flush());
+    CHECK_EQ(frame_at(0, 3)[0], FRAME_MARKER);
+    
+    ts_record_t out[8];
+    CHECK_EQ(ts_log_query(0, 5000, out, 8), 3);
+    CHECK_EQ(out[0].timestamp, 1000);
+    CHECK_EQ(out[1].timestamp, 1010);
+    CHECK_EQ(out[2].timestamp, 1010);
+}
+
+int main(void)
+{
+    RUN_TEST(test_resume_inside_timestamp_run);
+    RUN_TEST(test_skip_stops_at_later_timestamps);
+    RUN_TEST(test_remount_finds_write_position);
+    RUN_TEST(test_wrap_overwrites_oldest);
+    RUN_TEST(test_bad_frames_skipped);
+    RUN_TEST(test_torn_last_frame_on_remount);
+    return HOST_TEST_RESULT();
+}